@@ -17,47 +17,65 @@
 
 #ifndef AT_HISTORY_H
 #define AT_HISTORY_H
-#include <string>
-#include <vector>
+#include <cstddef>
+#include <cstring>
 
+/* entries kept at most, and the longest line stored (longer ones are not) */
+#define AT_HISTORY_MAX_ENTRIES      10
+#define AT_HISTORY_LINE_MAX         128
+
+/**
+ * Command history in a fixed ring of line buffers, adding a command does
+ * not allocate. Entry 0 is the oldest, position count() is past the
+ * newest (the empty line being typed).
+ */
 class ATHistory {
 private:
-    std::vector<std::string> history;
+    char lines[AT_HISTORY_MAX_ENTRIES][AT_HISTORY_LINE_MAX];
     const size_t history_max_size;
+    size_t first;       // ring slot of the oldest entry
+    size_t count;
     size_t history_position;
 
+    const char *entry(size_t ix)
+    {
+        return lines[(first + ix) % AT_HISTORY_MAX_ENTRIES];
+    }
+
 public:
-    ATHistory(size_t max_size = 10)
-        : history_max_size(max_size)
+    ATHistory(size_t max_size = AT_HISTORY_MAX_ENTRIES)
+        : history_max_size((max_size < AT_HISTORY_MAX_ENTRIES) ? max_size : AT_HISTORY_MAX_ENTRIES)
+        , first(0)
+        , count(0)
         , history_position(0) {};
 
-    std::string go_back(void)
+    const char *go_back(void)
     {
         if (!is_at_begin()) {
             history_position--;
         }
 
-        if (history.size() == 0) {
-            return std::string("");
+        if (count == 0) {
+            return "";
         }
         else {
-            return history[history_position];
+            return entry(history_position);
         }
     }
 
-    std::string go_next(void)
+    const char *go_next(void)
     {
-        if (++history_position >= history.size()) {
-            history_position = history.size();
-            return std::string("");
+        if (++history_position >= count) {
+            history_position = count;
+            return "";
         }
 
-        return history[history_position];
+        return entry(history_position);
     }
 
     bool is_at_end(void)
     {
-        return history_position == history.size();
+        return history_position == count;
     }
 
     bool is_at_begin(void)
@@ -65,20 +83,40 @@ public:
         return history_position == 0;
     }
 
-    void add(std::string &entry)
+    void add(const char *line, size_t len)
     {
         // don't add empty entries
-        if (entry == "") {
+        if (len == 0) {
             return;
         }
 
-        history.push_back(entry);
+        // nor ones that don't fit a slot
+        if (len >= AT_HISTORY_LINE_MAX || history_max_size == 0) {
+            history_position = count;
+            return;
+        }
 
-        if (history.size() > history_max_size) {
-            history.erase(history.begin());
+        // nor repeats of the last one (commands sent in a loop)
+        if (count > 0) {
+            const char *last = entry(count - 1);
+            if (strncmp(last, line, len) == 0 && last[len] == '\0') {
+                history_position = count;
+                return;
+            }
         }
 
-        history_position = history.size();
+        // full: the newest entry takes the slot of the oldest
+        if (count == history_max_size) {
+            first = (first + 1) % AT_HISTORY_MAX_ENTRIES;
+            count--;
+        }
+
+        char *slot = lines[(first + count) % AT_HISTORY_MAX_ENTRIES];
+        memcpy(slot, line, len);
+        slot[len] = '\0';
+        count++;
+
+        history_position = count;
     }
 };
 
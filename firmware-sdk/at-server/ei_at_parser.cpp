@@ -16,84 +16,88 @@
  */
 
 #include "ei_at_parser.h"
-
-using namespace std;
+#include <cstring>
 
 void ATParser::init_result(void)
 {
     last_result.type = AT_UNKNOWN;
-    last_result.command.clear();
-    last_result.arguments.clear();
-    last_result.max_arg_len = 0;
+    last_result.command = "";
+    last_result.argc = 0;
 }
 
-const ATParseResult_t &ATParser::parse(string input)
+const ATParseResult_t &ATParser::parse(char *line, size_t length)
 {
-    string tmp;
-    size_t pos = string::npos;
-    size_t delim1 = string::npos;
-    size_t delim2 = string::npos;
+    char *end = line + length;
+    char *pos;
+    int commas = 0;
 
     this->init_result();
 
-    if (input.size() == 0) {
-        last_result.type = AT_UNKNOWN;
-        return last_result;
+    // trim leading whitespaces
+    while (line < end && (*line == ' ' || *line == '\t')) {
+        line++;
     }
 
-    // trim leading whitespaces
-    input = input.substr(input.find_first_not_of(" \t"));
+    // trim spaces, newline and CR at the end
+    while (end > line && (end[-1] == ' ' || end[-1] == '\r' || end[-1] == '\n')) {
+        end--;
+    }
 
-    if (input.rfind("AT+", 0) != 0) {
-        last_result.type = AT_UNKNOWN;
+    if (end - line < 3 || strncmp(line, "AT+", 3) != 0) {
         return last_result;
     }
 
     //remove "AT+"
-    input = input.substr(3);
-
-    // trim spaces, newline and CR at the end
-    input = input.erase(input.find_last_not_of(" \r\n") + 1);
+    line += 3;
 
     // extract command itself
-    pos = input.find_first_of("?=");
-    last_result.command = input.substr(0, pos);
+    pos = line;
+    while (pos < end && *pos != '?' && *pos != '=') {
+        pos++;
+    }
 
-    if (pos == string::npos) {
-        last_result.type = AT_RUN;
+    if (pos < end && *pos == '=') {
+        for (char *c = pos + 1; c < end; c++) {
+            if (*c == ',') {
+                commas++;
+            }
+        }
+        if (commas >= AT_MAX_ARGS) {
+            return last_result;
+        }
     }
-    else if (input.at(pos) == '=') {
-        last_result.type = AT_WRITE;
+
+    // valid, from here on the line is split in place
+    if (pos == end) {
+        last_result.type = AT_RUN;
     }
-    else if (input.at(pos) == '?') {
+    else if (*pos == '?') {
         last_result.type = AT_READ;
     }
     else {
-        last_result.type = AT_UNKNOWN;
+        last_result.type = AT_WRITE;
     }
+    *end = '\0';
+    last_result.command = line;
 
     // check if command has arguments and extract them
-    if (pos != string::npos && input.at(pos) == '=') {
-        delim1 = pos;
-        delim2 = input.find_first_of(",", pos);
-        // we have arguments, let's extract them
-        while (delim2 != string::npos) {
-            //TODO: support args in a quote
-            tmp = string(input, delim1 + 1, delim2 - delim1 - 1);
-            last_result.arguments.push_back(tmp);
-            if (tmp.size() > last_result.max_arg_len) {
-                last_result.max_arg_len = tmp.size();
+    if (last_result.type == AT_WRITE) {
+        char *arg = pos + 1;
+        //TODO: support args in a quote
+        while (true) {
+            last_result.arguments[last_result.argc++] = arg;
+            char *comma = (char *)memchr(arg, ',', end - arg);
+            if (comma == nullptr) {
+                break;
             }
-            delim1 = delim2;
-            delim2 = input.find_first_of(",", delim1 + 1);
-        }
-        //there is one more argument, behind last comma so, get it until end of command
-        tmp = string(input, delim1 + 1);
-        last_result.arguments.push_back(tmp);
-        if (tmp.size() > last_result.max_arg_len) {
-            last_result.max_arg_len = tmp.size();
+            *comma = '\0';
+            arg = comma + 1;
         }
     }
 
+    if (pos < end) {
+        *pos = '\0';
+    }
+
     return last_result;
 }
@@ -17,8 +17,10 @@
 
 #ifndef AT_PARSER_H
 #define AT_PARSER_H
-#include <string>
-#include <vector>
+#include <cstddef>
+
+/* arguments of a write command, a line with more is not valid */
+#define AT_MAX_ARGS 16
 
 enum ATCommandType_t
 {
@@ -28,11 +30,12 @@ enum ATCommandType_t
     AT_UNKNOWN
 };
 
+/* command and arguments point into the parsed line */
 typedef struct {
     ATCommandType_t type;
-    std::string command;
-    std::vector<std::string> arguments;
-    unsigned int max_arg_len;
+    const char *command;
+    const char *arguments[AT_MAX_ARGS];
+    int argc;
 } ATParseResult_t;
 
 class ATParser {
@@ -43,7 +46,13 @@ private:
 public:
     ATParser() {};
     ~ATParser() {};
-    const ATParseResult_t &parse(std::string command);
+    /**
+     * @brief Tokenize line in place: the command and every argument are
+     * terminated by overwriting the separator after it, nothing is copied.
+     * line[length] must be writable (the string terminator). The line is
+     * only changed if it is a valid command.
+     */
+    const ATParseResult_t &parse(char *line, size_t length);
 };
 
 #endif /* AT_PARSER_H */
\ No newline at end of file
@@ -78,6 +78,64 @@ void ATServer::register_default_commands(void)
     tmp.run_handler = at_info;
 
     this->registered_commands.push_back(tmp);
+
+    this->build_command_index();
+}
+
+// FNV-1a
+static uint32_t command_hash(const char *cmd)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*cmd) {
+        hash ^= (uint8_t)*cmd++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Rebuild the hash index after registered_commands changed. The table
+ * is kept at most half full, so a lookup is a hash and usually one compare.
+ */
+void ATServer::build_command_index(void)
+{
+    size_t size = 16;
+
+    while (size < 2 * this->registered_commands.size()) {
+        size *= 2;
+    }
+
+    this->command_index.assign(size, 0);
+
+    for (size_t ix = 0; ix < this->registered_commands.size(); ix++) {
+        size_t slot = command_hash(this->registered_commands[ix].command.c_str()) & (size - 1);
+        while (this->command_index[slot] != 0) {
+            slot = (slot + 1) & (size - 1);
+        }
+        this->command_index[slot] = (uint16_t)(ix + 1);
+    }
+}
+
+ATCommand_t *ATServer::find_command(const char *cmd)
+{
+    if (this->command_index.empty()) {
+        return nullptr;
+    }
+
+    size_t mask = this->command_index.size() - 1;
+    size_t slot = command_hash(cmd) & mask;
+
+    while (this->command_index[slot] != 0) {
+        ATCommand_t *it = &this->registered_commands[this->command_index[slot] - 1];
+        if (strcmp(it->command.c_str(), cmd) == 0) {
+            return it;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return nullptr;
 }
 
 /**
@@ -96,16 +154,14 @@ bool ATServer::register_command(ATCommand_t &command)
     }
 
     // check if command exists
-    for (auto it = this->registered_commands.begin(); it != this->registered_commands.end(); ++it) {
-        if (it->command == command.command) {
-            // remove command that is already exist
-            this->registered_commands.erase(it);
-            // there shouldn't be another handler for same command
-            break;
-        }
+    ATCommand_t *existing = this->find_command(command.command.c_str());
+    if (existing != nullptr) {
+        // remove command that is already exist
+        this->registered_commands.erase(this->registered_commands.begin() + (existing - &this->registered_commands[0]));
     }
 
     this->registered_commands.push_back(command);
+    this->build_command_index();
 
     return true;
 }
@@ -139,21 +195,21 @@ bool ATServer::register_handlers(
     bool (*write_handler)(const char **, const int),
     const char *write_handler_args_list)
 {
-    for (auto it = registered_commands.begin(); it != registered_commands.end(); ++it) {
-        if (it->command.compare(cmd) == 0) {
-            //TODO: add sanity checks?
-            it->run_handler = run_handler;
-            it->read_handler = read_handler;
-            it->write_handler = write_handler;
-            //TODO: parse write_handler_args_list and update write_handler_arg_count
-            if (write_handler_args_list != nullptr) {
-                it->write_handler_args_list = string(write_handler_args_list);
-            }
-            return true;
-        }
+    ATCommand_t *it = this->find_command(cmd);
+
+    if (it == nullptr) {
+        return false;
     }
 
-    return false;
+    //TODO: add sanity checks?
+    it->run_handler = run_handler;
+    it->read_handler = read_handler;
+    it->write_handler = write_handler;
+    //TODO: parse write_handler_args_list and update write_handler_arg_count
+    if (write_handler_args_list != nullptr) {
+        it->write_handler_args_list = string(write_handler_args_list);
+    }
+    return true;
 }
 
 bool ATServer::print_help(void)
@@ -337,11 +393,10 @@ void ATServer::handle(char c)
     case '\r': /* want to run the buffer */
         ei_putchar(c);
         ei_putchar('\n');
-        tmp = buffer.get_string();
+        history.add(buffer.data(), buffer.size());
 
-        history.add(tmp);
-
-        print_new_prompt = execute(tmp);
+        // parsed in place, the line buffer is cleared afterwards anyway
+        print_new_prompt = execute(buffer.data(), buffer.size());
 
         buffer.clear();
 
@@ -375,62 +430,46 @@ void ATServer::handle(char c)
     }
 }
 
-bool ATServer::execute(string &input)
+bool ATServer::execute(char *line, size_t length)
 {
     bool new_prompt_required = false;
-    char **args = nullptr;
-    ATParseResult_t res;
 
-    res = parser.parse(input);
+    const ATParseResult_t &res = parser.parse(line, length);
     if (res.type == AT_UNKNOWN) {
-        ei_printf("Not a valid AT command (%s)\n", input.c_str());
+        ei_printf("Not a valid AT command (%.*s)\n", (int)length, line);
         return true;
     }
 
     // exception for HELP command which is built-in
-    if (res.command == AT_HELP && res.type == AT_RUN) {
+    if (res.type == AT_RUN && strcmp(res.command, AT_HELP) == 0) {
         return this->print_help();
     }
 
     // find a command to execute
-    for (auto it = this->registered_commands.begin(); it != this->registered_commands.end(); ++it) {
-        if (it->command == res.command) {
-            // we've got a hit!
-            if (res.type == AT_RUN && it->run_handler) {
-                // simple command like AT+HELP
-                new_prompt_required = it->run_handler();
-            }
-            else if (res.type == AT_READ && it->read_handler) {
-                // read command like AT+CONFIG?
-                new_prompt_required = it->read_handler();
-            }
-            else if (res.type == AT_WRITE && it->write_handler) {
-                // write command like AT+DEVICEID=abcde
-                args = (char **)ei_malloc(res.arguments.size() * sizeof(char *));
-                for (unsigned int i = 0; i < res.arguments.size(); i++) {
-                    // one more byte for null terminator (in case of zero-length = empty argument eg. AT+RUN=123,,5)
-                    args[i] = (char *)ei_malloc(res.max_arg_len + 1);
-                    strncpy(args[i], res.arguments.at(i).c_str(), res.max_arg_len + 1);
-                }
-
-                new_prompt_required =
-                    it->write_handler((const char **)args, (int)res.arguments.size());
+    ATCommand_t *it = this->find_command(res.command);
+    if (it == nullptr) {
+        // we shouldn't be here!
+        ei_printf("Command not found! (AT+%s)\n", res.command);
+        return true;
+    }
 
-                // now we are freeing the memory
-                for (unsigned int i = 0; i < res.arguments.size(); i++) {
-                    ei_free(args[i]);
-                }
-                ei_free(args);
-            }
-            else {
-                ei_printf("No handler for command! (%s)\n", input.c_str());
-                return true;
-            }
-            return new_prompt_required;
-        }
+    if (res.type == AT_RUN && it->run_handler) {
+        // simple command like AT+HELP
+        new_prompt_required = it->run_handler();
+    }
+    else if (res.type == AT_READ && it->read_handler) {
+        // read command like AT+CONFIG?
+        new_prompt_required = it->read_handler();
+    }
+    else if (res.type == AT_WRITE && it->write_handler) {
+        // write command like AT+DEVICEID=abcde, arguments are in the line itself
+        new_prompt_required =
+            it->write_handler(const_cast<const char **>(res.arguments), res.argc);
+    }
+    else {
+        ei_printf("No handler for command! (AT+%s)\n", res.command);
+        return true;
     }
 
-    // we shouldn't be here!
-    ei_printf("Command not found! (AT+%s)\n", res.command.c_str());
-    return true;
+    return new_prompt_required;
 }
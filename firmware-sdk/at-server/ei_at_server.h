@@ -20,6 +20,7 @@
 #include "ei_at_history.h"
 #include "ei_at_parser.h"
 #include "ei_line_buffer.h"
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <vector>
@@ -43,16 +44,20 @@ class ATServer {
 private:
     ATHistory history;
     std::vector<ATCommand_t> registered_commands;
+    /* open addressing hash of registered_commands, entry = index + 1, 0 = free */
+    std::vector<uint16_t> command_index;
     LineBuffer buffer;
     ATParser parser;
     void register_default_commands(void);
+    void build_command_index(void);
+    ATCommand_t *find_command(const char *cmd);
 
 protected:
     ATServer();
     ATServer(ATCommand_t *commands, size_t length, size_t max_history_size = default_history_size);
     ~ATServer();
     bool print_help(void);
-    bool execute(std::string &command);
+    bool execute(char *line, size_t length);
 
 public:
     ATServer(ATServer &other) = delete;
@@ -96,11 +96,17 @@ public:
         return buffer.size() == 0;
     }
 
-    std::string get_string()
+    const std::string &get_string()
     {
         return buffer;
     }
 
+    /* the line itself, data()[size()] is the terminator */
+    char *data()
+    {
+        return &buffer[0];
+    }
+
     size_t get_position()
     {
         return position;
@@ -106,6 +106,54 @@ void base64_encode(const char *input, size_t input_size, void (*putc_f)(char))
     }
 }
 
+/**
+ * @brief Base64 encode into output, a group of 3 input bytes becomes one
+ *        32-bit store of 4 characters. The last group is padded.
+ *
+ * @param input
+ * @param input_size
+ * @param output at least BASE64_ENCODED_SIZE(input_size) bytes
+ * @return size_t number of characters written
+ */
+size_t base64_encode_block(const uint8_t *input, size_t input_size, char *output)
+{
+    const uint8_t *chars = (const uint8_t *)base64_chars;
+    char *out = output;
+
+    for (size_t groups = input_size / 3; groups > 0; groups--) {
+        uint32_t v = ((uint32_t)input[0] << 16) | ((uint32_t)input[1] << 8) | input[2];
+        input += 3;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+        uint32_t word = (uint32_t)chars[v >> 18] |
+                        ((uint32_t)chars[(v >> 12) & 0x3f] << 8) |
+                        ((uint32_t)chars[(v >> 6) & 0x3f] << 16) |
+                        ((uint32_t)chars[v & 0x3f] << 24);
+        memcpy(out, &word, sizeof(word));
+#else
+        out[0] = chars[v >> 18];
+        out[1] = chars[(v >> 12) & 0x3f];
+        out[2] = chars[(v >> 6) & 0x3f];
+        out[3] = chars[v & 0x3f];
+#endif
+        out += 4;
+    }
+
+    size_t rest = input_size % 3;
+    if (rest) {
+        uint32_t v = (uint32_t)input[0] << 16;
+        if (rest == 2) {
+            v |= (uint32_t)input[1] << 8;
+        }
+        out[0] = chars[v >> 18];
+        out[1] = chars[(v >> 12) & 0x3f];
+        out[2] = (rest == 2) ? chars[(v >> 6) & 0x3f] : '=';
+        out[3] = '=';
+        out += 4;
+    }
+
+    return out - output;
+}
+
 void base64_encode_chunk(const char *input, size_t input_size, void (*putc_f)(char))
 {
     static char leftover[3];
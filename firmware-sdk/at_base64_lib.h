@@ -45,12 +45,17 @@
 
 */
 
+#include <cstdint>
 #include <cstdlib>
 #include <string>
 #include <vector>
 
+/* characters base64_encode_block() writes for n input bytes */
+#define BASE64_ENCODED_SIZE(n)  ((((n) + 2) / 3) * 4)
+
 /* Function prototypes ----------------------------------------------------- */
 void base64_encode(const char *input, size_t input_size, void (*putc_f)(char));
+size_t base64_encode_block(const uint8_t *input, size_t input_size, char *output);
 void base64_encode_chunk(const char *input, size_t input_size, void (*putc_f)(char));
 void base64_encode_finish(void (*putc_f)(char));
 int base64_encode_buffer(const char *input, size_t input_size, char *output, size_t output_size);
@@ -18,6 +18,9 @@
 #ifndef EI_DEVICE_INTERFACE_H
 #define EI_DEVICE_INTERFACE_H
 
+#include <cstdint>
+#include <cstddef>
+
 /* Function prototypes ----------------------------------------------------- */
 //TODO: remove as it is device specific and wil be superseded by AT Server
 void ei_command_line_handle(void);
@@ -32,5 +35,27 @@ void ei_write_string(char *data, int length);
 //TODO: move to a one header with all method requied by FW SDK
 char ei_getchar();
 
+/**
+ * @brief      Read length bytes from the serial port into buffer (binary safe,
+ *             unlike ei_getchar). Used by the binary static data transfer.
+ *
+ * @return     false if the bytes did not arrive within timeout_ms
+ */
+bool ei_serial_read(uint8_t *buffer, size_t length, uint32_t timeout_ms);
+
+/**
+ * @brief      Send length bytes from buffer. Waits for the previous write to
+ *             finish, then may return while buffer is still being sent: keep
+ *             it unchanged until the next ei_serial_write or ei_serial_flush.
+ *
+ * @return     false if the write could not be started
+ */
+bool ei_serial_write(const uint8_t *buffer, size_t length);
+
+/**
+ * @brief      Wait until the last ei_serial_write is sent
+ */
+void ei_serial_flush(void);
+
 
 #endif /* EI_DEVICE_INTERFACE_H */
@@ -32,6 +32,13 @@ extern "C" EI_IMPULSE_ERROR run_classifier(
 float *features;
 extern char* ei_classifier_inferencing_categories[];
 
+/* Binary static data transfer, see run_impulse_static_data_binary */
+#define STATIC_BIN_SYNC         0xA5
+#define STATIC_BIN_HEADER_LEN   4
+#define STATIC_BIN_CRC_LEN      4
+#define STATIC_BIN_TIMEOUT_MS   1000
+#define STATIC_BIN_IDLE_MS      20
+
 /**
  * @brief      Call this function periocally during inference to
  *             detect a user stop command
@@ -50,7 +57,9 @@ extern bool ei_user_invoke_stop_lib(void)
 
 /**
  * @brief Helper function for sending a data from memory over the
- * serial port. Data are encoded into base64 on the fly.
+ * serial port. Data are encoded into base64 a block at a time, one
+ * output buffer is sent while the next block is read and encoded into
+ * the other.
  *
  * @param address address of samples
  * @param length number of samples (bytes)
@@ -62,33 +71,44 @@ __attribute__((weak)) bool read_encode_send_sample_buffer(size_t address, size_t
     EiDeviceInfo *dev = EiDeviceInfo::get_device();
     EiDeviceMemory *memory = dev->get_memory();
     // we are encoiding data into base64, so it needs to be divisible by 3
-    const int buffer_size = 513;
-    uint8_t* buffer = (uint8_t*)ei_malloc(buffer_size);
+    const size_t buffer_size = 1536;
+    const size_t encoded_size = BASE64_ENCODED_SIZE(buffer_size);
+    uint8_t* buffer = (uint8_t*)ei_malloc(buffer_size + 2 * encoded_size);
+    bool success = true;
+    int out_ix = 0;
 
-    while (1) {
+    if (buffer == nullptr) {
+        return false;
+    }
+
+    while (length > 0) {
         size_t bytes_to_read = buffer_size;
+        char *encoded = (char *)&buffer[buffer_size + out_ix * encoded_size];
 
         if (bytes_to_read > length) {
             bytes_to_read = length;
         }
 
-        if (bytes_to_read == 0) {
-            ei_free(buffer);
-            return true;
-        }
-
         if (memory->read_sample_data(buffer, address, bytes_to_read) != bytes_to_read) {
-            ei_free(buffer);
-            return false;
+            success = false;
+            break;
         }
 
-        base64_encode((char *)buffer, bytes_to_read, ei_putchar);
+        size_t encoded_len = base64_encode_block(buffer, bytes_to_read, encoded);
+        if (ei_serial_write((const uint8_t *)encoded, encoded_len) == false) {
+            success = false;
+            break;
+        }
+        out_ix ^= 1;
 
         address += bytes_to_read;
         length -= bytes_to_read;
     }
 
-    return true;
+    ei_serial_flush();
+    ei_free(buffer);
+
+    return success;
 }
 
 bool run_impulse_static_data(bool debug, size_t length, size_t buf_len)
@@ -156,6 +176,132 @@ bool run_impulse_static_data(bool debug, size_t length, size_t buf_len)
     return true;
 }
 
+/**
+ * @brief CRC-32 (IEEE 802.3, same as zlib.crc32), 4 bits at a time to keep
+ * the table small
+ */
+uint32_t ei_crc32_update(uint32_t crc, const uint8_t *data, size_t length)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+    crc = ~crc;
+    for (size_t ix = 0; ix < length; ix++) {
+        crc = table[(crc ^ data[ix]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[ix] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+
+    return ~crc;
+}
+
+__attribute__((weak)) bool ei_serial_write(const uint8_t *buffer, size_t length)
+{
+    for (size_t ix = 0; ix < length; ix++) {
+        ei_putchar((char)buffer[ix]);
+    }
+
+    return true;
+}
+
+__attribute__((weak)) void ei_serial_flush(void)
+{
+}
+
+__attribute__((weak)) bool ei_serial_read(uint8_t *buffer, size_t length, uint32_t timeout_ms)
+{
+    (void)buffer;
+    (void)length;
+    (void)timeout_ms;
+
+    ei_printf("ERR: Binary transfer not supported on this device\r\n");
+    return false;
+}
+
+bool run_impulse_static_data_binary(bool debug, size_t length, size_t frame_len, size_t ack_window)
+{
+    size_t total_bytes = length * sizeof(float);
+    size_t received = 0;
+    size_t window_frames = 0;
+    uint8_t expected_seq = 0;
+    uint8_t header[STATIC_BIN_HEADER_LEN];
+    uint8_t crc_buf[STATIC_BIN_CRC_LEN];
+
+    if (length == 0 || frame_len == 0 || (frame_len % sizeof(float)) != 0 || ack_window == 0) {
+        ei_printf("ERR: Invalid transfer parameters\r\n");
+        return false;
+    }
+
+    // frames are read straight into the feature buffer, no intermediate copies
+    float *data_pt = (float*)ei_malloc(total_bytes);
+    if (data_pt == NULL) {
+        ei_printf("ERR: Memory allocation for data buffer failed\r\n");
+        return false;
+    }
+
+    ei_printf("OK FRAME=%d WINDOW=%d\r\n", (int)frame_len, (int)ack_window);
+
+    while (received < total_bytes) {
+        bool frame_ok = false;
+
+        if (ei_serial_read(header, STATIC_BIN_HEADER_LEN, STATIC_BIN_TIMEOUT_MS) == false) {
+            ei_printf("TIMEOUT\r\n");
+            ei_free(data_pt);
+            ei_printf("END OUTPUT\r\n");
+            return false;
+        }
+
+        size_t payload_len = (size_t)header[2] | ((size_t)header[3] << 8);
+
+        if (header[0] == STATIC_BIN_SYNC && header[1] == expected_seq &&
+            payload_len > 0 && payload_len <= frame_len && (payload_len % sizeof(float)) == 0 &&
+            payload_len <= total_bytes - received) {
+
+            uint8_t *payload = (uint8_t*)data_pt + received;
+
+            if (ei_serial_read(payload, payload_len, STATIC_BIN_TIMEOUT_MS) == false ||
+                ei_serial_read(crc_buf, STATIC_BIN_CRC_LEN, STATIC_BIN_TIMEOUT_MS) == false) {
+                ei_printf("TIMEOUT\r\n");
+                ei_free(data_pt);
+                ei_printf("END OUTPUT\r\n");
+                return false;
+            }
+
+            uint32_t crc = ei_crc32_update(0, &header[1], STATIC_BIN_HEADER_LEN - 1);
+            crc = ei_crc32_update(crc, payload, payload_len);
+            uint32_t frame_crc = (uint32_t)crc_buf[0] | ((uint32_t)crc_buf[1] << 8) |
+                ((uint32_t)crc_buf[2] << 16) | ((uint32_t)crc_buf[3] << 24);
+
+            frame_ok = (crc == frame_crc);
+        }
+
+        if (frame_ok == false) {
+            // drop the rest of the window, the sender resends from expected_seq
+            while (ei_serial_read(header, 1, STATIC_BIN_IDLE_MS)) { }
+            ei_printf("NAK %d %d\r\n", expected_seq, (int)(received / sizeof(float)));
+            window_frames = 0;
+            continue;
+        }
+
+        received += payload_len;
+        expected_seq++;
+
+        if (++window_frames >= ack_window || received == total_bytes) {
+            ei_printf("ACK %d %d\r\n", expected_seq, (int)(received / sizeof(float)));
+            window_frames = 0;
+        }
+    }
+
+    ei_printf("TRANSFER COMPLETED %d\r\n", (int)length);
+    uint32_t res = (uint32_t)ei_start_impulse_static_data(debug, data_pt, length);
+    ei_free(data_pt);
+    ei_printf("RESULT %d\r\n", res);
+    ei_printf("END OUTPUT\r\n");
+
+    return true;
+}
+
 int raw_feature_get_data(size_t offset, size_t length, float *out_ptr)
 {
     memcpy(out_ptr, features + offset, length * sizeof(float));
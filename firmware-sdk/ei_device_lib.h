@@ -43,6 +43,30 @@ bool read_encode_send_sample_buffer(size_t address, size_t length);
 
 bool run_impulse_static_data(bool debug, size_t length, size_t buf_len);
 
+/**
+ * @brief Binary version of run_impulse_static_data. The raw data (little
+ * endian floats) is sent in frames:
+ *   0xA5 | seq (u8) | payload length (u16 LE) | payload | CRC-32 (u32 LE)
+ * with the CRC-32 (as zlib.crc32) over seq, length and payload. The payload is
+ * a multiple of 4 bytes and at most frame_len bytes. After every ack_window
+ * frames, and after the last one, the device replies ACK <next seq> <floats>.
+ * A bad frame is answered with NAK <expected seq> <floats> once the line is
+ * idle, the sender then resends from the expected frame.
+ *
+ * @param debug passed to run_classifier
+ * @param length number of floats
+ * @param frame_len maximum payload size (bytes)
+ * @param ack_window frames sent between acks
+ * @return false on timeout or allocation failure
+ */
+bool run_impulse_static_data_binary(bool debug, size_t length, size_t frame_len, size_t ack_window);
+
 EI_IMPULSE_ERROR ei_start_impulse_static_data(bool debug, float* data, size_t size);
 
+/**
+ * @brief CRC-32 as zlib.crc32, start with crc = 0 and pass the result of the
+ * previous call to continue over more data
+ */
+uint32_t ei_crc32_update(uint32_t crc, const uint8_t *data, size_t length);
+
 #endif /* EI_DEVICE_LIB_H */
@@ -349,13 +349,13 @@ bool ei_fusion_setup_data_sampling(void)
     // Check available sample size before sampling for the selected frequency
     uint32_t requested_bytes = ceil(
         (dev->get_sample_length_ms() / dev->get_sample_interval_ms()) *
-        (sizeof(fusion_sample_format_t) * num_fusion_axis) * 2);
+        ei_sampler_sample_bytes(num_fusion_axis));
     if (requested_bytes > available_bytes) {
         ei_printf(
             "ERR: Sample length is too long. Maximum allowed is %ims at ",
             (int)floor(
                 available_bytes /
-                (((sizeof(fusion_sample_format_t) * num_fusion_axis) * 2) /
+                (ei_sampler_sample_bytes(num_fusion_axis) /
                  dev->get_sample_interval_ms())));
         ei_printf_float(1.f / dev->get_sample_interval_ms());
         ei_printf("Hz.\r\n");
@@ -4,6 +4,7 @@ import os
 import sys
 import struct
 import binascii
+import zlib
 
 def encode_and_send(string, ser):
     array_to_write = (string.encode())
@@ -77,6 +78,50 @@ def send_uart(data, raw_data_len, ser, sim_timeout=False):
     response = await_response_exact("END OUTPUT\r\n", ser)
     ser.close()
 
+def binary_frames(payload, seq, frame_len):
+    frames = []
+    for pos in range(0, len(payload), frame_len):
+        chunk = payload[pos:pos + frame_len]
+        header = struct.pack('<BH', seq & 0xFF, len(chunk))
+        crc = zlib.crc32(header + chunk) & 0xFFFFFFFF
+        frames.append(b'\xA5' + header + chunk + struct.pack('<I', crc))
+        seq += 1
+    return frames
+
+def send_uart_binary(features, ser):
+
+    payload = struct.pack('<' + 'f'*len(features), *features)
+
+    time.sleep(2)
+
+    encode_and_send("AT\r", ser)
+    response = await_response_exact("> ", ser)
+
+    encode_and_send("AT+RUNIMPULSESTATICBIN=n,{}\r".format(len(features)), ser)
+    response = await_response("OK FRAME=", ser)
+
+    frame_len, window = [int(v.split('=')[1]) for v in response.split()[1:3]]
+    print("Frame size is {}, ack window {}".format(frame_len, window))
+
+    frames = binary_frames(payload, 0, frame_len)
+    next_frame = 0
+
+    while next_frame < len(frames):
+        ser.write(b''.join(frames[next_frame:next_frame + window]))
+        response = await_response("AK", ser)
+
+        if response == "TIMEOUT\r\n":
+            print("Data send time out. Terminating...")
+            ser.close()
+            sys.exit(1)
+
+        # ACK/NAK carry the next frame the device expects (sequence number mod 256)
+        seq = int(response.split()[1])
+        next_frame += (seq - next_frame) & 0xFF
+
+    response = await_response_exact("END OUTPUT\r\n", ser)
+    ser.close()
+
 if __name__ == "__main__":
     ser = serial.Serial(sys.argv[2], 115200, timeout=0.050)
     with open(sys.argv[1],'r') as f:
@@ -85,5 +130,8 @@ if __name__ == "__main__":
             data = [float(int(num,16)) for num in data.split(',')]
         else:
             data = [float(num) for num in data.split(',')]
-    encoded_data = base64_encode(data)
-    send_uart(encoded_data, len(data), ser, sim_timeout=False)
\ No newline at end of file
+    if len(sys.argv) > 3 and sys.argv[3] == '--binary':
+        send_uart_binary(data, ser)
+    else:
+        encoded_data = base64_encode(data)
+        send_uart(encoded_data, len(data), ser, sim_timeout=False)
\ No newline at end of file
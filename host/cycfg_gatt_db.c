@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "cycfg_gatt_db.h"
+
+/* Characteristic lengths as configured in configs/design.cybt */
+uint8_t app_edge_impulse_class_result[32];
+uint8_t app_edge_impulse_inference[1];
+uint8_t app_edge_impulse_settings[32];
+uint8_t app_edge_impulse_result_record[244];
+
+const uint16_t app_edge_impulse_class_result_len = sizeof(app_edge_impulse_class_result);
+const uint16_t app_edge_impulse_inference_len = sizeof(app_edge_impulse_inference);
+const uint16_t app_edge_impulse_settings_len = sizeof(app_edge_impulse_settings);
+const uint16_t app_edge_impulse_result_record_len = sizeof(app_edge_impulse_result_record);
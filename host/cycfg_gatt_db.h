@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/* Host stand-in for the GATT database the Bluetooth Configurator generates
+ * from configs/design.cybt. Only the Edge Impulse service values used by the
+ * run impulse code are provided.
+ */
+
+#ifndef CYCFG_GATT_DB_H
+#define CYCFG_GATT_DB_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uint8_t app_edge_impulse_class_result[];
+extern uint8_t app_edge_impulse_inference[];
+extern uint8_t app_edge_impulse_settings[];
+extern uint8_t app_edge_impulse_result_record[];
+
+extern const uint16_t app_edge_impulse_class_result_len;
+extern const uint16_t app_edge_impulse_inference_len;
+extern const uint16_t app_edge_impulse_settings_len;
+extern const uint16_t app_edge_impulse_result_record_len;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CYCFG_GATT_DB_H */
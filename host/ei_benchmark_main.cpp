@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "model-parameters/model_metadata.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "firmware-sdk/ei_device_info_lib.h"
+#include "ei_benchmark.h"
+#include "ei_hmac_sha256.h"
+#include "ei_sample_format.h"
+#include "ei_sha256.h"
+#include "ei_sim.h"
+#include "mbedtls/sha256.h"
+
+/******
+ *
+ * @brief Inference benchmark on the host. Runs the impulse over a corpus of
+ *        recordings (or deterministic synthetic data) and writes a JSON report,
+ *        the same report AT+RUNBENCHMARK prints on the device.
+ *
+ ******/
+
+#define BENCHMARK_DEFAULT_WINDOWS   100
+#define BENCHMARK_JSON_SIZE         4096
+
+static std::vector<float> *corpus_recording;
+
+static int corpus_get_data(size_t offset, size_t length, float *out_ptr)
+{
+    memcpy(out_ptr, corpus_recording->data() + offset, length * sizeof(float));
+    return 0;
+}
+
+/* update sizes of the SHA-256 benchmark: a CBOR value, a block, a flash chunk */
+static const size_t sha256_update_sizes[] = { 4, 64, 256, 4096 };
+
+static double sha256_mbedtls(const uint8_t *data, size_t len, size_t update_size, uint8_t *digest)
+{
+    mbedtls_sha256_context ctx;
+    auto start = std::chrono::steady_clock::now();
+
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts_ret(&ctx, 0);
+    for(size_t offset = 0; offset < len; offset += update_size) {
+        mbedtls_sha256_update_ret(&ctx, &data[offset], update_size);
+    }
+    mbedtls_sha256_finish_ret(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double sha256_ei(const uint8_t *data, size_t len, size_t update_size, uint8_t *digest)
+{
+    ei_sha256_ctx_t ctx;
+    auto start = std::chrono::steady_clock::now();
+
+    ei_sha256_start(&ctx);
+    for(size_t offset = 0; offset < len; offset += update_size) {
+        ei_sha256_update(&ctx, &data[offset], update_size);
+    }
+    ei_sha256_finish(&ctx, digest);
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Signing path micro-benchmark: Mbed TLS SHA-256 against the
+ *        block functions of ei_sha256 (real time, not the virtual clock)
+ */
+static bool run_sha256_benchmark(size_t megabytes)
+{
+    const char *implementations[] = { "mbedtls", "sha-ni" };
+    size_t len = megabytes * 1024 * 1024;
+    std::vector<uint8_t> data(len);
+    uint32_t seed = 1;
+    bool ret = true;
+
+    for(size_t ix = 0; ix < len; ix++) {
+        seed = seed * 1103515245 + 12345;
+        data[ix] = (uint8_t)(seed >> 16);
+    }
+
+    printf("SHA-256 of %u MB, MB/s per update size\n", (unsigned int)megabytes);
+    printf("%-10s", "update");
+    for(size_t size : sha256_update_sizes) {
+        printf("%10u", (unsigned int)size);
+    }
+    printf("\n");
+
+    uint8_t reference[EI_SHA256_DIGEST_SIZE];
+    uint8_t digest[EI_SHA256_DIGEST_SIZE];
+
+    printf("%-10s", "reference");
+    for(size_t size : sha256_update_sizes) {
+        printf("%10.1f", megabytes / sha256_mbedtls(data.data(), len, size, reference));
+    }
+    printf("\n");
+
+    for(const char *name : implementations) {
+        if(ei_sha256_select(name) == false) {
+            printf("%-10s%10s\n", name, "n/a");
+            continue;
+        }
+        printf("%-10s", name);
+        for(size_t size : sha256_update_sizes) {
+            printf("%10.1f", megabytes / sha256_ei(data.data(), len, size, digest));
+            if(memcmp(digest, reference, sizeof(digest)) != 0) {
+                ret = false;
+            }
+        }
+        printf("\n");
+    }
+
+    if(ret == false) {
+        ei_printf("ERR: SHA-256 digest differs from Mbed TLS\n");
+    }
+
+    return ret;
+}
+
+/* sensor_aq output of the sample format benchmark, passed as its stream */
+static size_t vector_write(const void *data, size_t size, size_t count, EI_SENSOR_AQ_STREAM *stream)
+{
+    std::vector<uint8_t> *out = reinterpret_cast<std::vector<uint8_t> *>(stream);
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    out->insert(out->end(), bytes, bytes + size * count);
+    return count;
+}
+
+static int vector_seek(EI_SENSOR_AQ_STREAM *stream, long int offset, int origin)
+{
+    return 0;
+}
+
+static size_t encode_cbor(const std::vector<float> &samples, sensor_aq_payload_info *payload, size_t n_axes)
+{
+    static unsigned char buffer[1024];
+    std::vector<uint8_t> out;
+    sensor_aq_signing_ctx_t signing_ctx;
+    ei_hs256_ctx_t hs_ctx;
+    sensor_aq_ctx ctx = { { buffer, sizeof(buffer) }, &signing_ctx, &vector_write, &vector_seek, NULL };
+
+    // as ei_sampler: signed while recording
+    ei_hs256_init_context(&signing_ctx, &hs_ctx, EiDeviceInfo::get_device()->get_sample_hmac_key().c_str());
+    sensor_aq_init(&ctx, payload, reinterpret_cast<EI_SENSOR_AQ_STREAM *>(&out), false);
+    for(size_t ix = 0; ix + n_axes <= samples.size(); ix += n_axes) {
+        sensor_aq_add_data(&ctx, const_cast<float *>(&samples[ix]), n_axes);
+    }
+    sensor_aq_finish(&ctx);
+
+    return out.size();
+}
+
+static size_t encode_compact(const std::vector<float> &samples, sensor_aq_payload_info *payload, size_t n_axes,
+                             ei_sample_format_t format)
+{
+    static ei_sample_encoder_t encoder;
+    uint8_t header[1024];
+    uint8_t block[EI_SAMPLE_BLOCK_MAX_LEN];
+    size_t len = ei_sample_encoder_begin(&encoder, format, payload, header, sizeof(header));
+
+    for(size_t ix = 0; ix + n_axes <= samples.size(); ix += n_axes) {
+        if(ei_sample_encoder_add(&encoder, &samples[ix])) {
+            len += ei_sample_encoder_flush(&encoder, block);
+        }
+    }
+
+    return len + ei_sample_encoder_flush(&encoder, block);
+}
+
+/**
+ * @brief Sample file formats on a recording: bytes per sample, encode
+ *        time per sample (real time) and the minutes that fit in the
+ *        sample area
+ */
+static bool run_sample_format_benchmark(const char *path)
+{
+    EiDeviceInfo *dev = EiDeviceInfo::get_device();
+    const size_t n_axes = 3;
+    std::vector<float> samples;
+    uint32_t sample_rate_hz = 0;
+
+    if(ei_sim_load_recording(path, n_axes, samples, &sample_rate_hz) == false) {
+        return false;
+    }
+
+    size_t n_samples = samples.size() / n_axes;
+    if(n_samples == 0) {
+        ei_printf("ERR: %s has no samples\n", path);
+        return false;
+    }
+
+    float interval_ms = (sample_rate_hz > 0) ? 1000.0f / sample_rate_hz : dev->get_sample_interval_ms();
+    sensor_aq_payload_info payload = {
+        dev->get_device_id().c_str(),
+        dev->get_device_type().c_str(),
+        interval_ms,
+        { { "accX", "m/s2" }, { "accY", "m/s2" }, { "accZ", "m/s2" } }
+    };
+    uint32_t available = dev->get_memory()->get_available_sample_bytes();
+
+    printf("%u samples of %u axes at %.2f ms, %u kB sample area\n", (unsigned int)n_samples,
+        (unsigned int)n_axes, interval_ms, (unsigned int)(available / 1024));
+    printf("%-8s%10s%14s%14s%10s\n", "format", "bytes", "bytes/sample", "us/sample", "minutes");
+
+    for(int format = EI_SAMPLE_FORMAT_CBOR; format <= EI_SAMPLE_FORMAT_DELTA; format++) {
+        auto start = std::chrono::steady_clock::now();
+        size_t bytes = (format == EI_SAMPLE_FORMAT_CBOR) ?
+            encode_cbor(samples, &payload, n_axes) :
+            encode_compact(samples, &payload, n_axes, (ei_sample_format_t)format);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double per_sample = (double)bytes / n_samples;
+
+        printf("%-8s%10u%14.2f%14.3f%10.0f\n", ei_sample_format_name((ei_sample_format_t)format),
+            (unsigned int)bytes, per_sample, seconds * 1e6 / n_samples,
+            available / per_sample * interval_ms / 60000.0);
+    }
+
+    return true;
+}
+
+static void print_usage(const char *name)
+{
+    printf("Usage: %s [options] [recording ...]\n", name);
+    printf("Recordings are CSV, data acquisition CBOR or WAV files, synthetic data is used if none are given.\n");
+    printf("  --mode <all|single|continuous|static|resident>  modes to run (default: all)\n");
+    printf("  --windows <n>                                   max windows per mode (default: %d, synthetic: %d)\n",
+        EI_BENCHMARK_MAX_WINDOWS, BENCHMARK_DEFAULT_WINDOWS);
+    printf("  --json <file>                                   write the report to a file instead of stdout\n");
+    printf("  --sha256 <MB>                                   SHA-256 micro-benchmark instead of the impulse\n");
+    printf("  --sample-formats <file>                         sample file formats on an IMU recording instead\n");
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<const char *> corpus;
+    std::vector<ei_benchmark_mode_t> modes;
+    const char *json_path = NULL;
+    uint32_t max_windows = 0;
+
+    for(int ix = 1; ix < argc; ix++) {
+        const char *arg = argv[ix];
+
+        if(arg[0] != '-') {
+            corpus.push_back(arg);
+            continue;
+        }
+        if(ix + 1 >= argc || strcmp(arg, "--help") == 0) {
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        const char *value = argv[++ix];
+
+        if(strcmp(arg, "--mode") == 0) {
+            for(int mode = 0; mode < EI_BENCHMARK_MODES; mode++) {
+                if(strcmp(value, "all") == 0 || strcmp(value, ei_benchmark_mode_name((ei_benchmark_mode_t)mode)) == 0) {
+                    modes.push_back((ei_benchmark_mode_t)mode);
+                }
+            }
+            if(modes.size() == 0) {
+                ei_printf("ERR: unknown mode %s\n", value);
+                return 1;
+            }
+        }
+        else if(strcmp(arg, "--windows") == 0) {
+            max_windows = strtoul(value, NULL, 10);
+        }
+        else if(strcmp(arg, "--json") == 0) {
+            json_path = value;
+        }
+        else if(strcmp(arg, "--sha256") == 0) {
+            return run_sha256_benchmark(strtoul(value, NULL, 10)) ? 0 : 1;
+        }
+        else if(strcmp(arg, "--sample-formats") == 0) {
+            return run_sample_format_benchmark(value) ? 0 : 1;
+        }
+        else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(modes.size() == 0) {
+        for(int mode = 0; mode < EI_BENCHMARK_MODES; mode++) {
+            modes.push_back((ei_benchmark_mode_t)mode);
+        }
+    }
+
+    // load the whole corpus up front, so file I/O is not measured
+    std::vector<std::vector<float>> recordings(corpus.size());
+    for(size_t ix = 0; ix < corpus.size(); ix++) {
+        if(ei_sim_load_recording(corpus[ix], EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME, recordings[ix], NULL) == false) {
+            return 1;
+        }
+    }
+
+    std::vector<ei_benchmark_report_t> reports(modes.size());
+    bool ret = true;
+
+    for(size_t mx = 0; mx < modes.size(); mx++) {
+        ei_benchmark_report_t *report = &reports[mx];
+        ei_benchmark_source_t source;
+
+        if(ei_benchmark_begin(report, modes[mx], max_windows) == false) {
+            return 1;
+        }
+
+        if(recordings.size() == 0) {
+            ei_benchmark_synthetic_source(&source, (max_windows > 0) ? max_windows : BENCHMARK_DEFAULT_WINDOWS);
+            ret &= ei_benchmark_run(report, &source);
+        }
+
+        for(size_t rx = 0; rx < recordings.size(); rx++) {
+            corpus_recording = &recordings[rx];
+            source.total_length = recordings[rx].size();
+            source.get_data = &corpus_get_data;
+            ret &= ei_benchmark_run(report, &source);
+        }
+
+        ei_benchmark_end(report);
+    }
+
+    static char json[BENCHMARK_JSON_SIZE];
+    const char *device_type = EiDeviceInfo::get_device()->get_device_type().c_str();
+
+    if(ei_benchmark_to_json(device_type, reports.data(), reports.size(), json, sizeof(json)) < 0) {
+        ei_printf("ERR: benchmark report does not fit in %d bytes\n", BENCHMARK_JSON_SIZE);
+        return 1;
+    }
+
+    FILE *out = (json_path != NULL) ? fopen(json_path, "w") : stdout;
+    if(out == NULL) {
+        ei_printf("ERR: Failed to open %s\n", json_path);
+        return 1;
+    }
+
+    fprintf(out, "%s\n", json);
+
+    if(out != stdout) {
+        fclose(out);
+    }
+
+    return ret ? 0 : 1;
+}
@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "ei_bluetooth_psoc63.h"
+#include "ei_ble_model_update.h"
+#include "ei_ble_results.h"
+#include "ei_ble_stream.h"
+#include "ei_run_impulse.h"
+#include "cycfg_gatt_db.h"
+#include "ei_sim.h"
+
+/******
+ *
+ * @brief Stand-in for the BLE stack. Each connection event of the virtual
+ *        clock sends a few notifications and returns their buffers, like
+ *        GATT_APP_BUFFER_TRANSMITTED_EVT does on the device. The interval
+ *        follows the link mode, as if the central accepted the longest
+ *        interval of the requested range.
+ *        Class result notifications are counted and, if a log file is set,
+ *        written one per line with a timestamp. Result record notifications
+ *        go to their own log, hex encoded. Raw stream frames are decoded
+ *        the way a central would, checked for gaps and written as CSV.
+ *        Control Point indications are printed and confirmed right away.
+ *        Up to BT_APP_MAX_CONNECTIONS centrals can be connected, each with
+ *        its own queue, all subscribed. The logs are those of central 0, and
+ *        the last central can drop out at a given time.
+ *
+ ******/
+
+/* Negotiated by a typical central, limited to the MtuSize of configs/design.cybt */
+#define SIM_BT_MTU_SIZE             247
+/* 2M PHY with 251 byte PDUs fits several notifications in an event */
+#define SIM_BT_NOTIFICATIONS_PER_EVENT  4
+/* Notifications the stack accepts before it runs out of buffers */
+#define SIM_BT_TX_QUEUE             8
+
+typedef struct {
+    uint8_t index;
+    uint8_t *p_data;
+    uint16_t len;
+    bt_app_transmitted_cb_t on_transmitted;
+} sim_notification_t;
+
+typedef struct {
+    bool connected;
+    sim_notification_t tx_queue[SIM_BT_TX_QUEUE];
+    size_t tx_queue_len;
+    uint32_t notification_count;
+} sim_central_t;
+
+static FILE *notification_log = NULL;
+static FILE *record_log = NULL;
+static FILE *stream_log = NULL;
+static ei_bluetooth_sim_stream_t stream;
+static sim_central_t centrals[BT_APP_MAX_CONNECTIONS];
+static uint8_t central_count = 1;
+static uint64_t disconnect_us = 0;      // 0: the centrals stay connected
+/* longest interval of each bt_link_mode_t range (see ei_bluetooth_psoc63.cpp) */
+static const uint32_t link_interval_us[] = { 200000, 50000, 15000 };
+static bt_link_mode_t link_mode = BT_LINK_IDLE;
+static uint32_t interval_override_ms = 0;
+static int conn_timer = -1;
+
+void ei_bluetooth_sim_set_log(FILE *log)
+{
+    notification_log = log;
+}
+
+void ei_bluetooth_sim_set_record_log(FILE *log)
+{
+    record_log = log;
+}
+
+void ei_bluetooth_sim_set_stream_log(FILE *log)
+{
+    stream_log = log;
+}
+
+void ei_bluetooth_sim_get_stream(ei_bluetooth_sim_stream_t *out)
+{
+    *out = stream;
+}
+
+void ei_bluetooth_sim_set_interval(uint32_t interval_ms)
+{
+    interval_override_ms = interval_ms;
+}
+
+bool ei_bluetooth_sim_set_centrals(uint8_t count)
+{
+    if(count == 0 || count > BT_APP_MAX_CONNECTIONS) {
+        ei_printf("ERR: 1..%d centrals\n", BT_APP_MAX_CONNECTIONS);
+        return false;
+    }
+
+    central_count = count;
+    return true;
+}
+
+uint8_t ei_bluetooth_sim_get_centrals(void)
+{
+    return central_count;
+}
+
+void ei_bluetooth_sim_set_disconnect(uint32_t time_ms)
+{
+    disconnect_us = (uint64_t)time_ms * 1000;
+}
+
+uint32_t ei_bluetooth_sim_get_notification_count(uint8_t conn)
+{
+    return (conn < BT_APP_MAX_CONNECTIONS) ? centrals[conn].notification_count : 0;
+}
+
+static void decode_stream_frame(const uint8_t *frame, uint16_t len)
+{
+    static int16_t values[EI_BLE_STREAM_MAX_VALUES];
+    ei_ble_stream_header_t header;
+
+    int n_samples = ei_ble_stream_decode(frame, len, &header, values, EI_BLE_STREAM_MAX_VALUES);
+    if(n_samples < 0) {
+        ei_printf("ERR: Malformed stream frame (%u bytes)\n", len);
+        stream.errors++;
+        return;
+    }
+
+    if(stream.frames > 0) {
+        stream.lost_frames += (uint16_t)(header.seq - stream.next_seq);
+        stream.gap_samples += header.first_sample - stream.next_sample;
+    }
+    stream.frames++;
+    stream.samples += n_samples;
+    stream.bytes += len;
+    stream.next_seq = header.seq + 1;
+    stream.next_sample = header.first_sample + n_samples;
+
+    if(stream_log == NULL) {
+        return;
+    }
+
+    for(int sample = 0; sample < n_samples; sample++) {
+        fprintf(stream_log, "%lu", (unsigned long)(header.first_sample + sample));
+        for(int axis = 0; axis < header.n_axes; axis++) {
+            fprintf(stream_log, ",%.3f", (float)values[sample * header.n_axes + axis] / header.scale);
+        }
+        fprintf(stream_log, "\n");
+    }
+}
+
+static void log_notification(uint8_t conn, const sim_notification_t *notification)
+{
+    if(notification->index == RAW_STREAM) {
+        decode_stream_frame(notification->p_data, notification->len);
+        return;
+    }
+
+    if(notification->index == CLASS_RESULT) {
+        centrals[conn].notification_count++;
+
+        if(notification_log != NULL && conn == 0) {
+            fprintf(notification_log, "%llu,%.*s\n",
+                (unsigned long long)ei_read_timer_ms(),
+                (int)strnlen((const char *)notification->p_data, notification->len),
+                (const char *)notification->p_data);
+        }
+    }
+    else if(notification->index == RESULT_RECORD && record_log != NULL && conn == 0) {
+        fprintf(record_log, "%llu,", (unsigned long long)ei_read_timer_ms());
+        for(uint16_t ix = 0; ix < notification->len; ix++) {
+            fprintf(record_log, "%02x", notification->p_data[ix]);
+        }
+        fprintf(record_log, "\n");
+    }
+}
+
+/* same steps as the disconnect in bt_app_gatt_conn_status_cb() */
+static void disconnect(uint8_t conn)
+{
+    sim_central_t *central = &centrals[conn];
+
+    ei_printf("BLE central %u disconnected\n", conn);
+    central->connected = false;
+    central->tx_queue_len = 0;
+
+    ei_ble_results_reset(conn);
+    ei_ble_stream_reset(conn);
+    ei_ble_model_update_abort(conn);
+
+    for(int ix = 0; ix < BT_APP_MAX_CONNECTIONS; ix++) {
+        if(centrals[ix].connected) {
+            return;
+        }
+    }
+    ei_request_stop_impulse();
+}
+
+static void connection_event(void *arg)
+{
+    (void)arg;
+
+    if(disconnect_us > 0 && ei_sim_time_us() >= disconnect_us) {
+        disconnect_us = 0;
+        disconnect(central_count - 1);
+    }
+
+    // one event per central in the same interval
+    for(uint8_t conn = 0; conn < central_count; conn++) {
+        sim_central_t *central = &centrals[conn];
+
+        for(int ix = 0; ix < SIM_BT_NOTIFICATIONS_PER_EVENT && central->tx_queue_len > 0; ix++) {
+            sim_notification_t notification = central->tx_queue[0];
+            central->tx_queue_len--;
+            memmove(&central->tx_queue[0], &central->tx_queue[1],
+                central->tx_queue_len * sizeof(central->tx_queue[0]));
+
+            log_notification(conn, &notification);
+            if(notification.on_transmitted != NULL) {
+                notification.on_transmitted(notification.p_data);
+            }
+        }
+    }
+}
+
+static bool start_connection_events(void)
+{
+    uint64_t interval_us = interval_override_ms ? (uint64_t)interval_override_ms * 1000 : link_interval_us[link_mode];
+
+    ei_sim_timer_stop(conn_timer);
+    conn_timer = ei_sim_timer_start(connection_event, NULL, interval_us);
+
+    return (conn_timer >= 0);
+}
+
+cy_rslt_t ei_bluetooth_init(void)
+{
+    for(uint8_t conn = 0; conn < central_count; conn++) {
+        centrals[conn].connected = true;
+    }
+
+    if(start_connection_events() == false) {
+        return (cy_rslt_t)1;
+    }
+
+    return CY_RSLT_SUCCESS;
+}
+
+void bt_app_set_link_mode(bt_link_mode_t mode)
+{
+    if(mode == link_mode || mode > BT_LINK_STREAMING) {
+        return;
+    }
+
+    link_mode = mode;
+    if(conn_timer >= 0) {
+        start_connection_events();
+    }
+}
+
+bt_link_mode_t bt_app_get_link_mode(void)
+{
+    return link_mode;
+}
+
+bool bt_app_notification_enabled(uint8_t conn, uint8_t index)
+{
+    if(conn >= BT_APP_MAX_CONNECTIONS || centrals[conn].connected == false) {
+        return false;
+    }
+
+    return (index == CLASS_RESULT || index == RESULT_RECORD || index == RAW_STREAM ||
+            index == CONTROL_POINT || index == MODEL_UPDATE);
+}
+
+uint16_t bt_app_get_notification_max_len(uint8_t conn)
+{
+    (void)conn;
+
+    return SIM_BT_MTU_SIZE - 3;
+}
+
+bool bt_app_send_notification(uint8_t conn, uint8_t index, uint8_t *p_data, uint16_t len,
+                              bt_app_transmitted_cb_t on_transmitted)
+{
+    if(bt_app_notification_enabled(conn, index) == false) {
+        return false;
+    }
+
+    sim_central_t *central = &centrals[conn];
+    if(central->tx_queue_len >= SIM_BT_TX_QUEUE) {
+        return false;
+    }
+
+    central->tx_queue[central->tx_queue_len].index = index;
+    central->tx_queue[central->tx_queue_len].p_data = p_data;
+    central->tx_queue[central->tx_queue_len].len = len;
+    central->tx_queue[central->tx_queue_len].on_transmitted = on_transmitted;
+    central->tx_queue_len++;
+
+    return true;
+}
+
+bool bt_app_send_indication(uint8_t conn, uint8_t index, const uint8_t *p_data, uint16_t len)
+{
+    if(bt_app_notification_enabled(conn, index) == false ||
+       (index != CONTROL_POINT && index != MODEL_UPDATE)) {
+        return false;
+    }
+
+    if(central_count > 1) {
+        ei_printf("BLE indication to central %u:", conn);
+    }
+    else {
+        ei_printf("BLE indication:");
+    }
+    for(uint16_t ix = 0; ix < len; ix++) {
+        ei_printf(" %02x", p_data[ix]);
+    }
+    ei_printf("\n");
+
+    return true;
+}
+
+void bt_app_lock(void)
+{
+}
+
+void bt_app_unlock(void)
+{
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "firmware-sdk/ei_device_info_lib.h"
+#include "firmware-sdk/ei_device_memory.h"
+#include "ei_device_sim.h"
+#include "ei_flash_memory_sim.h"
+#include "ei_microphone.h"
+#include "ei_sim.h"
+
+/******
+ *
+ * @brief EdgeImpulse Device for the host simulation. Mirrors EiDevicePSoC62,
+ *        with the sample timer running on the virtual clock.
+ *
+ ******/
+
+#define SIM_DEFAULT_INTERVAL_MS 10.0f
+#define SIM_DEFAULT_LENGTH_MS   10000
+
+EiDeviceSim::EiDeviceSim(EiDeviceMemory* mem)
+{
+    EiDeviceInfo::memory = mem;
+
+    init_device_id();
+
+    load_config();
+
+    // erased flash holds no config, use the firmware defaults
+    if(sample_interval_ms <= 0.0f || sample_length_ms == 0) {
+        sample_interval_ms = SIM_DEFAULT_INTERVAL_MS;
+        sample_length_ms = SIM_DEFAULT_LENGTH_MS;
+    }
+
+    device_type = "INFINEON_PSOC63_SIM";
+    state = eiStateIdle;
+    sample_timer = -1;
+    sample_cb = nullptr;
+
+    sensors[EI_STANDALONE_SENSOR_MIC].name = "Microphone";
+    sensors[EI_STANDALONE_SENSOR_MIC].start_sampling_cb = ei_microphone_sample_start;
+    sensors[EI_STANDALONE_SENSOR_MIC].frequencies[0] = 8000.0f;
+    sensors[EI_STANDALONE_SENSOR_MIC].frequencies[1] = 16000.0f;
+    sensors[EI_STANDALONE_SENSOR_MIC].frequencies[2] = 32000.0f;
+    sensors[EI_STANDALONE_SENSOR_MIC].max_sample_length_s = mem->get_available_sample_bytes() / (sensors[EI_STANDALONE_SENSOR_MIC].frequencies[0] * 2);
+}
+
+EiDeviceSim::~EiDeviceSim()
+{
+
+}
+
+EiDeviceInfo* EiDeviceInfo::get_device(void)
+{
+    static EiFlashMemorySim memory(sizeof(EiConfig));
+    static EiDeviceSim dev(&memory);
+
+    return &dev;
+}
+
+void EiDeviceSim::init_device_id(void)
+{
+    device_id = "00:00:00:00:00:00";
+}
+
+bool EiDeviceSim::get_sensor_list(const ei_device_sensor_t **sensor_list, size_t *sensor_list_size)
+{
+    *sensor_list      = sensors;
+    *sensor_list_size = EI_STANDALONE_SENSORS_COUNT;
+
+    return true;
+}
+
+void EiDeviceSim::clear_config(void)
+{
+    EiDeviceInfo::clear_config();
+
+    init_device_id();
+    save_config();
+}
+
+uint32_t EiDeviceSim::get_data_output_baudrate(void)
+{
+    return EI_DEVICE_BAUDRATE;
+}
+
+void EiDeviceSim::set_max_data_output_baudrate()
+{
+}
+
+void EiDeviceSim::set_default_data_output_baudrate()
+{
+}
+
+void EiDeviceSim::sample_timer_handler(void *arg)
+{
+    EiDeviceSim *dev = static_cast<EiDeviceSim*>(arg);
+
+    if(dev->sample_cb != nullptr) {
+        dev->sample_cb();
+    }
+}
+
+bool EiDeviceSim::start_sample_thread(void (*sample_read_cb)(void), float sample_interval_ms)
+{
+    this->stop_sample_thread();
+
+    sample_cb = sample_read_cb;
+    sample_timer = ei_sim_timer_start(sample_timer_handler, this, (uint64_t)(sample_interval_ms * 1000.0f));
+
+    if(sample_timer < 0) {
+        ei_printf("ERR: Failed to start sample timer.\n");
+        return false;
+    }
+
+    this->set_state(eiStateSampling);
+
+    return true;
+}
+
+bool EiDeviceSim::stop_sample_thread(void)
+{
+    ei_sim_timer_stop(sample_timer);
+    sample_timer = -1;
+    sample_cb = nullptr;
+
+    this->set_state(eiStateIdle);
+
+    return true;
+}
+
+void EiDeviceSim::set_state(EiState state)
+{
+    this->state = state;
+}
+
+EiState EiDeviceSim::get_state(void)
+{
+    return this->state;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstdio>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "firmware-sdk/ei_device_info_lib.h"
+#include "ei_flash_memory_sim.h"
+#include "ei_sim.h"
+
+/******
+ *
+ * @brief RAM backed NOR flash. Erase sets bytes to 0xFF, the highest
+ *        address written in the sample area is tracked, so the host can
+ *        dump what the firmware would upload.
+ *
+ ******/
+
+uint32_t EiFlashMemorySim::read_data(uint8_t *data, uint32_t address, uint32_t num_bytes)
+{
+    if(address >= this->memory_size) {
+        return 0;
+    }
+
+    if(address + num_bytes > this->memory_size) {
+        num_bytes = this->memory_size - address;
+    }
+
+    memcpy(data, &flash[address], num_bytes);
+
+    return num_bytes;
+}
+
+uint32_t EiFlashMemorySim::write_data(const uint8_t *data, uint32_t address, uint32_t num_bytes)
+{
+    if(address >= this->memory_size) {
+        return 0;
+    }
+
+    if(address + num_bytes > this->memory_size) {
+        num_bytes = this->memory_size - address;
+    }
+
+    memcpy(&flash[address], data, num_bytes);
+
+    uint32_t offset = used_blocks * block_size;
+    uint32_t sample_end = offset + get_available_sample_bytes();
+    if(address >= offset && address + num_bytes <= sample_end &&
+       address + num_bytes - offset > sample_data_end) {
+        sample_data_end = address + num_bytes - offset;
+    }
+
+    return num_bytes;
+}
+
+uint32_t EiFlashMemorySim::erase_data(uint32_t address, uint32_t num_bytes)
+{
+    if(address >= this->memory_size) {
+        return 0;
+    }
+
+    if(address + num_bytes > this->memory_size) {
+        num_bytes = this->memory_size - address;
+    }
+
+    memset(&flash[address], SIM_FLASH_ERASED_BYTE, num_bytes);
+
+    // a new recording starts with erasing the start of the sample area
+    uint32_t offset = used_blocks * block_size;
+    if(address <= offset && address + num_bytes > offset) {
+        sample_data_end = 0;
+    }
+
+    return num_bytes;
+}
+
+EiFlashMemorySim::EiFlashMemorySim(uint32_t config_size):
+    EiConfigJournalMemory(config_size, SIM_FLASH_ERASE_TIME, SIM_FLASH_SIZE, SIM_FLASH_SECTOR_SIZE),
+    flash(SIM_FLASH_SIZE, SIM_FLASH_ERASED_BYTE),
+    sample_data_end(0)
+{
+}
+
+uint32_t EiFlashMemorySim::get_available_sample_blocks(void)
+{
+    return memory_blocks - used_blocks - EI_MODEL_STORE_BLOCKS;
+}
+
+uint32_t EiFlashMemorySim::get_available_sample_bytes(void)
+{
+    return get_available_sample_blocks() * block_size;
+}
+
+uint32_t EiFlashMemorySim::get_sample_data_size(void)
+{
+    return sample_data_end;
+}
+
+/**
+ * @brief      Write the sample area (what AT+READBUFFER would send) to a file
+ */
+bool ei_flash_sim_dump_samples(const char *path)
+{
+    EiFlashMemorySim *mem = static_cast<EiFlashMemorySim*>(EiDeviceInfo::get_device()->get_memory());
+    uint32_t size = mem->get_sample_data_size();
+    std::vector<uint8_t> buffer(size);
+
+    FILE *file = fopen(path, "wb");
+    if(file == NULL) {
+        ei_printf("ERR: Failed to open %s\n", path);
+        return false;
+    }
+
+    bool ret = (mem->read_sample_data(buffer.data(), 0, size) == size) &&
+               (fwrite(buffer.data(), 1, size, file) == size);
+    fclose(file);
+
+    if(ret == false) {
+        ei_printf("ERR: Failed to write %s\n", path);
+    }
+
+    return ret;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_FLASH_MEMORY_SIM_H
+#define EI_FLASH_MEMORY_SIM_H
+
+#include <vector>
+#include "ei_config_journal.h"
+#include "ei_model_store.h"
+
+/*
+  Same geometry as the external QSPI flash (see ei_flash_memory.h),
+  but only the first 16 MB are backed by RAM.
+*/
+#define SIM_FLASH_ERASE_TIME    600
+#define SIM_FLASH_SIZE          0x1000000   // 16 MB
+#define SIM_FLASH_SECTOR_SIZE   0x40000     // 256K Sector size
+#define SIM_FLASH_ERASED_BYTE   0xFF
+
+class EiFlashMemorySim : public EiConfigJournalMemory {
+private:
+    std::vector<uint8_t> flash;
+    uint32_t sample_data_end;
+
+protected:
+    uint32_t read_data(uint8_t *data, uint32_t address, uint32_t num_bytes) override;
+    uint32_t write_data(const uint8_t *data, uint32_t address, uint32_t num_bytes) override;
+    uint32_t erase_data(uint32_t address, uint32_t num_bytes) override;
+
+public:
+    EiFlashMemorySim(uint32_t config_size);
+    /* same reservation as EiFlashMemory */
+    uint32_t get_available_sample_blocks(void) override;
+    uint32_t get_available_sample_bytes(void) override;
+    uint32_t get_sample_data_size(void);
+};
+
+#endif /* EI_FLASH_MEMORY_SIM_H */
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+#include <vector>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "ei_inertial_sensor.h"
+#include "ei_sim.h"
+
+/******
+ *
+ * @brief Replays recorded accelerometer data in place of the BMI160.
+ *        Accepts a CSV file (optional header, optional leading timestamp
+ *        column) or an Edge Impulse data acquisition CBOR file, values in m/s2.
+ *
+ ******/
+
+/***************************************
+ *        Local variables
+ **************************************/
+static float imu_data[INERTIAL_AXIS_SAMPLED];
+static std::vector<float> recording;
+static size_t read_pos = 0;
+
+bool ei_inertial_sensor_sim_open(const char *path)
+{
+    read_pos = 0;
+
+    if(ei_sim_load_recording(path, INERTIAL_AXIS_SAMPLED, recording, NULL) == false) {
+        return false;
+    }
+
+    ei_printf("Loaded %u accelerometer samples from %s\n",
+        (unsigned int)(recording.size() / INERTIAL_AXIS_SAMPLED), path);
+
+    return true;
+}
+
+bool ei_inertial_sensor_init(void)
+{
+    if(ei_add_sensor_to_fusion_list(inertial_sensor) == false) {
+        ei_printf("ERR: failed to register Inertial sensor!\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool ei_inertial_sensor_test(void)
+{
+    ei_printf("Accel: %u samples left\n", (unsigned int)((recording.size() - read_pos) / INERTIAL_AXIS_SAMPLED));
+
+    return true;
+}
+
+float *ei_fusion_inertial_sensor_read_data(int n_samples)
+{
+    if(read_pos + INERTIAL_AXIS_SAMPLED <= recording.size()) {
+        memcpy(imu_data, &recording[read_pos], sizeof(imu_data));
+        read_pos += INERTIAL_AXIS_SAMPLED;
+    }
+    else {
+        memset(imu_data, 0, sizeof(imu_data));
+        ei_sim_set_input_exhausted();
+    }
+
+    return imu_data;
+}
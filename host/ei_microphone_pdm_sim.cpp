@@ -0,0 +1,158 @@
+/* Edge Impulse ingestion SDK
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <vector>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "ei_microphone.h"
+#include "ei_microphone_pdm.h"
+#include "ei_sim.h"
+
+/* Replays a 16 bit mono WAV file in place of the PDM/PCM block. A 1 ms
+ * timer on the virtual clock moves samples into the pending async read and
+ * raises the read complete event once it is full, like the PDM DMA does.
+ */
+
+#define PDM_SIM_TICK_US     1000
+
+/* LOCAL VARIABLES */
+static std::vector<microphone_sample_t> recording;
+static uint32_t recording_rate = 0;
+static size_t read_pos = 0;
+static uint32_t pdm_rate = 0;
+static uint32_t pdm_fraction = 0;
+static int pdm_timer = -1;
+static bool event_enabled = false;
+/* Pending async read */
+static microphone_sample_t *read_buffer = NULL;
+static size_t read_size = 0;
+static size_t read_done = 0;
+/* Read complete callback of the current user (ingestion or inference) */
+static pdm_read_complete_cb_t read_complete_cb;
+
+static void pdm_timer_handler(void *arg)
+{
+    // samples produced in this tick, keeping track of the fractional part
+    pdm_fraction += pdm_rate;
+    size_t n_samples = pdm_fraction / (1000000 / PDM_SIM_TICK_US);
+    pdm_fraction %= (1000000 / PDM_SIM_TICK_US);
+
+    if(read_buffer == NULL) {
+        // no read pending, samples are lost like on the hardware
+        read_pos += n_samples;
+        return;
+    }
+
+    while(n_samples-- > 0 && read_done < read_size) {
+        if(read_pos < recording.size()) {
+            read_buffer[read_done++] = recording[read_pos++];
+        }
+        else {
+            read_buffer[read_done++] = 0;
+            ei_sim_set_input_exhausted();
+        }
+    }
+
+    if(read_done == read_size) {
+        read_buffer = NULL;
+        if(event_enabled && read_complete_cb != NULL) {
+            read_complete_cb();
+        }
+    }
+}
+
+bool ei_microphone_sim_open(const char *path)
+{
+    std::vector<float> samples;
+
+    recording.clear();
+    recording_rate = 0;
+    read_pos = 0;
+
+    if(ei_sim_load_recording(path, 1, samples, &recording_rate) == false) {
+        return false;
+    }
+
+    recording.assign(samples.begin(), samples.end());
+
+    ei_printf("Loaded %u audio samples (%u Hz) from %s\n",
+        (unsigned int)recording.size(), (unsigned int)recording_rate, path);
+
+    return true;
+}
+
+bool ei_microphone_pdm_init(void)
+{
+    return true;
+}
+
+bool ei_pdm_start(uint32_t sample_rate, pdm_read_complete_cb_t callback)
+{
+    if(recording_rate != 0 && recording_rate != sample_rate) {
+        ei_printf("WARN: recording is %u Hz, sampling at %u Hz\n",
+            (unsigned int)recording_rate, (unsigned int)sample_rate);
+    }
+
+    pdm_rate = sample_rate;
+    pdm_fraction = 0;
+    read_complete_cb = callback;
+    event_enabled = false;
+
+    pdm_timer = ei_sim_timer_start(pdm_timer_handler, NULL, PDM_SIM_TICK_US);
+    if(pdm_timer < 0) {
+        ei_printf("ERR: PDM interface init failed!\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool ei_pdm_read_async(microphone_sample_t *buffer, size_t n_samples)
+{
+    if(read_buffer != NULL) {
+        return false;
+    }
+
+    read_done = 0;
+    read_size = n_samples;
+    read_buffer = buffer;
+
+    return true;
+}
+
+void ei_pdm_abort_async(void)
+{
+    read_buffer = NULL;
+}
+
+void ei_pdm_enable_event(bool enable)
+{
+    event_enabled = enable;
+}
+
+void ei_pdm_stop(void)
+{
+    ei_sim_timer_stop(pdm_timer);
+    pdm_timer = -1;
+    read_buffer = NULL;
+    read_complete_cb = NULL;
+}
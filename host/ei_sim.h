@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_SIM_H
+#define EI_SIM_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/**
+ * The host simulation runs the firmware on a virtual clock: wall clock time
+ * plus a skew that is added whenever the firmware waits (ei_sleep() or the
+ * main loop poll). Waiting therefore costs nothing, while the time spent in
+ * DSP and NN code is still measured for real.
+ * Periodic timers (sample thread, PDM DMA) fire while the clock advances.
+ */
+#define EI_SIM_MAX_TIMERS       4
+#define EI_SIM_POLL_MS          5   // same as the UART poll timeout of ei_task
+
+typedef void (*ei_sim_timer_cb_t)(void *arg);
+
+/* Virtual clock ----------------------------------------------------------- */
+uint64_t ei_sim_time_us(void);
+void ei_sim_advance_us(uint64_t time_us);
+int ei_sim_timer_start(ei_sim_timer_cb_t callback, void *arg, uint64_t period_us);
+void ei_sim_timer_stop(int timer_id);
+
+/* Recorded inputs --------------------------------------------------------- */
+bool ei_sim_load_recording(const char *path, size_t n_axes, std::vector<float> &samples, uint32_t *sample_rate_hz);
+bool ei_inertial_sensor_sim_open(const char *path);
+bool ei_microphone_sim_open(const char *path);
+bool ei_sim_console_open(const char *path);
+void ei_sim_set_input_exhausted(void);
+bool ei_sim_input_exhausted(void);
+
+/* Simulated flash --------------------------------------------------------- */
+bool ei_flash_sim_dump_samples(const char *path);
+
+/* Simulated BLE ----------------------------------------------------------- */
+void ei_bluetooth_sim_set_log(FILE *log);
+void ei_bluetooth_sim_set_record_log(FILE *log);
+void ei_bluetooth_sim_set_interval(uint32_t interval_ms);
+void ei_bluetooth_sim_set_stream_log(FILE *log);
+
+/* Raw stream as received by the central */
+#define EI_BLE_STREAM_MAX_VALUES    256
+typedef struct {
+    uint32_t frames;
+    uint32_t samples;
+    uint32_t bytes;
+    uint32_t lost_frames;   // seq gaps
+    uint32_t gap_samples;   // samples the device dropped
+    uint32_t errors;        // frames that failed to decode
+    uint16_t next_seq;
+    uint32_t next_sample;
+} ei_bluetooth_sim_stream_t;
+void ei_bluetooth_sim_get_stream(ei_bluetooth_sim_stream_t *stream);
+/* class result notifications received by a central */
+uint32_t ei_bluetooth_sim_get_notification_count(uint8_t conn);
+/* connected centrals (1..BT_APP_MAX_CONNECTIONS), set before ei_bluetooth_init() */
+bool ei_bluetooth_sim_set_centrals(uint8_t count);
+uint8_t ei_bluetooth_sim_get_centrals(void);
+/* the last central disconnects at this virtual time */
+void ei_bluetooth_sim_set_disconnect(uint32_t time_ms);
+
+#endif /* EI_SIM_H */
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/* Porting layer for the host simulation. The SDK POSIX port (disabled for this
+ * build) reads the process CPU clock, which can't be fast-forwarded, so the
+ * timer functions are implemented here on top of the virtual clock.
+ */
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "ei_sim.h"
+
+typedef struct {
+    ei_sim_timer_cb_t callback;
+    void *arg;
+    uint64_t period_us;
+    uint64_t deadline_us;
+} ei_sim_timer_t;
+
+static ei_sim_timer_t timers[EI_SIM_MAX_TIMERS];
+static uint64_t skew_us = 0;
+static bool input_exhausted = false;
+static FILE *console_in = NULL;
+
+/****************************** VIRTUAL CLOCK ***************************************************************/
+
+static uint64_t wall_clock_us(void)
+{
+    static uint64_t start_us = 0;
+    struct timespec spec;
+
+    clock_gettime(CLOCK_MONOTONIC, &spec);
+    uint64_t now_us = (uint64_t)spec.tv_sec * 1000000 + spec.tv_nsec / 1000;
+
+    if(start_us == 0) {
+        start_us = now_us;
+    }
+
+    return now_us - start_us;
+}
+
+static void jump_to(uint64_t time_us)
+{
+    uint64_t now_us = ei_sim_time_us();
+
+    if(time_us > now_us) {
+        skew_us += time_us - now_us;
+    }
+}
+
+uint64_t ei_sim_time_us(void)
+{
+    return wall_clock_us() + skew_us;
+}
+
+/**
+ * @brief      Advance the virtual clock, firing every timer that becomes due
+ *             (in deadline order) on the way.
+ */
+void ei_sim_advance_us(uint64_t time_us)
+{
+    uint64_t target_us = ei_sim_time_us() + time_us;
+
+    while(true) {
+        int next = -1;
+
+        for(int ix = 0; ix < EI_SIM_MAX_TIMERS; ix++) {
+            if(timers[ix].callback == NULL || timers[ix].deadline_us > target_us) {
+                continue;
+            }
+            if(next < 0 || timers[ix].deadline_us < timers[next].deadline_us) {
+                next = ix;
+            }
+        }
+
+        if(next < 0) {
+            break;
+        }
+
+        jump_to(timers[next].deadline_us);
+        timers[next].deadline_us += timers[next].period_us;
+        timers[next].callback(timers[next].arg);
+    }
+
+    jump_to(target_us);
+}
+
+int ei_sim_timer_start(ei_sim_timer_cb_t callback, void *arg, uint64_t period_us)
+{
+    if(callback == NULL || period_us == 0) {
+        return -1;
+    }
+
+    for(int ix = 0; ix < EI_SIM_MAX_TIMERS; ix++) {
+        if(timers[ix].callback == NULL) {
+            timers[ix].callback = callback;
+            timers[ix].arg = arg;
+            timers[ix].period_us = period_us;
+            timers[ix].deadline_us = ei_sim_time_us() + period_us;
+            return ix;
+        }
+    }
+
+    ei_printf("ERR: no free simulation timer\n");
+    return -1;
+}
+
+void ei_sim_timer_stop(int timer_id)
+{
+    if(timer_id >= 0 && timer_id < EI_SIM_MAX_TIMERS) {
+        timers[timer_id].callback = NULL;
+    }
+}
+
+void ei_sim_set_input_exhausted(void)
+{
+    input_exhausted = true;
+}
+
+bool ei_sim_input_exhausted(void)
+{
+    return input_exhausted;
+}
+
+bool ei_sim_console_open(const char *path)
+{
+    console_in = fopen(path, "rb");
+    if(console_in == NULL) {
+        ei_printf("ERR: Failed to open %s\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+/****************************** PORTING FUNCTIONS ***********************************************************/
+
+__attribute__((weak)) EI_IMPULSE_ERROR ei_run_impulse_check_canceled() {
+    return EI_IMPULSE_OK;
+}
+
+__attribute__((weak)) EI_IMPULSE_ERROR ei_sleep(int32_t time_ms) {
+    if(time_ms > 0) {
+        ei_sim_advance_us((uint64_t)time_ms * 1000);
+    }
+
+    return EI_IMPULSE_OK;
+}
+
+uint64_t ei_read_timer_ms() {
+    return ei_sim_time_us() / 1000;
+}
+
+uint64_t ei_read_timer_us() {
+    return ei_sim_time_us();
+}
+
+void ei_putchar(char c)
+{
+    putchar(c);
+}
+
+__attribute__((weak)) char ei_getchar(void)
+{
+    int c = (console_in != NULL) ? fgetc(console_in) : EOF;
+
+    if(c == EOF) {
+        // nothing received, behave like an idle UART
+        ei_sim_advance_us(1000);
+        return 0;
+    }
+
+    return (char)c;
+}
+
+/**
+ * @brief      Binary read from the simulated UART. A missing byte is a
+ *             silent line, the clock moves on by the timeout.
+ */
+bool ei_serial_read(uint8_t *buffer, size_t length, uint32_t timeout_ms)
+{
+    if(console_in == NULL || fread(buffer, 1, length, console_in) != length) {
+        ei_sim_advance_us((uint64_t)timeout_ms * 1000);
+        return false;
+    }
+
+    return true;
+}
+
+__attribute__((weak)) void ei_printf(const char *format, ...) {
+    va_list myargs;
+    va_start(myargs, format);
+    vprintf(format, myargs);
+    va_end(myargs);
+}
+
+__attribute__((weak)) void ei_printf_float(float f) {
+    ei_printf("%f", f);
+}
+
+__attribute__((weak)) void *ei_malloc(size_t size) {
+    return malloc(size);
+}
+
+__attribute__((weak)) void *ei_calloc(size_t nitems, size_t size) {
+    return calloc(nitems, size);
+}
+
+__attribute__((weak)) void ei_free(void *ptr) {
+    free(ptr);
+}
+
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+extern "C"
+#endif
+__attribute__((weak)) void DebugLog(const char* s) {
+    ei_printf("%s", s);
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "qcbor.h"
+#include "ei_sim.h"
+
+/******
+ *
+ * @brief Loads recorded data for the simulated sensors and the benchmark.
+ *        Supported formats:
+ *        - CSV, one sample per line, optional header and timestamp column.
+ *          A line with any other number of values (e.g. raw features copied
+ *          from the studio) is taken as is.
+ *        - Edge Impulse data acquisition CBOR (payload values).
+ *        - 16 bit mono PCM WAV, samples are returned unscaled.
+ *
+ ******/
+
+static bool load_file(const char *path, std::vector<uint8_t> &contents)
+{
+    FILE *file = fopen(path, "rb");
+    if(file == NULL) {
+        ei_printf("ERR: Failed to open %s\n", path);
+        return false;
+    }
+
+    uint8_t chunk[512];
+    size_t n;
+    while((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        contents.insert(contents.end(), chunk, chunk + n);
+    }
+    fclose(file);
+
+    return true;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t get_le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static bool parse_csv(const std::vector<uint8_t> &contents, size_t n_axes, std::vector<float> &samples)
+{
+    std::string text(contents.begin(), contents.end());
+    size_t line_start = 0;
+
+    while(line_start < text.size()) {
+        size_t line_end = text.find('\n', line_start);
+        if(line_end == std::string::npos) {
+            line_end = text.size();
+        }
+        std::string line = text.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+
+        std::vector<float> row;
+        const char *p = line.c_str();
+        char *end;
+
+        while(*p != '\0') {
+            float value = strtof(p, &end);
+            if(end == p) {
+                break;
+            }
+            row.push_back(value);
+            p = end;
+            while(*p == ',' || *p == ' ' || *p == '\t' || *p == ';') {
+                p++;
+            }
+        }
+
+        // header or empty line
+        if(row.size() < n_axes) {
+            continue;
+        }
+
+        // skip the timestamp column if present
+        size_t first = (row.size() == n_axes + 1) ? 1 : 0;
+        samples.insert(samples.end(), row.begin() + first, row.end());
+    }
+
+    return true;
+}
+
+static bool parse_cbor(const std::vector<uint8_t> &contents, size_t n_axes, std::vector<float> &samples)
+{
+    QCBORDecodeContext ctx;
+    QCBORItem item;
+    QCBORError err;
+    int values_level = -1;
+    std::vector<float> row;
+    UsefulBufC encoded = { contents.data(), contents.size() };
+
+    QCBORDecode_Init(&ctx, encoded, QCBOR_DECODE_MODE_NORMAL);
+
+    while((err = QCBORDecode_GetNext(&ctx, &item)) == QCBOR_SUCCESS || err == QCBOR_ERR_BAD_BREAK) {
+        // the 0xFF padding the firmware writes after the values array shows
+        // up as extra breaks, the item returned with that error is the last one
+        if(err != QCBOR_SUCCESS) {
+            if(item.uDataType == QCBOR_TYPE_BREAK) {
+                break;
+            }
+            item.uNextNestLevel = 0;
+        }
+
+        if(values_level < 0) {
+            if(item.uDataType == QCBOR_TYPE_ARRAY &&
+               item.uLabelType == QCBOR_TYPE_TEXT_STRING &&
+               item.label.string.len == 6 &&
+               memcmp(item.label.string.ptr, "values", 6) == 0) {
+                values_level = item.uNestingLevel;
+            }
+            continue;
+        }
+
+        // half and single precision values are also returned as double
+        if(item.uDataType == QCBOR_TYPE_DOUBLE || item.uDataType == QCBOR_TYPE_FLOAT) {
+            row.push_back((float)item.val.dfnum);
+        }
+        else if(item.uDataType == QCBOR_TYPE_INT64) {
+            row.push_back((float)item.val.int64);
+        }
+
+        // sample (or flat value) complete
+        if(item.uNextNestLevel <= values_level + 1 && row.size() > 0) {
+            row.resize(n_axes, 0.0f);
+            samples.insert(samples.end(), row.begin(), row.end());
+            row.clear();
+        }
+
+        // end of values array
+        if(item.uNextNestLevel <= values_level) {
+            break;
+        }
+    }
+
+    if(values_level < 0) {
+        ei_printf("ERR: no values array found in CBOR file\n");
+        return false;
+    }
+
+    return true;
+}
+
+static bool parse_wav(const std::vector<uint8_t> &contents, std::vector<float> &samples, uint32_t *sample_rate_hz)
+{
+    bool format_ok = false;
+    size_t pos = 12;
+
+    while(pos + 8 <= contents.size()) {
+        uint32_t chunk_size = get_le32(&contents[pos + 4]);
+        const uint8_t *data = &contents[pos + 8];
+        size_t available = contents.size() - (pos + 8);
+
+        if(chunk_size > available) {
+            chunk_size = available;
+        }
+
+        if(memcmp(&contents[pos], "fmt ", 4) == 0 && chunk_size >= 16) {
+            // PCM, mono, 16 bit
+            format_ok = (get_le16(data) == 1 && get_le16(data + 2) == 1 && get_le16(data + 14) == 16);
+            if(sample_rate_hz != NULL) {
+                *sample_rate_hz = get_le32(data + 4);
+            }
+        }
+        else if(memcmp(&contents[pos], "data", 4) == 0) {
+            for(size_t ix = 0; ix + 1 < chunk_size; ix += 2) {
+                samples.push_back((float)(int16_t)get_le16(data + ix));
+            }
+        }
+
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    if(format_ok == false) {
+        ei_printf("ERR: only 16 bit mono PCM WAV files are supported\n");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief      Load a recording
+ *
+ * @param[in]  path            The file
+ * @param[in]  n_axes          Values per sample
+ * @param      samples         Values, interleaved per axis
+ * @param      sample_rate_hz  Sample rate if the file has one (WAV), may be NULL
+ *
+ * @return     false on error or if the file holds no samples
+ */
+bool ei_sim_load_recording(const char *path, size_t n_axes, std::vector<float> &samples, uint32_t *sample_rate_hz)
+{
+    std::vector<uint8_t> contents;
+    bool ret;
+
+    if(load_file(path, contents) == false) {
+        return false;
+    }
+
+    samples.clear();
+
+    if(contents.size() >= 12 && memcmp(&contents[0], "RIFF", 4) == 0 && memcmp(&contents[8], "WAVE", 4) == 0) {
+        ret = parse_wav(contents, samples, sample_rate_hz);
+    }
+    // CBOR ingestion files start with a map (major type 5)
+    else if(contents.size() > 0 && (contents[0] & 0xE0) == 0xA0) {
+        ret = parse_cbor(contents, n_axes, samples);
+    }
+    else {
+        ret = parse_csv(contents, n_axes, samples);
+    }
+
+    if(ret == false || samples.size() == 0) {
+        ei_printf("ERR: no samples in %s\n", path);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/**
+ * Writes the EON compiled model of ei-model/ as a TFLite flatbuffer, for the
+ * host build on the TFLite Micro interpreter (host/tflm-model/). The EON
+ * graph only keeps its tensors and nodes, this rebuilds the model from
+ * them. The generated model is run on the interpreter next to the EON graph
+ * and rejected unless both give the same output. The arena size is the
+ * smallest one AllocateTensors() and Invoke() work in (arena_used_bytes()
+ * leaves out the temporary allocations of Prepare()), the comparison runs
+ * in an arena of exactly that size.
+ *
+ *   ei_tflm_model_gen <output.cpp>
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* the tensor and node tables of the EON graph are local to its source */
+#include "tflite-model/trained_model_compiled.cpp"
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_error_reporter.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_interpreter.h"
+#include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated.h"
+#include "edge-impulse-sdk/classifier/ei_aligned_malloc.h"
+
+#define GEN_ARENA_SIZE      (64 * 1024)
+#define GEN_TEST_WINDOWS    64
+
+static const size_t tensor_count = sizeof(tensorData) / sizeof(tensorData[0]);
+static const size_t node_count = sizeof(nodeData) / sizeof(nodeData[0]);
+
+static bool tensor_type(TfLiteType type, tflite::TensorType *out)
+{
+    switch(type) {
+        case kTfLiteFloat32: *out = tflite::TensorType_FLOAT32; return true;
+        case kTfLiteInt32: *out = tflite::TensorType_INT32; return true;
+        case kTfLiteInt16: *out = tflite::TensorType_INT16; return true;
+        case kTfLiteInt8: *out = tflite::TensorType_INT8; return true;
+        case kTfLiteUInt8: *out = tflite::TensorType_UINT8; return true;
+        default: return false;
+    }
+}
+
+static std::vector<int32_t> int_array(const TfLiteIntArray *array)
+{
+    return std::vector<int32_t>(array->data, array->data + array->size);
+}
+
+/* graph inputs are the arena tensors no node writes, outputs the ones no node reads */
+static std::vector<int32_t> graph_io(bool inputs)
+{
+    std::vector<int32_t> io;
+
+    for(size_t t = 0; t < tensor_count; t++) {
+        if(tensorData[t].allocation_type != kTfLiteArenaRw) {
+            continue;
+        }
+        bool found = false;
+        for(size_t n = 0; n < node_count; n++) {
+            const TfLiteIntArray *list = inputs ? nodeData[n].outputs : nodeData[n].inputs;
+            for(int ix = 0; ix < list->size; ix++) {
+                found |= (list->data[ix] == (int)t);
+            }
+        }
+        if(!found) {
+            io.push_back((int32_t)t);
+        }
+    }
+
+    return io;
+}
+
+static bool build_model(flatbuffers::FlatBufferBuilder &fbb)
+{
+    std::vector<flatbuffers::Offset<tflite::Buffer>> buffers;
+    std::vector<flatbuffers::Offset<tflite::Tensor>> tensors;
+    std::vector<flatbuffers::Offset<tflite::Operator>> operators;
+    std::vector<flatbuffers::Offset<tflite::OperatorCode>> operator_codes;
+
+    // buffer 0 is the empty buffer of the arena tensors
+    buffers.push_back(tflite::CreateBuffer(fbb));
+
+    for(size_t t = 0; t < tensor_count; t++) {
+        const TensorInfo_t *info = &tensorData[t];
+        tflite::TensorType type;
+        uint32_t buffer = 0;
+
+        if(tensor_type(info->type, &type) == false) {
+            fprintf(stderr, "Tensor %u: unsupported type %d\n", (unsigned int)t, (int)info->type);
+            return false;
+        }
+
+        if(info->allocation_type == kTfLiteMmapRo) {
+            const uint8_t *data = (const uint8_t *)info->data;
+            std::vector<uint8_t> bytes(data, data + info->bytes);
+            buffer = (uint32_t)buffers.size();
+            buffers.push_back(tflite::CreateBufferDirect(fbb, &bytes));
+        }
+
+        flatbuffers::Offset<tflite::QuantizationParameters> quantization = 0;
+        if(info->quantization.type == kTfLiteAffineQuantization) {
+            const TfLiteAffineQuantization *q = (const TfLiteAffineQuantization *)info->quantization.params;
+            std::vector<float> scale(q->scale->data, q->scale->data + q->scale->size);
+            std::vector<int64_t> zero_point(q->zero_point->data, q->zero_point->data + q->zero_point->size);
+            quantization = tflite::CreateQuantizationParametersDirect(fbb, nullptr, nullptr, &scale, &zero_point,
+                tflite::QuantizationDetails_NONE, 0, q->quantized_dimension);
+        }
+
+        std::vector<int32_t> shape = int_array(info->dims);
+        char name[16];
+        snprintf(name, sizeof(name), "t%u", (unsigned int)t);
+        tensors.push_back(tflite::CreateTensorDirect(fbb, &shape, type, buffer, name, quantization));
+    }
+
+    for(int op = 0; op < OP_LAST; op++) {
+        tflite::BuiltinOperator code = (op == OP_FULLY_CONNECTED) ?
+            tflite::BuiltinOperator_FULLY_CONNECTED : tflite::BuiltinOperator_SOFTMAX;
+        operator_codes.push_back(tflite::CreateOperatorCode(fbb, (int8_t)code, 0, 1, code));
+    }
+
+    for(size_t n = 0; n < node_count; n++) {
+        const NodeInfo_t *node = &nodeData[n];
+        std::vector<int32_t> inputs = int_array(node->inputs);
+        std::vector<int32_t> outputs = int_array(node->outputs);
+        tflite::BuiltinOptions options_type;
+        flatbuffers::Offset<void> options;
+
+        switch(node->used_op_index) {
+            case OP_FULLY_CONNECTED: {
+                const TfLiteFullyConnectedParams *params = (const TfLiteFullyConnectedParams *)node->builtin_data;
+                tflite::ActivationFunctionType activation;
+                if(params->activation == kTfLiteActNone) {
+                    activation = tflite::ActivationFunctionType_NONE;
+                }
+                else if(params->activation == kTfLiteActRelu) {
+                    activation = tflite::ActivationFunctionType_RELU;
+                }
+                else {
+                    fprintf(stderr, "Node %u: unsupported activation %d\n", (unsigned int)n, (int)params->activation);
+                    return false;
+                }
+                options_type = tflite::BuiltinOptions_FullyConnectedOptions;
+                options = tflite::CreateFullyConnectedOptions(fbb, activation,
+                    tflite::FullyConnectedOptionsWeightsFormat_DEFAULT, params->keep_num_dims,
+                    params->asymmetric_quantize_inputs).Union();
+                break;
+            }
+            case OP_SOFTMAX: {
+                const TfLiteSoftmaxParams *params = (const TfLiteSoftmaxParams *)node->builtin_data;
+                options_type = tflite::BuiltinOptions_SoftmaxOptions;
+                options = tflite::CreateSoftmaxOptions(fbb, params->beta).Union();
+                break;
+            }
+            default:
+                fprintf(stderr, "Node %u: unsupported operator\n", (unsigned int)n);
+                return false;
+        }
+
+        operators.push_back(tflite::CreateOperatorDirect(fbb, (uint32_t)node->used_op_index,
+            &inputs, &outputs, options_type, options));
+    }
+
+    std::vector<int32_t> inputs = graph_io(true);
+    std::vector<int32_t> outputs = graph_io(false);
+    std::vector<flatbuffers::Offset<tflite::SubGraph>> subgraphs;
+    subgraphs.push_back(tflite::CreateSubGraphDirect(fbb, &tensors, &inputs, &outputs, &operators, "main"));
+
+    auto model = tflite::CreateModelDirect(fbb, TFLITE_SCHEMA_VERSION, &operator_codes, &subgraphs,
+        "EON graph of ei-model", &buffers);
+    tflite::FinishModelBuffer(fbb, model);
+
+    return true;
+}
+
+/* does the model run in an arena of this size? A temporary allocation that
+ * does not fit is dereferenced by the kernels, so each try runs in a child */
+static bool arena_fits(const uint8_t *buffer, const tflite::MicroOpResolver &resolver, size_t arena_size)
+{
+    pid_t pid = fork();
+    int status;
+
+    if(pid == 0) {
+        static tflite::MicroErrorReporter error_reporter;
+        uint8_t *arena = (uint8_t *)ei_aligned_calloc(16, arena_size);
+        // the allocation errors of the tries that do not fit
+        if(freopen("/dev/null", "w", stdout) == NULL) {
+            _exit(1);
+        }
+        tflite::MicroInterpreter interpreter(tflite::GetModel(buffer), resolver, arena, arena_size, &error_reporter);
+        _exit((interpreter.AllocateTensors() == kTfLiteOk && interpreter.Invoke() == kTfLiteOk) ? 0 : 1);
+    }
+
+    if(pid < 0 || waitpid(pid, &status, 0) != pid) {
+        return false;
+    }
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* smallest arena (16 byte steps) the model runs in */
+static bool measure_arena(const uint8_t *buffer, const tflite::MicroOpResolver &resolver, size_t *arena_size)
+{
+    size_t low = 0;
+    size_t high = GEN_ARENA_SIZE;
+
+    if(arena_fits(buffer, resolver, high) == false) {
+        fprintf(stderr, "The model does not run in %u bytes\n", (unsigned int)high);
+        return false;
+    }
+
+    while(high - low > 16) {
+        size_t mid = ((low + high) / 2) & ~(size_t)15;
+        if(arena_fits(buffer, resolver, mid)) {
+            high = mid;
+        }
+        else {
+            low = mid;
+        }
+    }
+
+    *arena_size = high;
+
+    return true;
+}
+
+/* same windows through the EON graph and the interpreter, in the planned arena */
+static bool check_model(const uint8_t *buffer, size_t *arena_size)
+{
+    static tflite::MicroErrorReporter error_reporter;
+    tflite::MicroMutableOpResolver<2> resolver;
+    resolver.AddFullyConnected();
+    resolver.AddSoftmax();
+
+    if(measure_arena(buffer, resolver, arena_size) == false) {
+        return false;
+    }
+
+    uint8_t *arena = (uint8_t *)ei_aligned_calloc(16, *arena_size);
+    tflite::MicroInterpreter interpreter(tflite::GetModel(buffer), resolver, arena, *arena_size, &error_reporter);
+    if(interpreter.AllocateTensors() != kTfLiteOk) {
+        fprintf(stderr, "AllocateTensors() failed\n");
+        ei_aligned_free(arena);
+        return false;
+    }
+
+    if(trained_model_init(ei_aligned_calloc) != kTfLiteOk) {
+        fprintf(stderr, "EON graph init failed\n");
+        ei_aligned_free(arena);
+        return false;
+    }
+
+    TfLiteTensor eon_input, eon_output;
+    trained_model_input(0, &eon_input);
+    trained_model_output(0, &eon_output);
+    TfLiteTensor *input = interpreter.input(0);
+    TfLiteTensor *output = interpreter.output(0);
+    bool ret = (input->bytes == eon_input.bytes && output->bytes == eon_output.bytes);
+
+    srand(1);
+    for(int window = 0; window < GEN_TEST_WINDOWS && ret; window++) {
+        for(size_t ix = 0; ix < input->bytes; ix++) {
+            input->data.int8[ix] = (int8_t)(rand() & 0xff);
+        }
+        memcpy(eon_input.data.raw, input->data.raw, input->bytes);
+
+        if(interpreter.Invoke() != kTfLiteOk || trained_model_invoke() != kTfLiteOk) {
+            fprintf(stderr, "Invoke failed\n");
+            ret = false;
+        }
+        else if(memcmp(output->data.raw, eon_output.data.raw, output->bytes) != 0) {
+            fprintf(stderr, "Output of window %d differs from the EON graph\n", window);
+            ret = false;
+        }
+    }
+
+    trained_model_reset(ei_aligned_free);
+    ei_aligned_free(arena);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    flatbuffers::FlatBufferBuilder fbb;
+    size_t arena_size;
+
+    if(argc != 2) {
+        fprintf(stderr, "Usage: %s <output.cpp>\n", argv[0]);
+        return 1;
+    }
+
+    if(build_model(fbb) == false || check_model(fbb.GetBufferPointer(), &arena_size) == false) {
+        return 1;
+    }
+
+    FILE *out = fopen(argv[1], "w");
+    if(out == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    const uint8_t *data = fbb.GetBufferPointer();
+    size_t len = fbb.GetSize();
+
+    fprintf(out, "/* Generated by ei_tflm_model_gen from tflite-model/trained_model_compiled.cpp */\n\n");
+    fprintf(out, "#include \"tflite-model/tflite_learn_0.h\"\n\n");
+    fprintf(out, "const size_t tflite_learn_0_arena_size = %u;\n", (unsigned int)arena_size);
+    fprintf(out, "const unsigned int tflite_learn_0_len = %u;\n", (unsigned int)len);
+    fprintf(out, "alignas(16) const unsigned char tflite_learn_0[%u] = {", (unsigned int)len);
+    for(size_t ix = 0; ix < len; ix++) {
+        fprintf(out, "%s0x%02x,", (ix % 16) ? " " : "\n    ", data[ix]);
+    }
+    fprintf(out, "\n};\n");
+
+    return (fclose(out) == 0) ? 0 : 1;
+}
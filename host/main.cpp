@@ -0,0 +1,951 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "model-parameters/model_metadata.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "firmware-sdk/ei_device_info_lib.h"
+#include "firmware-sdk/ei_device_interface.h"
+#include "firmware-sdk/ei_device_lib.h"
+#include "firmware-sdk/ei_fusion.h"
+#include "ei_inertial_sensor.h"
+#include "ei_microphone.h"
+#include "ei_run_impulse.h"
+#include "ei_bluetooth_psoc63.h"
+#include "ei_ble_results.h"
+#include "ei_ble_stream.h"
+#include "ei_ble_control.h"
+#include "ei_ble_model_update.h"
+#include "ei_model_store.h"
+#include "ei_framed_protocol.h"
+#include "ei_sample_signing.h"
+#include "ei_sample_format.h"
+#include "ei_sample_reader.h"
+#include "sensor_aq_mbedtls_hs256.h"
+#include "ei_classifier.h"
+#include "ei_sim.h"
+
+/******
+ *
+ * @brief Host simulation of the EdgeImpulse PSoC63 firmware. Runs the
+ *        firmware sampling and inferencing code against recorded data,
+ *        on a virtual clock. See README.md for more information
+ *
+ ******/
+
+/* same as the AT+RUNIMPULSESTATICBIN settings in ei_at_handlers.cpp */
+#define SIM_TRANSFER_FRAME_LEN      512
+#define SIM_TRANSFER_ACK_WINDOW     8
+
+typedef enum {
+    SIM_MODE_INGEST,
+    SIM_MODE_SINGLE,
+    SIM_MODE_CONTINUOUS,
+    SIM_MODE_STATIC,
+    SIM_MODE_REPLAY,
+    SIM_MODE_STREAM,
+    SIM_MODE_CONTROL,
+    SIM_MODE_UPDATE,
+    SIM_MODE_FRAMED,
+    SIM_MODE_CONVERT,
+    SIM_MODE_STORED
+} sim_mode_t;
+
+/* Control Point writes given on the command line */
+#define SIM_MAX_CONTROL_WRITES      8
+/* models sent one after the other in update mode */
+#define SIM_MAX_MODEL_UPDATES       4
+
+typedef struct {
+    sim_mode_t mode;
+    const char *imu_path;
+    const char *mic_path;
+    const char *features_path;
+    const char *console_path;
+    const char *compact_path;
+    const char *out_path;
+    const char *ble_log_path;
+    const char *ble_records_path;
+    const char *ble_stream_path;
+    ei_ble_stream_format_t stream_format;
+    const char *label;
+    const char *signing;
+    const char *sample_format;
+    float interval_ms;
+    uint32_t length_ms;
+    uint32_t max_results;
+    uint32_t stride;
+    const char *nn_mode;
+    const char *ble_policy;
+    uint32_t ble_coalesce;
+    uint32_t ble_interval_ms;
+    uint32_t ble_centrals;
+    uint32_t ble_disconnect_ms;
+    const char *ble_control[SIM_MAX_CONTROL_WRITES];
+    size_t ble_control_count;
+    const char *model_path[SIM_MAX_MODEL_UPDATES];
+    size_t model_count;
+    const char *model_key;
+    bool debug;
+} sim_options_t;
+
+static void print_usage(const char *name)
+{
+    printf("Usage: %s --mode <ingest|single|continuous|static|replay|stream|control|update|framed|convert|stored> [options]\n", name);
+    printf("Inputs:\n");
+    printf("  --imu <file>          accelerometer recording (CSV or data acquisition CBOR)\n");
+    printf("  --mic <file>          microphone recording (16 bit mono WAV)\n");
+    printf("  --features <file>     raw features for static mode (comma separated)\n");
+    printf("  --console <file>      bytes received on the UART (static mode without\n");
+    printf("                        --features: binary transfer frames, framed mode:\n");
+    printf("                        request frames, the response frames go to stdout)\n");
+    printf("Ingestion:\n");
+    printf("  --label <name>        sample label\n");
+    printf("  --interval <ms>       sample interval\n");
+    printf("  --length <ms>         sample length\n");
+    printf("  --out <file>          write the sampled CBOR file\n");
+    printf("  --signing <mode>      inline or deferred (default: inline)\n");
+    printf("  --sample-format <f>   cbor, int16 or delta (default: cbor)\n");
+    printf("  --compact <file>      convert mode: int16/delta sample file to convert to\n");
+    printf("                        signed CBOR (--out)\n");
+    printf("BLE streaming (--interval and --length apply too):\n");
+    printf("  --stream-format <f>   int16 or delta (default: delta)\n");
+    printf("  --ble-stream <file>   write the samples decoded from the notifications (CSV)\n");
+    printf("Inference:\n");
+    printf("  --max-results <n>     stop after n results (default: end of recording)\n");
+    printf("  --nn-mode <mode>      NN setup: window or resident (default: window)\n");
+    printf("  --ble-log <file>      log BLE class result notifications\n");
+    printf("  --ble-records <file>  log BLE result record notifications (hex)\n");
+    printf("  --ble-policy <name>   BLE result policy: latest, coalesce, change (default: latest)\n");
+    printf("  --ble-coalesce <n>    results per notification with the coalesce policy\n");
+    printf("  --ble-interval <ms>   fixed connection interval (default: follows the link mode)\n");
+    printf("  --ble-centrals <n>    connected centrals, each gets every result (default: 1)\n");
+    printf("  --ble-disconnect <ms> the last central disconnects at this time\n");
+    printf("  --ble-control <hex>   write to the Control Point before the run, repeatable\n");
+    printf("                        (control mode: inference is started by these writes)\n");
+    printf("Model update over BLE:\n");
+    printf("  --model <file>        model blob to send, repeatable (one update each)\n");
+    printf("  --model-key <key>     sign with this key instead of EI_MODEL_SIGNING_KEY\n");
+    printf("  --stride <samples>    window step in replay and stored mode (default: one slice)\n");
+    printf("  --debug               print DSP and NN debug output\n");
+}
+
+static bool parse_options(int argc, char **argv, sim_options_t *opt)
+{
+    memset(opt, 0, sizeof(*opt));
+    opt->mode = SIM_MODE_SINGLE;
+    opt->stream_format = EI_BLE_STREAM_FORMAT_DELTA;
+
+    for(int ix = 1; ix < argc; ix++) {
+        const char *arg = argv[ix];
+        const char *value = (ix + 1 < argc) ? argv[ix + 1] : NULL;
+
+        if(strcmp(arg, "--debug") == 0) {
+            opt->debug = true;
+            continue;
+        }
+        if(strcmp(arg, "--help") == 0) {
+            return false;
+        }
+        if(value == NULL) {
+            ei_printf("ERR: missing value for %s\n", arg);
+            return false;
+        }
+        ix++;
+
+        if(strcmp(arg, "--mode") == 0) {
+            if(strcmp(value, "ingest") == 0) {
+                opt->mode = SIM_MODE_INGEST;
+            }
+            else if(strcmp(value, "single") == 0) {
+                opt->mode = SIM_MODE_SINGLE;
+            }
+            else if(strcmp(value, "continuous") == 0) {
+                opt->mode = SIM_MODE_CONTINUOUS;
+            }
+            else if(strcmp(value, "static") == 0) {
+                opt->mode = SIM_MODE_STATIC;
+            }
+            else if(strcmp(value, "replay") == 0) {
+                opt->mode = SIM_MODE_REPLAY;
+            }
+            else if(strcmp(value, "stream") == 0) {
+                opt->mode = SIM_MODE_STREAM;
+            }
+            else if(strcmp(value, "control") == 0) {
+                opt->mode = SIM_MODE_CONTROL;
+            }
+            else if(strcmp(value, "update") == 0) {
+                opt->mode = SIM_MODE_UPDATE;
+            }
+            else if(strcmp(value, "framed") == 0) {
+                opt->mode = SIM_MODE_FRAMED;
+            }
+            else if(strcmp(value, "convert") == 0) {
+                opt->mode = SIM_MODE_CONVERT;
+            }
+            else if(strcmp(value, "stored") == 0) {
+                opt->mode = SIM_MODE_STORED;
+            }
+            else {
+                ei_printf("ERR: unknown mode %s\n", value);
+                return false;
+            }
+        }
+        else if(strcmp(arg, "--imu") == 0) {
+            opt->imu_path = value;
+        }
+        else if(strcmp(arg, "--mic") == 0) {
+            opt->mic_path = value;
+        }
+        else if(strcmp(arg, "--features") == 0) {
+            opt->features_path = value;
+        }
+        else if(strcmp(arg, "--console") == 0) {
+            opt->console_path = value;
+        }
+        else if(strcmp(arg, "--out") == 0) {
+            opt->out_path = value;
+        }
+        else if(strcmp(arg, "--ble-log") == 0) {
+            opt->ble_log_path = value;
+        }
+        else if(strcmp(arg, "--ble-records") == 0) {
+            opt->ble_records_path = value;
+        }
+        else if(strcmp(arg, "--label") == 0) {
+            opt->label = value;
+        }
+        else if(strcmp(arg, "--signing") == 0) {
+            opt->signing = value;
+        }
+        else if(strcmp(arg, "--sample-format") == 0) {
+            opt->sample_format = value;
+        }
+        else if(strcmp(arg, "--compact") == 0) {
+            opt->compact_path = value;
+        }
+        else if(strcmp(arg, "--interval") == 0) {
+            opt->interval_ms = strtof(value, NULL);
+        }
+        else if(strcmp(arg, "--length") == 0) {
+            opt->length_ms = strtoul(value, NULL, 10);
+        }
+        else if(strcmp(arg, "--max-results") == 0) {
+            opt->max_results = strtoul(value, NULL, 10);
+        }
+        else if(strcmp(arg, "--stride") == 0) {
+            opt->stride = strtoul(value, NULL, 10);
+        }
+        else if(strcmp(arg, "--nn-mode") == 0) {
+            opt->nn_mode = value;
+        }
+        else if(strcmp(arg, "--ble-policy") == 0) {
+            opt->ble_policy = value;
+        }
+        else if(strcmp(arg, "--ble-coalesce") == 0) {
+            opt->ble_coalesce = strtoul(value, NULL, 10);
+        }
+        else if(strcmp(arg, "--ble-stream") == 0) {
+            opt->ble_stream_path = value;
+        }
+        else if(strcmp(arg, "--stream-format") == 0) {
+            if(strcmp(value, "int16") == 0) {
+                opt->stream_format = EI_BLE_STREAM_FORMAT_INT16;
+            }
+            else if(strcmp(value, "delta") == 0) {
+                opt->stream_format = EI_BLE_STREAM_FORMAT_DELTA;
+            }
+            else {
+                ei_printf("ERR: unknown stream format %s\n", value);
+                return false;
+            }
+        }
+        else if(strcmp(arg, "--ble-interval") == 0) {
+            opt->ble_interval_ms = strtoul(value, NULL, 10);
+        }
+        else if(strcmp(arg, "--ble-centrals") == 0) {
+            opt->ble_centrals = (uint32_t)atoi(value);
+        }
+        else if(strcmp(arg, "--ble-disconnect") == 0) {
+            opt->ble_disconnect_ms = (uint32_t)atoi(value);
+        }
+        else if(strcmp(arg, "--ble-control") == 0) {
+            if(opt->ble_control_count >= SIM_MAX_CONTROL_WRITES) {
+                ei_printf("ERR: at most %d Control Point writes\n", SIM_MAX_CONTROL_WRITES);
+                return false;
+            }
+            opt->ble_control[opt->ble_control_count++] = value;
+        }
+        else if(strcmp(arg, "--model") == 0) {
+            if(opt->model_count >= SIM_MAX_MODEL_UPDATES) {
+                ei_printf("ERR: at most %d models\n", SIM_MAX_MODEL_UPDATES);
+                return false;
+            }
+            opt->model_path[opt->model_count++] = value;
+        }
+        else if(strcmp(arg, "--model-key") == 0) {
+            opt->model_key = value;
+        }
+        else {
+            ei_printf("ERR: unknown option %s\n", arg);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool run_ingest(sim_options_t *opt)
+{
+    EiDeviceInfo *dev = EiDeviceInfo::get_device();
+    bool ret;
+
+    if(opt->label != NULL) {
+        dev->set_sample_label(opt->label, false);
+    }
+    if(opt->interval_ms > 0.0f) {
+        dev->set_sample_interval_ms(opt->interval_ms, false);
+    }
+    if(opt->length_ms > 0) {
+        dev->set_sample_length_ms(opt->length_ms, false);
+    }
+    if(opt->signing != NULL) {
+        ei_signing_mode_t mode;
+        if(ei_signing_mode_from_name(opt->signing, &mode) == false) {
+            return false;
+        }
+        ei_signing_set_mode(mode);
+    }
+    if(opt->sample_format != NULL) {
+        ei_sample_format_t format;
+        if(ei_sample_format_from_name(opt->sample_format, &format) == false) {
+            return false;
+        }
+        ei_sample_set_format(format);
+    }
+
+    // same as AT+SAMPLESTART
+    if(opt->mic_path != NULL) {
+        ret = ei_microphone_sample_start();
+    }
+    else if(ei_connect_fusion_list(inertial_sensor.name, SENSOR_FORMAT)) {
+        ret = ei_fusion_setup_data_sampling();
+    }
+    else {
+        ei_printf("ERR: Failed to find sensor '%s' in the sensor list\n", inertial_sensor.name);
+        ret = false;
+    }
+
+    if(ret == false) {
+        ei_printf("ERR: Failed to start sampling\n");
+        return false;
+    }
+
+    if(opt->out_path != NULL) {
+        ret = ei_flash_sim_dump_samples(opt->out_path);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief      What the uploader does with a compact sample file: decode the
+ *             blocks and write them as data acquisition CBOR, signed with
+ *             the device HMAC key
+ */
+static bool run_convert(sim_options_t *opt)
+{
+    EiDeviceInfo *dev = EiDeviceInfo::get_device();
+    std::vector<uint8_t> file;
+    ei_sample_file_info_t info;
+    int16_t values[EI_SAMPLE_BLOCK_VALUES];
+    float sample[EI_MAX_SENSOR_AXES];
+
+    FILE *in = fopen(opt->compact_path, "rb");
+    if(in == NULL) {
+        ei_printf("ERR: Failed to open %s\n", opt->compact_path);
+        return false;
+    }
+    int c;
+    while((c = fgetc(in)) != EOF) {
+        file.push_back((uint8_t)c);
+    }
+    fclose(in);
+
+    size_t pos = ei_sample_file_parse_header(file.data(), file.size(), &info);
+    if(pos == 0) {
+        ei_printf("ERR: %s is not an int16/delta sample file\n", opt->compact_path);
+        return false;
+    }
+
+    sensor_aq_payload_info payload = { info.device_name, info.device_type, info.interval_ms, {} };
+    for(uint8_t ix = 0; ix < info.n_axes; ix++) {
+        payload.sensors[ix].name = info.axes[ix].name;
+        payload.sensors[ix].units = info.axes[ix].units;
+    }
+
+    FILE *out = fopen(opt->out_path, "w+b");
+    if(out == NULL) {
+        ei_printf("ERR: Failed to open %s\n", opt->out_path);
+        return false;
+    }
+
+    static unsigned char cbor_buffer[1024];
+    sensor_aq_signing_ctx_t signing_ctx;
+    sensor_aq_mbedtls_hs256_ctx_t hs_ctx;
+    sensor_aq_ctx ctx = { { cbor_buffer, sizeof(cbor_buffer) }, &signing_ctx, &fwrite, &fseek, NULL };
+    uint32_t samples = 0;
+    bool ret = true;
+
+    sensor_aq_init_mbedtls_hs256_context(&signing_ctx, &hs_ctx, dev->get_sample_hmac_key().c_str());
+    if(sensor_aq_init(&ctx, &payload, out, false) != AQ_OK) {
+        ei_printf("ERR: sensor_aq_init failed\n");
+        ret = false;
+    }
+
+    while(ret) {
+        size_t block_len;
+        int n = ei_sample_file_decode_block(&file[pos], file.size() - pos, &info, values, EI_SAMPLE_BLOCK_VALUES, &block_len);
+        if(n == 0) {
+            break;
+        }
+        if(n < 0) {
+            ei_printf("ERR: Damaged block at offset %u\n", (unsigned int)pos);
+            ret = false;
+            break;
+        }
+
+        for(int sx = 0; sx < n && ret; sx++) {
+            for(uint8_t ax = 0; ax < info.n_axes; ax++) {
+                sample[ax] = (float)values[sx * info.n_axes + ax] / info.scale;
+            }
+            ret = (sensor_aq_add_data(&ctx, sample, info.n_axes) == AQ_OK);
+        }
+        samples += n;
+        pos += block_len;
+    }
+
+    if(ret && sensor_aq_finish(&ctx) != AQ_OK) {
+        ret = false;
+    }
+    fclose(out);
+
+    if(ret) {
+        ei_printf("Converted %u samples (%u bytes %s) to %s\n", (unsigned int)samples,
+            (unsigned int)pos, ei_sample_format_name(info.format), opt->out_path);
+    }
+    else {
+        ei_printf("ERR: Failed to convert %s\n", opt->compact_path);
+    }
+
+    return ret;
+}
+
+static bool write_control_point(const char *hex)
+{
+    uint8_t data[EI_BLE_CONTROL_MAX_LEN];
+    size_t len = strlen(hex) / 2;
+
+    if(strlen(hex) % 2 != 0 || len == 0 || len > sizeof(data)) {
+        ei_printf("ERR: Control Point write must be 1..%d hex bytes\n", EI_BLE_CONTROL_MAX_LEN);
+        return false;
+    }
+    for(size_t ix = 0; ix < len; ix++) {
+        char byte[3] = { hex[ix * 2], hex[ix * 2 + 1], 0 };
+        char *end;
+        data[ix] = (uint8_t)strtoul(byte, &end, 16);
+        if(*end != 0) {
+            ei_printf("ERR: Invalid hex byte %s\n", byte);
+            return false;
+        }
+    }
+
+    // same as the write to HDLC_EDGE_IMPULSE_CONTROL_POINT_VALUE
+    return ei_ble_control_command(0, data, (uint16_t)len);
+}
+
+static bool send_model(const char *path, uint32_t version, const char *key)
+{
+    std::vector<uint8_t> blob;
+    uint8_t packet[EI_BLE_MODEL_MAX_LEN];
+    const uint32_t chunk = EI_BLE_MODEL_MAX_LEN - 5;
+    sensor_aq_signing_ctx_t signing_ctx;
+    sensor_aq_mbedtls_hs256_ctx_t hs_ctx;
+    ei_model_info_t before, after;
+
+    FILE *f = fopen(path, "rb");
+    if(f == NULL) {
+        ei_printf("ERR: Failed to open %s\n", path);
+        return false;
+    }
+    int c;
+    while((c = fgetc(f)) != EOF) {
+        blob.push_back((uint8_t)c);
+    }
+    fclose(f);
+
+    // what the central computes before the transfer
+    uint32_t crc = ei_crc32_update(0, blob.data(), blob.size());
+    sensor_aq_init_mbedtls_hs256_context(&signing_ctx, &hs_ctx, key);
+    signing_ctx.init(&signing_ctx);
+    signing_ctx.update(&signing_ctx, blob.data(), blob.size());
+
+    ei_model_store_get_active(&before);
+    ei_printf("Sending %s (%u bytes, CRC %08x, version %u)\n", path,
+        (unsigned int)blob.size(), (unsigned int)crc, (unsigned int)version);
+
+    // same as the writes to HDLC_EDGE_IMPULSE_MODEL_UPDATE_VALUE
+    uint32_t len = (uint32_t)blob.size();
+    packet[0] = EI_BLE_MODEL_OP_BEGIN;
+    memcpy(&packet[1], &len, 4);
+    memcpy(&packet[5], &crc, 4);
+    memcpy(&packet[9], &version, 4);
+    ei_ble_model_update_command(0, packet, 13);
+
+    for(uint32_t offset = 0; offset < len; offset += chunk) {
+        uint32_t n = (len - offset < chunk) ? len - offset : chunk;
+        packet[0] = EI_BLE_MODEL_OP_DATA;
+        memcpy(&packet[1], &offset, 4);
+        memcpy(&packet[5], &blob[offset], n);
+        ei_ble_model_update_command(0, packet, (uint16_t)(n + 5));
+    }
+
+    packet[0] = EI_BLE_MODEL_OP_COMMIT;
+    signing_ctx.finish(&signing_ctx, &packet[1]);
+    ei_ble_model_update_command(0, packet, 1 + EI_MODEL_SIGNATURE_LEN);
+
+    packet[0] = EI_BLE_MODEL_OP_STATUS;
+    ei_ble_model_update_command(0, packet, 1);
+
+    ei_model_store_get_active(&after);
+    if(after.seq == before.seq) {
+        ei_printf("Model update failed, slot %u still active\n", after.slot);
+        return false;
+    }
+    ei_printf("Model version %u stored in slot %u, not loaded\n", (unsigned int)after.version, after.slot);
+
+    return true;
+}
+
+static bool run_update(sim_options_t *opt)
+{
+    const char *key = opt->model_key;
+    bool ret = true;
+
+    if(key == NULL) {
+        key = EI_MODEL_SIGNING_KEY;
+    }
+
+    for(size_t ix = 0; ix < opt->model_count; ix++) {
+        if(send_model(opt->model_path[ix], (uint32_t)(ix + 1), key) == false) {
+            ret = false;
+        }
+    }
+
+    // what the next boot finds in the selector
+    ei_model_info_t info;
+    ei_model_store_init();
+    ei_model_store_get_active(&info);
+    ei_printf("After reboot: slot %u, version %u\n", info.slot, (unsigned int)info.version);
+
+    return ret;
+}
+
+static bool run_inference(sim_options_t *opt)
+{
+    // in control mode the Control Point writes started inference
+    if(opt->mode != SIM_MODE_CONTROL) {
+        ei_start_impulse(opt->mode == SIM_MODE_CONTINUOUS, opt->debug);
+    }
+
+    // same loop as ei_task, the UART poll is replaced by a virtual clock step
+    while(is_inference_running()) {
+        ei_sim_advance_us(EI_SIM_POLL_MS * 1000);
+
+        if(ei_getchar() == 'b') {
+            break;
+        }
+
+        ei_run_impulse();
+
+        if(ei_sim_input_exhausted()) {
+            break;
+        }
+        if(opt->max_results > 0) {
+            ei_ble_results_stats_t stats;
+            ei_ble_results_get_stats(&stats);
+            if(stats.results >= opt->max_results) {
+                break;
+            }
+        }
+    }
+
+    ei_stop_impulse();
+    // the next pass of the firmware loop, frees the resident NN
+    ei_run_impulse();
+
+    return true;
+}
+
+static bool run_framed(sim_options_t *opt)
+{
+    bool input = true;
+    uint8_t c;
+
+    // as after AT+FRAMED: the request frames are read from the console file,
+    // inference started by a CONTROL frame runs on until the recording ends
+    ei_framed_start();
+
+    while(true) {
+        if(input && ei_framed_is_active()) {
+            input = ei_serial_read(&c, 1, 0);
+            if(input) {
+                ei_framed_handle(c);
+            }
+        }
+        else if(is_inference_running() == false) {
+            break;
+        }
+
+        if(is_inference_running()) {
+            ei_sim_advance_us(EI_SIM_POLL_MS * 1000);
+            ei_run_impulse();
+
+            if(ei_sim_input_exhausted()) {
+                break;
+            }
+            if(opt->max_results > 0) {
+                ei_ble_results_stats_t stats;
+                ei_ble_results_get_stats(&stats);
+                if(stats.results >= opt->max_results) {
+                    break;
+                }
+            }
+        }
+    }
+
+    ei_stop_impulse();
+    // the next pass of the firmware loop, frees the resident NN
+    ei_run_impulse();
+
+    return true;
+}
+
+static bool run_static(sim_options_t *opt)
+{
+    std::vector<float> features;
+
+    if(opt->features_path == NULL) {
+        // same as AT+RUNIMPULSESTATICBIN, the frames are read from the console file
+        return run_impulse_static_data_binary(opt->debug, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE,
+            SIM_TRANSFER_FRAME_LEN, SIM_TRANSFER_ACK_WINDOW);
+    }
+
+    FILE *file = fopen(opt->features_path, "r");
+    if(file == NULL) {
+        ei_printf("ERR: Failed to open %s\n", opt->features_path);
+        return false;
+    }
+
+    float value;
+    while(fscanf(file, " %f ,", &value) == 1) {
+        features.push_back(value);
+    }
+    fclose(file);
+
+    // same as AT+RUNIMPULSESTATIC, without the base64 transfer
+    EI_IMPULSE_ERROR res = ei_start_impulse_static_data(opt->debug, features.data(), features.size());
+    ei_printf("RESULT %d\r\n", (int)res);
+
+    return (res == EI_IMPULSE_OK);
+}
+
+static std::vector<float> replay_samples;
+
+static int replay_get_data(size_t offset, size_t length, float *out_ptr)
+{
+    memcpy(out_ptr, &replay_samples[offset], length * sizeof(float));
+    return 0;
+}
+
+static bool run_stream(sim_options_t *opt)
+{
+    ei_bluetooth_sim_stream_t received;
+    ei_ble_stream_stats_t sent;
+    FILE *stream_log = NULL;
+
+    if(opt->ble_stream_path != NULL) {
+        stream_log = fopen(opt->ble_stream_path, "w");
+        if(stream_log == NULL) {
+            ei_printf("ERR: Failed to open %s\n", opt->ble_stream_path);
+            return false;
+        }
+        ei_bluetooth_sim_set_stream_log(stream_log);
+    }
+
+    // same as writing a start command to the Raw Stream characteristic
+    uint64_t start_ms = ei_read_timer_ms();
+    if(ei_ble_stream_start(0, opt->stream_format, (uint32_t)opt->interval_ms) == false) {
+        return false;
+    }
+
+    while(ei_ble_stream_is_running()) {
+        ei_sim_advance_us(EI_SIM_POLL_MS * 1000);
+
+        if(ei_sim_input_exhausted() ||
+           (opt->length_ms > 0 && ei_read_timer_ms() - start_ms >= opt->length_ms)) {
+            ei_ble_stream_stop();
+        }
+    }
+    uint64_t elapsed_ms = ei_read_timer_ms() - start_ms;
+
+    // let the sampler send the last frame and the link drain
+    ei_sim_advance_us(1000 * 1000);
+
+    ei_ble_stream_get_stats(&sent);
+    ei_bluetooth_sim_get_stream(&received);
+
+    ei_printf("Device: %u samples, %u frames, %u bytes, %u samples dropped, %u frames refused\n",
+        (unsigned int)sent.samples, (unsigned int)sent.frames, (unsigned int)sent.bytes,
+        (unsigned int)sent.dropped_samples, (unsigned int)sent.dropped_frames);
+    ei_printf("Central: %u samples, %u frames, %u bytes, %u frames lost, %u samples missing, %u bad frames\n",
+        (unsigned int)received.samples, (unsigned int)received.frames, (unsigned int)received.bytes,
+        (unsigned int)received.lost_frames, (unsigned int)received.gap_samples, (unsigned int)received.errors);
+    if(received.samples > 0 && elapsed_ms > 0) {
+        ei_printf("Throughput: %u bytes/s, %u.%02u bytes/sample\n",
+            (unsigned int)((uint64_t)received.bytes * 1000 / elapsed_ms),
+            (unsigned int)(received.bytes / received.samples),
+            (unsigned int)((received.bytes * 100 / received.samples) % 100));
+    }
+
+    if(stream_log != NULL) {
+        fclose(stream_log);
+    }
+
+    return (received.errors == 0);
+}
+
+static bool run_replay(sim_options_t *opt)
+{
+    const char *path = (opt->imu_path != NULL) ? opt->imu_path : opt->mic_path;
+    size_t stride = (opt->stride > 0) ? opt->stride : EI_CLASSIFIER_SLICE_SIZE;
+    size_t n_results = 0;
+
+    if(ei_sim_load_recording(path, EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME, replay_samples, NULL) == false) {
+        return false;
+    }
+
+    // classify the whole recording in one batch, instead of sampling it window by window
+    size_t max_results = 0;
+    if(replay_samples.size() >= EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
+        max_results = 1 + (replay_samples.size() - EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) /
+            (stride * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME);
+    }
+    if(opt->max_results > 0 && opt->max_results < max_results) {
+        max_results = opt->max_results;
+    }
+
+    std::vector<ei_impulse_result_t> results(max_results);
+    signal_t recording;
+    recording.total_length = replay_samples.size();
+    recording.get_data = &replay_get_data;
+
+    uint64_t start_ms = ei_read_timer_ms();
+    EI_IMPULSE_ERROR res = run_classifier_batch_strided(&recording, stride, results.data(),
+        max_results, &n_results, opt->debug);
+
+    // one line per window: start time, best label and its score
+    for(size_t ix = 0; ix < n_results; ix++) {
+        size_t best = 0;
+        for(size_t jx = 1; jx < EI_CLASSIFIER_LABEL_COUNT; jx++) {
+            if(results[ix].classification[jx].value > results[ix].classification[best].value) {
+                best = jx;
+            }
+        }
+        ei_printf("%u,%s,%.5f\n", (unsigned int)(ix * stride * EI_CLASSIFIER_INTERVAL_MS),
+            results[ix].classification[best].label, results[ix].classification[best].value);
+    }
+
+    ei_printf("Replayed %u windows in %llu ms\n", (unsigned int)n_results,
+        (unsigned long long)(ei_read_timer_ms() - start_ms));
+
+    return (res == EI_IMPULSE_OK);
+}
+
+/**
+ * @brief      Record as AT+SAMPLESTART, then classify the file in flash as
+ *             AT+RUNIMPULSESTORED
+ */
+static bool run_stored(sim_options_t *opt)
+{
+    uint32_t length = 0;
+
+    if(run_ingest(opt) == false) {
+        return false;
+    }
+
+    // audio has no end marker, use the length the capture reported
+    if(opt->mic_path != NULL) {
+        ei_signing_stats_t stats;
+        ei_signing_get_stats(&stats);
+        length = stats.bytes;
+    }
+
+    return ei_sample_reader_run_impulse(length, opt->stride, opt->debug);
+}
+
+int main(int argc, char **argv)
+{
+    sim_options_t opt;
+    FILE *ble_log = NULL;
+    FILE *ble_records = NULL;
+    bool ret;
+
+    if(parse_options(argc, argv, &opt) == false) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if((opt.mode == SIM_MODE_STATIC && opt.features_path == NULL && opt.console_path == NULL) ||
+       (opt.mode == SIM_MODE_FRAMED && opt.console_path == NULL) ||
+       (opt.mode == SIM_MODE_UPDATE && opt.model_count == 0) ||
+       (opt.mode == SIM_MODE_CONVERT && (opt.compact_path == NULL || opt.out_path == NULL)) ||
+       (opt.mode != SIM_MODE_STATIC && opt.mode != SIM_MODE_UPDATE && opt.mode != SIM_MODE_CONVERT &&
+        opt.imu_path == NULL && opt.mic_path == NULL)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if((opt.imu_path != NULL && ei_inertial_sensor_sim_open(opt.imu_path) == false) ||
+       (opt.mic_path != NULL && ei_microphone_sim_open(opt.mic_path) == false) ||
+       (opt.console_path != NULL && ei_sim_console_open(opt.console_path) == false)) {
+        return 1;
+    }
+
+    if(opt.ble_log_path != NULL) {
+        ble_log = fopen(opt.ble_log_path, "w");
+        if(ble_log == NULL) {
+            ei_printf("ERR: Failed to open %s\n", opt.ble_log_path);
+            return 1;
+        }
+        ei_bluetooth_sim_set_log(ble_log);
+    }
+
+    if(opt.ble_records_path != NULL) {
+        ble_records = fopen(opt.ble_records_path, "w");
+        if(ble_records == NULL) {
+            ei_printf("ERR: Failed to open %s\n", opt.ble_records_path);
+            return 1;
+        }
+        ei_bluetooth_sim_set_record_log(ble_records);
+    }
+
+    if(opt.nn_mode != NULL) {
+        ei_classifier_nn_mode_t nn_mode;
+        if(ei_classifier_nn_mode_from_name(opt.nn_mode, &nn_mode) == false) {
+            return 1;
+        }
+        ei_classifier_set_nn_mode(nn_mode);
+    }
+
+    if(opt.ble_policy != NULL) {
+        ei_ble_policy_t policy;
+        if(ei_ble_results_policy_from_name(opt.ble_policy, &policy) == false ||
+           ei_ble_results_set_policy(policy, opt.ble_coalesce) == false) {
+            return 1;
+        }
+    }
+    if(opt.ble_interval_ms > 0) {
+        ei_bluetooth_sim_set_interval(opt.ble_interval_ms);
+    }
+    if(opt.ble_centrals > 0 && ei_bluetooth_sim_set_centrals((uint8_t)opt.ble_centrals) == false) {
+        return 1;
+    }
+    if(opt.ble_disconnect_ms > 0) {
+        ei_bluetooth_sim_set_disconnect(opt.ble_disconnect_ms);
+    }
+
+    ei_inertial_sensor_init();
+    ei_microphone_pdm_init();
+    EiDeviceInfo::get_device();
+    ei_model_store_init();
+    ei_bluetooth_init();
+
+    for(size_t ix = 0; ix < opt.ble_control_count; ix++) {
+        if(write_control_point(opt.ble_control[ix]) == false) {
+            return 1;
+        }
+    }
+
+    switch(opt.mode) {
+        case SIM_MODE_INGEST:
+            ret = run_ingest(&opt);
+            break;
+        case SIM_MODE_STATIC:
+            ret = run_static(&opt);
+            break;
+        case SIM_MODE_REPLAY:
+            ret = run_replay(&opt);
+            break;
+        case SIM_MODE_STREAM:
+            ret = run_stream(&opt);
+            break;
+        case SIM_MODE_UPDATE:
+            ret = run_update(&opt);
+            break;
+        case SIM_MODE_FRAMED:
+            ret = run_framed(&opt);
+            break;
+        case SIM_MODE_CONVERT:
+            ret = run_convert(&opt);
+            break;
+        case SIM_MODE_STORED:
+            ret = run_stored(&opt);
+            break;
+        default:
+            ret = run_inference(&opt);
+            break;
+    }
+
+    ei_ble_results_stats_t stats;
+    ei_ble_results_get_stats(&stats);
+    ei_printf("Simulated time: %llu ms, results: %u\n",
+        (unsigned long long)ei_read_timer_ms(), (unsigned int)stats.results);
+    ei_printf("BLE notifications: %u sent, %u results dropped, %u unchanged, %u gated\n",
+        (unsigned int)stats.sent, (unsigned int)stats.dropped, (unsigned int)stats.unchanged,
+        (unsigned int)stats.gated);
+    if(ei_bluetooth_sim_get_centrals() > 1) {
+        for(uint8_t conn = 0; conn < ei_bluetooth_sim_get_centrals(); conn++) {
+            ei_printf("BLE central %u: %u class results\n", conn,
+                (unsigned int)ei_bluetooth_sim_get_notification_count(conn));
+        }
+    }
+
+    if(ble_log != NULL) {
+        fclose(ble_log);
+    }
+
+    if(ble_records != NULL) {
+        fclose(ble_records);
+    }
+
+    return ret ? 0 : 1;
+}
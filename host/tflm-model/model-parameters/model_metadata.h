@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_HOST_TFLM_MODEL_METADATA_H
+#define EI_HOST_TFLM_MODEL_METADATA_H
+
+/**
+ * Host build on the TFLite Micro interpreter: the model of ei-model/ as a
+ * flatbuffer instead of the EON compiled graph (see host/ei_tflm_model_gen.cpp).
+ * This directory comes before ei-model/ in the include path of the
+ * classifier sources only.
+ */
+#include "../../../ei-model/model-parameters/model_metadata.h"
+
+#undef EI_CLASSIFIER_COMPILED
+#define EI_CLASSIFIER_COMPILED                      0
+
+#endif /* EI_HOST_TFLM_MODEL_METADATA_H */
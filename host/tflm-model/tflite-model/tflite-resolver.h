@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_HOST_TFLITE_RESOLVER_H
+#define EI_HOST_TFLITE_RESOLVER_H
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_mutable_op_resolver.h"
+
+/* the operators of tflite_learn_0, as an exported non-EON model declares them */
+#define EI_TFLITE_RESOLVER static tflite::MicroMutableOpResolver<2> resolver; \
+    resolver.AddFullyConnected(); \
+    resolver.AddSoftmax();
+
+#endif /* EI_HOST_TFLITE_RESOLVER_H */
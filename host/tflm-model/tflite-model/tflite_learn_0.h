@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_HOST_TFLITE_LEARN_0_H
+#define EI_HOST_TFLITE_LEARN_0_H
+
+#include <cstddef>
+
+/**
+ * The EON graph of ei-model/ as a TFLite flatbuffer, generated into the build
+ * directory by ei_tflm_model_gen. The arena size is the one the interpreter
+ * planned on the host (64 bit pointers, more than the target needs).
+ */
+extern const unsigned char tflite_learn_0[];
+extern const unsigned int tflite_learn_0_len;
+extern const size_t tflite_learn_0_arena_size;
+
+#endif /* EI_HOST_TFLITE_LEARN_0_H */
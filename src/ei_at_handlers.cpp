@@ -18,7 +18,18 @@
 
 #include "ei_at_handlers.h"
 #include "ei_device_psoc62.h"
+#include "ei_flash_memory.h"
 #include "ei_run_impulse.h"
+#include "ei_benchmark.h"
+#include "ei_classifier.h"
+#include "ei_ble_results.h"
+#include "ei_ble_buffers.h"
+#include "ei_model_store.h"
+#include "ei_framed_protocol.h"
+#include "ei_uart_tx.h"
+#include "ei_sample_signing.h"
+#include "ei_sample_format.h"
+#include "ei_sample_reader.h"
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
 #include "firmware-sdk/ei_fusion.h"
 #include "firmware-sdk/ei_device_info_lib.h"
@@ -30,6 +41,57 @@
 using namespace std;
 
 #define TRANSFER_BUF_LEN 32
+/* Binary transfer: 512 byte frames, ack every 8 frames (4 kB) */
+#define TRANSFER_FRAME_LEN 512
+#define TRANSFER_ACK_WINDOW 8
+
+#define AT_RUNIMPULSESTATICBIN              "RUNIMPULSESTATICBIN"
+#define AT_RUNIMPULSESTATICBIN_ARGS         "DEBUG,LENGTH"
+#define AT_RUNIMPULSESTATICBIN_HELP_TEXT    "Run the impulse on static data (binary frames)"
+
+#define AT_RUNIMPULSESTORED             "RUNIMPULSESTORED"
+#define AT_RUNIMPULSESTORED_ARGS        "LENGTH,STRIDE,DEBUG"
+#define AT_RUNIMPULSESTORED_HELP_TEXT   "Run the impulse on the stored sample (LENGTH 0: up to its end)"
+
+#define AT_RUNBENCHMARK             "RUNBENCHMARK"
+#define AT_RUNBENCHMARK_ARGS        "WINDOWS"
+#define AT_RUNBENCHMARK_HELP_TEXT   "Benchmark the impulse on synthetic data (JSON report)"
+#define BENCHMARK_JSON_SIZE         2048
+/* ei_printf formats into a 256 byte buffer */
+#define BENCHMARK_PRINT_CHUNK       200
+
+#define AT_BLERESULTS               "BLERESULTS"
+#define AT_BLERESULTS_ARGS          "POLICY,N"
+#define AT_BLERESULTS_HELP_TEXT     "BLE result policy (latest, coalesce, change) and counters"
+
+#define AT_BLEBUFFERS               "BLEBUFFERS"
+#define AT_BLEBUFFERS_HELP_TEXT     "BLE buffer pool usage"
+
+#define AT_MODEL                    "MODEL"
+#define AT_MODEL_HELP_TEXT          "Model slot updated over BLE"
+
+#define AT_BAUD                     "BAUD"
+#define AT_BAUD_ARGS                "BAUDRATE"
+#define AT_BAUD_HELP_TEXT           "Negotiate the UART rate for a session of transfers"
+
+#define AT_UARTTX                   "UARTTX"
+#define AT_UARTTX_ARGS              "POLICY"
+#define AT_UARTTX_HELP_TEXT         "Console TX ring policy (block, drop) and counters"
+
+#define AT_SIGNING                  "SIGNING"
+#define AT_SIGNING_ARGS             "MODE"
+#define AT_SIGNING_HELP_TEXT        "Sample signing (inline, deferred) and the last signing time"
+
+#define AT_SAMPLEFORMAT             "SAMPLEFORMAT"
+#define AT_SAMPLEFORMAT_ARGS        "FORMAT"
+#define AT_SAMPLEFORMAT_HELP_TEXT   "Sample file format (cbor, int16, delta) and the last file size"
+
+#define AT_NNMODE                   "NNMODE"
+#define AT_NNMODE_ARGS              "MODE"
+#define AT_NNMODE_HELP_TEXT         "NN setup per window or resident (window, resident) and setup count"
+
+#define AT_FRAMED                   "FRAMED"
+#define AT_FRAMED_HELP_TEXT         "Switch to the COBS framed protocol (until its EXIT frame)"
 
 // Helper functions
 
@@ -277,8 +339,9 @@ bool at_read_buffer(const char **argv, const int argc)
 
     dev->set_state(eiStateUploading);
 
+    // in an AT+BAUD session the data already goes at the negotiated rate
     bool use_max_baudrate = false;
-    if (argc >= 3 && argv[2][0] == 'y') {
+    if (argc >= 3 && argv[2][0] == 'y' && dev->is_baudrate_session() == false) {
        use_max_baudrate = true;
     }
 
@@ -400,6 +463,349 @@ bool at_run_impulse_static_data(const char **argv, const int argc)
     return res;
 }
 
+bool at_run_impulse_static_binary(const char **argv, const int argc)
+{
+    if (check_args_num(2, argc) == false) {
+        return false;
+    }
+
+    bool debug = (argv[0][0] == 'y');
+    size_t length = (size_t)atoi(argv[1]);
+
+    return run_impulse_static_data_binary(debug, length, TRANSFER_FRAME_LEN, TRANSFER_ACK_WINDOW);
+}
+
+bool at_run_impulse_stored(const char **argv, const int argc)
+{
+    if (check_args_num(1, argc) == false) {
+        return false;
+    }
+
+    if (is_inference_running()) {
+        ei_printf("ERR: Inference is running, stop it first\n");
+        return false;
+    }
+
+#if EI_FLASH_QSPI_DRIVER == 0
+    // the reads would return the buffers untouched, not the sample
+    ei_printf("ERR: The QSPI flash driver is stubbed, the stored sample can't be read\n");
+    return false;
+#endif
+
+    uint32_t length = (uint32_t)atoi(argv[0]);
+    uint32_t stride = (argc >= 2) ? (uint32_t)atoi(argv[1]) : 0;
+    bool debug = (argc >= 3 && argv[2][0] == 'y');
+
+    return ei_sample_reader_run_impulse(length, stride, debug);
+}
+
+bool at_run_benchmark(const char **argv, const int argc)
+{
+    ei_benchmark_report_t reports[EI_BENCHMARK_MODES];
+    ei_benchmark_source_t source;
+    bool ret = true;
+
+    if (check_args_num(1, argc) == false) {
+        return false;
+    }
+
+    if (is_inference_running()) {
+        ei_printf("ERR: Inference is running, stop it first\n");
+        return false;
+    }
+
+    uint32_t windows = (uint32_t)atoi(argv[0]);
+    if (windows == 0 || windows > EI_BENCHMARK_MAX_WINDOWS) {
+        ei_printf("ERR: WINDOWS must be 1..%d\n", EI_BENCHMARK_MAX_WINDOWS);
+        return false;
+    }
+
+    ei_benchmark_synthetic_source(&source, windows);
+
+    for (int mode = 0; mode < EI_BENCHMARK_MODES; mode++) {
+        if (ei_benchmark_begin(&reports[mode], (ei_benchmark_mode_t)mode, windows) == false) {
+            return false;
+        }
+        ret &= ei_benchmark_run(&reports[mode], &source);
+        ei_benchmark_end(&reports[mode]);
+    }
+
+    char *json = (char *)ei_malloc(BENCHMARK_JSON_SIZE);
+    if (json == NULL) {
+        ei_printf("ERR: Failed to allocate benchmark report\n");
+        return false;
+    }
+
+    int len = ei_benchmark_to_json(dev->get_device_type().c_str(), reports, EI_BENCHMARK_MODES, json, BENCHMARK_JSON_SIZE);
+    for (int pos = 0; pos < len; pos += BENCHMARK_PRINT_CHUNK) {
+        ei_printf("%.*s", BENCHMARK_PRINT_CHUNK, json + pos);
+    }
+    ei_printf("\n");
+    ei_free(json);
+
+    return ret && (len > 0);
+}
+
+bool at_get_ble_results(void)
+{
+    ei_ble_results_stats_t stats;
+    uint8_t coalesce_n;
+    ei_ble_policy_t policy = ei_ble_results_get_policy(&coalesce_n);
+
+    ei_ble_results_get_stats(&stats);
+
+    ei_printf("Policy:    %s\n", ei_ble_results_policy_name(policy));
+    if (policy == EI_BLE_POLICY_COALESCE) {
+        ei_printf("Coalesce:  %u\n", coalesce_n);
+    }
+    ei_printf("Format:    0x%02x\n", ei_ble_results_get_format());
+    ei_printf("Results:   %lu\n", (unsigned long)stats.results);
+    ei_printf("Gated:     %lu\n", (unsigned long)stats.gated);
+    ei_printf("Unchanged: %lu\n", (unsigned long)stats.unchanged);
+    ei_printf("Sent:      %lu\n", (unsigned long)stats.sent);
+    ei_printf("Dropped:   %lu\n", (unsigned long)stats.dropped);
+    ei_printf("Credits:   %u\n", stats.credits);
+
+    return true;
+}
+
+bool at_set_ble_results(const char **argv, const int argc)
+{
+    ei_ble_policy_t policy;
+    uint32_t coalesce_n = 1;
+
+    if (check_args_num(1, argc) == false) {
+        return false;
+    }
+
+    if (ei_ble_results_policy_from_name(argv[0], &policy) == false) {
+        return false;
+    }
+
+    if (argc >= 2) {
+        coalesce_n = (uint32_t)atoi(argv[1]);
+    }
+
+    if (ei_ble_results_set_policy(policy, coalesce_n) == false) {
+        return false;
+    }
+
+    ei_printf("OK\n");
+
+    return true;
+}
+
+bool at_get_ble_buffers(void)
+{
+    ei_ble_buffer_stats_t stats;
+
+    ei_ble_buffer_get_stats(&stats);
+
+    for (int ix = 0; ix < EI_BLE_BUFFER_CLASSES; ix++) {
+        ei_printf("%3u bytes: %u/%u in use, peak %u\n", stats.classes[ix].block_size,
+            stats.classes[ix].in_use, stats.classes[ix].blocks, stats.classes[ix].peak);
+    }
+    ei_printf("Allocs:    %lu\n", (unsigned long)stats.allocs);
+    ei_printf("Heap:      %lu (%u in use)\n", (unsigned long)stats.heap_fallbacks, stats.heap_in_use);
+    ei_printf("Failed:    %lu\n", (unsigned long)stats.failures);
+
+    return true;
+}
+
+bool at_get_baud(void)
+{
+    ei_printf("%lu\n", (unsigned long)dev->get_data_output_baudrate());
+
+    return true;
+}
+
+bool at_set_baud(const char **argv, const int argc)
+{
+    if (check_args_num(1, argc) == false) {
+        return false;
+    }
+
+    uint32_t baudrate = (uint32_t)atoi(argv[0]);
+
+    dev->negotiate_data_output_baudrate(baudrate);
+
+    return true;
+}
+
+bool at_get_uart_tx(void)
+{
+    ei_uart_tx_stats_t stats;
+
+    ei_uart_tx_get_stats(&stats);
+
+    ei_printf("Policy:    %s\n", ei_uart_tx_policy_name(ei_uart_tx_get_policy()));
+    ei_printf("Ring:      %u bytes, peak %u\n", stats.size, stats.peak);
+    ei_printf("Bytes:     %lu\n", (unsigned long)stats.bytes);
+    ei_printf("Dropped:   %lu\n", (unsigned long)stats.dropped);
+    ei_printf("Waits:     %lu\n", (unsigned long)stats.waits);
+
+    return true;
+}
+
+bool at_set_uart_tx(const char **argv, const int argc)
+{
+    ei_uart_tx_policy_t policy;
+
+    if (check_args_num(1, argc) == false) {
+        return false;
+    }
+
+    if (ei_uart_tx_policy_from_name(argv[0], &policy) == false) {
+        return false;
+    }
+
+    ei_uart_tx_set_policy(policy);
+
+    ei_printf("OK\n");
+
+    return true;
+}
+
+bool at_get_signing(void)
+{
+    ei_signing_stats_t stats;
+
+    ei_signing_get_stats(&stats);
+
+    ei_printf("Mode:      %s\n", ei_signing_mode_name(ei_signing_get_mode()));
+    ei_printf("Last:      %lu bytes, signed in %lu ms\n", (unsigned long)stats.bytes, (unsigned long)stats.sign_ms);
+
+    return true;
+}
+
+bool at_set_signing(const char **argv, const int argc)
+{
+    ei_signing_mode_t mode;
+
+    if (check_args_num(1, argc) == false) {
+        return false;
+    }
+
+    if (ei_signing_mode_from_name(argv[0], &mode) == false) {
+        return false;
+    }
+
+    ei_signing_set_mode(mode);
+
+    ei_printf("OK\n");
+
+    return true;
+}
+
+bool at_get_sample_format(void)
+{
+    ei_sample_format_stats_t stats;
+
+    ei_sample_format_get_stats(&stats);
+
+    ei_printf("Format:    %s\n", ei_sample_format_name(ei_sample_get_format()));
+    ei_printf("Last:      %lu bytes, %lu samples", (unsigned long)stats.bytes, (unsigned long)stats.samples);
+    if (stats.samples > 0) {
+        ei_printf(" (%.2f bytes/sample)", (float)stats.bytes / stats.samples);
+    }
+    ei_printf("\n");
+    ei_printf("Saturated: %lu\n", (unsigned long)stats.saturated);
+
+    return true;
+}
+
+bool at_set_sample_format(const char **argv, const int argc)
+{
+    ei_sample_format_t format;
+
+    if (check_args_num(1, argc) == false) {
+        return false;
+    }
+
+    if (ei_sample_format_from_name(argv[0], &format) == false) {
+        return false;
+    }
+
+    ei_sample_set_format(format);
+
+    ei_printf("OK\n");
+
+    return true;
+}
+
+bool at_get_nn_mode(void)
+{
+    ei_classifier_nn_stats_t stats;
+
+    ei_classifier_get_nn_stats(&stats);
+
+    ei_printf("Mode:      %s\n", ei_classifier_nn_mode_name(ei_classifier_get_nn_mode()));
+    ei_printf("Setups:    %lu, last in %lu us\n", (unsigned long)stats.setups, (unsigned long)stats.setup_us);
+    ei_printf("Resident:  %s\n", stats.resident ? "yes" : "no");
+
+    return true;
+}
+
+bool at_set_nn_mode(const char **argv, const int argc)
+{
+    ei_classifier_nn_mode_t mode;
+
+    if (check_args_num(1, argc) == false) {
+        return false;
+    }
+
+    if (is_inference_running()) {
+        ei_printf("ERR: Inference is running, stop it first\n");
+        return false;
+    }
+
+    if (ei_classifier_nn_mode_from_name(argv[0], &mode) == false) {
+        return false;
+    }
+
+    ei_classifier_set_nn_mode(mode);
+
+    ei_printf("OK\n");
+
+    return true;
+}
+
+bool at_get_model(void)
+{
+    ei_model_info_t info;
+
+    ei_model_store_get_active(&info);
+
+    if (info.slot == EI_MODEL_NO_SLOT) {
+        ei_printf("Slot:      none\n");
+    }
+    else {
+        ei_printf("Slot:      %u\n", info.slot);
+        ei_printf("Version:   %lu\n", (unsigned long)info.version);
+        ei_printf("Length:    %lu\n", (unsigned long)info.length);
+    }
+    ei_printf("Received:  %lu\n", (unsigned long)ei_model_store_get_received());
+    // a stored model is only selected, nothing loads it yet
+    ei_printf("Running:   compiled-in model\n");
+    if (ei_model_store_has_key() == false) {
+        ei_printf("Updates:   refused, EI_MODEL_SIGNING_KEY not set\n");
+    }
+#if EI_FLASH_QSPI_DRIVER == 0
+    ei_printf("Flash:     QSPI driver stubbed, updates fail their read-back check\n");
+#endif
+
+    return true;
+}
+
+bool at_framed(void)
+{
+    ei_printf("OK\n");
+    ei_framed_start();
+
+    // no prompt, the next byte is the first frame
+    return false;
+}
+
 bool at_stop_impulse(void)
 {
     ei_stop_impulse();
@@ -429,6 +835,18 @@ ATServer *ei_at_init(EiDevicePSoC62 *device)
     at->register_command(AT_RUNIMPULSECONT, AT_RUNIMPULSECONT_HELP_TEXT, at_run_impulse_cont, nullptr, nullptr, nullptr);
     at->register_command("STOPIMPULSE", "", at_stop_impulse, nullptr, nullptr, nullptr);
     at->register_command(AT_RUNIMPULSESTATIC, AT_RUNIMPULSESTATIC_HELP_TEXT, nullptr, nullptr, at_run_impulse_static_data, AT_RUNIMPULSESTATIC_ARGS);
+    at->register_command(AT_RUNIMPULSESTATICBIN, AT_RUNIMPULSESTATICBIN_HELP_TEXT, nullptr, nullptr, at_run_impulse_static_binary, AT_RUNIMPULSESTATICBIN_ARGS);
+    at->register_command(AT_RUNIMPULSESTORED, AT_RUNIMPULSESTORED_HELP_TEXT, nullptr, nullptr, at_run_impulse_stored, AT_RUNIMPULSESTORED_ARGS);
+    at->register_command(AT_RUNBENCHMARK, AT_RUNBENCHMARK_HELP_TEXT, nullptr, nullptr, at_run_benchmark, AT_RUNBENCHMARK_ARGS);
+    at->register_command(AT_BLERESULTS, AT_BLERESULTS_HELP_TEXT, nullptr, at_get_ble_results, at_set_ble_results, AT_BLERESULTS_ARGS);
+    at->register_command(AT_BLEBUFFERS, AT_BLEBUFFERS_HELP_TEXT, nullptr, at_get_ble_buffers, nullptr, nullptr);
+    at->register_command(AT_MODEL, AT_MODEL_HELP_TEXT, nullptr, at_get_model, nullptr, nullptr);
+    at->register_command(AT_BAUD, AT_BAUD_HELP_TEXT, nullptr, at_get_baud, at_set_baud, AT_BAUD_ARGS);
+    at->register_command(AT_UARTTX, AT_UARTTX_HELP_TEXT, nullptr, at_get_uart_tx, at_set_uart_tx, AT_UARTTX_ARGS);
+    at->register_command(AT_SIGNING, AT_SIGNING_HELP_TEXT, nullptr, at_get_signing, at_set_signing, AT_SIGNING_ARGS);
+    at->register_command(AT_SAMPLEFORMAT, AT_SAMPLEFORMAT_HELP_TEXT, nullptr, at_get_sample_format, at_set_sample_format, AT_SAMPLEFORMAT_ARGS);
+    at->register_command(AT_NNMODE, AT_NNMODE_HELP_TEXT, nullptr, at_get_nn_mode, at_set_nn_mode, AT_NNMODE_ARGS);
+    at->register_command(AT_FRAMED, AT_FRAMED_HELP_TEXT, at_framed, nullptr, nullptr, nullptr);
 
     return at;
 }
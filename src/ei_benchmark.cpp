@@ -0,0 +1,503 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+
+#include "model-parameters/model_metadata.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_types.h"
+#include "edge-impulse-sdk/classifier/ei_signal_with_axes.h"
+#include "ei_benchmark.h"
+#include "ei_classifier.h"
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+#include "edge-impulse-sdk/classifier/ei_aligned_malloc.h"
+#include "tflite-model/trained_model_compiled.h"
+#define EI_BENCHMARK_EON_ARENA  1
+#endif
+
+#ifdef FREERTOS_ENABLED
+#include <FreeRTOS.h>
+#include <task.h>
+#endif
+
+/******
+ *
+ * @brief Inference benchmark. Classifies windows of a recording and reports
+ *        throughput, DSP/NN latency percentiles and heap usage.
+ *
+ ******/
+
+/* Latencies stored per window: dsp, nn, total */
+#define LATENCY_KINDS   3
+
+/***************************************
+ *        Heap tracking
+ **************************************/
+
+#if EI_BENCHMARK_TRACK_HEAP == 1
+/* Every allocation carries its size in front of the returned pointer,
+ * keeping the platform alignment. These replace the weak porting versions,
+ * so they are only built with EI_BENCHMARK_TRACK_HEAP=1. Allocations are
+ * counted while a benchmark runs, from any task (the BT stack allocates
+ * too), the size of the others is stored as 0.
+ */
+typedef union {
+    size_t size;
+    std::max_align_t align;
+} heap_header_t;
+
+static volatile bool heap_tracking = false;
+static size_t heap_in_use = 0;
+static size_t heap_peak = 0;
+
+static inline void heap_lock(void)
+{
+#ifdef FREERTOS_ENABLED
+    taskENTER_CRITICAL();
+#endif
+}
+
+static inline void heap_unlock(void)
+{
+#ifdef FREERTOS_ENABLED
+    taskEXIT_CRITICAL();
+#endif
+}
+
+static void *heap_alloc(size_t size)
+{
+#ifdef FREERTOS_ENABLED
+    return pvPortMalloc(size);
+#else
+    return malloc(size);
+#endif
+}
+
+static void heap_release(void *ptr)
+{
+#ifdef FREERTOS_ENABLED
+    vPortFree(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+void *ei_malloc(size_t size)
+{
+    heap_header_t *hdr = (heap_header_t *)heap_alloc(sizeof(heap_header_t) + size);
+
+    if(hdr == NULL) {
+        return NULL;
+    }
+
+    hdr->size = 0;
+    if(heap_tracking) {
+        heap_lock();
+        hdr->size = size;
+        heap_in_use += size;
+        if(heap_in_use > heap_peak) {
+            heap_peak = heap_in_use;
+        }
+        heap_unlock();
+    }
+
+    return hdr + 1;
+}
+
+void *ei_calloc(size_t nitems, size_t size)
+{
+    void *ptr = ei_malloc(nitems * size);
+
+    if(ptr != NULL) {
+        memset(ptr, 0, nitems * size);
+    }
+
+    return ptr;
+}
+
+void ei_free(void *ptr)
+{
+    if(ptr == NULL) {
+        return;
+    }
+
+    heap_header_t *hdr = (heap_header_t *)ptr - 1;
+    if(hdr->size > 0) {
+        heap_lock();
+        heap_in_use -= hdr->size;
+        heap_unlock();
+    }
+    heap_release(hdr);
+}
+
+/* count the allocations from here on */
+static void heap_track_begin(void)
+{
+    heap_lock();
+    heap_in_use = 0;
+    heap_peak = 0;
+    heap_tracking = true;
+    heap_unlock();
+}
+
+/* @return peak heap since heap_track_begin() */
+static size_t heap_track_end(void)
+{
+    heap_lock();
+    heap_tracking = false;
+    size_t peak = heap_peak;
+    heap_unlock();
+
+    return peak;
+}
+#else
+/* heap usage is reported as 0 */
+static void heap_track_begin(void)
+{
+}
+
+static size_t heap_track_end(void)
+{
+    return 0;
+}
+#endif
+
+/***************************************
+ *        Window sources
+ **************************************/
+
+static const ei_benchmark_source_t *window_source;
+static size_t window_offset;
+static float *window_buffer;
+
+static int window_get_data(size_t offset, size_t length, float *out_ptr)
+{
+    return window_source->get_data(window_offset + offset, length, out_ptr);
+}
+
+static int window_buffer_get_data(size_t offset, size_t length, float *out_ptr)
+{
+    memcpy(out_ptr, window_buffer + offset, length * sizeof(float));
+    return 0;
+}
+
+/* Deterministic pseudo random data, so every run classifies the same input */
+static int synthetic_get_data(size_t offset, size_t length, float *out_ptr)
+{
+    for(size_t ix = 0; ix < length; ix++) {
+        uint32_t hash = (uint32_t)(offset + ix) * 2654435761u;
+        out_ptr[ix] = ((float)(hash >> 16) / 32768.0f - 1.0f) * 10.0f;
+    }
+
+    return 0;
+}
+
+void ei_benchmark_synthetic_source(ei_benchmark_source_t *source, uint32_t n_windows)
+{
+    source->total_length = (size_t)n_windows * EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE;
+    source->get_data = &synthetic_get_data;
+}
+
+/***************************************
+ *        Statistics
+ **************************************/
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t va = *(const uint32_t *)a;
+    uint32_t vb = *(const uint32_t *)b;
+
+    return (va > vb) - (va < vb);
+}
+
+/* nearest-rank percentile on sorted data */
+static uint32_t percentile(const uint32_t *sorted, uint32_t n, uint32_t pct)
+{
+    uint32_t rank = (pct * n + 99) / 100;
+
+    return sorted[(rank > 0) ? rank - 1 : 0];
+}
+
+static void calc_latency(uint32_t *samples, uint32_t n, ei_benchmark_latency_t *latency)
+{
+    memset(latency, 0, sizeof(*latency));
+
+    if(n == 0) {
+        return;
+    }
+
+    qsort(samples, n, sizeof(uint32_t), compare_u32);
+    latency->p50 = percentile(samples, n, 50);
+    latency->p95 = percentile(samples, n, 95);
+    latency->p99 = percentile(samples, n, 99);
+    latency->max = samples[n - 1];
+}
+
+/**
+ * @brief      Size of the tensor arena (and overflow buffers) the model allocates
+ */
+static uint32_t measure_arena(void)
+{
+#if EI_BENCHMARK_EON_ARENA == 1
+    heap_track_begin();
+    trained_model_init(ei_aligned_calloc);
+    trained_model_reset(ei_aligned_free);
+
+    return (uint32_t)heap_track_end();
+#else
+    return 0;
+#endif
+}
+
+const char *ei_benchmark_mode_name(ei_benchmark_mode_t mode)
+{
+    switch(mode) {
+        case EI_BENCHMARK_SINGLE:
+            return "single";
+        case EI_BENCHMARK_CONTINUOUS:
+            return "continuous";
+        case EI_BENCHMARK_STATIC:
+            return "static";
+        case EI_BENCHMARK_RESIDENT:
+            return "resident";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * @brief      Prepare a report, windows of one or more sources are added to it
+ *             with ei_benchmark_run()
+ */
+bool ei_benchmark_begin(ei_benchmark_report_t *report, ei_benchmark_mode_t mode, uint32_t max_windows)
+{
+    memset(report, 0, sizeof(*report));
+
+    if(max_windows == 0 || max_windows > EI_BENCHMARK_MAX_WINDOWS) {
+        max_windows = EI_BENCHMARK_MAX_WINDOWS;
+    }
+
+    report->samples = (uint32_t *)ei_malloc(LATENCY_KINDS * max_windows * sizeof(uint32_t));
+    if(report->samples == NULL) {
+        ei_printf("ERR: Failed to allocate benchmark buffer\n");
+        return false;
+    }
+
+    report->mode = mode;
+    report->max_windows = max_windows;
+    // a resident graph would be initialised twice (and freed twice)
+    ei_classifier_release();
+    report->arena_bytes = measure_arena();
+
+    return true;
+}
+
+bool ei_benchmark_run(ei_benchmark_report_t *report, const ei_benchmark_source_t *source)
+{
+    size_t frame_size = EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE;
+    size_t stride = frame_size;
+
+    if(report->samples == NULL) {
+        return false;
+    }
+
+    if(report->mode == EI_BENCHMARK_CONTINUOUS) {
+        stride = EI_CLASSIFIER_SLICE_SIZE * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+    }
+
+    if(report->mode == EI_BENCHMARK_STATIC) {
+        window_buffer = (float *)ei_malloc(frame_size * sizeof(float));
+        if(window_buffer == NULL) {
+            ei_printf("ERR: Failed to allocate benchmark buffer\n");
+            return false;
+        }
+    }
+
+    // only the resident mode keeps the NN between windows
+    ei_classifier_nn_mode_t nn_mode = ei_classifier_get_nn_mode();
+    ei_classifier_release();
+    ei_classifier_set_nn_mode((report->mode == EI_BENCHMARK_RESIDENT) ? EI_CLASSIFIER_NN_RESIDENT : EI_CLASSIFIER_NN_PER_WINDOW);
+
+    window_source = source;
+    heap_track_begin();
+
+    for(size_t offset = 0; offset + frame_size <= source->total_length; offset += stride) {
+        if(report->windows >= report->max_windows) {
+            break;
+        }
+
+        signal_t signal;
+        ei_impulse_result_t result = { 0 };
+        signal.total_length = frame_size;
+        window_offset = offset;
+
+        uint64_t start_us = ei_read_timer_us();
+
+        if(report->mode == EI_BENCHMARK_STATIC) {
+            source->get_data(offset, frame_size, window_buffer);
+            signal.get_data = &window_buffer_get_data;
+        }
+        else {
+            signal.get_data = &window_get_data;
+        }
+
+        EI_IMPULSE_ERROR res = ei_classifier_run(&signal, &result, false);
+        uint32_t total_us = (uint32_t)(ei_read_timer_us() - start_us);
+
+        if(res != EI_IMPULSE_OK) {
+            report->errors++;
+            continue;
+        }
+
+        uint32_t *samples = &report->samples[report->windows * LATENCY_KINDS];
+        samples[0] = (uint32_t)result.timing.dsp_us;
+        samples[1] = (uint32_t)(result.timing.classification_us + result.timing.anomaly_us);
+        samples[2] = total_us;
+        report->elapsed_us += total_us;
+        report->windows++;
+    }
+
+    size_t peak = heap_track_end();
+    if(peak > report->peak_heap_bytes) {
+        report->peak_heap_bytes = (uint32_t)peak;
+    }
+
+    ei_classifier_release();
+    ei_classifier_set_nn_mode(nn_mode);
+
+    if(window_buffer != NULL) {
+        ei_free(window_buffer);
+        window_buffer = NULL;
+    }
+
+    return (report->errors == 0);
+}
+
+/**
+ * @brief      Calculate throughput and percentiles, release the sample buffer
+ */
+void ei_benchmark_end(ei_benchmark_report_t *report)
+{
+    uint32_t n = report->windows;
+
+    if(report->samples == NULL) {
+        return;
+    }
+
+    // de-interleave, so each latency kind can be sorted in place
+    uint32_t *sorted = (uint32_t *)ei_malloc((n + 1) * sizeof(uint32_t));
+    ei_benchmark_latency_t *latencies[LATENCY_KINDS] = { &report->dsp_us, &report->nn_us, &report->total_us };
+
+    for(int kind = 0; kind < LATENCY_KINDS; kind++) {
+        if(sorted == NULL) {
+            memset(latencies[kind], 0, sizeof(ei_benchmark_latency_t));
+            continue;
+        }
+        for(uint32_t ix = 0; ix < n; ix++) {
+            sorted[ix] = report->samples[ix * LATENCY_KINDS + kind];
+        }
+        calc_latency(sorted, n, latencies[kind]);
+    }
+
+    if(report->elapsed_us > 0) {
+        report->windows_per_s = (float)n * 1000000.0f / (float)report->elapsed_us;
+    }
+
+    ei_free(sorted);
+    ei_free(report->samples);
+    report->samples = NULL;
+}
+
+/***************************************
+ *        JSON report
+ **************************************/
+
+/* append to buffer at *len, @return false if it does not fit */
+static bool json_append(char *buffer, size_t buffer_size, size_t *len, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    int ret = vsnprintf(buffer + *len, buffer_size - *len, format, args);
+    va_end(args);
+
+    if(ret < 0 || (size_t)ret >= buffer_size - *len) {
+        return false;
+    }
+    *len += ret;
+
+    return true;
+}
+
+static bool json_latency(char *buffer, size_t buffer_size, size_t *len, const char *name,
+                         const ei_benchmark_latency_t *latency, bool last)
+{
+    return json_append(buffer, buffer_size, len, "\"%s\":{\"p50\":%lu,\"p95\":%lu,\"p99\":%lu,\"max\":%lu}%s",
+        name, (unsigned long)latency->p50, (unsigned long)latency->p95,
+        (unsigned long)latency->p99, (unsigned long)latency->max, last ? "" : ",");
+}
+
+/**
+ * @brief      Write the reports as a single line JSON object
+ *
+ * @return     length of the JSON string, -1 if the buffer is too small
+ */
+int ei_benchmark_to_json(const char *device_type, const ei_benchmark_report_t *reports, size_t n_reports, char *buffer, size_t buffer_size)
+{
+    size_t len = 0;
+
+    // floats are printed as fixed point, newlib nano has no float printf by default
+    uint32_t interval_us = (uint32_t)(EI_CLASSIFIER_INTERVAL_MS * 1000.0f);
+
+    if(json_append(buffer, buffer_size, &len,
+        "{\"device\":\"%s\",\"model\":{\"project_id\":%d,\"deploy_version\":%d,"
+        "\"frame_size\":%d,\"interval_ms\":%lu.%03lu,\"labels\":%d},\"modes\":[",
+        device_type, EI_CLASSIFIER_PROJECT_ID, EI_CLASSIFIER_PROJECT_DEPLOY_VERSION,
+        EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, (unsigned long)(interval_us / 1000),
+        (unsigned long)(interval_us % 1000), EI_CLASSIFIER_LABEL_COUNT) == false) {
+        return -1;
+    }
+
+    for(size_t ix = 0; ix < n_reports; ix++) {
+        const ei_benchmark_report_t *report = &reports[ix];
+        uint32_t rate_x100 = (uint32_t)(report->windows_per_s * 100.0f + 0.5f);
+
+        if(json_append(buffer, buffer_size, &len,
+               "{\"mode\":\"%s\",\"windows\":%lu,\"errors\":%lu,\"windows_per_s\":%lu.%02lu,\"latency_us\":{",
+               ei_benchmark_mode_name(report->mode), (unsigned long)report->windows,
+               (unsigned long)report->errors, (unsigned long)(rate_x100 / 100), (unsigned long)(rate_x100 % 100)) == false ||
+           json_latency(buffer, buffer_size, &len, "dsp", &report->dsp_us, false) == false ||
+           json_latency(buffer, buffer_size, &len, "nn", &report->nn_us, false) == false ||
+           json_latency(buffer, buffer_size, &len, "total", &report->total_us, true) == false ||
+           json_append(buffer, buffer_size, &len,
+               "},\"peak_heap_bytes\":%lu,\"arena_bytes\":%lu}%s",
+               (unsigned long)report->peak_heap_bytes, (unsigned long)report->arena_bytes,
+               (ix + 1 < n_reports) ? "," : "") == false) {
+            return -1;
+        }
+    }
+
+    if(json_append(buffer, buffer_size, &len, "]}") == false) {
+        return -1;
+    }
+
+    return (int)len;
+}
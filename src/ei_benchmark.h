@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_BENCHMARK_H
+#define EI_BENCHMARK_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include <cstddef>
+
+/** Maximum number of windows classified per mode */
+#define EI_BENCHMARK_MAX_WINDOWS    1000
+
+/** Count the SDK allocations for peak_heap_bytes and arena_bytes (0 without).
+ *  Replaces ei_malloc/ei_calloc/ei_free for the whole firmware and adds a
+ *  header to every allocation, so it is off on the device by default.
+ */
+#ifndef EI_BENCHMARK_TRACK_HEAP
+#define EI_BENCHMARK_TRACK_HEAP     0
+#endif
+
+typedef enum {
+    EI_BENCHMARK_SINGLE = 0,    // non-overlapping windows, like AT+RUNIMPULSE
+    EI_BENCHMARK_CONTINUOUS,    // window moves by one slice, like AT+RUNIMPULSECONT
+    EI_BENCHMARK_STATIC,        // window copied to RAM first, like AT+RUNIMPULSESTATIC
+    EI_BENCHMARK_RESIDENT,      // as single, the NN is set up once (AT+NNMODE=resident)
+    EI_BENCHMARK_MODES
+} ei_benchmark_mode_t;
+
+/**
+ * Recording the windows are taken from, raw samples interleaved per axis
+ * (same layout as the model input)
+ */
+typedef struct {
+    size_t total_length;
+    int (*get_data)(size_t offset, size_t length, float *out_ptr);
+} ei_benchmark_source_t;
+
+typedef struct {
+    uint32_t p50;
+    uint32_t p95;
+    uint32_t p99;
+    uint32_t max;
+} ei_benchmark_latency_t;
+
+typedef struct {
+    ei_benchmark_mode_t mode;
+    uint32_t windows;
+    uint32_t errors;
+    float windows_per_s;
+    ei_benchmark_latency_t dsp_us;
+    ei_benchmark_latency_t nn_us;
+    ei_benchmark_latency_t total_us;
+    uint32_t peak_heap_bytes;
+    uint32_t arena_bytes;
+
+    /* private, valid between ei_benchmark_begin() and ei_benchmark_end() */
+    uint32_t max_windows;
+    uint32_t *samples;
+    uint64_t elapsed_us;
+} ei_benchmark_report_t;
+
+/* Function prototypes ----------------------------------------------------- */
+bool ei_benchmark_begin(ei_benchmark_report_t *report, ei_benchmark_mode_t mode, uint32_t max_windows);
+bool ei_benchmark_run(ei_benchmark_report_t *report, const ei_benchmark_source_t *source);
+void ei_benchmark_end(ei_benchmark_report_t *report);
+
+void ei_benchmark_synthetic_source(ei_benchmark_source_t *source, uint32_t n_windows);
+int ei_benchmark_to_json(const char *device_type, const ei_benchmark_report_t *reports, size_t n_reports, char *buffer, size_t buffer_size);
+const char *ei_benchmark_mode_name(ei_benchmark_mode_t mode);
+
+#endif /* EI_BENCHMARK_H */
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstdlib>
+
+#include "ei_ble_buffers.h"
+#include "ei_bluetooth_psoc63.h"
+
+#ifdef FREERTOS_ENABLED
+#include <FreeRTOS.h>
+#endif
+
+/******
+ *
+ * @brief BLE buffer pool. Each size class is a static array of blocks with
+ *        a bitmap of the blocks in use; a block is found by its address.
+ *
+ ******/
+
+#define SMALL_SIZE      32
+#define SMALL_BLOCKS    8
+#define MEDIUM_SIZE     128
+#define MEDIUM_BLOCKS   4
+#define LARGE_SIZE      EI_BLE_BUFFER_MAX_SIZE
+#define LARGE_BLOCKS    4
+
+typedef struct {
+    uint8_t *storage;
+    uint16_t block_size;
+    uint8_t blocks;
+    uint8_t in_use;
+    uint8_t peak;
+    uint16_t used_mask;     // bit n: block n is in use
+} buffer_class_t;
+
+static uint8_t small_storage[SMALL_BLOCKS][SMALL_SIZE] __attribute__((aligned(4)));
+static uint8_t medium_storage[MEDIUM_BLOCKS][MEDIUM_SIZE] __attribute__((aligned(4)));
+static uint8_t large_storage[LARGE_BLOCKS][LARGE_SIZE] __attribute__((aligned(4)));
+
+static buffer_class_t classes[EI_BLE_BUFFER_CLASSES] = {
+    { &small_storage[0][0], SMALL_SIZE, SMALL_BLOCKS, 0, 0, 0 },
+    { &medium_storage[0][0], MEDIUM_SIZE, MEDIUM_BLOCKS, 0, 0, 0 },
+    { &large_storage[0][0], LARGE_SIZE, LARGE_BLOCKS, 0, 0, 0 },
+};
+
+static uint32_t allocs = 0;
+static uint32_t heap_fallbacks = 0;
+static uint32_t failures = 0;
+static uint16_t heap_in_use = 0;
+
+static void *heap_alloc(size_t size)
+{
+#ifdef FREERTOS_ENABLED
+    return pvPortMalloc(size);
+#else
+    return malloc(size);
+#endif
+}
+
+static void heap_release(void *ptr)
+{
+#ifdef FREERTOS_ENABLED
+    vPortFree(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+static void *take_block(buffer_class_t *c)
+{
+    for(int ix = 0; ix < c->blocks; ix++) {
+        if((c->used_mask & (1u << ix)) == 0) {
+            c->used_mask |= (1u << ix);
+            c->in_use++;
+            if(c->in_use > c->peak) {
+                c->peak = c->in_use;
+            }
+            return c->storage + ix * c->block_size;
+        }
+    }
+    return NULL;
+}
+
+void *ei_ble_buffer_alloc(size_t len)
+{
+    void *p_buf = NULL;
+
+    bt_app_lock();
+    for(int ix = 0; ix < EI_BLE_BUFFER_CLASSES && p_buf == NULL; ix++) {
+        if(len <= classes[ix].block_size) {
+            p_buf = take_block(&classes[ix]);
+        }
+    }
+    if(p_buf != NULL) {
+        allocs++;
+    }
+    else {
+        heap_fallbacks++;
+    }
+    bt_app_unlock();
+
+    if(p_buf != NULL) {
+        return p_buf;
+    }
+
+    p_buf = heap_alloc(len);
+
+    bt_app_lock();
+    if(p_buf == NULL) {
+        failures++;
+    }
+    else {
+        heap_in_use++;
+    }
+    bt_app_unlock();
+
+    return p_buf;
+}
+
+void ei_ble_buffer_free(void *p_buf)
+{
+    uint8_t *p = (uint8_t *)p_buf;
+
+    if(p == NULL) {
+        return;
+    }
+
+    bt_app_lock();
+    for(int ix = 0; ix < EI_BLE_BUFFER_CLASSES; ix++) {
+        buffer_class_t *c = &classes[ix];
+
+        if(p >= c->storage && p < c->storage + c->blocks * c->block_size) {
+            uint16_t bit = 1u << ((p - c->storage) / c->block_size);
+            if(c->used_mask & bit) {
+                c->used_mask &= ~bit;
+                c->in_use--;
+            }
+            bt_app_unlock();
+            return;
+        }
+    }
+    heap_in_use--;
+    bt_app_unlock();
+
+    heap_release(p_buf);
+}
+
+void ei_ble_buffer_get_stats(ei_ble_buffer_stats_t *stats)
+{
+    bt_app_lock();
+    for(int ix = 0; ix < EI_BLE_BUFFER_CLASSES; ix++) {
+        stats->classes[ix].block_size = classes[ix].block_size;
+        stats->classes[ix].blocks = classes[ix].blocks;
+        stats->classes[ix].in_use = classes[ix].in_use;
+        stats->classes[ix].peak = classes[ix].peak;
+    }
+    stats->allocs = allocs;
+    stats->heap_fallbacks = heap_fallbacks;
+    stats->failures = failures;
+    stats->heap_in_use = heap_in_use;
+    bt_app_unlock();
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_BLE_BUFFERS_H
+#define EI_BLE_BUFFERS_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Fixed block pool for the buffers the BT stack asks for
+ * (GATT_GET_RESPONSE_BUFFER_EVT, read by type responses). Blocks come from
+ * the smallest size class that fits and has a free block, so BLE traffic
+ * does not touch the heap shared with the DSP. Only when every fitting
+ * block is in use, or a request is larger than the largest class, the
+ * buffer comes from the heap and is counted as a fallback.
+ */
+#define EI_BLE_BUFFER_CLASSES       3
+/* largest class holds a full ATT MTU (247, configs/design.cybt) */
+#define EI_BLE_BUFFER_MAX_SIZE      256
+
+typedef struct {
+    uint16_t block_size;
+    uint8_t blocks;
+    uint8_t in_use;
+    uint8_t peak;
+} ei_ble_buffer_class_stats_t;
+
+typedef struct {
+    ei_ble_buffer_class_stats_t classes[EI_BLE_BUFFER_CLASSES];
+    uint32_t allocs;            // buffers handed out by the pool
+    uint32_t heap_fallbacks;    // buffers that had to come from the heap
+    uint32_t failures;          // heap fallbacks that failed too
+    uint16_t heap_in_use;       // heap buffers not freed yet
+} ei_ble_buffer_stats_t;
+
+void *ei_ble_buffer_alloc(size_t len);
+void ei_ble_buffer_free(void *p_buf);
+void ei_ble_buffer_get_stats(ei_ble_buffer_stats_t *stats);
+
+#endif /* EI_BLE_BUFFERS_H */
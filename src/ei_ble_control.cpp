@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "ei_ble_control.h"
+#include "ei_ble_results.h"
+#include "ei_ble_stream.h"
+#include "ei_bluetooth_psoc63.h"
+#include "ei_run_impulse.h"
+
+/******
+ *
+ * @brief BLE Control Point. Runs in the BT stack task, like the Inference
+ *        characteristic write, and answers every command with an
+ *        indication so the central knows whether it took effect. START
+ *        and STOP are handed to the inference task (ei_run_impulse.h).
+ *
+ ******/
+
+#define RESPONSE_HEADER_LEN     3
+
+static ei_ble_control_status_code_t start_inference(const uint8_t *param, uint16_t len)
+{
+    if(len < 1 || param[0] > 1) {
+        return EI_BLE_CONTROL_INVALID_PARAMETER;
+    }
+    if(ei_ble_stream_is_running()) {
+        return EI_BLE_CONTROL_BUSY;
+    }
+
+    ei_request_start_impulse(param[0] == 1);
+
+    return EI_BLE_CONTROL_SUCCESS;
+}
+
+static ei_ble_control_status_code_t set_gate(const uint8_t *param, uint16_t len)
+{
+    int16_t anomaly = EI_BLE_CONTROL_ANOMALY_OFF;
+
+    if(len < 1) {
+        return EI_BLE_CONTROL_INVALID_PARAMETER;
+    }
+    if(len >= 3) {
+        anomaly = (int16_t)(param[1] | (param[2] << 8));
+    }
+
+    ei_ble_results_set_gate((float)param[0] / 255.0f,
+        (anomaly == EI_BLE_CONTROL_ANOMALY_OFF) ? EI_BLE_RESULTS_ANOMALY_OFF : (float)anomaly / 256.0f);
+
+    return EI_BLE_CONTROL_SUCCESS;
+}
+
+static uint16_t get_status(uint8_t *data)
+{
+    ei_ble_control_status_t status;
+    ei_ble_results_stats_t stats;
+    uint8_t coalesce_n;
+    float min_score;
+    float anomaly;
+
+    ei_ble_results_get_stats(&stats);
+    ei_ble_results_get_gate(&min_score, &anomaly);
+
+    if(is_inference_running() == false) {
+        status.state = EI_BLE_CONTROL_STOPPED;
+    }
+    else {
+        status.state = is_inference_continuous() ? EI_BLE_CONTROL_CONTINUOUS : EI_BLE_CONTROL_SINGLE;
+    }
+    status.stride = (uint8_t)ei_get_result_stride();
+    status.format = ei_ble_results_get_format();
+    status.policy = (uint8_t)ei_ble_results_get_policy(&coalesce_n);
+    status.coalesce_n = coalesce_n;
+    status.min_score = (uint8_t)(min_score * 255.0f + 0.5f);
+    status.anomaly = (anomaly >= (float)EI_BLE_CONTROL_ANOMALY_OFF / 256.0f) ?
+        EI_BLE_CONTROL_ANOMALY_OFF : (int16_t)(anomaly * 256.0f);
+    status.results = stats.results;
+    status.sent = stats.sent;
+    status.dropped = stats.dropped;
+    status.gated = stats.gated;
+
+    memcpy(data, &status, sizeof(status));
+
+    return sizeof(status);
+}
+
+uint16_t ei_ble_control_execute(const uint8_t *data, uint16_t len, uint8_t *response)
+{
+    ei_ble_control_status_code_t status = EI_BLE_CONTROL_SUCCESS;
+    uint16_t response_len = RESPONSE_HEADER_LEN;
+    const uint8_t *param = data + 1;
+    uint16_t param_len = (len > 0) ? len - 1 : 0;
+
+    response[0] = EI_BLE_CONTROL_RESPONSE;
+    response[1] = (len > 0) ? data[0] : 0;
+
+    if(len < 1) {
+        response[2] = EI_BLE_CONTROL_INVALID_PARAMETER;
+        return response_len;
+    }
+
+    switch(data[0]) {
+        case EI_BLE_CONTROL_OP_START:
+            status = start_inference(param, param_len);
+            break;
+        case EI_BLE_CONTROL_OP_STOP:
+            ei_request_stop_impulse();
+            break;
+        case EI_BLE_CONTROL_OP_SET_STRIDE:
+            if(param_len < 1 || ei_set_result_stride(param[0]) == false) {
+                status = EI_BLE_CONTROL_INVALID_PARAMETER;
+            }
+            break;
+        case EI_BLE_CONTROL_OP_SET_GATE:
+            status = set_gate(param, param_len);
+            break;
+        case EI_BLE_CONTROL_OP_SET_FORMAT:
+            if(param_len < 1 || ei_ble_results_set_format(param[0]) == false) {
+                status = EI_BLE_CONTROL_INVALID_PARAMETER;
+            }
+            break;
+        case EI_BLE_CONTROL_OP_SET_POLICY:
+            if(param_len < 1 ||
+               ei_ble_results_set_policy((ei_ble_policy_t)param[0], (param_len >= 2) ? param[1] : 1) == false) {
+                status = EI_BLE_CONTROL_INVALID_PARAMETER;
+            }
+            break;
+        case EI_BLE_CONTROL_OP_GET_STATUS:
+            response_len += get_status(response + RESPONSE_HEADER_LEN);
+            break;
+        default:
+            ei_printf("ERR: Unknown control opcode 0x%02x\n", data[0]);
+            status = EI_BLE_CONTROL_UNKNOWN_OPCODE;
+            break;
+    }
+
+    response[2] = (uint8_t)status;
+
+    return response_len;
+}
+
+bool ei_ble_control_command(uint8_t conn, const uint8_t *data, uint16_t len)
+{
+    uint8_t response[EI_BLE_CONTROL_MAX_LEN];
+    uint16_t response_len = ei_ble_control_execute(data, len, response);
+
+    return bt_app_send_indication(conn, CONTROL_POINT, response, response_len);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_BLE_CONTROL_H
+#define EI_BLE_CONTROL_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+
+/**
+ * Control Point characteristic (000ED0E8-0000-1000-8000-00805F9B0133).
+ * The central writes [opcode u8] [parameters], the device answers every
+ * write with an indication:
+ * [EI_BLE_CONTROL_RESPONSE] [opcode u8] [status u8] [data]
+ * The central has to enable indications first, and wait for the response
+ * before writing the next command. All fields are little endian.
+ * The GET_STATUS response needs the larger ATT MTU negotiated on connect.
+ *
+ * START        [mode u8: 0 single, 1 continuous], restarts a running inference
+ * STOP
+ *              START and STOP take effect on the next pass of the inference
+ *              task, a sensor error after SUCCESS shows as STOPPED in GET_STATUS
+ * SET_STRIDE   [slices u8], continuous results every N slices (next start)
+ * SET_GATE     [min_score u8, score * 255] [anomaly int16 * 256, optional,
+ *              EI_BLE_CONTROL_ANOMALY_OFF when omitted]
+ * SET_FORMAT   [EI_BLE_RESULT_FORMAT_* mask u8]
+ * SET_POLICY   [ei_ble_policy_t u8] [coalesce n u8, optional]
+ * GET_STATUS   data: ei_ble_control_status_t
+ */
+#define EI_BLE_CONTROL_OP_START         0x01
+#define EI_BLE_CONTROL_OP_STOP          0x02
+#define EI_BLE_CONTROL_OP_SET_STRIDE    0x03
+#define EI_BLE_CONTROL_OP_SET_GATE      0x04
+#define EI_BLE_CONTROL_OP_SET_FORMAT    0x05
+#define EI_BLE_CONTROL_OP_SET_POLICY    0x06
+#define EI_BLE_CONTROL_OP_GET_STATUS    0x07
+
+#define EI_BLE_CONTROL_RESPONSE         0x80
+
+#define EI_BLE_CONTROL_ANOMALY_OFF      INT16_MAX
+
+typedef enum {
+    EI_BLE_CONTROL_SUCCESS = 0,
+    EI_BLE_CONTROL_UNKNOWN_OPCODE,
+    EI_BLE_CONTROL_INVALID_PARAMETER,
+    EI_BLE_CONTROL_BUSY,            // raw stream is running
+    EI_BLE_CONTROL_FAILED,
+} ei_ble_control_status_code_t;
+
+typedef enum {
+    EI_BLE_CONTROL_STOPPED = 0,
+    EI_BLE_CONTROL_SINGLE,
+    EI_BLE_CONTROL_CONTINUOUS,
+} ei_ble_control_state_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t state;          // ei_ble_control_state_t
+    uint8_t stride;
+    uint8_t format;
+    uint8_t policy;
+    uint8_t coalesce_n;
+    uint8_t min_score;
+    int16_t anomaly;
+    uint32_t results;
+    uint32_t sent;
+    uint32_t dropped;
+    uint32_t gated;
+} ei_ble_control_status_t;
+
+/* ByteLength of the Control Point characteristic */
+#define EI_BLE_CONTROL_MAX_LEN          32
+
+/**
+ * @brief Run a command written to the Control Point by the central in
+ *        connection slot conn, and indicate the response to it
+ * @return false if the response could not be indicated
+ */
+bool ei_ble_control_command(uint8_t conn, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief Run a command, store the response in response (EI_BLE_CONTROL_MAX_LEN)
+ * @return response length
+ */
+uint16_t ei_ble_control_execute(const uint8_t *data, uint16_t len, uint8_t *response);
+
+#endif /* EI_BLE_CONTROL_H */
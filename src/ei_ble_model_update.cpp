@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "ei_ble_model_update.h"
+#include "ei_ble_stream.h"
+#include "ei_bluetooth_psoc63.h"
+#include "ei_model_store.h"
+#include "ei_run_impulse.h"
+
+/******
+ *
+ * @brief BLE model update. Runs in the BT stack task; the flash writes of
+ *        one DATA packet are short, the erase in BEGIN is the slow part.
+ *
+ ******/
+
+#define RESPONSE_HEADER_LEN     3
+
+static uint32_t expected_length = 0;
+static uint32_t last_ack = 0;
+static uint8_t update_conn = 0;     // central that sent BEGIN
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t put_u32(uint8_t *p, uint32_t value)
+{
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = (value >> 24) & 0xFF;
+
+    return 4;
+}
+
+static uint8_t begin(const uint8_t *param, uint16_t len)
+{
+    if(len < 12) {
+        return EI_BLE_MODEL_INVALID_PARAMETER;
+    }
+    // the erase and the flash traffic would stall the sampling
+    if(is_inference_running() || ei_ble_stream_is_running()) {
+        return EI_BLE_MODEL_BUSY;
+    }
+
+    expected_length = get_u32(&param[0]);
+    last_ack = 0;
+
+    return ei_model_store_begin(expected_length, get_u32(&param[4]), get_u32(&param[8]));
+}
+
+static uint16_t status(uint8_t *data)
+{
+    ei_model_info_t info;
+    uint16_t len = 0;
+
+    ei_model_store_get_active(&info);
+    data[len++] = info.slot;
+    len += put_u32(&data[len], info.version);
+    len += put_u32(&data[len], info.length);
+    len += put_u32(&data[len], ei_model_store_get_received());
+
+    return len;
+}
+
+uint16_t ei_ble_model_update_execute(const uint8_t *data, uint16_t len, uint8_t *response)
+{
+    uint8_t status_code = EI_MODEL_OK;
+    uint16_t response_len = RESPONSE_HEADER_LEN;
+    const uint8_t *param = data + 1;
+    uint16_t param_len = (len > 0) ? len - 1 : 0;
+    ei_model_info_t info;
+
+    response[0] = EI_BLE_MODEL_RESPONSE;
+    response[1] = (len > 0) ? data[0] : 0;
+
+    if(len < 1) {
+        response[2] = EI_BLE_MODEL_INVALID_PARAMETER;
+        return response_len;
+    }
+
+    switch(data[0]) {
+        case EI_BLE_MODEL_OP_BEGIN:
+            status_code = begin(param, param_len);
+            break;
+        case EI_BLE_MODEL_OP_DATA: {
+            if(param_len < 4) {
+                status_code = EI_BLE_MODEL_INVALID_PARAMETER;
+                break;
+            }
+            status_code = ei_model_store_write(get_u32(param), param + 4, param_len - 4);
+            uint32_t received = ei_model_store_get_received();
+            if(status_code == EI_MODEL_OK && received != expected_length &&
+               received - last_ack < EI_BLE_MODEL_ACK_INTERVAL) {
+                return 0;
+            }
+            last_ack = received;
+            response_len += put_u32(response + RESPONSE_HEADER_LEN, received);
+            break;
+        }
+        case EI_BLE_MODEL_OP_COMMIT:
+            if(param_len < EI_MODEL_SIGNATURE_LEN) {
+                status_code = EI_BLE_MODEL_INVALID_PARAMETER;
+                break;
+            }
+            status_code = ei_model_store_commit(param);
+            if(status_code == EI_MODEL_OK) {
+                ei_model_store_get_active(&info);
+                response[response_len++] = info.slot;
+                ei_printf("Model version %lu stored in slot %u, not loaded (the compiled-in model keeps running)\n",
+                    (unsigned long)info.version, info.slot);
+                status_code = EI_BLE_MODEL_NOT_LOADED;
+            }
+            break;
+        case EI_BLE_MODEL_OP_ABORT:
+            ei_model_store_abort();
+            break;
+        case EI_BLE_MODEL_OP_STATUS:
+            response_len += status(response + RESPONSE_HEADER_LEN);
+            break;
+        default:
+            ei_printf("ERR: Unknown model update opcode 0x%02x\n", data[0]);
+            status_code = EI_BLE_MODEL_UNKNOWN_OPCODE;
+            break;
+    }
+
+    response[2] = status_code;
+
+    return response_len;
+}
+
+bool ei_ble_model_update_command(uint8_t conn, const uint8_t *data, uint16_t len)
+{
+    uint8_t response[EI_BLE_MODEL_RESPONSE_MAX_LEN];
+    uint16_t response_len;
+
+    // one transfer at a time, the owner is whoever sent the last BEGIN
+    if(len > 0 && data[0] == EI_BLE_MODEL_OP_BEGIN) {
+        update_conn = conn;
+    }
+    response_len = ei_ble_model_update_execute(data, len, response);
+
+    if(response_len == 0) {
+        return true;
+    }
+
+    return bt_app_send_indication(conn, MODEL_UPDATE, response, response_len);
+}
+
+void ei_ble_model_update_abort(uint8_t conn)
+{
+    if(conn == update_conn) {
+        ei_model_store_abort();
+    }
+}
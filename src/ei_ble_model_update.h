@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_BLE_MODEL_UPDATE_H
+#define EI_BLE_MODEL_UPDATE_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+
+/**
+ * Model Update characteristic (000ED0E8-0000-1000-8000-00805F9B0134).
+ * Same framing as the Control Point: [opcode u8] [parameters], answered by
+ * an indication [EI_BLE_MODEL_RESPONSE] [opcode u8] [status u8] [data].
+ * Status is ei_model_status_t or one of the codes below. DATA may be sent
+ * as write without response; it is only answered every
+ * EI_BLE_MODEL_ACK_INTERVAL bytes, when the blob is complete or on error.
+ *
+ * BEGIN    [length u32] [crc32 u32] [version u32], erases the inactive slot
+ * DATA     [offset u32] [bytes], data: [next offset u32]
+ * COMMIT   [HMAC-SHA256 of the blob, 32 bytes], data: [slot u8], status
+ *          EI_BLE_MODEL_NOT_LOADED when the blob is stored and selected
+ * ABORT
+ * STATUS   data: [slot u8] [version u32] [length u32] [received u32]
+ */
+#define EI_BLE_MODEL_OP_BEGIN           0x01
+#define EI_BLE_MODEL_OP_DATA            0x02
+#define EI_BLE_MODEL_OP_COMMIT          0x03
+#define EI_BLE_MODEL_OP_ABORT           0x04
+#define EI_BLE_MODEL_OP_STATUS          0x05
+
+#define EI_BLE_MODEL_RESPONSE           0x80
+
+/* status codes next to ei_model_status_t */
+#define EI_BLE_MODEL_UNKNOWN_OPCODE     0x10
+#define EI_BLE_MODEL_INVALID_PARAMETER  0x11
+#define EI_BLE_MODEL_BUSY               0x12    // inference or raw stream running
+/* stored and selected, but inference keeps running the compiled-in model:
+ * loading a stored model is not implemented */
+#define EI_BLE_MODEL_NOT_LOADED         0x13
+
+#define EI_BLE_MODEL_ACK_INTERVAL       4096
+/* ByteLength of the Model Update characteristic (ATT MTU 247 - 3) */
+#define EI_BLE_MODEL_MAX_LEN            244
+#define EI_BLE_MODEL_RESPONSE_MAX_LEN   16
+
+/**
+ * @brief Run a command written to Model Update by the central in connection
+ *        slot conn, indicate the response to it if any
+ * @return false if the response could not be indicated
+ */
+bool ei_ble_model_update_command(uint8_t conn, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief Run a command, store the response in response
+ *        (EI_BLE_MODEL_RESPONSE_MAX_LEN)
+ * @return response length, 0 if the command is not answered
+ */
+uint16_t ei_ble_model_update_execute(const uint8_t *data, uint16_t len, uint8_t *response);
+
+/**
+ * @brief Drop an unfinished transfer started by conn (link lost)
+ */
+void ei_ble_model_update_abort(uint8_t conn);
+
+#endif /* EI_BLE_MODEL_UPDATE_H */
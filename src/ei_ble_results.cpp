@@ -0,0 +1,488 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+
+#include "model-parameters/model_metadata.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "ei_ble_results.h"
+#include "ei_bluetooth_psoc63.h"
+#include "cycfg_gatt_db.h"
+
+/******
+ *
+ * @brief BLE result queue. display_results() pushes every result here, it
+ *        is encoded once and queued for each subscribed central. The values
+ *        are notified from whichever context frees a credit of that central:
+ *        the inference task right after the push, or the BT stack task when
+ *        a notification buffer has been transmitted.
+ *
+ ******/
+
+#define RECORD_LEN          (sizeof(ei_ble_result_header_t) + EI_CLASSIFIER_LABEL_COUNT)
+/* ByteLength of the Result Record characteristic */
+#define MAX_PAYLOAD_LEN     244
+
+#define CHANNEL_CLASS       0
+#define CHANNEL_RECORD      1
+#define CHANNELS            2
+
+typedef struct {
+    uint8_t data[MAX_PAYLOAD_LEN];
+    uint16_t len;
+    uint8_t results;        // results since the last notification
+    bool ready;             // policy says send when a credit is free
+} pending_value_t;
+
+typedef struct {
+    uint8_t data[MAX_PAYLOAD_LEN];
+    uint8_t results;
+    bool busy;
+} tx_buffer_t;
+
+static const uint8_t channel_index[CHANNELS] = { CLASS_RESULT, RESULT_RECORD };
+
+typedef struct {
+    pending_value_t pending[CHANNELS];
+    tx_buffer_t tx_buffers[EI_BLE_RESULTS_CREDITS];
+} conn_queue_t;
+
+static conn_queue_t queues[BT_APP_MAX_CONNECTIONS];
+static ei_ble_results_stats_t stats = { 0, 0, 0, 0, 0, EI_BLE_RESULTS_CREDITS * BT_APP_MAX_CONNECTIONS };
+
+static ei_ble_policy_t policy = EI_BLE_POLICY_LATEST;
+static uint8_t coalesce_n = 1;
+static int last_label_ix = -1;
+static uint16_t record_seq = 0;
+static uint8_t result_format = EI_BLE_RESULT_FORMAT_ALL;
+static float gate_min_score = EI_BLE_RESULTS_GATE_OFF;
+static float gate_anomaly = EI_BLE_RESULTS_ANOMALY_OFF;
+
+static void dispatch(uint8_t conn);
+
+/***************************************
+ *        Encoding
+ **************************************/
+
+static uint16_t saturate_u16(int value)
+{
+    if(value < 0) {
+        return 0;
+    }
+    return (value > UINT16_MAX) ? UINT16_MAX : (uint16_t)value;
+}
+
+static int16_t quantize_anomaly(float anomaly)
+{
+    float scaled = anomaly * 256.0f;
+
+    if(scaled >= (float)INT16_MAX) {
+        return INT16_MAX;
+    }
+    if(scaled <= (float)INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)(scaled + ((scaled < 0.0f) ? -0.5f : 0.5f));
+}
+
+static uint8_t quantize_score(float score)
+{
+    if(score <= 0.0f) {
+        return 0;
+    }
+    if(score >= 1.0f) {
+        return 255;
+    }
+    return (uint8_t)(score * 255.0f + 0.5f);
+}
+
+static uint8_t best_label(const ei_impulse_result_t *result)
+{
+    uint8_t label_ix = 0;
+
+    for(size_t ix = 1; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        if(result->classification[ix].value > result->classification[label_ix].value) {
+            label_ix = ix;
+        }
+    }
+
+    return label_ix;
+}
+
+static void encode_record(const ei_impulse_result_t *result, uint8_t label_ix, uint8_t *record)
+{
+    ei_ble_result_header_t header;
+
+    header.seq = record_seq++;
+    header.timestamp_ms = (uint32_t)ei_read_timer_ms();
+    header.label_ix = label_ix;
+    header.label_count = EI_CLASSIFIER_LABEL_COUNT;
+    header.dsp_ms = saturate_u16(result->timing.dsp);
+    header.nn_ms = saturate_u16(result->timing.classification);
+    header.anomaly = quantize_anomaly(result->anomaly);
+    memcpy(record, &header, sizeof(header));
+
+    for(size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        record[sizeof(header) + ix] = quantize_score(result->classification[ix].value);
+    }
+}
+
+static bool gate_passed(const ei_impulse_result_t *result, uint8_t label_ix)
+{
+    if(result->classification[label_ix].value >= gate_min_score) {
+        return true;
+    }
+#if EI_CLASSIFIER_HAS_ANOMALY == 1
+    if(result->anomaly >= gate_anomaly) {
+        return true;
+    }
+#endif
+    return false;
+}
+
+/***************************************
+ *        Queue (called with bt_app_lock held)
+ **************************************/
+
+static bool policy_ready(const pending_value_t *value, bool continuous)
+{
+    if(continuous == false || policy != EI_BLE_POLICY_COALESCE) {
+        return true;
+    }
+    return (value->results >= coalesce_n);
+}
+
+static void queue_class_result(conn_queue_t *queue, const char *label, bool continuous)
+{
+    pending_value_t *value = &queue->pending[CHANNEL_CLASS];
+    uint16_t len = app_edge_impulse_class_result_len;
+
+    if(len > MAX_PAYLOAD_LEN) {
+        len = MAX_PAYLOAD_LEN;
+    }
+
+    // the older label never made it out
+    if(value->ready) {
+        stats.dropped++;
+    }
+
+    memset(value->data, 0, len);
+    strncpy((char *)value->data, label, len);
+    value->len = len;
+    value->results++;
+    value->ready = policy_ready(value, continuous);
+}
+
+static void queue_record(uint8_t conn, const uint8_t *record, bool continuous)
+{
+    pending_value_t *value = &queues[conn].pending[CHANNEL_RECORD];
+    uint16_t max_len = bt_app_get_notification_max_len(conn);
+
+    if(max_len > app_edge_impulse_result_record_len) {
+        max_len = app_edge_impulse_result_record_len;
+    }
+    if(max_len > MAX_PAYLOAD_LEN) {
+        max_len = MAX_PAYLOAD_LEN;
+    }
+    if(RECORD_LEN > max_len) {
+        // MTU too small for even one record, central has to use Class Result
+        return;
+    }
+
+    // full and still waiting for a credit, keep the newest records
+    while(value->len + RECORD_LEN > max_len) {
+        memmove(value->data, value->data + RECORD_LEN, value->len - RECORD_LEN);
+        value->len -= RECORD_LEN;
+        value->results--;
+        stats.dropped++;
+    }
+
+    memcpy(value->data + value->len, record, RECORD_LEN);
+    value->len += RECORD_LEN;
+    value->results++;
+    value->ready = policy_ready(value, continuous) || (value->len + RECORD_LEN > max_len);
+}
+
+/***************************************
+ *        Transmission
+ **************************************/
+
+static void on_transmitted(uint8_t *p_data)
+{
+    int conn;
+
+    bt_app_lock();
+    for(conn = 0; conn < BT_APP_MAX_CONNECTIONS; conn++) {
+        tx_buffer_t *buffer = NULL;
+
+        for(int ix = 0; ix < EI_BLE_RESULTS_CREDITS; ix++) {
+            if(queues[conn].tx_buffers[ix].data == p_data) {
+                buffer = &queues[conn].tx_buffers[ix];
+            }
+        }
+        if(buffer != NULL) {
+            if(buffer->busy) {
+                buffer->busy = false;
+                stats.credits++;
+                stats.sent++;
+            }
+            break;
+        }
+    }
+    bt_app_unlock();
+
+    if(conn < BT_APP_MAX_CONNECTIONS) {
+        dispatch((uint8_t)conn);
+    }
+}
+
+static void dispatch(uint8_t conn)
+{
+    conn_queue_t *queue = &queues[conn];
+    pending_value_t *pending = queue->pending;
+
+    while(true) {
+        tx_buffer_t *buffer = NULL;
+        int channel;
+        uint16_t len;
+
+        bt_app_lock();
+        for(int ix = 0; ix < EI_BLE_RESULTS_CREDITS && buffer == NULL; ix++) {
+            if(queue->tx_buffers[ix].busy == false) {
+                buffer = &queue->tx_buffers[ix];
+            }
+        }
+        for(channel = 0; channel < CHANNELS; channel++) {
+            if(pending[channel].ready && pending[channel].len > 0) {
+                break;
+            }
+        }
+        if(buffer == NULL || channel == CHANNELS) {
+            bt_app_unlock();
+            return;
+        }
+
+        // the value may be replaced while the buffer is in flight
+        len = pending[channel].len;
+        memcpy(buffer->data, pending[channel].data, len);
+        buffer->results = (channel == CHANNEL_CLASS) ? 1 : pending[channel].results;
+        buffer->busy = true;
+        stats.credits--;
+        pending[channel].len = 0;
+        pending[channel].results = 0;
+        pending[channel].ready = false;
+        bt_app_unlock();
+
+        if(bt_app_send_notification(conn, channel_index[channel], buffer->data, len, &on_transmitted) == false) {
+            bt_app_lock();
+            buffer->busy = false;
+            stats.credits++;
+            stats.dropped += buffer->results;
+            bt_app_unlock();
+            return;
+        }
+    }
+}
+
+/***************************************
+ *        Public functions
+ **************************************/
+
+void ei_ble_results_push(const ei_impulse_result_t *result, bool continuous)
+{
+    uint8_t record[RECORD_LEN];
+    uint8_t label_ix = best_label(result);
+    bool class_enabled[BT_APP_MAX_CONNECTIONS];
+    bool record_enabled[BT_APP_MAX_CONNECTIONS];
+
+    for(int conn = 0; conn < BT_APP_MAX_CONNECTIONS; conn++) {
+        class_enabled[conn] = (result_format & EI_BLE_RESULT_FORMAT_CLASS) &&
+                              bt_app_notification_enabled(conn, CLASS_RESULT);
+        record_enabled[conn] = (result_format & EI_BLE_RESULT_FORMAT_RECORD) &&
+                               bt_app_notification_enabled(conn, RESULT_RECORD);
+    }
+
+    stats.results++;
+
+    if(gate_passed(result, label_ix) == false) {
+        stats.gated++;
+        return;
+    }
+
+    if(continuous && policy == EI_BLE_POLICY_ON_CHANGE && label_ix == last_label_ix) {
+        stats.unchanged++;
+        return;
+    }
+    last_label_ix = label_ix;
+
+    // one encode, fanned out to every subscribed central
+    encode_record(result, label_ix, record);
+
+    bt_app_lock();
+    for(int conn = 0; conn < BT_APP_MAX_CONNECTIONS; conn++) {
+        if(class_enabled[conn]) {
+            queue_class_result(&queues[conn], result->classification[label_ix].label, continuous);
+        }
+        if(record_enabled[conn]) {
+            queue_record(conn, record, continuous);
+        }
+    }
+    bt_app_unlock();
+
+    for(int conn = 0; conn < BT_APP_MAX_CONNECTIONS; conn++) {
+        dispatch(conn);
+    }
+}
+
+void ei_ble_results_flush(void)
+{
+    bt_app_lock();
+    for(int conn = 0; conn < BT_APP_MAX_CONNECTIONS; conn++) {
+        for(int channel = 0; channel < CHANNELS; channel++) {
+            pending_value_t *value = &queues[conn].pending[channel];
+            value->ready = (value->len > 0);
+        }
+    }
+    bt_app_unlock();
+
+    last_label_ix = -1;
+    for(int conn = 0; conn < BT_APP_MAX_CONNECTIONS; conn++) {
+        dispatch(conn);
+    }
+}
+
+void ei_ble_results_reset(uint8_t conn)
+{
+    conn_queue_t *queue;
+
+    if(conn >= BT_APP_MAX_CONNECTIONS) {
+        return;
+    }
+    queue = &queues[conn];
+
+    bt_app_lock();
+    for(int channel = 0; channel < CHANNELS; channel++) {
+        pending_value_t *value = &queue->pending[channel];
+        stats.dropped += (value->len > 0) ? value->results : 0;
+        value->len = 0;
+        value->results = 0;
+        value->ready = false;
+    }
+    for(int ix = 0; ix < EI_BLE_RESULTS_CREDITS; ix++) {
+        if(queue->tx_buffers[ix].busy) {
+            queue->tx_buffers[ix].busy = false;
+            stats.credits++;
+        }
+    }
+    bt_app_unlock();
+
+    // the next central to subscribe gets the current label right away
+    last_label_ix = -1;
+}
+
+bool ei_ble_results_set_policy(ei_ble_policy_t new_policy, uint32_t n)
+{
+    if(new_policy > EI_BLE_POLICY_ON_CHANGE) {
+        ei_printf("ERR: Unknown BLE result policy %d\n", (int)new_policy);
+        return false;
+    }
+    if(new_policy == EI_BLE_POLICY_COALESCE && (n == 0 || n > EI_BLE_RESULTS_MAX_COALESCE)) {
+        ei_printf("ERR: Coalesce count must be 1..%d\n", EI_BLE_RESULTS_MAX_COALESCE);
+        return false;
+    }
+
+    bt_app_lock();
+    policy = new_policy;
+    coalesce_n = (new_policy == EI_BLE_POLICY_COALESCE) ? (uint8_t)n : 1;
+    bt_app_unlock();
+
+    last_label_ix = -1;
+
+    return true;
+}
+
+ei_ble_policy_t ei_ble_results_get_policy(uint8_t *n)
+{
+    if(n != NULL) {
+        *n = coalesce_n;
+    }
+    return policy;
+}
+
+const char *ei_ble_results_policy_name(ei_ble_policy_t policy)
+{
+    switch(policy) {
+        case EI_BLE_POLICY_LATEST:
+            return "latest";
+        case EI_BLE_POLICY_COALESCE:
+            return "coalesce";
+        case EI_BLE_POLICY_ON_CHANGE:
+            return "change";
+        default:
+            return "unknown";
+    }
+}
+
+bool ei_ble_results_policy_from_name(const char *name, ei_ble_policy_t *out)
+{
+    for(int ix = EI_BLE_POLICY_LATEST; ix <= EI_BLE_POLICY_ON_CHANGE; ix++) {
+        if(strcmp(name, ei_ble_results_policy_name((ei_ble_policy_t)ix)) == 0) {
+            *out = (ei_ble_policy_t)ix;
+            return true;
+        }
+    }
+
+    ei_printf("ERR: Unknown BLE result policy %s (latest, coalesce, change)\n", name);
+    return false;
+}
+
+void ei_ble_results_get_stats(ei_ble_results_stats_t *out)
+{
+    bt_app_lock();
+    *out = stats;
+    bt_app_unlock();
+}
+
+bool ei_ble_results_set_format(uint8_t format)
+{
+    if(format == 0 || (format & ~EI_BLE_RESULT_FORMAT_ALL) != 0) {
+        ei_printf("ERR: Unknown BLE result format 0x%02x\n", format);
+        return false;
+    }
+
+    bt_app_lock();
+    result_format = format;
+    bt_app_unlock();
+
+    return true;
+}
+
+uint8_t ei_ble_results_get_format(void)
+{
+    return result_format;
+}
+
+void ei_ble_results_set_gate(float min_score, float anomaly)
+{
+    gate_min_score = min_score;
+    gate_anomaly = anomaly;
+}
+
+void ei_ble_results_get_gate(float *min_score, float *anomaly)
+{
+    *min_score = gate_min_score;
+    *anomaly = gate_anomaly;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_BLE_RESULTS_H
+#define EI_BLE_RESULTS_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include "edge-impulse-sdk/classifier/ei_classifier_types.h"
+
+/**
+ * Binary result record, sent on the Result Record characteristic
+ * (000ED0E8-0000-1000-8000-00805F9B0131). All fields are little endian and
+ * the header is followed by label_count scores. A notification carries as
+ * many whole records as fit in the ATT MTU, records are self-delimiting.
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t seq;           // record counter, wraps
+    uint32_t timestamp_ms;  // device time of the result
+    uint8_t label_ix;       // label with the highest score
+    uint8_t label_count;    // number of scores following the header
+    uint16_t dsp_ms;
+    uint16_t nn_ms;
+    int16_t anomaly;        // anomaly score * 256, saturated (0 without anomaly block)
+} ei_ble_result_header_t;
+// uint8_t scores[label_count], score * 255 rounded
+
+/**
+ * Results are queued, inference never waits for the radio. A result is
+ * encoded once, then for every subscribed central it updates that central's
+ * pending Class Result value and appends a record to its pending Result
+ * Record value. Pending values are sent when a notification buffer (credit)
+ * of the central is free, credits return on GATT_APP_BUFFER_TRANSMITTED_EVT.
+ * A slow central only drops its own results.
+ */
+#define EI_BLE_RESULTS_CREDITS          2       // per connection
+#define EI_BLE_RESULTS_MAX_COALESCE     16
+
+typedef enum {
+    EI_BLE_POLICY_LATEST = 0,   // send the newest result when a credit is free
+    EI_BLE_POLICY_COALESCE,     // send once every N results
+    EI_BLE_POLICY_ON_CHANGE,    // send only when the best label changes
+} ei_ble_policy_t;
+
+/* characteristics a result is sent on */
+#define EI_BLE_RESULT_FORMAT_CLASS      0x01    // Class Result, label text
+#define EI_BLE_RESULT_FORMAT_RECORD     0x02    // Result Record, ei_ble_result_header_t
+#define EI_BLE_RESULT_FORMAT_ALL        (EI_BLE_RESULT_FORMAT_CLASS | EI_BLE_RESULT_FORMAT_RECORD)
+
+/**
+ * Gate: a result is only sent when its best score reaches min_score, or its
+ * anomaly score reaches anomaly (if the model has an anomaly block).
+ * Gated results are still printed on the console.
+ */
+#define EI_BLE_RESULTS_GATE_OFF         0.0f
+#define EI_BLE_RESULTS_ANOMALY_OFF      1e9f
+
+typedef struct {
+    uint32_t results;           // results pushed
+    uint32_t unchanged;         // results skipped by EI_BLE_POLICY_ON_CHANGE
+    uint32_t gated;             // results below the gate thresholds
+    uint32_t sent;              // notifications transmitted
+    uint32_t dropped;           // results replaced or lost before they were sent
+    uint8_t credits;            // free notification buffers, all connections
+} ei_ble_results_stats_t;
+
+/**
+ * @brief Queue a result. Single results are sent right away, continuous
+ * results follow the policy.
+ */
+void ei_ble_results_push(const ei_impulse_result_t *result, bool continuous);
+
+/**
+ * @brief Send the pending values regardless of the policy (call when inference stops)
+ */
+void ei_ble_results_flush(void);
+
+/**
+ * @brief Drop the pending values of a connection and restore its credits
+ * (call on disconnect)
+ */
+void ei_ble_results_reset(uint8_t conn);
+
+bool ei_ble_results_set_policy(ei_ble_policy_t policy, uint32_t coalesce_n);
+ei_ble_policy_t ei_ble_results_get_policy(uint8_t *coalesce_n);
+const char *ei_ble_results_policy_name(ei_ble_policy_t policy);
+bool ei_ble_results_policy_from_name(const char *name, ei_ble_policy_t *policy);
+void ei_ble_results_get_stats(ei_ble_results_stats_t *stats);
+
+bool ei_ble_results_set_format(uint8_t format);
+uint8_t ei_ble_results_get_format(void);
+void ei_ble_results_set_gate(float min_score, float anomaly);
+void ei_ble_results_get_gate(float *min_score, float *anomaly);
+
+#endif /* EI_BLE_RESULTS_H */
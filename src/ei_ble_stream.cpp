@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "firmware-sdk/ei_fusion.h"
+#include "firmware-sdk/ei_device_info_lib.h"
+#include "ei_ble_stream.h"
+#include "ei_int16_codec.h"
+#include "ei_bluetooth_psoc63.h"
+#include "ei_run_impulse.h"
+
+/******
+ *
+ * @brief Raw sensor data over BLE (wireless data forwarder). The fusion
+ *        sampler callback packs samples into frames, a full frame is
+ *        notified right away and the next one is packed in a free buffer.
+ *        While all buffers are in flight, samples are dropped and counted.
+ *
+ ******/
+
+/* ByteLength of the Raw Stream characteristic */
+#define MAX_FRAME_LEN       244
+#define MAX_AXES            16
+
+typedef enum {
+    BUFFER_FREE = 0,
+    BUFFER_FILLING,
+    BUFFER_IN_FLIGHT
+} buffer_state_t;
+
+typedef struct {
+    uint8_t data[MAX_FRAME_LEN];
+    uint16_t len;
+    buffer_state_t state;
+} frame_buffer_t;
+
+static frame_buffer_t buffers[EI_BLE_STREAM_BUFFERS];
+static frame_buffer_t *current = NULL;
+static int16_t previous[MAX_AXES];
+
+static volatile bool running = false;
+static uint8_t stream_conn;     // central that started the stream
+static ei_ble_stream_format_t stream_format;
+static uint32_t stream_interval_us;
+static uint16_t frame_seq;
+static uint16_t max_frame_len;
+static ei_ble_stream_stats_t stats;
+
+/***************************************
+ *        Buffers (called with bt_app_lock held)
+ **************************************/
+
+static frame_buffer_t *take_buffer(void)
+{
+    for(int ix = 0; ix < EI_BLE_STREAM_BUFFERS; ix++) {
+        if(buffers[ix].state == BUFFER_FREE) {
+            buffers[ix].state = BUFFER_FILLING;
+            buffers[ix].len = 0;
+            return &buffers[ix];
+        }
+    }
+    return NULL;
+}
+
+static void on_transmitted(uint8_t *p_data)
+{
+    bt_app_lock();
+    for(int ix = 0; ix < EI_BLE_STREAM_BUFFERS; ix++) {
+        if(buffers[ix].data == p_data && buffers[ix].state == BUFFER_IN_FLIGHT) {
+            buffers[ix].state = BUFFER_FREE;
+            stats.sent++;
+            break;
+        }
+    }
+    bt_app_unlock();
+}
+
+static void send_frame(frame_buffer_t *frame)
+{
+    bt_app_lock();
+    frame->state = BUFFER_IN_FLIGHT;
+    stats.frames++;
+    stats.bytes += frame->len;
+    bt_app_unlock();
+
+    if(bt_app_send_notification(stream_conn, RAW_STREAM, frame->data, frame->len, &on_transmitted) == false) {
+        bt_app_lock();
+        frame->state = BUFFER_FREE;
+        stats.dropped_frames++;
+        bt_app_unlock();
+    }
+}
+
+static void begin_frame(frame_buffer_t *frame, uint8_t n_axes)
+{
+    ei_ble_stream_header_t header;
+
+    header.seq = frame_seq++;
+    header.format = (uint8_t)stream_format;
+    header.n_axes = n_axes;
+    header.n_samples = 0;
+    header.scale = EI_BLE_STREAM_SCALE;
+    header.first_sample = stats.samples;
+    header.interval_us = stream_interval_us;
+
+    memcpy(frame->data, &header, sizeof(header));
+    frame->len = sizeof(header);
+}
+
+/* Returns false (frame unchanged) if the sample does not fit */
+static bool append_sample(frame_buffer_t *frame, const int16_t *values, uint8_t n_axes)
+{
+    ei_ble_stream_header_t *header = (ei_ble_stream_header_t *)frame->data;
+    bool first = (header->n_samples == 0);
+    uint8_t encoded[MAX_AXES * EI_VARINT_MAX_LEN];
+    size_t len = 0;
+
+    if(header->n_samples == UINT8_MAX) {
+        return false;
+    }
+
+    for(uint8_t ix = 0; ix < n_axes; ix++) {
+        if(stream_format == EI_BLE_STREAM_FORMAT_DELTA) {
+            int32_t value = first ? values[ix] : (int32_t)values[ix] - previous[ix];
+            len += ei_varint_put(&encoded[len], value);
+        }
+        else {
+            encoded[len++] = (uint8_t)(values[ix] & 0xff);
+            encoded[len++] = (uint8_t)((uint16_t)values[ix] >> 8);
+        }
+    }
+
+    if(frame->len + len > max_frame_len) {
+        return false;
+    }
+
+    memcpy(&frame->data[frame->len], encoded, len);
+    memcpy(previous, values, n_axes * sizeof(int16_t));
+    frame->len += len;
+    header->n_samples++;
+
+    return true;
+}
+
+/***************************************
+ *        Sampler
+ **************************************/
+
+static bool stream_sample_callback(const void *raw_sample, uint32_t raw_sample_size)
+{
+    const float *sample = (const float *)raw_sample;
+    uint8_t n_axes = (uint8_t)(raw_sample_size / sizeof(float));
+    int16_t values[MAX_AXES];
+
+    if(running == false) {
+        // stop the sampler, send what is left
+        if(current != NULL && current->len > sizeof(ei_ble_stream_header_t)) {
+            send_frame(current);
+        }
+        else if(current != NULL) {
+            current->state = BUFFER_FREE;
+        }
+        current = NULL;
+        return true;
+    }
+
+    if(n_axes == 0 || n_axes > MAX_AXES) {
+        return false;
+    }
+
+    for(uint8_t ix = 0; ix < n_axes; ix++) {
+        values[ix] = ei_quantize_int16(sample[ix], EI_BLE_STREAM_SCALE, NULL);
+    }
+
+    // frame full, send it and start the next one with this sample
+    if(current != NULL && append_sample(current, values, n_axes) == false) {
+        send_frame(current);
+        current = NULL;
+    }
+    else if(current != NULL) {
+        stats.samples++;
+        return false;
+    }
+
+    bt_app_lock();
+    current = take_buffer();
+    bt_app_unlock();
+
+    if(current == NULL) {
+        // all buffers in flight, the gap shows in first_sample of the next frame
+        stats.dropped_samples++;
+    }
+    else {
+        begin_frame(current, n_axes);
+        append_sample(current, values, n_axes);
+    }
+    stats.samples++;
+
+    return false;
+}
+
+/***************************************
+ *        Public functions
+ **************************************/
+
+bool ei_ble_stream_start(uint8_t conn, ei_ble_stream_format_t format, uint32_t interval_ms)
+{
+    if(running) {
+        ei_printf("ERR: Stream is already running\n");
+        return false;
+    }
+    if(is_inference_running()) {
+        ei_printf("ERR: Inference is running, stop it first\n");
+        return false;
+    }
+    if(format > EI_BLE_STREAM_FORMAT_DELTA) {
+        ei_printf("ERR: Unknown stream format %d\n", (int)format);
+        return false;
+    }
+    if(interval_ms == 0) {
+        interval_ms = EI_BLE_STREAM_DEFAULT_INTERVAL_MS;
+    }
+
+    if(ei_connect_fusion_list(EI_BLE_STREAM_SENSOR, SENSOR_FORMAT) == false) {
+        ei_printf("ERR: Failed to find sensor '%s' in the sensor list\n", EI_BLE_STREAM_SENSOR);
+        return false;
+    }
+
+    stream_conn = conn;
+    max_frame_len = bt_app_get_notification_max_len(conn);
+    if(max_frame_len > MAX_FRAME_LEN) {
+        max_frame_len = MAX_FRAME_LEN;
+    }
+
+    bt_app_lock();
+    memset(&stats, 0, sizeof(stats));
+    bt_app_unlock();
+    stream_format = format;
+    stream_interval_us = interval_ms * 1000;
+    frame_seq = 0;
+    current = NULL;
+
+    // short connection interval before the first frame is ready
+    bt_app_set_link_mode(BT_LINK_STREAMING);
+
+    running = true;
+    if(ei_fusion_sample_start(&stream_sample_callback, (float)interval_ms) == false) {
+        ei_printf("ERR: Failed to start sampling\n");
+        running = false;
+        bt_app_set_link_mode(BT_LINK_IDLE);
+        return false;
+    }
+
+    EiDeviceInfo::get_device()->set_state(eiStateSampling);
+    ei_printf("Streaming %s over BLE every %lu ms\n", EI_BLE_STREAM_SENSOR, (unsigned long)interval_ms);
+
+    return true;
+}
+
+void ei_ble_stream_stop(void)
+{
+    if(running == false) {
+        return;
+    }
+
+    // the sampler stops and sends the last frame on its next callback
+    running = false;
+    bt_app_set_link_mode(BT_LINK_IDLE);
+    EiDeviceInfo::get_device()->set_state(eiStateFinished);
+    ei_printf("Streaming stopped\n");
+}
+
+bool ei_ble_stream_is_running(void)
+{
+    return running;
+}
+
+void ei_ble_stream_get_stats(ei_ble_stream_stats_t *out)
+{
+    bt_app_lock();
+    *out = stats;
+    bt_app_unlock();
+}
+
+bool ei_ble_stream_command(uint8_t conn, const uint8_t *data, uint16_t len)
+{
+    uint32_t interval_ms = 0;
+
+    if(len < 1) {
+        return false;
+    }
+    if(len >= 3) {
+        interval_ms = data[1] | ((uint32_t)data[2] << 8);
+    }
+
+    switch(data[0]) {
+        case EI_BLE_STREAM_CMD_STOP:
+            ei_ble_stream_stop();
+            return true;
+        case EI_BLE_STREAM_CMD_START_INT16:
+            return ei_ble_stream_start(conn, EI_BLE_STREAM_FORMAT_INT16, interval_ms);
+        case EI_BLE_STREAM_CMD_START_DELTA:
+            return ei_ble_stream_start(conn, EI_BLE_STREAM_FORMAT_DELTA, interval_ms);
+        default:
+            ei_printf("ERR: Unknown stream command %d\n", data[0]);
+            return false;
+    }
+}
+
+void ei_ble_stream_reset(uint8_t conn)
+{
+    if(conn != stream_conn) {
+        return;
+    }
+
+    ei_ble_stream_stop();
+
+    bt_app_lock();
+    for(int ix = 0; ix < EI_BLE_STREAM_BUFFERS; ix++) {
+        if(buffers[ix].state == BUFFER_IN_FLIGHT) {
+            buffers[ix].state = BUFFER_FREE;
+        }
+    }
+    bt_app_unlock();
+}
+
+int ei_ble_stream_decode(const uint8_t *frame, size_t len, ei_ble_stream_header_t *header,
+                         int16_t *values, size_t max_values)
+{
+    size_t pos = sizeof(ei_ble_stream_header_t);
+    size_t n_values;
+
+    if(len < sizeof(ei_ble_stream_header_t)) {
+        return -1;
+    }
+
+    memcpy(header, frame, sizeof(ei_ble_stream_header_t));
+    n_values = (size_t)header->n_samples * header->n_axes;
+    if(header->n_axes == 0 || n_values > max_values) {
+        return -1;
+    }
+
+    for(size_t ix = 0; ix < n_values; ix++) {
+        if(header->format == EI_BLE_STREAM_FORMAT_DELTA) {
+            int32_t value;
+            size_t used = ei_varint_get(&frame[pos], len - pos, &value);
+            if(used == 0) {
+                return -1;
+            }
+            pos += used;
+            values[ix] = (int16_t)((ix < header->n_axes) ? value : values[ix - header->n_axes] + value);
+        }
+        else if(header->format == EI_BLE_STREAM_FORMAT_INT16) {
+            if(pos + 2 > len) {
+                return -1;
+            }
+            values[ix] = (int16_t)(frame[pos] | (frame[pos + 1] << 8));
+            pos += 2;
+        }
+        else {
+            return -1;
+        }
+    }
+
+    return (pos == len) ? header->n_samples : -1;
+}
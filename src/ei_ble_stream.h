@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_BLE_STREAM_H
+#define EI_BLE_STREAM_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Raw sensor stream, sent on the Raw Stream characteristic
+ * (000ED0E8-0000-1000-8000-00805F9B0132). Every notification is one frame:
+ * this header, then n_samples samples of n_axes values. Values are the
+ * sensor reading * scale as int16 (saturated). All fields are little endian.
+ *
+ * EI_BLE_STREAM_FORMAT_INT16: values as int16.
+ * EI_BLE_STREAM_FORMAT_DELTA: the first sample as zigzag varints, every next
+ *   value as the zigzag varint of its difference to the same axis of the
+ *   previous sample. Frames decode on their own, a lost frame only loses its
+ *   samples.
+ *
+ * seq counts frames, first_sample counts samples since the stream started,
+ * so a gap in first_sample is data the device dropped (no free buffer) and a
+ * gap in seq is a notification the link lost.
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t seq;
+    uint8_t format;         // ei_ble_stream_format_t
+    uint8_t n_axes;
+    uint8_t n_samples;
+    uint16_t scale;         // value = int16 / scale
+    uint32_t first_sample;
+    uint32_t interval_us;   // sample interval
+} ei_ble_stream_header_t;
+
+typedef enum {
+    EI_BLE_STREAM_FORMAT_INT16 = 0,
+    EI_BLE_STREAM_FORMAT_DELTA = 1,
+} ei_ble_stream_format_t;
+
+/**
+ * Commands written to the Raw Stream characteristic:
+ * [command u8] [interval_ms u16, optional, default EI_BLE_STREAM_DEFAULT_INTERVAL_MS]
+ */
+#define EI_BLE_STREAM_CMD_STOP          0
+#define EI_BLE_STREAM_CMD_START_INT16   1
+#define EI_BLE_STREAM_CMD_START_DELTA   2
+
+#define EI_BLE_STREAM_SENSOR                "Inertial"
+#define EI_BLE_STREAM_SCALE                 1000    // m/s2 -> mm/s2
+#define EI_BLE_STREAM_DEFAULT_INTERVAL_MS   10
+#define EI_BLE_STREAM_BUFFERS               4
+
+typedef struct {
+    uint32_t samples;           // samples read from the sensor
+    uint32_t frames;            // frames handed to the BLE stack
+    uint32_t sent;              // frames transmitted
+    uint32_t dropped_samples;   // samples lost because no buffer was free
+    uint32_t dropped_frames;    // frames the BLE stack refused
+    uint32_t bytes;             // payload bytes handed to the BLE stack
+} ei_ble_stream_stats_t;
+
+/* frames go to the central in connection slot conn */
+bool ei_ble_stream_start(uint8_t conn, ei_ble_stream_format_t format, uint32_t interval_ms);
+void ei_ble_stream_stop(void);
+bool ei_ble_stream_is_running(void);
+void ei_ble_stream_get_stats(ei_ble_stream_stats_t *stats);
+
+/**
+ * @brief Handle a command written to the Raw Stream characteristic
+ */
+bool ei_ble_stream_command(uint8_t conn, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief Stop the stream and drop the frames in flight if conn started it
+ * (call on disconnect)
+ */
+void ei_ble_stream_reset(uint8_t conn);
+
+/**
+ * @brief Decode one frame into interleaved samples (host tools)
+ * @return number of samples decoded, -1 on a malformed frame
+ */
+int ei_ble_stream_decode(const uint8_t *frame, size_t len, ei_ble_stream_header_t *header,
+                         int16_t *values, size_t max_values);
+
+#endif /* EI_BLE_STREAM_H */
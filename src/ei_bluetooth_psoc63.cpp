@@ -15,8 +15,26 @@
  */
 
 
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
 #include "ei_bluetooth_psoc63.h"
 #include "ei_run_impulse.h"
+#include "ei_ble_results.h"
+#include "ei_ble_stream.h"
+#include "ei_ble_control.h"
+#include "ei_ble_buffers.h"
+#include "ei_ble_model_update.h"
+
+#include "cy_pdl.h"
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+
+/* BLE stack for Infineon PSoC 6 requires FreeRTOS */
+#ifdef FREERTOS_ENABLED
+#include <FreeRTOS.h>
+#include <task.h>
+#include <timers.h>
+#endif
 
 #include "wiced_bt_stack.h"
 #include "wiced_bt_dev.h"
@@ -30,6 +48,7 @@
 #include "cycfg_bt_settings.h"
 #include "wiced_bt_types.h"
 #include "wiced_bt_gatt.h"
+#include "wiced_bt_l2c.h"
 #include "wiced_bt_stack.h"
 
 
@@ -39,11 +58,6 @@
  *
  ******/
 
-enum
-{
-    NOTIFIY_OFF,
-    NOTIFIY_ON,
-};
 /*******************************************************************************
 * Function Prototypes
 *******************************************************************************/
@@ -52,7 +66,7 @@ wiced_bt_gatt_status_t bt_app_gatt_event_cb(wiced_bt_gatt_evt_t event,
 wiced_bt_gatt_status_t bt_app_gatt_conn_status_cb(wiced_bt_gatt_connection_status_t
                                                                     *p_conn_status);
 wiced_bt_gatt_status_t bt_app_gatt_req_cb(wiced_bt_gatt_attribute_request_t *p_attr_req);
-wiced_bt_gatt_status_t bt_app_gatt_req_write_value(uint16_t attr_handle,
+wiced_bt_gatt_status_t bt_app_gatt_req_write_value(uint16_t conn_id, uint16_t attr_handle,
                                                     uint8_t *p_val, uint16_t len);
 wiced_bt_gatt_status_t bt_app_gatt_req_write_handler(uint16_t conn_id,
                                                 wiced_bt_gatt_opcode_t opcode,
@@ -70,23 +84,122 @@ static gatt_db_lookup_table_t *bt_app_find_by_handle(uint16_t handle);
 static void* bt_app_alloc_buffer(int len);
 static void  bt_app_free_buffer(uint8_t *p_event_data);
 static void  bt_print_bd_address(wiced_bt_device_address_t bdadr);
+static void  bt_app_negotiate_link(struct bt_app_conn *p_conn);
+static bool  bt_app_build_attr_map(void);
 wiced_result_t bt_app_management_cb(wiced_bt_management_evt_t event,
                                     wiced_bt_management_evt_data_t *p_event_data);
 
 
-/* Variable to denote notification received for bt task. */
-uint8_t notify_enabled;
-uint8_t notify_temperature_sensor;
-uint8_t notify_index;
+/* ATT MTU of a connection, default until the central exchanges MTU */
+#define BT_DEFAULT_MTU_SIZE     23
+
+/* State of one central. The generated GATT database holds a single value
+ * per CCCD, so the subscriptions of each central are kept here and copied
+ * into the attribute when that central reads it.
+ */
+typedef struct bt_app_conn {
+    uint16_t conn_id;                   /* 0: slot free */
+    uint16_t mtu;
+    /* ATT allows one indication in flight, cleared by GATT_HANDLE_VALUE_CONF */
+    volatile bool indication_pending;
+    wiced_bt_device_address_t peer_addr;
+    uint8_t cccd[MODEL_UPDATE + 1];     /* GATT_CLIENT_CONFIG_* per ble_char_index */
+} bt_app_conn_t;
+
+static bt_app_conn_t bt_conns[BT_APP_MAX_CONNECTIONS];
+
+/* Data Length Extension: largest LL PDU payload and its air time on 1M PHY */
+#define BT_DLE_TX_PDU_LEN       251
+#define BT_DLE_TX_TIME_US       2120
+
+/* Connection parameters per link mode. Intervals in 1.25 ms units,
+ * supervision timeout in 10 ms units
+ */
+typedef struct {
+    uint16_t min_interval;
+    uint16_t max_interval;
+    uint16_t latency;
+    uint16_t timeout;
+} bt_conn_params_t;
+
+static const bt_conn_params_t bt_link_params[] = {
+    /* BT_LINK_IDLE: 100-200 ms, skip up to 4 events */
+    { 80, 160, 4, 600 },
+    /* BT_LINK_RESULTS: 30-50 ms, a result every few hundred ms */
+    { 24, 40, 0, 500 },
+    /* BT_LINK_STREAMING: 7.5-15 ms, several notifications per event */
+    { 6, 12, 0, 500 },
+};
+
+static bt_link_mode_t bt_link_mode = BT_LINK_IDLE;
+
+/* Dense handle -> attribute map. The generated GATT database numbers its
+ * handles from 1 without gaps, so a byte per handle replaces the linear scan
+ * of app_gatt_db_ext_attr_tbl on every ATT request.
+ */
+#define BT_APP_MAX_HANDLE       0x7F
+#define BT_APP_NO_ENTRY         0xFF
+
+typedef wiced_bt_gatt_status_t (*bt_app_attr_write_cb_t)(bt_app_conn_t *p_conn, uint8_t index,
+                                                         uint8_t *p_val, uint16_t len);
+typedef void (*bt_app_attr_read_cb_t)(bt_app_conn_t *p_conn, uint8_t index,
+                                      gatt_db_lookup_table_t *p_attr);
+
+typedef struct {
+    uint16_t handle;
+    uint8_t index;                      /* ble_char_index of the characteristic */
+    bt_app_attr_read_cb_t on_read;      /* update the value before it is read */
+    bt_app_attr_write_cb_t on_write;    /* act on a value that has been written */
+} bt_app_attr_handler_t;
 
-/* Holds the connection ID */
-volatile uint16_t bt_connection_id = 0;
+typedef struct {
+    uint8_t attr_ix;        /* app_gatt_db_ext_attr_tbl index */
+    uint8_t handler_ix;     /* bt_app_attr_handlers index */
+} bt_app_attr_map_t;
+
+static bt_app_attr_map_t bt_app_attr_map[BT_APP_MAX_HANDLE + 1];
+static const bt_app_attr_handler_t *bt_app_find_handler(uint16_t handle);
 
 /**
  * Typdef for function used to free allocated buffer to stack
  */
 typedef void (*pfn_free_buffer_t)(uint8_t *);
 
+static bt_app_conn_t *bt_app_find_conn(uint16_t conn_id)
+{
+    for (int i = 0; i < BT_APP_MAX_CONNECTIONS; i++)
+    {
+        if (0 != conn_id && bt_conns[i].conn_id == conn_id)
+        {
+            return &bt_conns[i];
+        }
+    }
+    return NULL;
+}
+
+static bt_app_conn_t *bt_app_get_conn(uint8_t conn)
+{
+    if (conn >= BT_APP_MAX_CONNECTIONS || 0 == bt_conns[conn].conn_id)
+    {
+        return NULL;
+    }
+    return &bt_conns[conn];
+}
+
+static uint8_t bt_app_conn_count(void)
+{
+    uint8_t count = 0;
+
+    for (int i = 0; i < BT_APP_MAX_CONNECTIONS; i++)
+    {
+        if (0 != bt_conns[i].conn_id)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
 cy_rslt_t ei_bluetooth_init(void)
 {
     cy_rslt_t result;
@@ -98,11 +211,11 @@ cy_rslt_t ei_bluetooth_init(void)
     result = wiced_bt_stack_init(bt_app_management_cb, &wiced_bt_cfg_settings);
     if(CY_RSLT_SUCCESS == result)
     {
-        printf("Bluetooth stack initialization successful!\r\n");
+        ei_printf("Bluetooth stack initialization successful!\r\n");
     }
     else
     {
-        printf("Bluetooth stack initialization failed!\r\n");
+        ei_printf("Bluetooth stack initialization failed!\r\n");
     }
     return result;
 }
@@ -114,11 +227,17 @@ void bt_app_init(void)
 
     /* Register with BT stack to receive GATT callback */
     status = wiced_bt_gatt_register(bt_app_gatt_event_cb);
-    printf("GATT event handler registration status: %d \r\n",status);
+    ei_printf("GATT event handler registration status: %d \r\n",status);
+
+    /* Index the attribute table by handle */
+    if (!bt_app_build_attr_map())
+    {
+        CY_ASSERT(0);
+    }
 
     /* Initialize GATT Database */
     status = wiced_bt_gatt_db_init(gatt_database, gatt_database_len, NULL);
-    printf("GATT database initialization status: %d \r\n",status);
+    ei_printf("GATT database initialization status: %d \r\n",status);
 
     /* Allow peer to pair */
     wiced_bt_set_pairable_mode(FALSE, FALSE);
@@ -134,7 +253,7 @@ void bt_app_init(void)
     /* Failed to start advertisement. Stop program execution */
     if (WICED_BT_SUCCESS != result)
     {
-        printf("Failed to start advertisement! \r\n");
+        ei_printf("Failed to start advertisement! \r\n");
         CY_ASSERT(0);
     }
 
@@ -164,7 +283,7 @@ wiced_result_t bt_app_management_cb(wiced_bt_management_evt_t event,
     wiced_result_t result = WICED_BT_SUCCESS;
     wiced_bt_device_address_t local_bda = {0x00, 0xA0, 0x50, 0x02, 0x04, 0x08};
 
-    printf("Bluetooth app management callback: 0x%x\r\n", event);
+    ei_printf("Bluetooth app management callback: 0x%x\r\n", event);
 
     switch (event)
     {
@@ -175,7 +294,7 @@ wiced_result_t bt_app_management_cb(wiced_bt_management_evt_t event,
             {
                 wiced_bt_set_local_bdaddr(local_bda, BLE_ADDR_PUBLIC);
                 wiced_bt_dev_read_local_addr(local_bda);
-                printf("Bluetooth local device address: ");
+                ei_printf("Bluetooth local device address: ");
                 bt_print_bd_address(local_bda);
 
                 /* Perform application-specific initialization */
@@ -183,7 +302,7 @@ wiced_result_t bt_app_management_cb(wiced_bt_management_evt_t event,
             }
             else
             {
-                printf("Bluetooth enable failed, status = %d \r\n",
+                ei_printf("Bluetooth enable failed, status = %d \r\n",
                                                 p_event_data->enabled.status);
             }
             break;
@@ -194,25 +313,26 @@ wiced_result_t bt_app_management_cb(wiced_bt_management_evt_t event,
         case BTM_BLE_ADVERT_STATE_CHANGED_EVT:
 
             /* Advertisement State Changed */
-            printf("Bluetooth advertisement state change: 0x%x\r\n",
+            ei_printf("Bluetooth advertisement state change: 0x%x\r\n",
                                      p_event_data->ble_advert_state_changed);
             break;
 
         case BTM_BLE_CONNECTION_PARAM_UPDATE:
-            printf("Bluetooth connection parameter update status:%d\n \
-                    parameter interval: %d ms\n \
-                    parameter latency: %d ms\n \
+            ei_printf("Bluetooth connection parameter update status:%d\n \
+                    parameter interval: %d.%02d ms\n \
+                    parameter latency: %d events\n \
                     parameter timeout: %d ms\r\n",
                     p_event_data->ble_connection_param_update.status,
-                    p_event_data->ble_connection_param_update.conn_interval,
+                    (p_event_data->ble_connection_param_update.conn_interval * 125) / 100,
+                    (p_event_data->ble_connection_param_update.conn_interval * 125) % 100,
                     p_event_data->ble_connection_param_update.conn_latency,
-                    p_event_data->ble_connection_param_update.supervision_timeout);
+                    p_event_data->ble_connection_param_update.supervision_timeout * 10);
             result = WICED_SUCCESS;
             break;
 
         case BTM_BLE_PHY_UPDATE_EVT:
             /* Print the updated BLE physical link*/
-            printf("Bluetooth phy update selected TX - %dM\r\nBluetooth phy update selected RX - %dM\r\n",
+            ei_printf("Bluetooth phy update selected TX - %dM\r\nBluetooth phy update selected RX - %dM\r\n",
                     p_event_data->ble_phy_update_event.tx_phy,
                     p_event_data->ble_phy_update_event.rx_phy);
             break;
@@ -223,7 +343,7 @@ wiced_result_t bt_app_management_cb(wiced_bt_management_evt_t event,
              break;
 
         default:
-            printf("Bluetooth unhandled event: 0x%x \r\n", event);
+            ei_printf("Bluetooth unhandled event: 0x%x \r\n", event);
             break;
     }
     return result;
@@ -257,7 +377,7 @@ wiced_bt_gatt_status_t bt_app_gatt_event_cb(wiced_bt_gatt_evt_t event,
             status = bt_app_gatt_conn_status_cb(&p_event_data->connection_status );
             if(WICED_BT_GATT_SUCCESS != status)
             {
-               printf("GATT connection status failed: 0x%x\r\n", status);
+               ei_printf("GATT connection status failed: 0x%x\r\n", status);
             }
             break;
 
@@ -265,6 +385,20 @@ wiced_bt_gatt_status_t bt_app_gatt_event_cb(wiced_bt_gatt_evt_t event,
             status = bt_app_gatt_req_cb(p_attr_req);
             break;
 
+        case GATT_OPERATION_CPLT_EVT:
+            /* Response to the MTU exchange started in bt_app_negotiate_link() */
+            if (GATTC_OPTYPE_CONFIG_MTU == p_event_data->operation_complete.op)
+            {
+                bt_app_conn_t *p_conn = bt_app_find_conn(p_event_data->operation_complete.conn_id);
+                if (NULL != p_conn)
+                {
+                    p_conn->mtu = MIN(p_event_data->operation_complete.response_data.mtu, CY_BT_MTU_SIZE);
+                    ei_printf("Bluetooth ATT MTU: %d (conn 0x%x)\r\n", p_conn->mtu, p_conn->conn_id);
+                }
+            }
+            status = WICED_BT_GATT_SUCCESS;
+            break;
+
         case GATT_GET_RESPONSE_BUFFER_EVT:
             p_event_data->buffer_request.buffer.p_app_rsp_buffer = (uint8_t *) bt_app_alloc_buffer(p_event_data->buffer_request.len_requested);
             p_event_data->buffer_request.buffer.p_app_ctxt = (wiced_bt_gatt_app_context_t) bt_app_free_buffer;
@@ -311,6 +445,7 @@ wiced_bt_gatt_status_t bt_app_gatt_event_cb(wiced_bt_gatt_evt_t event,
 wiced_bt_gatt_status_t bt_app_gatt_req_cb(wiced_bt_gatt_attribute_request_t *p_attr_req)
 {
     wiced_bt_gatt_status_t status = WICED_BT_GATT_ERROR;
+    bt_app_conn_t *p_conn;
     switch ( p_attr_req->opcode )
     {
         case GATT_REQ_READ:
@@ -333,6 +468,11 @@ wiced_bt_gatt_status_t bt_app_gatt_req_cb(wiced_bt_gatt_attribute_request_t *p_a
             break;
 
         case GATT_REQ_MTU:
+            p_conn = bt_app_find_conn(p_attr_req->conn_id);
+            if (NULL != p_conn)
+            {
+                p_conn->mtu = MIN(p_attr_req->data.remote_mtu, CY_BT_MTU_SIZE);
+            }
             status = wiced_bt_gatt_server_send_mtu_rsp(p_attr_req->conn_id,
                                                        p_attr_req->data.remote_mtu,
                                                        CY_BT_MTU_SIZE);
@@ -356,11 +496,17 @@ wiced_bt_gatt_status_t bt_app_gatt_req_cb(wiced_bt_gatt_attribute_request_t *p_a
              }
              break;
         case GATT_HANDLE_VALUE_CONF:
+             p_conn = bt_app_find_conn(p_attr_req->conn_id);
+             if (NULL != p_conn)
+             {
+                 p_conn->indication_pending = false;
+             }
+             break;
         case GATT_HANDLE_VALUE_NOTIF:
              break;
 
         default:
-            printf("bt_app_gatt: unhandled GATT request: %d\r\n", p_attr_req->opcode);
+            ei_printf("bt_app_gatt: unhandled GATT request: %d\r\n", p_attr_req->opcode);
             break;
     }
 
@@ -389,6 +535,8 @@ wiced_bt_gatt_status_t bt_app_gatt_req_read_by_type_handler(uint16_t conn_id,
                                                 uint16_t len_req)
 {
     gatt_db_lookup_table_t *puAttribute;
+    const bt_app_attr_handler_t *handler;
+    bt_app_conn_t *p_conn = bt_app_find_conn(conn_id);
     uint16_t last_handle = 0;
     uint16_t attr_handle = p_read_req->s_handle;
     uint8_t *p_rsp = (uint8_t *) bt_app_alloc_buffer(len_req);
@@ -397,7 +545,7 @@ wiced_bt_gatt_status_t bt_app_gatt_req_read_by_type_handler(uint16_t conn_id,
 
     if (NULL == p_rsp)
     {
-        printf("bt_app_gatt:no memory found, len_req: %d!!\r\n",len_req);
+        ei_printf("bt_app_gatt:no memory found, len_req: %d!!\r\n",len_req);
         wiced_bt_gatt_server_send_error_rsp(conn_id,
                                             opcode,
                                             attr_handle,
@@ -418,7 +566,7 @@ wiced_bt_gatt_status_t bt_app_gatt_req_read_by_type_handler(uint16_t conn_id,
 
         if ( NULL == (puAttribute = bt_app_find_by_handle(attr_handle)))
         {
-            printf("bt_app_gatt:found type but no attribute for %d \r\n",last_handle);
+            ei_printf("bt_app_gatt:found type but no attribute for %d \r\n",last_handle);
             wiced_bt_gatt_server_send_error_rsp(conn_id,
                                                 opcode,
                                                 p_read_req->s_handle,
@@ -427,6 +575,12 @@ wiced_bt_gatt_status_t bt_app_gatt_req_read_by_type_handler(uint16_t conn_id,
             return WICED_BT_GATT_INVALID_HANDLE;
         }
 
+        handler = bt_app_find_handler(attr_handle);
+        if (NULL != handler && NULL != handler->on_read && NULL != p_conn)
+        {
+            handler->on_read(p_conn, handler->index, puAttribute);
+        }
+
         int filled = wiced_bt_gatt_put_read_by_type_rsp_in_stream(p_rsp + used_len,
                                                                 len_req - used_len,
                                                                 &pair_len,
@@ -445,7 +599,7 @@ wiced_bt_gatt_status_t bt_app_gatt_req_read_by_type_handler(uint16_t conn_id,
 
     if (0 == used_len)
     {
-        printf("bt_app_gatt:attr not found start_handle: 0x%04x  end_handle: 0x%04x \
+        ei_printf("bt_app_gatt:attr not found start_handle: 0x%04x  end_handle: 0x%04x \
                                                         type: 0x%04x\r\n",
                                                         p_read_req->s_handle,
                                                         p_read_req->e_handle,
@@ -469,15 +623,169 @@ wiced_bt_gatt_status_t bt_app_gatt_req_read_by_type_handler(uint16_t conn_id,
 }
 
 
+/*******************************************************************************
+* Attribute callbacks. Write callbacks run after the value has been stored,
+* p_conn is the central that sent the request.
+*******************************************************************************/
+static wiced_bt_gatt_status_t bt_app_write_inference(bt_app_conn_t *p_conn, uint8_t index,
+                                                     uint8_t *p_val, uint16_t len)
+{
+    if ( len < 1 )
+    {
+        return WICED_BT_GATT_INVALID_ATTR_LEN;
+    }
+
+    if (p_val[0]) {
+        ei_request_start_impulse(false);
+    }
+    else {
+        ei_request_stop_impulse();
+    }
+    return WICED_BT_GATT_SUCCESS;
+}
+
+static wiced_bt_gatt_status_t bt_app_write_cccd(bt_app_conn_t *p_conn, uint8_t index,
+                                                uint8_t *p_val, uint16_t len)
+{
+    if ( len != 2 )
+    {
+        return WICED_BT_GATT_INVALID_ATTR_LEN;
+    }
+
+    p_conn->cccd[index] = p_val[0];
+    return WICED_BT_GATT_SUCCESS;
+}
+
+static void bt_app_read_cccd(bt_app_conn_t *p_conn, uint8_t index, gatt_db_lookup_table_t *p_attr)
+{
+    /* the value of the central that reads */
+    p_attr->p_data[0] = p_conn->cccd[index];
+    p_attr->p_data[1] = 0;
+    p_attr->cur_len = 2;
+}
+
+static wiced_bt_gatt_status_t bt_app_write_raw_stream(bt_app_conn_t *p_conn, uint8_t index,
+                                                      uint8_t *p_val, uint16_t len)
+{
+    if (!ei_ble_stream_command((uint8_t)(p_conn - bt_conns), p_val, len))
+    {
+        return WICED_BT_GATT_WRITE_NOT_PERMIT;
+    }
+    return WICED_BT_GATT_SUCCESS;
+}
+
+static wiced_bt_gatt_status_t bt_app_write_control_point(bt_app_conn_t *p_conn, uint8_t index,
+                                                         uint8_t *p_val, uint16_t len)
+{
+    /* the response goes out as an indication to the writer */
+    if (GATT_CLIENT_CONFIG_INDICATION != p_conn->cccd[index])
+    {
+        return WICED_BT_GATT_CCC_CFG_ERR;
+    }
+    if (p_conn->indication_pending)
+    {
+        return WICED_BT_GATT_PRC_IN_PROGRESS;
+    }
+    ei_ble_control_command((uint8_t)(p_conn - bt_conns), p_val, len);
+    return WICED_BT_GATT_SUCCESS;
+}
+
+static wiced_bt_gatt_status_t bt_app_write_model_update(bt_app_conn_t *p_conn, uint8_t index,
+                                                        uint8_t *p_val, uint16_t len)
+{
+    /* same rules as the Control Point, the central waits for the DATA acks */
+    if (GATT_CLIENT_CONFIG_INDICATION != p_conn->cccd[index])
+    {
+        return WICED_BT_GATT_CCC_CFG_ERR;
+    }
+    if (p_conn->indication_pending)
+    {
+        return WICED_BT_GATT_PRC_IN_PROGRESS;
+    }
+    ei_ble_model_update_command((uint8_t)(p_conn - bt_conns), p_val, len);
+    return WICED_BT_GATT_SUCCESS;
+}
+
+/* Handles with an action on read or write, resolved into bt_app_attr_map
+ * by bt_app_build_attr_map() */
+static const bt_app_attr_handler_t bt_app_attr_handlers[] = {
+    { HDLC_EDGE_IMPULSE_INFERENCE_VALUE,                    INFERENCE,      NULL, bt_app_write_inference },
+    { HDLD_EDGE_IMPULSE_CLASS_RESULT_CLIENT_CHAR_CONFIG,    CLASS_RESULT,   bt_app_read_cccd, bt_app_write_cccd },
+    { HDLD_EDGE_IMPULSE_RESULT_RECORD_CLIENT_CHAR_CONFIG,   RESULT_RECORD,  bt_app_read_cccd, bt_app_write_cccd },
+    { HDLC_EDGE_IMPULSE_RAW_STREAM_VALUE,                   RAW_STREAM,     NULL, bt_app_write_raw_stream },
+    { HDLD_EDGE_IMPULSE_RAW_STREAM_CLIENT_CHAR_CONFIG,      RAW_STREAM,     bt_app_read_cccd, bt_app_write_cccd },
+    { HDLC_EDGE_IMPULSE_CONTROL_POINT_VALUE,                CONTROL_POINT,  NULL, bt_app_write_control_point },
+    { HDLD_EDGE_IMPULSE_CONTROL_POINT_CLIENT_CHAR_CONFIG,   CONTROL_POINT,  bt_app_read_cccd, bt_app_write_cccd },
+    { HDLC_EDGE_IMPULSE_MODEL_UPDATE_VALUE,                 MODEL_UPDATE,   NULL, bt_app_write_model_update },
+    { HDLD_EDGE_IMPULSE_MODEL_UPDATE_CLIENT_CHAR_CONFIG,    MODEL_UPDATE,   bt_app_read_cccd, bt_app_write_cccd },
+};
+
+/*******************************************************************************
+* Function Name: bt_app_build_attr_map
+********************************************************************************
+* Summary:
+*   Indexes app_gatt_db_ext_attr_tbl and bt_app_attr_handlers by handle, so
+*   every ATT request finds its attribute and callbacks in one array access.
+*
+* Return:
+*  bool : false if a handle does not fit in the map
+*
+*******************************************************************************/
+static bool bt_app_build_attr_map(void)
+{
+    for (int handle = 0; handle <= BT_APP_MAX_HANDLE; handle++)
+    {
+        bt_app_attr_map[handle].attr_ix = BT_APP_NO_ENTRY;
+        bt_app_attr_map[handle].handler_ix = BT_APP_NO_ENTRY;
+    }
+
+    for (int i = 0; i < app_gatt_db_ext_attr_tbl_size; i++)
+    {
+        uint16_t handle = app_gatt_db_ext_attr_tbl[i].handle;
+
+        if (handle > BT_APP_MAX_HANDLE || i >= BT_APP_NO_ENTRY)
+        {
+            ei_printf("GATT handle 0x%x does not fit the attribute map\r\n", handle);
+            return false;
+        }
+        bt_app_attr_map[handle].attr_ix = (uint8_t)i;
+    }
+
+    for (size_t i = 0; i < sizeof(bt_app_attr_handlers) / sizeof(bt_app_attr_handlers[0]); i++)
+    {
+        uint16_t handle = bt_app_attr_handlers[i].handle;
+
+        if (handle > BT_APP_MAX_HANDLE || BT_APP_NO_ENTRY == bt_app_attr_map[handle].attr_ix)
+        {
+            ei_printf("GATT handler for unknown handle 0x%x\r\n", handle);
+            return false;
+        }
+        bt_app_attr_map[handle].handler_ix = (uint8_t)i;
+    }
+
+    return true;
+}
+
+static const bt_app_attr_handler_t *bt_app_find_handler(uint16_t handle)
+{
+    if (handle > BT_APP_MAX_HANDLE || BT_APP_NO_ENTRY == bt_app_attr_map[handle].handler_ix)
+    {
+        return NULL;
+    }
+    return &bt_app_attr_handlers[bt_app_attr_map[handle].handler_ix];
+}
+
 /*******************************************************************************
 * Function Name: bt_app_gatt_req_write_value
 ********************************************************************************
 * Summary:
 * This function handles writing to the attribute handle in the GATT database
 * using the data passed from the BT stack. The value to write is stored in a
-* buffer whose starting address is passed as one of the function parameters
+* buffer whose starting address is passed as one of the function parameters,
+* then the write callback of the handle runs.
 *
 * Parameters:
+*  uint16_t conn_id          : Connection ID of the writer
 *  uint16_t attr_handle      : GATT attribute handle
 *  uint8_t p_val            : Pointer to BLE GATT write request value
 *  uint16_t len              : length of GATT write request
@@ -485,97 +793,45 @@ wiced_bt_gatt_status_t bt_app_gatt_req_read_by_type_handler(uint16_t conn_id,
 *  wiced_bt_gatt_status_t: Status codes in wiced_bt_gatt_status_e
 *
 *******************************************************************************/
-wiced_bt_gatt_status_t bt_app_gatt_req_write_value(uint16_t attr_handle,
+wiced_bt_gatt_status_t bt_app_gatt_req_write_value(uint16_t conn_id, uint16_t attr_handle,
                                                     uint8_t *p_val, uint16_t len)
 {
-    wiced_bt_gatt_status_t gatt_status  = WICED_BT_GATT_INVALID_HANDLE;
-    wiced_bool_t isHandleInTable = WICED_FALSE;
-    wiced_bool_t validLen = WICED_FALSE;
-    uint8_t *p_attr   = p_val;
+    gatt_db_lookup_table_t *puAttribute = bt_app_find_by_handle(attr_handle);
+    bt_app_conn_t *p_conn = bt_app_find_conn(conn_id);
+    const bt_app_attr_handler_t *handler;
 
-    /* Check for a matching handle entry */
-    for (int i = 0; i < app_gatt_db_ext_attr_tbl_size; i++)
+    if (NULL == p_conn)
     {
+        return WICED_BT_GATT_ERROR;
+    }
 
-        if (app_gatt_db_ext_attr_tbl[i].handle == attr_handle)
-        {
-            /* Detected a matching handle in external lookup table */
-            isHandleInTable = WICED_TRUE;
-
-            /* Check if the buffer has space to store the data */
-            validLen = (app_gatt_db_ext_attr_tbl[i].max_len >= len);
-
-            if (validLen)
-            {
-
-                /* Value fits within the supplied buffer; copy over the value */
-                app_gatt_db_ext_attr_tbl[i].cur_len = len;
-                memcpy(app_gatt_db_ext_attr_tbl[i].p_data, p_val, len);
-                gatt_status = WICED_BT_GATT_SUCCESS;
-
-                /* Add code for any action required when this attribute is written.
-                 * In this case, we Initialize the characteristic value */
-
-                switch ( attr_handle )
-                {
-                case HDLC_EDGE_IMPULSE_INFERENCE_VALUE:
-                    if (p_attr[0]) {
-                        ei_start_impulse(false, false);
-                    }
-                    else {
-                        ei_stop_impulse();
-                    }
-                    break;
-
-                case HDLD_EDGE_IMPULSE_CLASS_RESULT_CLIENT_CHAR_CONFIG:
-                    if ( len != 2 )
-                    {
-                        return WICED_BT_GATT_INVALID_ATTR_LEN;
-                    }
-
-                    app_edge_impulse_class_result_client_char_config[0] = p_attr[0];
-
-                    if(GATT_CLIENT_CONFIG_NOTIFICATION ==
-                               app_edge_impulse_class_result_client_char_config[0])
-                    {
-                        notify_enabled = NOTIFIY_ON;
-                    }
-                    else
-                    {
-                        notify_enabled = NOTIFIY_OFF;
-                    }
-                    break;
-                }
+    if (NULL == puAttribute)
+    {
+        /* The write operation was not performed for the
+         * indicated handle */
+        ei_printf("GATT write request to invalid handle: 0x%x\n", attr_handle);
+        return WICED_BT_GATT_WRITE_NOT_PERMIT;
+    }
 
-            }
-            else
-            {
-                /* Value to write does not meet size constraints */
-                gatt_status = WICED_BT_GATT_INVALID_HANDLE;
-                printf("GATT write request to invalid handle: 0x%x\r\n", attr_handle);
-            }
-            break;
-        }
+    /* Check if the buffer has space to store the data */
+    if (puAttribute->max_len < len)
+    {
+        /* Value to write does not meet size constraints */
+        ei_printf("GATT write request to invalid handle: 0x%x\r\n", attr_handle);
+        return WICED_BT_GATT_INVALID_HANDLE;
     }
 
-    if (!isHandleInTable)
+    /* Value fits within the supplied buffer; copy over the value */
+    puAttribute->cur_len = len;
+    memcpy(puAttribute->p_data, p_val, len);
+
+    handler = bt_app_find_handler(attr_handle);
+    if (NULL != handler && NULL != handler->on_write)
     {
-        /* TODO: Add code to read value for handles not contained within
-         * generated lookup table. This is a custom logic that depends on the
-         * application, and is not used in the current application. If the value
-         * for the current handle is successfully written in the below code
-         * snippet, then set the result using: res = WICED_BT_GATT_SUCCESS; */
-        switch(attr_handle)
-        {
-            default:
-                /* The write operation was not performed for the
-                    * indicated handle */
-                gatt_status = WICED_BT_GATT_WRITE_NOT_PERMIT;
-                printf("GATT write request to invalid handle: 0x%x\n", attr_handle);
-                break;
-        }
+        return handler->on_write(p_conn, handler->index, p_val, len);
     }
-    return gatt_status;
+
+    return WICED_BT_GATT_SUCCESS;
 }
 
 /*******************************************************************************
@@ -601,20 +857,20 @@ wiced_bt_gatt_status_t bt_app_gatt_req_write_handler(uint16_t conn_id,
 {
     wiced_bt_gatt_status_t status = WICED_BT_GATT_INVALID_HANDLE;
 
-    printf("bt_app_gatt_write_handler: conn_id:%d handle:0x%x offset:%d len:%d\r\n",
+    ei_printf("bt_app_gatt_write_handler: conn_id:%d handle:0x%x offset:%d len:%d\r\n",
                                                             conn_id,
                                                             p_write_req->handle,
                                                             p_write_req->offset,
                                                             p_write_req->val_len );
 
     /* Attempt to perform the Write Request */
-    status = bt_app_gatt_req_write_value(p_write_req->handle,
+    status = bt_app_gatt_req_write_value(conn_id, p_write_req->handle,
                                          p_write_req->p_val,
                                          p_write_req->val_len);
 
     if(WICED_BT_GATT_SUCCESS != status)
     {
-        printf("bt_app_gatt:GATT set attr status : 0x%x\n", status);
+        ei_printf("bt_app_gatt:GATT set attr status : 0x%x\n", status);
     }
 
     return (status);
@@ -642,6 +898,8 @@ wiced_bt_gatt_status_t bt_app_gatt_req_read_handler( uint16_t conn_id,
                                                     uint16_t len_req)
 {
     gatt_db_lookup_table_t  *puAttribute;
+    const bt_app_attr_handler_t *handler;
+    bt_app_conn_t *p_conn;
     int          attr_len_to_copy;
     uint8_t     *from;
     int          to_send;
@@ -653,9 +911,17 @@ wiced_bt_gatt_status_t bt_app_gatt_req_read_handler( uint16_t conn_id,
                                             WICED_BT_GATT_INVALID_HANDLE);
         return WICED_BT_GATT_INVALID_HANDLE;
     }
+
+    /* let the owner refresh the value first */
+    handler = bt_app_find_handler(p_read_req->handle);
+    p_conn = bt_app_find_conn(conn_id);
+    if (NULL != handler && NULL != handler->on_read && NULL != p_conn)
+    {
+        handler->on_read(p_conn, handler->index, puAttribute);
+    }
     attr_len_to_copy = puAttribute->cur_len;
 
-    printf("bt_app_gatt_read_handler: conn_id:%d handle:0x%x offset:%d len:%d\r\n",
+    ei_printf("bt_app_gatt_read_handler: conn_id:%d handle:0x%x offset:%d len:%d\r\n",
                                                     conn_id, p_read_req->handle,
                                                     p_read_req->offset,
                                                     attr_len_to_copy);
@@ -670,15 +936,6 @@ wiced_bt_gatt_status_t bt_app_gatt_req_read_handler( uint16_t conn_id,
     to_send = MIN(len_req, attr_len_to_copy - p_read_req->offset);
     from = ((uint8_t *)puAttribute->p_data) + p_read_req->offset;
 
-    switch ( p_read_req->handle )
-    {
-    case HDLC_EDGE_IMPULSE_CLASS_RESULT_VALUE:
-        /* Read class result */
-        break;
-    case HDLC_EDGE_IMPULSE_SETTINGS_VALUE:
-        break;
-    }
-
     /* No need for context, as buff not allocated */
     return wiced_bt_gatt_server_send_read_handle_rsp(conn_id, opcode, to_send,
                                                                     from, NULL);
@@ -704,39 +961,88 @@ wiced_bt_gatt_status_t bt_app_gatt_conn_status_cb(wiced_bt_gatt_connection_statu
 {
     wiced_bt_gatt_status_t status = WICED_BT_GATT_ERROR;
     wiced_result_t result = WICED_BT_ERROR;
+    bt_app_conn_t *p_conn;
 
     if ( NULL != p_conn_status )
     {
         if (p_conn_status->connected)
         {
             /* Device has connected */
-            printf("Bluetooth connected with device address:" );
+            ei_printf("Bluetooth connected with device address:" );
             bt_print_bd_address(p_conn_status->bd_addr);
-            printf("Bluetooth device connection id: 0x%x\r\n", p_conn_status->conn_id );
-            /* Store the connection ID */
-            bt_connection_id = p_conn_status->conn_id;
+            ei_printf("Bluetooth device connection id: 0x%x\r\n", p_conn_status->conn_id );
+
+            /* Take a free slot, new centrals start unsubscribed */
+            p_conn = NULL;
+            for (int i = 0; i < BT_APP_MAX_CONNECTIONS && NULL == p_conn; i++)
+            {
+                if (0 == bt_conns[i].conn_id)
+                {
+                    p_conn = &bt_conns[i];
+                }
+            }
+            if (NULL == p_conn)
+            {
+                ei_printf("No free connection slot, disconnecting\r\n");
+                wiced_bt_gatt_disconnect(p_conn_status->conn_id);
+                return WICED_BT_GATT_SUCCESS;
+            }
+
+            bt_app_lock();
+            memset(p_conn, 0, sizeof(*p_conn));
+            p_conn->conn_id = p_conn_status->conn_id;
+            p_conn->mtu = BT_DEFAULT_MTU_SIZE;
+            memcpy(p_conn->peer_addr, p_conn_status->bd_addr, sizeof(wiced_bt_device_address_t));
+            bt_app_unlock();
+
+            /* Ask for the larger MTU, 251 byte PDUs and 2M PHY, then the
+             * interval of the current mode */
+            bt_app_negotiate_link(p_conn);
           //  board_led_set_state(USER_LED1, LED_OFF);
         }
         else
         {
             /* Device has disconnected */
-            printf("Bluetooth disconnected with device address:" );
+            ei_printf("Bluetooth disconnected with device address:" );
             bt_print_bd_address(p_conn_status->bd_addr);
-            printf("Bluetooth device connection id: 0x%x\r\n", p_conn_status->conn_id );
-            /* Set the connection id to zero to indicate disconnected state */
-            bt_connection_id = 0;
+            ei_printf("Bluetooth device connection id: 0x%x\r\n", p_conn_status->conn_id );
 
-            /* Stop inference if it is running */
-            ei_stop_impulse();
+            p_conn = bt_app_find_conn(p_conn_status->conn_id);
+            if (NULL != p_conn)
+            {
+                uint8_t conn = (uint8_t)(p_conn - bt_conns);
+
+                /* Free the slot first, nothing is sent to this central anymore */
+                bt_app_lock();
+                p_conn->conn_id = 0;
+                p_conn->indication_pending = false;
+                bt_app_unlock();
+
+                /* Drop the results queued for this central, stop its stream and
+                 * an unfinished model transfer, the other centrals carry on */
+                ei_ble_results_reset(conn);
+                ei_ble_stream_reset(conn);
+                ei_ble_model_update_abort(conn);
+            }
 
-            /* Restart the advertisements */
+            /* Stop inference when the last central is gone */
+            if (0 == bt_app_conn_count())
+            {
+                ei_request_stop_impulse();
+            }
+           // board_led_set_blink(USER_LED1, BLINK_SLOW);
+        }
+
+        /* Keep advertising while a slot is free (the stack stops on connect) */
+        if (bt_app_conn_count() < BT_APP_MAX_CONNECTIONS &&
+            BTM_BLE_ADVERT_OFF == wiced_bt_ble_get_current_advert_mode())
+        {
             result = wiced_bt_start_advertisements(BTM_BLE_ADVERT_UNDIRECTED_HIGH, 0, NULL);
             /* Failed to start advertisement. Stop program execution */
             if (CY_RSLT_SUCCESS != result)
             {
                 CY_ASSERT(0);
             }
-           // board_led_set_blink(USER_LED1, BLINK_SLOW);
         }
         status = WICED_BT_GATT_SUCCESS;
     }
@@ -748,7 +1054,7 @@ wiced_bt_gatt_status_t bt_app_gatt_conn_status_cb(wiced_bt_gatt_connection_statu
  * Function Name: bt_app_free_buffer
  *******************************************************************************
  * Summary:
- *  This function frees up the memory buffer
+ *  This function returns the memory buffer to the BLE buffer pool
  *
  * Parameters:
  *  uint8_t *p_data: Pointer to the buffer to be free
@@ -759,15 +1065,15 @@ wiced_bt_gatt_status_t bt_app_gatt_conn_status_cb(wiced_bt_gatt_connection_statu
  ******************************************************************************/
 void bt_app_free_buffer(uint8_t *p_buf)
 {
-    vPortFree(p_buf);
+    ei_ble_buffer_free(p_buf);
 }
 
 /*******************************************************************************
  * Function Name: bt_app_alloc_buffer
  *******************************************************************************
  * Summary:
- *  This function allocates a memory buffer.
- *
+ *  This function allocates a memory buffer from the BLE buffer pool, the
+ *  heap is only used when the pool is exhausted.
  *
  * Parameters:
  *  int len: Length to allocate
@@ -778,14 +1084,14 @@ void bt_app_free_buffer(uint8_t *p_buf)
  ******************************************************************************/
 void* bt_app_alloc_buffer(int len)
 {
-    return pvPortMalloc(len);
+    return ei_ble_buffer_alloc(len);
 }
 
 /*******************************************************************************
  * Function Name : bt_app_find_by_handle
  * *****************************************************************************
  * Summary :
- *    Find attribute description by handle
+ *    Find attribute description by handle (bt_app_attr_map, built in bt_app_init)
  *
  * Parameters:
  *  uint16_t handle    handle to look up
@@ -796,57 +1102,319 @@ void* bt_app_alloc_buffer(int len)
  ******************************************************************************/
 gatt_db_lookup_table_t  *bt_app_find_by_handle(uint16_t handle)
 {
-    for (uint8_t i = 0; i < app_gatt_db_ext_attr_tbl_size; i++)
+    if (handle > BT_APP_MAX_HANDLE || BT_APP_NO_ENTRY == bt_app_attr_map[handle].attr_ix)
     {
-        if (handle == app_gatt_db_ext_attr_tbl[i].handle)
-        {
-            return (&app_gatt_db_ext_attr_tbl[i]);
-        }
+        return NULL;
+    }
+    return &app_gatt_db_ext_attr_tbl[bt_app_attr_map[handle].attr_ix];
+}
+
+/*******************************************************************************
+* Function Name: bt_app_get_notification_max_len
+********************************************************************************
+* Summary: Largest value that fits in one notification on a connection.
+*
+* Parameters:
+*  uint8_t conn    : connection slot
+*
+* Return:
+*  uint16_t : ATT MTU - 3 (opcode and handle)
+*
+*******************************************************************************/
+uint16_t bt_app_get_notification_max_len(uint8_t conn)
+{
+    bt_app_conn_t *p_conn = bt_app_get_conn(conn);
+
+    return ((NULL != p_conn) ? p_conn->mtu : BT_DEFAULT_MTU_SIZE) - 3;
+}
+
+/*******************************************************************************
+* Function Name: bt_app_notification_enabled
+********************************************************************************
+* Summary: Checks if a central is connected and subscribed to a characteristic.
+*
+* Parameters:
+*  uint8_t conn    : connection slot
+*  uint8_t index   : characteristic index (ble_char_index)
+*
+* Return:
+*  bool : true if notifications (indications for the Control Point and
+*         Model Update) of the characteristic are enabled
+*
+*******************************************************************************/
+bool bt_app_notification_enabled(uint8_t conn, uint8_t index)
+{
+    bt_app_conn_t *p_conn = bt_app_get_conn(conn);
+
+    if(NULL == p_conn)
+    {
+        return false;
+    }
+
+    switch(index)
+    {
+    case CLASS_RESULT:
+    case RESULT_RECORD:
+    case RAW_STREAM:
+        return (GATT_CLIENT_CONFIG_NOTIFICATION == p_conn->cccd[index]);
+    case CONTROL_POINT:
+    case MODEL_UPDATE:
+        return (GATT_CLIENT_CONFIG_INDICATION == p_conn->cccd[index]);
+    default:
+        return false;
     }
-    return NULL;
 }
 
 /*******************************************************************************
 * Function Name: bt_app_send_notification
 ********************************************************************************
-* Summary: Sends GATT notification.
+* Summary: Sends GATT notification to one central. The value is also stored
+*          in the characteristic, so reads return the last notified value.
 *
- * Parameters:
- *  uint8_t index   : index of the sensor
+* Parameters:
+*  uint8_t conn         : connection slot
+*  uint8_t index        : characteristic index (ble_char_index)
+*  uint8_t *p_data      : value to send, owned by the stack until transmitted
+*  uint16_t len         : bytes to send
+*  on_transmitted       : called with p_data on GATT_APP_BUFFER_TRANSMITTED_EVT
 *
 * Return:
-*  None
+*  bool : true if the stack accepted the notification
 *
 *******************************************************************************/
-void bt_app_send_notification(uint8_t index)
+bool bt_app_send_notification(uint8_t conn, uint8_t index, uint8_t *p_data, uint16_t len,
+                              bt_app_transmitted_cb_t on_transmitted)
 {
     wiced_bt_gatt_status_t status = WICED_BT_GATT_ERROR;
+    gatt_db_lookup_table_t *puAttribute;
+    uint16_t conn_id;
+    uint16_t handle;
 
     switch(index)
     {
-
     case CLASS_RESULT:
+        handle = HDLC_EDGE_IMPULSE_CLASS_RESULT_VALUE;
+        break;
+    case RESULT_RECORD:
+        handle = HDLC_EDGE_IMPULSE_RESULT_RECORD_VALUE;
+        break;
+    case RAW_STREAM:
+        handle = HDLC_EDGE_IMPULSE_RAW_STREAM_VALUE;
+        break;
+    default:
+        return false;
+    }
 
-       if((GATT_CLIENT_CONFIG_NOTIFICATION == \
-                            app_edge_impulse_class_result_client_char_config[0])
-                            && (0 != bt_connection_id))
-        {
-            /* Motion data to be send*/
-        status = wiced_bt_gatt_server_send_notification(
-                                bt_connection_id,
-                                HDLC_EDGE_IMPULSE_CLASS_RESULT_VALUE,
-                                app_gatt_db_ext_attr_tbl[2].cur_len,
-                                app_gatt_db_ext_attr_tbl[2].p_data,NULL);
-
-        if(WICED_BT_GATT_SUCCESS != status)
-        {
-            printf("Sending class result notification failed %d \r\n", status);
-        }
+    if(!bt_app_notification_enabled(conn, index))
+    {
+        return false;
+    }
+    conn_id = bt_conns[conn].conn_id;
 
-        }
+    puAttribute = bt_app_find_by_handle(handle);
+    if(NULL == puAttribute)
+    {
+        return false;
+    }
+
+    if(len > puAttribute->max_len)
+    {
+        len = puAttribute->max_len;
+    }
+    memcpy(puAttribute->p_data, p_data, len);
+    puAttribute->cur_len = len;
+
+    status = wiced_bt_gatt_server_send_notification(conn_id, handle, len, p_data,
+                                                    (wiced_bt_gatt_app_context_t)on_transmitted);
+
+    if(WICED_BT_GATT_SUCCESS != status)
+    {
+        ei_printf("Sending notification 0x%x failed %d \r\n", handle, status);
+        return false;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: bt_app_send_indication
+********************************************************************************
+* Summary: Sends GATT indication to one central. The value is copied into the
+*          characteristic, so the caller's buffer is free on return and reads
+*          return the last indicated value.
+*
+* Parameters:
+*  uint8_t conn         : connection slot
+*  uint8_t index        : characteristic index (ble_char_index)
+*  uint8_t *p_data      : value to send
+*  uint16_t len         : bytes to send
+*
+* Return:
+*  bool : true if the stack accepted the indication
+*
+*******************************************************************************/
+bool bt_app_send_indication(uint8_t conn, uint8_t index, const uint8_t *p_data, uint16_t len)
+{
+    wiced_bt_gatt_status_t status = WICED_BT_GATT_ERROR;
+    gatt_db_lookup_table_t *puAttribute;
+    bt_app_conn_t *p_conn;
+    uint16_t handle;
+
+    switch(index)
+    {
+    case CONTROL_POINT:
+        handle = HDLC_EDGE_IMPULSE_CONTROL_POINT_VALUE;
+        break;
+    case MODEL_UPDATE:
+        handle = HDLC_EDGE_IMPULSE_MODEL_UPDATE_VALUE;
         break;
+    default:
+        return false;
+    }
+
+    if(!bt_app_notification_enabled(conn, index) || bt_conns[conn].indication_pending)
+    {
+        return false;
     }
+    p_conn = &bt_conns[conn];
 
+    puAttribute = bt_app_find_by_handle(handle);
+    if(NULL == puAttribute)
+    {
+        return false;
+    }
+
+    if(len > puAttribute->max_len)
+    {
+        len = puAttribute->max_len;
+    }
+    memcpy(puAttribute->p_data, p_data, len);
+    puAttribute->cur_len = len;
+
+    p_conn->indication_pending = true;
+    status = wiced_bt_gatt_server_send_indication(p_conn->conn_id, handle, len,
+                                                  puAttribute->p_data, NULL);
+
+    if(WICED_BT_GATT_SUCCESS != status)
+    {
+        p_conn->indication_pending = false;
+        ei_printf("Sending indication 0x%x failed %d \r\n", handle, status);
+        return false;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: bt_app_request_conn_params
+********************************************************************************
+* Summary: Asks the central for the connection parameters of a link mode.
+*
+*******************************************************************************/
+static void bt_app_request_conn_params(bt_app_conn_t *p_conn, bt_link_mode_t mode)
+{
+    const bt_conn_params_t *params = &bt_link_params[mode];
+
+    if (!wiced_bt_l2cap_update_ble_conn_params(p_conn->peer_addr, params->min_interval,
+                                               params->max_interval, params->latency,
+                                               params->timeout))
+    {
+        ei_printf("Connection parameter update request failed\r\n");
+    }
+}
+
+/*******************************************************************************
+* Function Name: bt_app_negotiate_link
+********************************************************************************
+* Summary: Requests the larger ATT MTU, Data Length Extension and 2M PHY after
+*          connecting. The central may refuse any of them, the link then keeps
+*          running with what it accepted (GATT_OPERATION_CPLT_EVT and
+*          BTM_BLE_PHY_UPDATE_EVT report the outcome).
+*
+*******************************************************************************/
+static void bt_app_negotiate_link(bt_app_conn_t *p_conn)
+{
+    wiced_bt_ble_phy_preferences_t phy_preferences;
+    wiced_bt_gatt_status_t gatt_status;
+    wiced_result_t result;
+
+    gatt_status = wiced_bt_gatt_client_configure_mtu(p_conn->conn_id, CY_BT_MTU_SIZE);
+    if (WICED_BT_GATT_SUCCESS != gatt_status)
+    {
+        ei_printf("MTU exchange request failed %d\r\n", gatt_status);
+    }
+
+    result = wiced_bt_ble_set_data_packet_length(p_conn->peer_addr, BT_DLE_TX_PDU_LEN, BT_DLE_TX_TIME_US);
+    if (WICED_BT_SUCCESS != result)
+    {
+        ei_printf("Data length request failed %d\r\n", result);
+    }
+
+    memcpy(phy_preferences.remote_bd_addr, p_conn->peer_addr, sizeof(wiced_bt_device_address_t));
+    phy_preferences.allowed_tx_phys = BTM_BLE_PREFER_2M_PHY;
+    phy_preferences.allowed_rx_phys = BTM_BLE_PREFER_2M_PHY;
+    phy_preferences.phy_opts = BTM_BLE_PREFER_CODED_PHY_NONE;
+    result = wiced_bt_ble_set_phy(&phy_preferences);
+    if (WICED_BT_SUCCESS != result)
+    {
+        ei_printf("2M PHY request failed %d\r\n", result);
+    }
+
+    bt_app_request_conn_params(p_conn, bt_link_mode);
+}
+
+/*******************************************************************************
+* Function Name: bt_app_set_link_mode
+********************************************************************************
+* Summary: Selects the connection parameters for what the application is doing.
+*          Applied right away to every connected central, otherwise on the
+*          next connection.
+*
+* Parameters:
+*  bt_link_mode_t mode : idle, inference results or raw data streaming
+*
+*******************************************************************************/
+void bt_app_set_link_mode(bt_link_mode_t mode)
+{
+    if (mode == bt_link_mode || mode > BT_LINK_STREAMING)
+    {
+        return;
+    }
+
+    bt_link_mode = mode;
+
+    for (int i = 0; i < BT_APP_MAX_CONNECTIONS; i++)
+    {
+        if (0 != bt_conns[i].conn_id)
+        {
+            bt_app_request_conn_params(&bt_conns[i], mode);
+        }
+    }
+}
+
+bt_link_mode_t bt_app_get_link_mode(void)
+{
+    return bt_link_mode;
+}
+
+/*******************************************************************************
+* Function Name: bt_app_lock / bt_app_unlock
+********************************************************************************
+* Summary: Guard state shared between the BT stack task and the application.
+*
+*******************************************************************************/
+void bt_app_lock(void)
+{
+#ifdef FREERTOS_ENABLED
+    taskENTER_CRITICAL();
+#endif
+}
+
+void bt_app_unlock(void)
+{
+#ifdef FREERTOS_ENABLED
+    taskEXIT_CRITICAL();
+#endif
 }
 
 /*******************************************************************************
@@ -866,7 +1434,7 @@ void bt_print_bd_address(wiced_bt_device_address_t bdadr)
 {
     for(uint8_t i=0;i<BD_ADDR_LEN-1;i++)
     {
-        printf("%02X:",bdadr[i]);
+        ei_printf("%02X:",bdadr[i]);
     }
-    printf("%02X\n",bdadr[BD_ADDR_LEN-1]);
+    ei_printf("%02X\n",bdadr[BD_ADDR_LEN-1]);
 }
@@ -17,27 +17,52 @@
 #ifndef EI_BLUETOOTH_PSOC63_H_
 #define EI_BLUETOOTH_PSOC63_H_
 
-#include "cy_pdl.h"
-#include "cyhal.h"
-#include "cybsp.h"
-#include "cy_retarget_io.h"
-
-
-/* BLE stack for Infineon PSoC 6 requires FreeRTOS */
-#ifdef FREERTOS_ENABLED
-#include <FreeRTOS.h>
-#include <timers.h>
-#endif
+#include <stdint.h>
+#include "cy_result.h"
 
 enum ble_char_index
 {
     CLASS_RESULT = 0,
     INFERENCE = 1,
-    SETTINGS = 2
+    SETTINGS = 2,
+    RESULT_RECORD = 3,
+    RAW_STREAM = 4,
+    CONTROL_POINT = 5,
+    MODEL_UPDATE = 6
 };
 
+/* what the link is used for, selects the connection parameters */
+typedef enum
+{
+    BT_LINK_IDLE = 0,
+    BT_LINK_RESULTS,
+    BT_LINK_STREAMING
+} bt_link_mode_t;
+
+/* centrals served at the same time (phone + gateway), MaxClientsConnections
+ * in configs/design.cybt. Functions below take a connection slot
+ * 0..BT_APP_MAX_CONNECTIONS - 1, each with its own subscriptions and MTU */
+#define BT_APP_MAX_CONNECTIONS  2
+
+/* called from the BT stack task when a notification buffer has been sent */
+typedef void (*bt_app_transmitted_cb_t)(uint8_t *p_data);
+
 cy_rslt_t ei_bluetooth_init(void);
-void bt_app_send_notification(uint8_t index);
+/* connected and the central subscribed to the characteristic */
+bool bt_app_notification_enabled(uint8_t conn, uint8_t index);
+/* p_data must stay valid until on_transmitted is called with it */
+bool bt_app_send_notification(uint8_t conn, uint8_t index, uint8_t *p_data, uint16_t len,
+                              bt_app_transmitted_cb_t on_transmitted);
+/* indications are copied, false while the last one is not yet confirmed */
+bool bt_app_send_indication(uint8_t conn, uint8_t index, const uint8_t *p_data, uint16_t len);
+/* largest notification value for a connection (ATT MTU - 3) */
+uint16_t bt_app_get_notification_max_len(uint8_t conn);
+/* request the connection parameters of a mode (now if connected, else on connect) */
+void bt_app_set_link_mode(bt_link_mode_t mode);
+bt_link_mode_t bt_app_get_link_mode(void);
+/* guard for state shared with the BT stack task */
+void bt_app_lock(void);
+void bt_app_unlock(void);
 
 
 #endif /* EI_BLUETOOTH_PSOC63_H_ */
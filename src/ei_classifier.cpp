@@ -0,0 +1,503 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+
+#include "model-parameters/model_metadata.h"
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "ei_classifier.h"
+
+/******
+ *
+ * @brief Classifier translation unit, batched and resident inference.
+ *        process_impulse() sets up and tears down the NN for every window,
+ *        a batch does that once for all windows, the resident mode once
+ *        until ei_classifier_release().
+ *
+ ******/
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+#define EI_CLASSIFIER_BATCH_EON     1
+#elif (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE)
+#define EI_CLASSIFIER_BATCH_TFLM    1
+#endif
+
+/* Copies of the learning blocks that run on the NN set up by nn_setup() */
+static ei_learning_block_t batch_blocks[ei_learning_blocks_size];
+static bool nn_ready = false;
+static ei_classifier_nn_mode_t nn_mode = EI_CLASSIFIER_NN_PER_WINDOW;
+static ei_classifier_nn_stats_t nn_stats = { 0, 0, false };
+
+#if EI_CLASSIFIER_BATCH_EON
+/* The EON graph init/reset are no-ops in the copies, the graphs are
+ * initialised in nn_setup() and reset in nn_teardown()
+ */
+static ei_learning_block_config_tflite_graph_t batch_block_configs[ei_learning_blocks_size];
+static ei_config_tflite_eon_graph_t batch_graph_configs[ei_learning_blocks_size];
+#endif
+
+#if EI_CLASSIFIER_BATCH_TFLM
+/* One interpreter per learning block, with the op resolver and the arena
+ * planned by AllocateTensors() kept between windows
+ */
+typedef struct {
+    const unsigned char *model;
+    tflite::MicroInterpreter *interpreter;
+    uint8_t *arena;
+} resident_graph_t;
+
+static resident_graph_t resident_graphs[ei_learning_blocks_size];
+#endif
+
+/* Recording and window offset for run_classifier_batch_strided() */
+static signal_t *batch_recording = NULL;
+static size_t batch_offset = 0;
+
+/***************************************
+ *        NN setup
+ **************************************/
+
+#if EI_CLASSIFIER_BATCH_EON
+static TfLiteStatus batch_model_init(void*(*alloc_fnc)(size_t, size_t))
+{
+    (void)alloc_fnc;
+    return kTfLiteOk;
+}
+
+static TfLiteStatus batch_model_reset(void (*free_fnc)(void* ptr))
+{
+    (void)free_fnc;
+    return kTfLiteOk;
+}
+
+static void nn_teardown(void)
+{
+    for (size_t ix = 0; ix < ei_learning_blocks_size; ix++) {
+        if (batch_blocks[ix].config != &batch_block_configs[ix]) {
+            continue;
+        }
+
+        const ei_learning_block_config_tflite_graph_t *block_config =
+            (const ei_learning_block_config_tflite_graph_t *)ei_learning_blocks[ix].config;
+        const ei_config_tflite_eon_graph_t *graph_config =
+            (const ei_config_tflite_eon_graph_t *)block_config->graph_config;
+
+        graph_config->model_reset(ei_aligned_free);
+        batch_blocks[ix].config = NULL;
+    }
+}
+
+static EI_IMPULSE_ERROR nn_setup(void)
+{
+    uint64_t start_us = ei_read_timer_us();
+
+    for (size_t ix = 0; ix < ei_learning_blocks_size; ix++) {
+        batch_blocks[ix] = ei_learning_blocks[ix];
+
+        if (batch_blocks[ix].infer_fn != &run_nn_inference) {
+            continue;
+        }
+
+        const ei_learning_block_config_tflite_graph_t *block_config =
+            (const ei_learning_block_config_tflite_graph_t *)ei_learning_blocks[ix].config;
+        const ei_config_tflite_eon_graph_t *graph_config =
+            (const ei_config_tflite_eon_graph_t *)block_config->graph_config;
+
+        if (graph_config->model_init(ei_aligned_calloc) != kTfLiteOk) {
+            ei_printf("ERR: Failed to allocate TFLite arena\n");
+            // release the graphs set up so far
+            batch_blocks[ix].config = NULL;
+            nn_teardown();
+            return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
+        }
+
+        batch_graph_configs[ix] = *graph_config;
+        batch_graph_configs[ix].model_init = &batch_model_init;
+        batch_graph_configs[ix].model_reset = &batch_model_reset;
+        batch_block_configs[ix] = *block_config;
+        batch_block_configs[ix].graph_config = (void *)&batch_graph_configs[ix];
+        batch_blocks[ix].config = (void *)&batch_block_configs[ix];
+    }
+
+    nn_stats.setups++;
+    nn_stats.setup_us = (uint32_t)(ei_read_timer_us() - start_us);
+
+    return EI_IMPULSE_OK;
+}
+#elif EI_CLASSIFIER_BATCH_TFLM
+static tflite::MicroOpResolver *resident_resolver(void)
+{
+#ifdef EI_TFLITE_RESOLVER
+    // the generated resolver is a static, its ops are added once
+    static bool resolver_ready = false;
+    static tflite::MicroOpResolver *op_resolver = NULL;
+    if (resolver_ready == false) {
+        EI_TFLITE_RESOLVER
+        op_resolver = &resolver;
+        resolver_ready = true;
+    }
+    return op_resolver;
+#else
+    static tflite::AllOpsResolver resolver;
+    return &resolver;
+#endif
+}
+
+static void graph_teardown(resident_graph_t *graph)
+{
+    if (graph->interpreter != NULL) {
+        delete graph->interpreter;
+        graph->interpreter = NULL;
+    }
+    if (graph->arena != NULL) {
+        ei_aligned_free(graph->arena);
+        graph->arena = NULL;
+    }
+    graph->model = NULL;
+}
+
+/* map the model, build the interpreter and plan the arena, once per model */
+static EI_IMPULSE_ERROR graph_setup(resident_graph_t *graph, const ei_config_tflite_graph_t *graph_config)
+{
+    uint64_t start_us = ei_read_timer_us();
+
+    graph_teardown(graph);
+
+    const tflite::Model *model = tflite::GetModel(graph_config->model);
+    if (model->version() != TFLITE_SCHEMA_VERSION) {
+        ei_printf("ERR: Model schema version %d, supported version %d\n",
+            (int)model->version(), TFLITE_SCHEMA_VERSION);
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+
+    graph->arena = (uint8_t *)ei_aligned_calloc(16, graph_config->arena_size);
+    if (graph->arena == NULL) {
+        ei_printf("ERR: Failed to allocate TFLite arena (%u bytes)\n", (unsigned int)graph_config->arena_size);
+        return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
+    }
+
+    graph->interpreter = new tflite::MicroInterpreter(model, *resident_resolver(), graph->arena,
+        graph_config->arena_size, error_reporter);
+
+    if (graph->interpreter->AllocateTensors() != kTfLiteOk) {
+        ei_printf("ERR: AllocateTensors() failed\n");
+        graph_teardown(graph);
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+
+    graph->model = graph_config->model;
+    nn_stats.setups++;
+    nn_stats.setup_us = (uint32_t)(ei_read_timer_us() - start_us);
+
+    return EI_IMPULSE_OK;
+}
+
+/* run_nn_inference() on the resident interpreter: only Invoke() per window */
+static EI_IMPULSE_ERROR resident_nn_inference(
+    const ei_impulse_t *impulse,
+    ei::matrix_t *fmatrix,
+    ei_impulse_result_t *result,
+    void *config_ptr,
+    bool debug)
+{
+    ei_learning_block_config_tflite_graph_t *block_config = (ei_learning_block_config_tflite_graph_t *)config_ptr;
+    const ei_config_tflite_graph_t *graph_config = (const ei_config_tflite_graph_t *)block_config->graph_config;
+    resident_graph_t *graph = NULL;
+    uint64_t ctx_start_us = ei_read_timer_us();
+
+    for (size_t ix = 0; ix < ei_learning_blocks_size; ix++) {
+        if (ei_learning_blocks[ix].config == config_ptr) {
+            graph = &resident_graphs[ix];
+        }
+    }
+    if (graph == NULL) {
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+
+    // a model swapped at runtime is set up on its first window
+    if (graph->interpreter == NULL || graph->model != graph_config->model) {
+        EI_IMPULSE_ERROR res = graph_setup(graph, graph_config);
+        if (res != EI_IMPULSE_OK) {
+            return res;
+        }
+    }
+
+    tflite::MicroInterpreter *interpreter = graph->interpreter;
+    TfLiteTensor *output_labels = NULL;
+    TfLiteTensor *output_scores = NULL;
+
+    EI_IMPULSE_ERROR input_res = fill_input_tensor_from_matrix(fmatrix, interpreter->input(0));
+    if (input_res != EI_IMPULSE_OK) {
+        return input_res;
+    }
+
+    TfLiteStatus invoke_status = interpreter->Invoke();
+    if (invoke_status != kTfLiteOk) {
+        ei_printf("ERR: Invoke failed (%d)\n", invoke_status);
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+
+    result->timing.classification_us = ei_read_timer_us() - ctx_start_us;
+    result->timing.classification = (int)(result->timing.classification_us / 1000);
+
+    if (debug) {
+        ei_printf("Predictions (time: %d ms.):\n", result->timing.classification);
+    }
+
+    if (block_config->object_detection_last_layer == EI_CLASSIFIER_LAST_LAYER_SSD) {
+        output_scores = interpreter->output(block_config->output_score_tensor);
+        output_labels = interpreter->output(block_config->output_labels_tensor);
+    }
+
+    EI_IMPULSE_ERROR fill_res = fill_result_struct_from_output_tensor_tflite(impulse,
+        interpreter->output(block_config->output_data_tensor), output_labels, output_scores, result, debug);
+    if (fill_res != EI_IMPULSE_OK) {
+        return fill_res;
+    }
+
+    return ei_run_impulse_check_canceled();
+}
+
+static void nn_teardown(void)
+{
+    for (size_t ix = 0; ix < ei_learning_blocks_size; ix++) {
+        graph_teardown(&resident_graphs[ix]);
+    }
+}
+
+static EI_IMPULSE_ERROR nn_setup(void)
+{
+    // the interpreters are set up on their first window, so the model can change
+    for (size_t ix = 0; ix < ei_learning_blocks_size; ix++) {
+        batch_blocks[ix] = ei_learning_blocks[ix];
+
+        if (batch_blocks[ix].infer_fn == &run_nn_inference) {
+            batch_blocks[ix].infer_fn = &resident_nn_inference;
+        }
+    }
+
+    return EI_IMPULSE_OK;
+}
+#else
+static void nn_teardown(void)
+{
+}
+
+static EI_IMPULSE_ERROR nn_setup(void)
+{
+    // no setup to share with this inferencing engine
+    for (size_t ix = 0; ix < ei_learning_blocks_size; ix++) {
+        batch_blocks[ix] = ei_learning_blocks[ix];
+    }
+
+    return EI_IMPULSE_OK;
+}
+#endif
+
+static EI_IMPULSE_ERROR batch_begin(ei_impulse_t *impulse)
+{
+    if (nn_ready == false) {
+        EI_IMPULSE_ERROR res = nn_setup();
+        if (res != EI_IMPULSE_OK) {
+            return res;
+        }
+        nn_ready = true;
+    }
+
+    impulse->learning_blocks = batch_blocks;
+
+    return EI_IMPULSE_OK;
+}
+
+/* the resident NN stays set up after a batch */
+static void batch_end(void)
+{
+    if (nn_mode != EI_CLASSIFIER_NN_RESIDENT) {
+        ei_classifier_release();
+    }
+}
+
+static int batch_window_get_data(size_t offset, size_t length, float *out_ptr)
+{
+    return batch_recording->get_data(batch_offset + offset, length, out_ptr);
+}
+
+/***************************************
+ *        Public functions
+ **************************************/
+
+EI_IMPULSE_ERROR run_classifier_batch(
+    signal_t *signals,
+    size_t n,
+    ei_impulse_result_t *results,
+    bool debug)
+{
+    ei_impulse_t impulse = ei_default_impulse;
+
+    EI_IMPULSE_ERROR res = batch_begin(&impulse);
+    if (res != EI_IMPULSE_OK) {
+        return res;
+    }
+
+    for (size_t ix = 0; ix < n; ix++) {
+        res = process_impulse(&impulse, &signals[ix], &results[ix], debug);
+        if (res != EI_IMPULSE_OK) {
+            ei_printf("ERR: Failed to classify window %u (%d)\n", (unsigned int)ix, res);
+            break;
+        }
+    }
+
+    batch_end();
+
+    return res;
+}
+
+EI_IMPULSE_ERROR run_classifier_batch_strided(
+    signal_t *recording,
+    size_t stride,
+    ei_impulse_result_t *results,
+    size_t max_results,
+    size_t *n_results,
+    bool debug)
+{
+    ei_impulse_t impulse = ei_default_impulse;
+    size_t frame_size;
+    size_t step;
+
+    *n_results = 0;
+
+    if (stride == 0) {
+        ei_printf("ERR: Window stride can't be 0\n");
+        return EI_IMPULSE_INVALID_SIZE;
+    }
+
+    EI_IMPULSE_ERROR res = batch_begin(&impulse);
+    if (res != EI_IMPULSE_OK) {
+        return res;
+    }
+
+    frame_size = impulse.dsp_input_frame_size;
+    step = stride * impulse.raw_samples_per_frame;
+    batch_recording = recording;
+
+    for (batch_offset = 0; batch_offset + frame_size <= recording->total_length; batch_offset += step) {
+        if (*n_results >= max_results) {
+            break;
+        }
+
+        signal_t window;
+        window.total_length = frame_size;
+        window.get_data = &batch_window_get_data;
+
+        res = process_impulse(&impulse, &window, &results[*n_results], debug);
+        if (res != EI_IMPULSE_OK) {
+            ei_printf("ERR: Failed to classify window %u (%d)\n", (unsigned int)*n_results, res);
+            break;
+        }
+
+        (*n_results)++;
+    }
+
+    batch_recording = NULL;
+    batch_end();
+
+    return res;
+}
+
+EI_IMPULSE_ERROR ei_classifier_run(signal_t *signal, ei_impulse_result_t *result, bool debug)
+{
+    if (nn_mode != EI_CLASSIFIER_NN_RESIDENT) {
+        return run_classifier(signal, result, debug);
+    }
+
+    ei_impulse_t impulse = ei_default_impulse;
+
+    EI_IMPULSE_ERROR res = batch_begin(&impulse);
+    if (res != EI_IMPULSE_OK) {
+        return res;
+    }
+
+    return process_impulse(&impulse, signal, result, debug);
+}
+
+EI_IMPULSE_ERROR ei_classifier_run_continuous(signal_t *signal, ei_impulse_result_t *result, bool debug)
+{
+    if (nn_mode != EI_CLASSIFIER_NN_RESIDENT) {
+        return run_classifier_continuous(signal, result, debug);
+    }
+
+    ei_impulse_t impulse = ei_default_impulse;
+
+    EI_IMPULSE_ERROR res = batch_begin(&impulse);
+    if (res != EI_IMPULSE_OK) {
+        return res;
+    }
+
+    return process_impulse_continuous(&impulse, signal, result, debug, true);
+}
+
+void ei_classifier_release(void)
+{
+    if (nn_ready) {
+        nn_teardown();
+        nn_ready = false;
+    }
+}
+
+void ei_classifier_set_nn_mode(ei_classifier_nn_mode_t mode)
+{
+    nn_mode = mode;
+
+    if (mode != EI_CLASSIFIER_NN_RESIDENT) {
+        ei_classifier_release();
+    }
+}
+
+ei_classifier_nn_mode_t ei_classifier_get_nn_mode(void)
+{
+    return nn_mode;
+}
+
+const char *ei_classifier_nn_mode_name(ei_classifier_nn_mode_t mode)
+{
+    switch (mode) {
+        case EI_CLASSIFIER_NN_PER_WINDOW:
+            return "window";
+        case EI_CLASSIFIER_NN_RESIDENT:
+            return "resident";
+        default:
+            return "unknown";
+    }
+}
+
+bool ei_classifier_nn_mode_from_name(const char *name, ei_classifier_nn_mode_t *out)
+{
+    for (int ix = EI_CLASSIFIER_NN_PER_WINDOW; ix <= EI_CLASSIFIER_NN_RESIDENT; ix++) {
+        if (strcmp(name, ei_classifier_nn_mode_name((ei_classifier_nn_mode_t)ix)) == 0) {
+            *out = (ei_classifier_nn_mode_t)ix;
+            return true;
+        }
+    }
+
+    ei_printf("ERR: Unknown NN mode %s (window, resident)\n", name);
+    return false;
+}
+
+void ei_classifier_get_nn_stats(ei_classifier_nn_stats_t *stats)
+{
+    *stats = nn_stats;
+    stats->resident = nn_ready;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_CLASSIFIER_H
+#define EI_CLASSIFIER_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include <cstddef>
+#include "edge-impulse-sdk/classifier/ei_classifier_types.h"
+#include "edge-impulse-sdk/classifier/ei_signal_with_axes.h"
+
+/**
+ * ei_run_classifier.h defines the classifier (and the model variables), so it
+ * is compiled once, in ei_classifier.cpp. The rest of the firmware uses these
+ * declarations.
+ */
+#ifndef _EDGE_IMPULSE_RUN_CLASSIFIER_H_
+extern "C" EI_IMPULSE_ERROR run_classifier(
+    signal_t *signal,
+    ei_impulse_result_t *result,
+    bool debug = false);
+extern "C" EI_IMPULSE_ERROR run_classifier_continuous(
+    signal_t *signal,
+    ei_impulse_result_t *result,
+    bool debug = false,
+    bool enable_maf = true);
+extern "C" void run_classifier_init(void);
+extern "C" void run_classifier_deinit(void);
+#endif
+
+/**
+ * Classify n windows in one go, results[ix] belongs to signals[ix].
+ * Only the NN setup is batched: it is done once for the whole batch
+ * instead of once per window, the DSP still runs on every window.
+ * Stops at the first window that fails.
+ */
+EI_IMPULSE_ERROR run_classifier_batch(
+    signal_t *signals,
+    size_t n,
+    ei_impulse_result_t *results,
+    bool debug = false);
+
+/**
+ * Classify the windows of one long recording (raw samples interleaved per
+ * axis), window ix starts at sample ix * stride. Windows are read straight
+ * from the recording, overlapping windows are not copied. As for
+ * run_classifier_batch() only the NN setup is shared: the DSP block
+ * (spectral analysis over the whole window) is computed again for every
+ * window, no features of the overlapping part are reused.
+ * Processes up to max_results windows, the number done is stored in n_results.
+ */
+EI_IMPULSE_ERROR run_classifier_batch_strided(
+    signal_t *recording,
+    size_t stride,
+    ei_impulse_result_t *results,
+    size_t max_results,
+    size_t *n_results,
+    bool debug = false);
+
+/**
+ * NN set up per window (EI_CLASSIFIER_NN_PER_WINDOW, as run_classifier()) or
+ * kept resident between windows until ei_classifier_release(): the EON
+ * graph, or for the TFLite Micro interpreter the op resolver, the
+ * interpreter and the arena planned by AllocateTensors(), once per model
+ * (again when the model pointer of the graph config changes).
+ * The resident arena stays allocated while the DSP runs, release it when
+ * the RAM is needed elsewhere (MFCC scratch); the next window sets it up
+ * again. Batches set up the NN the same way, in resident mode they leave it
+ * set up.
+ */
+typedef enum {
+    EI_CLASSIFIER_NN_PER_WINDOW = 0,
+    EI_CLASSIFIER_NN_RESIDENT,
+} ei_classifier_nn_mode_t;
+
+typedef struct {
+    uint32_t setups;        // NN set up since boot (batches and resident)
+    uint32_t setup_us;      // time of the last setup
+    bool resident;          // set up now
+} ei_classifier_nn_stats_t;
+
+void ei_classifier_set_nn_mode(ei_classifier_nn_mode_t mode);
+ei_classifier_nn_mode_t ei_classifier_get_nn_mode(void);
+const char *ei_classifier_nn_mode_name(ei_classifier_nn_mode_t mode);
+bool ei_classifier_nn_mode_from_name(const char *name, ei_classifier_nn_mode_t *mode);
+void ei_classifier_get_nn_stats(ei_classifier_nn_stats_t *stats);
+
+/**
+ * run_classifier() and run_classifier_continuous() in the selected NN mode
+ */
+EI_IMPULSE_ERROR ei_classifier_run(signal_t *signal, ei_impulse_result_t *result, bool debug = false);
+EI_IMPULSE_ERROR ei_classifier_run_continuous(signal_t *signal, ei_impulse_result_t *result, bool debug = false);
+
+/**
+ * @brief Tear down the resident NN (its arena is freed)
+ */
+void ei_classifier_release(void);
+
+#endif /* EI_CLASSIFIER_H */
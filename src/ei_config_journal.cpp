@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstddef>
+#include <cstring>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "firmware-sdk/ei_device_lib.h"
+#include "ei_config_journal.h"
+
+/******
+ *
+ * @brief Config journal, see ei_config_journal.h for the layout
+ *
+ ******/
+
+#define HEADER_MAGIC        0x4A434945  // "EICJ"
+#define RECORD_MAGIC        0x4A43      // "CJ"
+#define ERASED_MAGIC        0xFFFF
+#define KEY_MASK            0x7F
+#define IO_CHUNK            512
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t generation;
+    uint16_t chunk_size;
+    uint8_t reserved[18];
+    uint32_t crc;           // CRC-32 of the fields above
+} journal_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t key;            // chunk index | EI_CONFIG_JOURNAL_COMMIT
+    uint8_t length;
+    uint8_t data[EI_CONFIG_JOURNAL_CHUNK_SIZE];
+    uint32_t crc;           // CRC-32 of the fields above
+} journal_record_t;
+
+static_assert(sizeof(journal_header_t) == EI_CONFIG_JOURNAL_RECORD_SIZE, "header must fill one record");
+static_assert(sizeof(journal_record_t) == EI_CONFIG_JOURNAL_RECORD_SIZE, "record size mismatch");
+
+static uint8_t io_buffer[IO_CHUNK];
+
+static bool record_valid(const journal_record_t *record)
+{
+    return record->magic == RECORD_MAGIC &&
+           (record->key & KEY_MASK) < EI_CONFIG_JOURNAL_MAX_CHUNKS &&
+           record->length <= EI_CONFIG_JOURNAL_CHUNK_SIZE &&
+           record->crc == ei_crc32_update(0, (const uint8_t *)record, offsetof(journal_record_t, crc));
+}
+
+static uint32_t config_chunks(uint32_t config_size)
+{
+    return (config_size + EI_CONFIG_JOURNAL_CHUNK_SIZE - 1) / EI_CONFIG_JOURNAL_CHUNK_SIZE;
+}
+
+static uint8_t chunk_length(uint32_t config_size, uint32_t key)
+{
+    uint32_t left = config_size - key * EI_CONFIG_JOURNAL_CHUNK_SIZE;
+
+    return (left < EI_CONFIG_JOURNAL_CHUNK_SIZE) ? left : EI_CONFIG_JOURNAL_CHUNK_SIZE;
+}
+
+EiConfigJournalMemory::EiConfigJournalMemory(
+    uint32_t config_size,
+    uint32_t erase_time,
+    uint32_t memory_size,
+    uint32_t block_size)
+    : EiDeviceMemory(EI_CONFIG_JOURNAL_BLOCKS * block_size, erase_time, memory_size, block_size)
+    , scanned(false)
+    , active(-1)
+    , generation(0)
+    , write_offset(0)
+{
+    // checked against EI_CONFIG_JOURNAL_MAX_CHUNKS on every save
+    (void)config_size;
+}
+
+uint32_t EiConfigJournalMemory::sector_address(int8_t sector)
+{
+    return sector * this->block_size;
+}
+
+/**
+ * @brief Find the active sector and the last committed record of every chunk
+ */
+bool EiConfigJournalMemory::scan(void)
+{
+    journal_header_t header;
+    uint8_t staged_keys[EI_CONFIG_JOURNAL_MAX_CHUNKS];
+    uint32_t staged_offsets[EI_CONFIG_JOURNAL_MAX_CHUNKS];
+    uint32_t staged = 0;
+    bool done = false;
+
+    this->scanned = true;
+    this->active = -1;
+    this->write_offset = this->block_size;
+    memset(this->chunk_offset, 0, sizeof(this->chunk_offset));
+
+    for(int8_t sector = 0; sector < EI_CONFIG_JOURNAL_BLOCKS; sector++) {
+        if(read_data((uint8_t *)&header, sector_address(sector), sizeof(header)) != sizeof(header)) {
+            return false;
+        }
+        if(header.magic == HEADER_MAGIC && header.chunk_size == EI_CONFIG_JOURNAL_CHUNK_SIZE &&
+           header.crc == ei_crc32_update(0, (const uint8_t *)&header, offsetof(journal_header_t, crc)) &&
+           (this->active < 0 || (int32_t)(header.generation - this->generation) > 0)) {
+            this->active = sector;
+            this->generation = header.generation;
+        }
+    }
+
+    if(this->active < 0) {
+        return false;
+    }
+
+    uint32_t base = sector_address(this->active);
+    for(uint32_t page = 0; page < this->block_size && done == false; page += IO_CHUNK) {
+        if(read_data(io_buffer, base + page, IO_CHUNK) != IO_CHUNK) {
+            this->active = -1;
+            return false;
+        }
+
+        for(uint32_t ix = (page == 0) ? EI_CONFIG_JOURNAL_RECORD_SIZE : 0; ix < IO_CHUNK; ix += EI_CONFIG_JOURNAL_RECORD_SIZE) {
+            const journal_record_t *record = (const journal_record_t *)&io_buffer[ix];
+
+            if(record->magic == ERASED_MAGIC) {
+                this->write_offset = page + ix;
+                done = true;
+                break;
+            }
+            if(record_valid(record) == false) {
+                // torn write, drop the save it belonged to
+                staged = 0;
+                continue;
+            }
+
+            // a save has at most one record per chunk
+            if(staged == EI_CONFIG_JOURNAL_MAX_CHUNKS) {
+                staged = 0;
+            }
+            staged_keys[staged] = record->key & KEY_MASK;
+            staged_offsets[staged] = page + ix;
+            staged++;
+
+            if(record->key & EI_CONFIG_JOURNAL_COMMIT) {
+                for(uint32_t s = 0; s < staged; s++) {
+                    this->chunk_offset[staged_keys[s]] = staged_offsets[s];
+                }
+                staged = 0;
+            }
+        }
+    }
+
+    for(uint32_t key = 0; key < EI_CONFIG_JOURNAL_MAX_CHUNKS; key++) {
+        journal_record_t record;
+
+        if(this->chunk_offset[key] == 0) {
+            continue;
+        }
+        if(read_data((uint8_t *)&record, base + this->chunk_offset[key], sizeof(record)) != sizeof(record)) {
+            this->active = -1;
+            return false;
+        }
+        this->chunk_crc[key] = ei_crc32_update(0, record.data, record.length);
+    }
+
+    return true;
+}
+
+bool EiConfigJournalMemory::append(uint32_t address, uint8_t key, const uint8_t *data, uint8_t length)
+{
+    journal_record_t record;
+
+    record.magic = RECORD_MAGIC;
+    record.key = key;
+    record.length = length;
+    memset(record.data, 0xFF, sizeof(record.data));
+    memcpy(record.data, data, length);
+    record.crc = ei_crc32_update(0, (const uint8_t *)&record, offsetof(journal_record_t, crc));
+
+    return write_data((const uint8_t *)&record, address, sizeof(record)) == sizeof(record);
+}
+
+/**
+ * @brief Write the whole config to the other sector, then switch to it
+ */
+bool EiConfigJournalMemory::compact(const uint8_t *config, uint32_t config_size)
+{
+    int8_t target = (this->active < 0) ? 0 : 1 - this->active;
+    uint32_t base = sector_address(target);
+    uint32_t chunks = config_chunks(config_size);
+    uint32_t offset = EI_CONFIG_JOURNAL_RECORD_SIZE;
+    journal_header_t header;
+
+    // from here on the RAM state is rebuilt, a failure has to rescan
+    this->scanned = false;
+
+    if(erase_data(base, this->block_size) != this->block_size) {
+        ei_printf("ERR: Failed to erase config sector %d\n", target);
+        return false;
+    }
+
+    for(uint32_t key = 0; key < chunks; key++) {
+        const uint8_t *data = &config[key * EI_CONFIG_JOURNAL_CHUNK_SIZE];
+        uint8_t length = chunk_length(config_size, key);
+        uint8_t flags = (key == chunks - 1) ? EI_CONFIG_JOURNAL_COMMIT : 0;
+
+        if(append(base + offset, key | flags, data, length) == false) {
+            ei_printf("ERR: Failed to write config sector %d\n", target);
+            return false;
+        }
+        this->chunk_offset[key] = offset;
+        this->chunk_crc[key] = ei_crc32_update(0, data, length);
+        offset += EI_CONFIG_JOURNAL_RECORD_SIZE;
+    }
+    for(uint32_t key = chunks; key < EI_CONFIG_JOURNAL_MAX_CHUNKS; key++) {
+        this->chunk_offset[key] = 0;
+    }
+
+    // the switch: the header goes last
+    memset(&header, 0xFF, sizeof(header));
+    header.magic = HEADER_MAGIC;
+    header.generation = this->generation + 1;
+    header.chunk_size = EI_CONFIG_JOURNAL_CHUNK_SIZE;
+    header.crc = ei_crc32_update(0, (const uint8_t *)&header, offsetof(journal_header_t, crc));
+    if(write_data((const uint8_t *)&header, base, sizeof(header)) != sizeof(header)) {
+        ei_printf("ERR: Failed to write config sector %d\n", target);
+        return false;
+    }
+
+    this->active = target;
+    this->generation++;
+    this->write_offset = offset;
+    this->scanned = true;
+
+    return true;
+}
+
+bool EiConfigJournalMemory::save_config(const uint8_t *config, uint32_t config_size)
+{
+    uint32_t chunks = config_chunks(config_size);
+    uint32_t changed_crc[EI_CONFIG_JOURNAL_MAX_CHUNKS];
+    uint32_t changed = 0;
+
+    if(chunks > EI_CONFIG_JOURNAL_MAX_CHUNKS) {
+        ei_printf("ERR: Config of %lu bytes does not fit the journal\n", (unsigned long)config_size);
+        return false;
+    }
+
+    if(this->scanned == false) {
+        scan();
+    }
+    if(this->active < 0) {
+        return compact(config, config_size);
+    }
+
+    for(uint32_t key = 0; key < chunks; key++) {
+        changed_crc[key] = ei_crc32_update(0, &config[key * EI_CONFIG_JOURNAL_CHUNK_SIZE], chunk_length(config_size, key));
+        if(this->chunk_offset[key] == 0 || changed_crc[key] != this->chunk_crc[key]) {
+            changed++;
+        }
+    }
+
+    if(changed == 0) {
+        return true;
+    }
+    if(this->write_offset + changed * EI_CONFIG_JOURNAL_RECORD_SIZE > this->block_size) {
+        return compact(config, config_size);
+    }
+
+    uint32_t base = sector_address(this->active);
+    for(uint32_t key = 0; key < chunks; key++) {
+        if(this->chunk_offset[key] != 0 && changed_crc[key] == this->chunk_crc[key]) {
+            continue;
+        }
+
+        uint8_t flags = (--changed == 0) ? EI_CONFIG_JOURNAL_COMMIT : 0;
+        if(append(base + this->write_offset, key | flags, &config[key * EI_CONFIG_JOURNAL_CHUNK_SIZE],
+                  chunk_length(config_size, key)) == false) {
+            ei_printf("ERR: Failed to write config\n");
+            this->scanned = false;
+            return false;
+        }
+        this->chunk_offset[key] = this->write_offset;
+        this->chunk_crc[key] = changed_crc[key];
+        this->write_offset += EI_CONFIG_JOURNAL_RECORD_SIZE;
+    }
+
+    return true;
+}
+
+bool EiConfigJournalMemory::load_config(uint8_t *config, uint32_t config_size)
+{
+    uint32_t chunks = config_chunks(config_size);
+
+    if(this->scanned == false) {
+        scan();
+    }
+    // nothing stored yet, config keeps what the caller put in
+    if(this->active < 0 || chunks > EI_CONFIG_JOURNAL_MAX_CHUNKS) {
+        return false;
+    }
+
+    uint32_t base = sector_address(this->active);
+    for(uint32_t key = 0; key < chunks; key++) {
+        journal_record_t record;
+        uint8_t length = chunk_length(config_size, key);
+
+        if(this->chunk_offset[key] == 0) {
+            continue;
+        }
+        if(read_data((uint8_t *)&record, base + this->chunk_offset[key], sizeof(record)) != sizeof(record)) {
+            return false;
+        }
+        memcpy(&config[key * EI_CONFIG_JOURNAL_CHUNK_SIZE], record.data, (record.length < length) ? record.length : length);
+    }
+
+    return true;
+}
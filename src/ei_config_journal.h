@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_CONFIG_JOURNAL_H
+#define EI_CONFIG_JOURNAL_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include "firmware-sdk/ei_device_memory.h"
+
+/**
+ * Config storage as an append-only journal instead of erase + rewrite on
+ * every setter. The config (EiConfig) is split into chunks, chunk n is key n.
+ * save_config() appends a record for each chunk that differs from the
+ * stored one, an unchanged config costs nothing.
+ *
+ * The config region is two blocks, each a sector of the journal:
+ *
+ *   record 0       header: magic, generation, chunk size, CRC-32
+ *   record 1..     [magic u16] [key u8] [length u8] [data] [CRC-32]
+ *
+ * The valid header with the highest generation marks the active sector.
+ * The last record of a save has EI_CONFIG_JOURNAL_COMMIT set in its key,
+ * records after the last commit (power loss during a save) are ignored.
+ * When the active sector is full the whole config is written to the other
+ * one and its header is written last, so power loss during compaction
+ * leaves the old sector active.
+ */
+#define EI_CONFIG_JOURNAL_BLOCKS        2
+/* 32 byte records, a record never crosses a 512 byte flash page */
+#define EI_CONFIG_JOURNAL_RECORD_SIZE   32
+#define EI_CONFIG_JOURNAL_CHUNK_SIZE    (EI_CONFIG_JOURNAL_RECORD_SIZE - 8)
+#define EI_CONFIG_JOURNAL_MAX_CHUNKS    64
+#define EI_CONFIG_JOURNAL_COMMIT        0x80
+
+class EiConfigJournalMemory : public EiDeviceMemory {
+private:
+    bool scanned;
+    int8_t active;                  // sector, -1: no valid sector
+    uint32_t generation;
+    uint32_t write_offset;          // next free record in the active sector
+    uint32_t chunk_offset[EI_CONFIG_JOURNAL_MAX_CHUNKS];  // 0: never written
+    uint32_t chunk_crc[EI_CONFIG_JOURNAL_MAX_CHUNKS];
+
+    uint32_t sector_address(int8_t sector);
+    bool scan(void);
+    bool append(uint32_t address, uint8_t key, const uint8_t *data, uint8_t length);
+    bool compact(const uint8_t *config, uint32_t config_size);
+
+public:
+    /* the config region is EI_CONFIG_JOURNAL_BLOCKS blocks, config_size
+     * (the config struct) only has to fit EI_CONFIG_JOURNAL_MAX_CHUNKS */
+    EiConfigJournalMemory(
+        uint32_t config_size,
+        uint32_t erase_time,
+        uint32_t memory_size,
+        uint32_t block_size);
+
+    bool save_config(const uint8_t *config, uint32_t config_size) override;
+    bool load_config(uint8_t *config, uint32_t config_size) override;
+};
+
+#endif /* EI_CONFIG_JOURNAL_H */
@@ -20,9 +20,11 @@
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
 #include "firmware-sdk/ei_device_info_lib.h"
 #include "firmware-sdk/ei_device_memory.h"
+#include "firmware-sdk/ei_device_interface.h"
 #include "ei_device_psoc62.h"
 #include "ei_flash_memory.h"
 #include "ei_microphone.h"
+#include "ei_uart_tx.h"
 #include "cy_syslib.h"
 #include "cyhal_gpio.h"
 
@@ -138,6 +140,9 @@ EiDevicePSoC62::EiDevicePSoC62(EiDeviceMemory* mem)
     EiDeviceInfo::memory = mem;
     cy_rslt_t result;
 
+    data_output_baudrate = EI_DEVICE_BAUDRATE;
+    session_rx_errors = 0;
+
     init_device_id();
 
     load_config();
@@ -269,8 +274,35 @@ uint32_t EiDevicePSoC62::get_data_output_baudrate(void)
     /* Using EI_DEVICE_BAUDRATE_MAX and speeds above 115k baudrate
      * requires a firmware update of the KitProg3. Most Pioneer Kits
      * come with a KitProg3 firmware that supports speeds up to 115k.
+     * Faster rates are negotiated with AT+BAUD, which checks the link.
      */
-    return EI_DEVICE_BAUDRATE;
+    return data_output_baudrate;
+}
+
+/* counted by serial_event() */
+static volatile uint32_t serial_rx_errors = 0;
+
+bool EiDevicePSoC62::set_uart_baudrate(uint32_t baudrate)
+{
+    cy_rslt_t result;
+    uint32_t actual;
+
+    // what is queued goes out at the old rate
+    ei_serial_flush();
+    result = cyhal_uart_set_baud(&cy_retarget_io_uart_obj, baudrate, &actual);
+    if(result != CY_RSLT_SUCCESS) {
+        ei_printf("ERR: Failed to change baudrate to %lu\n", (unsigned long)baudrate);
+        return false;
+    }
+
+    uint32_t diff = (actual > baudrate) ? actual - baudrate : baudrate - actual;
+    if((uint64_t)diff * 100 > (uint64_t)baudrate * EI_DEVICE_BAUD_TOLERANCE) {
+        cyhal_uart_set_baud(&cy_retarget_io_uart_obj, data_output_baudrate, NULL);
+        ei_printf("ERR: Baudrate %lu not possible (%lu)\n", (unsigned long)baudrate, (unsigned long)actual);
+        return false;
+    }
+
+    return true;
 }
 
 /**
@@ -279,12 +311,7 @@ uint32_t EiDevicePSoC62::get_data_output_baudrate(void)
  */
 void EiDevicePSoC62::set_max_data_output_baudrate()
 {
-    cy_rslt_t result;
-
-    result = cyhal_uart_set_baud(&cy_retarget_io_uart_obj, EI_DEVICE_BAUDRATE_MAX, NULL);
-    if(result != CY_RSLT_SUCCESS) {
-        ei_printf("ERR: Failed to change baudrate to %d\n", EI_DEVICE_BAUDRATE_MAX);
-    }
+    set_uart_baudrate(EI_DEVICE_BAUDRATE_MAX);
 }
 
 /**
@@ -293,12 +320,92 @@ void EiDevicePSoC62::set_max_data_output_baudrate()
  */
 void EiDevicePSoC62::set_default_data_output_baudrate()
 {
-    cy_rslt_t result;
+    set_uart_baudrate(EI_DEVICE_BAUDRATE);
+}
 
-    result = cyhal_uart_set_baud(&cy_retarget_io_uart_obj, EI_DEVICE_BAUDRATE, NULL);
-    if(result != CY_RSLT_SUCCESS) {
-        ei_printf("ERR: Failed to change baudrate to %d\n", EI_DEVICE_BAUDRATE);
+/* look for the sync pattern, bytes sent before it (the end of the AT
+ * command line, noise of the rate switch) are skipped */
+static bool wait_baud_sync(void)
+{
+    const char *sync = EI_DEVICE_BAUD_SYNC;
+    size_t matched = 0;
+    uint64_t start_ms = ei_read_timer_ms();
+    uint8_t c;
+
+    while(sync[matched] != 0) {
+        uint64_t elapsed_ms = ei_read_timer_ms() - start_ms;
+        if(elapsed_ms >= EI_DEVICE_BAUD_SYNC_MS ||
+           ei_serial_read(&c, 1, EI_DEVICE_BAUD_SYNC_MS - elapsed_ms) == false) {
+            return false;
+        }
+
+        // no character repeats in the pattern, a mismatch restarts it
+        if(c == sync[matched]) {
+            matched++;
+        }
+        else {
+            matched = (c == sync[0]) ? 1 : 0;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief      Switch to baudrate for a session of transfers. The OK goes
+ *             out at the current rate, then the host has to send the sync
+ *             pattern at the new one; without it the device goes back.
+ */
+bool EiDevicePSoC62::negotiate_data_output_baudrate(uint32_t baudrate)
+{
+    uint32_t previous = data_output_baudrate;
+
+    if(baudrate < EI_DEVICE_BAUDRATE_MIN || baudrate > EI_DEVICE_BAUDRATE_LIMIT) {
+        ei_printf("ERR: Baudrate %lu out of range (%d - %d)\n", (unsigned long)baudrate,
+            EI_DEVICE_BAUDRATE_MIN, EI_DEVICE_BAUDRATE_LIMIT);
+        return false;
+    }
+
+    ei_printf("OK\n");
+    if(set_uart_baudrate(baudrate) == false) {
+        return false;
+    }
+
+    if(wait_baud_sync() == false) {
+        set_uart_baudrate(previous);
+        ei_printf("ERR: No sync at %lu, staying at %lu\n", (unsigned long)baudrate,
+            (unsigned long)previous);
+        return false;
     }
+
+    data_output_baudrate = baudrate;
+    session_rx_errors = serial_rx_errors;
+    ei_printf(EI_DEVICE_BAUD_SYNC "\n");
+
+    return true;
+}
+
+bool EiDevicePSoC62::is_baudrate_session(void)
+{
+    return (data_output_baudrate != EI_DEVICE_BAUDRATE);
+}
+
+/**
+ * @brief      Fall back to the default rate when the session link keeps
+ *             failing (framing, parity or overflow errors); called from
+ *             the UART task. The host notices the silence and renegotiates.
+ */
+void EiDevicePSoC62::check_data_output_baudrate(void)
+{
+    if(is_baudrate_session() == false ||
+       serial_rx_errors - session_rx_errors < EI_DEVICE_BAUD_MAX_ERRORS) {
+        return;
+    }
+
+    uint32_t failed = data_output_baudrate;
+    set_uart_baudrate(EI_DEVICE_BAUDRATE);
+    data_output_baudrate = EI_DEVICE_BAUDRATE;
+    ei_printf("ERR: UART errors at %lu, back to %d\n", (unsigned long)failed, EI_DEVICE_BAUDRATE);
 }
 
 bool EiDevicePSoC62::start_sample_thread(void (*sample_read_cb)(void), float sample_interval_ms)
@@ -400,6 +507,150 @@ bool EiDevicePSoC62::is_environmental_sampling(void)
     return this->environmental_sampling;
 }
 
+/* console ring bytes in the running transfer, 0: none */
+static volatile size_t tx_ring_len = 0;
+
+static void serial_event(void *callback_arg, cyhal_uart_event_t event)
+{
+    (void)callback_arg;
+
+    if(event & CYHAL_UART_IRQ_RX_ERROR) {
+        serial_rx_errors++;
+    }
+    if(event & CYHAL_UART_IRQ_TX_DONE) {
+        if(tx_ring_len > 0) {
+            ei_uart_tx_done(tx_ring_len);
+            tx_ring_len = 0;
+        }
+        // next run of the ring, or what was queued during an ei_serial_write()
+        ei_uart_tx_kick();
+    }
+}
+
+static bool serial_enable_dma(void)
+{
+    static bool dma_enabled = false;
+    cy_rslt_t result;
+
+    if(dma_enabled == false) {
+        result = cyhal_uart_set_async_mode(&cy_retarget_io_uart_obj, CYHAL_ASYNC_DMA, CYHAL_DMA_PRIORITY_DEFAULT);
+        if(result != CY_RSLT_SUCCESS) {
+            // no ei_printf here, it would come back through the ring
+            return false;
+        }
+        cyhal_uart_register_callback(&cy_retarget_io_uart_obj, serial_event, NULL);
+        cyhal_uart_enable_event(&cy_retarget_io_uart_obj,
+            (cyhal_uart_event_t)(CYHAL_UART_IRQ_TX_DONE | CYHAL_UART_IRQ_RX_ERROR), CYHAL_ISR_PRIORITY_DEFAULT, true);
+        dma_enabled = true;
+    }
+
+    return true;
+}
+
+/**
+ * @brief      Console ring port: send the oldest run of the ring by DMA.
+ *             Called by writers and by the TX done interrupt.
+ */
+void ei_uart_tx_kick(void)
+{
+    const uint8_t *data;
+    size_t len;
+
+    if(serial_enable_dma() == false) {
+        // blocking fallback, nothing is lost
+        while((len = ei_uart_tx_pending(&data)) > 0) {
+            cyhal_uart_write(&cy_retarget_io_uart_obj, (void *)data, &len);
+            ei_uart_tx_done(len);
+        }
+        return;
+    }
+
+    uint32_t state = cyhal_system_critical_section_enter();
+
+    if(tx_ring_len == 0 && cyhal_uart_is_tx_active(&cy_retarget_io_uart_obj) == false) {
+        len = ei_uart_tx_pending(&data);
+        if(len > 0 && cyhal_uart_write_async(&cy_retarget_io_uart_obj, (void *)data, len) == CY_RSLT_SUCCESS) {
+            tx_ring_len = len;
+        }
+    }
+
+    cyhal_system_critical_section_exit(state);
+}
+
+/**
+ * @brief      Binary read from the debug UART, the DMA writes straight into
+ *             buffer while this task sleeps
+ */
+bool ei_serial_read(uint8_t *buffer, size_t length, uint32_t timeout_ms)
+{
+    cy_rslt_t result;
+
+    if(serial_enable_dma() == false) {
+        return false;
+    }
+
+    result = cyhal_uart_read_async(&cy_retarget_io_uart_obj, buffer, length);
+    if(result != CY_RSLT_SUCCESS) {
+        return false;
+    }
+
+    uint64_t start_ms = ei_read_timer_ms();
+
+    while(cyhal_uart_is_rx_active(&cy_retarget_io_uart_obj)) {
+        if(ei_read_timer_ms() - start_ms > timeout_ms) {
+            cyhal_uart_read_abort(&cy_retarget_io_uart_obj);
+            return false;
+        }
+        ei_sleep(1);
+    }
+
+    return true;
+}
+
+/**
+ * @brief      Write to the debug UART by DMA, the caller fills its next
+ *             buffer while this one goes out (used by AT+READBUFFER)
+ */
+bool ei_serial_write(const uint8_t *buffer, size_t length)
+{
+    cy_rslt_t result;
+
+    if(serial_enable_dma() == false) {
+        return false;
+    }
+
+    // the console ring can start again between the flush and this write
+    while(true) {
+        ei_serial_flush();
+
+        uint32_t state = cyhal_system_critical_section_enter();
+        bool idle = (tx_ring_len == 0 && cyhal_uart_is_tx_active(&cy_retarget_io_uart_obj) == false);
+        if(idle) {
+            result = cyhal_uart_write_async(&cy_retarget_io_uart_obj, (void *)buffer, length);
+        }
+        cyhal_system_critical_section_exit(state);
+
+        if(idle) {
+            break;
+        }
+    }
+
+    if(result != CY_RSLT_SUCCESS) {
+        ei_printf("ERR: Failed to start UART write\n");
+        return false;
+    }
+
+    return true;
+}
+
+void ei_serial_flush(void)
+{
+    ei_uart_tx_flush();
+    while(cyhal_uart_is_tx_active(&cy_retarget_io_uart_obj)) {
+        ei_sleep(1);
+    }
+}
+
 #ifdef FREERTOS_ENABLED
 void vTimerCallback(TimerHandle_t xTimer)
 {
@@ -36,6 +36,16 @@
 #define EI_DEVICE_BAUDRATE 115200
 #define EI_DEVICE_BAUDRATE_MAX 460800
 
+/* AT+BAUD: negotiated data rate, kept until AT+BAUD=115200 or an error.
+ * After the OK the host switches and sends EI_DEVICE_BAUD_SYNC at the new
+ * rate within EI_DEVICE_BAUD_SYNC_MS, the device echoes it back. */
+#define EI_DEVICE_BAUDRATE_MIN      9600
+#define EI_DEVICE_BAUDRATE_LIMIT    4000000
+#define EI_DEVICE_BAUD_TOLERANCE    2       // % between asked and actual rate
+#define EI_DEVICE_BAUD_SYNC         "EISYNC"
+#define EI_DEVICE_BAUD_SYNC_MS      1000
+#define EI_DEVICE_BAUD_MAX_ERRORS   8       // RX errors before falling back
+
 class EiDevicePSoC62 : public EiDeviceInfo {
 private:
     EiDevicePSoC62() = delete;
@@ -48,6 +58,10 @@ private:
     cyhal_timer_t led_timer;
 #endif
     volatile bool environmental_sampling;
+    uint32_t data_output_baudrate;          // EI_DEVICE_BAUDRATE: no session
+    uint32_t session_rx_errors;
+
+    bool set_uart_baudrate(uint32_t baudrate);
 
 public:
     EiDevicePSoC62(EiDeviceMemory *mem);
@@ -58,6 +72,9 @@ public:
     uint32_t get_data_output_baudrate(void);
     void set_max_data_output_baudrate(void);
     void set_default_data_output_baudrate(void);
+    bool negotiate_data_output_baudrate(uint32_t baudrate);
+    bool is_baudrate_session(void);
+    void check_data_output_baudrate(void);
     bool test_flash(void);
     bool start_sample_thread(void (*sample_read_cb)(void), float sample_interval_ms) override;
     bool stop_sample_thread(void) override;
@@ -27,7 +27,7 @@
 uint32_t EiFlashMemory::read_data(uint8_t *data, uint32_t address, uint32_t num_bytes)
 {
 	cy_rslt_t result;
-#if 0
+#if EI_FLASH_QSPI_DRIVER
     if(address + num_bytes > this->memory_size) {
         num_bytes = this->memory_size - address;
     }
@@ -46,7 +46,7 @@ uint32_t EiFlashMemory::write_data(const uint8_t *data, uint32_t address, uint32
     uint32_t offset = 0;
     uint32_t n_bytes = 0;
     uint32_t bytes_to_write = num_bytes;
-#if 0
+#if EI_FLASH_QSPI_DRIVER
     do {
         if(bytes_to_write > FLASH_PAGE_SIZE) {
             n_bytes = FLASH_PAGE_SIZE;
@@ -88,7 +88,7 @@ uint32_t EiFlashMemory::write_data(const uint8_t *data, uint32_t address, uint32
 uint32_t EiFlashMemory::erase_data(uint32_t address, uint32_t num_bytes)
 {
 	cy_rslt_t result;
-#if 0
+#if EI_FLASH_QSPI_DRIVER
     /**
      * Address can point to the middle of sector, but num_bytes may be reaching
      *  part of the last sector
@@ -115,10 +115,10 @@ uint32_t EiFlashMemory::erase_data(uint32_t address, uint32_t num_bytes)
 }
 
 EiFlashMemory::EiFlashMemory(uint32_t config_size):
-    EiDeviceMemory(config_size, FLASH_ERASE_TIME, FLASH_SIZE, FLASH_SECTOR_SIZE)
+    EiConfigJournalMemory(config_size, FLASH_ERASE_TIME, FLASH_SIZE, FLASH_SECTOR_SIZE)
 {
 	cy_rslt_t result;
-#if 0
+#if EI_FLASH_QSPI_DRIVER
     result = cy_serial_flash_qspi_init(smifMemConfigs[QSPI_MEM_SLOT_NUM],
     			CYBSP_QSPI_D0, CYBSP_QSPI_D1, CYBSP_QSPI_D2, CYBSP_QSPI_D3,
 				NC, NC, NC, NC, CYBSP_QSPI_SCK, CYBSP_QSPI_SS,
@@ -126,3 +126,13 @@ EiFlashMemory::EiFlashMemory(uint32_t config_size):
 	CY_ASSERT(result == CY_RSLT_SUCCESS);
 #endif
 }
+
+uint32_t EiFlashMemory::get_available_sample_blocks(void)
+{
+    return memory_blocks - used_blocks - EI_MODEL_STORE_BLOCKS;
+}
+
+uint32_t EiFlashMemory::get_available_sample_bytes(void)
+{
+    return get_available_sample_blocks() * block_size;
+}
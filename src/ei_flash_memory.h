@@ -17,7 +17,8 @@
 #ifndef EI_FLASH_MEMORY_H
 #define EI_FLASH_MEMORY_H
 
-#include "firmware-sdk/ei_device_memory.h"
+#include "ei_config_journal.h"
+#include "ei_model_store.h"
 
 extern "C" {
 	#include "cy_pdl.h"
@@ -40,7 +41,15 @@ extern "C" {
 #define FLASH_PAGE_SIZE     0x0200      // 512 Byte Page size
 #define FLASH_BLOCK_NUM     (FLASH_SIZE / SECTOR_SIZE)
 
-class EiFlashMemory : public EiDeviceMemory {
+/* The cy_serial_flash_qspi calls are not enabled yet: reads return without
+ * filling the buffer, writes and erases do nothing. Set to 1 once the QSPI
+ * driver works on the board.
+ */
+#ifndef EI_FLASH_QSPI_DRIVER
+#define EI_FLASH_QSPI_DRIVER    0
+#endif
+
+class EiFlashMemory : public EiConfigJournalMemory {
 protected:
     uint32_t read_data(uint8_t *data, uint32_t address, uint32_t num_bytes);
     uint32_t write_data(const uint8_t *data, uint32_t address, uint32_t num_bytes);
@@ -48,6 +57,9 @@ protected:
 
 public:
     EiFlashMemory(uint32_t config_size);
+    /* the top EI_MODEL_STORE_BLOCKS hold the model slots */
+    uint32_t get_available_sample_blocks(void) override;
+    uint32_t get_available_sample_bytes(void) override;
 };
 
 #endif /* EI_FLASH_MEMORY_H */
@@ -0,0 +1,460 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+#include <string>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "firmware-sdk/ei_device_info_lib.h"
+#include "firmware-sdk/ei_device_interface.h"
+#include "firmware-sdk/ei_device_lib.h"
+#include "ei_ble_control.h"
+#include "ei_framed_protocol.h"
+
+#ifdef FREERTOS_ENABLED
+#include <FreeRTOS.h>
+#include <semphr.h>
+#endif
+
+/******
+ *
+ * @brief Framed serial protocol, see ei_framed_protocol.h. Runs in the
+ *        UART task instead of the AT server while active. Other tasks (the
+ *        BT stack) print too, so the log line and every frame sent are
+ *        taken under tx_lock().
+ *
+ ******/
+
+#define FRAME_HEADER_LEN    3   // seq, opcode, status
+#define FRAME_CRC_LEN       4
+#define FRAME_MAX_LEN       (FRAME_HEADER_LEN + EI_FRAMED_MAX_DATA + FRAME_CRC_LEN)
+/* COBS adds a code byte every 254 bytes, plus the trailing 0x00 */
+#define FRAME_MAX_ENCODED   (FRAME_MAX_LEN + FRAME_MAX_LEN / 254 + 2)
+#define LOG_LINE_LEN        128
+#define LOG_FRAME_LEN       (FRAME_HEADER_LEN + LOG_LINE_LEN + FRAME_CRC_LEN)
+
+static volatile bool active = false;
+static uint8_t rx_encoded[FRAME_MAX_ENCODED];
+static uint16_t rx_len = 0;
+static bool rx_overflow = false;
+static uint8_t rx_frame[FRAME_MAX_LEN];
+static uint8_t tx_frame[FRAME_MAX_LEN];
+static uint8_t log_frame[LOG_FRAME_LEN];
+static uint16_t log_len = 0;
+static uint8_t tx_encoded[FRAME_MAX_ENCODED];
+#ifdef FREERTOS_ENABLED
+/* recursive: an error printed while a frame is sent comes back through ei_framed_log() */
+static SemaphoreHandle_t tx_mutex = NULL;
+#endif
+
+static inline void tx_lock(void)
+{
+#ifdef FREERTOS_ENABLED
+    if(tx_mutex != NULL) {
+        xSemaphoreTakeRecursive(tx_mutex, portMAX_DELAY);
+    }
+#endif
+}
+
+static inline void tx_unlock(void)
+{
+#ifdef FREERTOS_ENABLED
+    if(tx_mutex != NULL) {
+        xSemaphoreGiveRecursive(tx_mutex);
+    }
+#endif
+}
+
+static size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t code_ix = 0;
+    size_t out_ix = 1;
+    uint8_t code = 1;
+
+    for(size_t ix = 0; ix < len; ix++) {
+        if(in[ix] == 0) {
+            out[code_ix] = code;
+            code_ix = out_ix++;
+            code = 1;
+            continue;
+        }
+        out[out_ix++] = in[ix];
+        if(++code == 0xFF) {
+            out[code_ix] = code;
+            code_ix = out_ix++;
+            code = 1;
+        }
+    }
+    out[code_ix] = code;
+    out[out_ix++] = 0;
+
+    return out_ix;
+}
+
+/* @return decoded length, -1 if the frame is malformed */
+static int cobs_decode(const uint8_t *in, size_t len, uint8_t *out, size_t max_len)
+{
+    size_t in_ix = 0;
+    size_t out_ix = 0;
+
+    while(in_ix < len) {
+        uint8_t code = in[in_ix++];
+
+        if(code == 0 || in_ix + code - 1 > len || out_ix + code - 1 > max_len) {
+            return -1;
+        }
+        memcpy(&out[out_ix], &in[in_ix], code - 1);
+        in_ix += code - 1;
+        out_ix += code - 1;
+
+        if(code < 0xFF && in_ix < len) {
+            if(out_ix >= max_len) {
+                return -1;
+            }
+            out[out_ix++] = 0;
+        }
+    }
+
+    return out_ix;
+}
+
+static void put_u32(uint8_t *p, uint32_t value)
+{
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = (value >> 24) & 0xFF;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* frame holds the header and len - FRAME_HEADER_LEN data bytes */
+static void send_frame(uint8_t *frame, uint16_t len)
+{
+    put_u32(&frame[len], ei_crc32_update(0, frame, len));
+
+    // the previous frame may still be going out of tx_encoded
+    ei_serial_flush();
+    size_t encoded_len = cobs_encode(frame, len + FRAME_CRC_LEN, tx_encoded);
+    ei_serial_write(tx_encoded, encoded_len);
+}
+
+static void log_flush(void)
+{
+    if(log_len == 0) {
+        return;
+    }
+
+    log_frame[0] = 0;
+    log_frame[1] = EI_FRAMED_LOG;
+    log_frame[2] = 0;
+    send_frame(log_frame, FRAME_HEADER_LEN + log_len);
+    log_len = 0;
+}
+
+bool ei_framed_log(const char *text)
+{
+    if(active == false) {
+        return false;
+    }
+
+    tx_lock();
+
+    // framed mode may have ended while waiting for the lock
+    if(active == false) {
+        tx_unlock();
+        return false;
+    }
+
+    for(; *text; text++) {
+        if(*text == '\n') {
+            log_flush();
+        }
+        else if(*text != '\r') {
+            log_frame[FRAME_HEADER_LEN + log_len++] = *text;
+            if(log_len == LOG_LINE_LEN) {
+                log_flush();
+            }
+        }
+    }
+
+    tx_unlock();
+
+    return true;
+}
+
+/* str up to its first NUL (strings loaded from the config are padded with
+ * NULs), appended at data[*len]
+ * @return false if it does not fit in a string or the data field
+ */
+static bool put_string(uint8_t *data, uint16_t *len, const std::string &str)
+{
+    size_t str_len = strnlen(str.c_str(), str.size());
+
+    if(str_len > 255 || *len + 1 + str_len > EI_FRAMED_MAX_DATA) {
+        return false;
+    }
+
+    data[*len] = (uint8_t)str_len;
+    memcpy(&data[*len + 1], str.c_str(), str_len);
+    *len += 1 + str_len;
+
+    return true;
+}
+
+/* @return false if the string does not fit in the parameters */
+static bool get_string(const uint8_t **param, uint16_t *len, std::string *str)
+{
+    if(*len < 1 || *len < 1 + (*param)[0]) {
+        return false;
+    }
+
+    str->assign((const char *)&(*param)[1], (*param)[0]);
+    *len -= 1 + (*param)[0];
+    *param += 1 + (*param)[0];
+
+    return true;
+}
+
+static ei_framed_status_t get_info(uint8_t *data, uint16_t *data_len)
+{
+    EiDeviceInfo *dev = EiDeviceInfo::get_device();
+    uint16_t len = 0;
+
+    data[len++] = EI_FRAMED_VERSION;
+    data[len++] = EI_FRAMED_MAX_DATA & 0xFF;
+    data[len++] = EI_FRAMED_MAX_DATA >> 8;
+    if(put_string(data, &len, dev->get_device_id()) == false ||
+       put_string(data, &len, dev->get_device_type()) == false) {
+        return EI_FRAMED_FAILED;
+    }
+    *data_len = len;
+
+    return EI_FRAMED_SUCCESS;
+}
+
+static ei_framed_status_t get_config(uint8_t *data, uint16_t *data_len)
+{
+    EiDeviceInfo *dev = EiDeviceInfo::get_device();
+    float interval_ms = dev->get_sample_interval_ms();
+    uint32_t interval_bits;
+    uint16_t len = 0;
+
+    memcpy(&interval_bits, &interval_ms, sizeof(interval_bits));
+    put_u32(&data[len], interval_bits);
+    len += 4;
+    put_u32(&data[len], dev->get_sample_length_ms());
+    len += 4;
+    if(put_string(data, &len, dev->get_sample_label()) == false ||
+       put_string(data, &len, dev->get_upload_host()) == false ||
+       put_string(data, &len, dev->get_upload_path()) == false) {
+        return EI_FRAMED_FAILED;
+    }
+    *data_len = len;
+
+    return EI_FRAMED_SUCCESS;
+}
+
+static ei_framed_status_t set_sample(const uint8_t *param, uint16_t len)
+{
+    EiDeviceInfo *dev = EiDeviceInfo::get_device();
+    uint32_t interval_bits;
+    float interval_ms;
+    uint32_t length_ms;
+    std::string label;
+
+    if(len < 8) {
+        return EI_FRAMED_INVALID_PARAMETER;
+    }
+    interval_bits = get_u32(param);
+    memcpy(&interval_ms, &interval_bits, sizeof(interval_ms));
+    length_ms = get_u32(&param[4]);
+    param += 8;
+    len -= 8;
+
+    if(get_string(&param, &len, &label) == false || label.size() > EI_FRAMED_MAX_LABEL ||
+       !(interval_ms > 0.0f) || length_ms == 0) {
+        return EI_FRAMED_INVALID_PARAMETER;
+    }
+
+    dev->set_sample_label(label, false);
+    dev->set_sample_interval_ms(interval_ms, false);
+    dev->set_sample_length_ms(length_ms, true);
+
+    return EI_FRAMED_SUCCESS;
+}
+
+static ei_framed_status_t set_device_id(const uint8_t *param, uint16_t len)
+{
+    std::string id;
+
+    if(get_string(&param, &len, &id) == false || id.empty()) {
+        return EI_FRAMED_INVALID_PARAMETER;
+    }
+
+    EiDeviceInfo::get_device()->set_device_id(id);
+
+    return EI_FRAMED_SUCCESS;
+}
+
+static ei_framed_status_t control(const uint8_t *param, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+    uint8_t response[EI_BLE_CONTROL_MAX_LEN];
+
+    if(len < 1 || len > EI_BLE_CONTROL_MAX_LEN) {
+        return EI_FRAMED_INVALID_PARAMETER;
+    }
+
+    // [EI_BLE_CONTROL_RESPONSE] [opcode] [status] [data]
+    uint16_t response_len = ei_ble_control_execute(param, len, response);
+    *data_len = response_len - 3;
+    memcpy(data, &response[3], *data_len);
+
+    // the control status codes are the same as ei_framed_status_t
+    return (ei_framed_status_t)response[2];
+}
+
+static ei_framed_status_t read_buffer(const uint8_t *param, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+    EiDeviceMemory *memory = EiDeviceInfo::get_device()->get_memory();
+
+    if(len < 6) {
+        return EI_FRAMED_INVALID_PARAMETER;
+    }
+
+    uint32_t address = get_u32(param);
+    uint16_t length = param[4] | (param[5] << 8);
+    if(length > EI_FRAMED_MAX_DATA || address > memory->get_available_sample_bytes() ||
+       length > memory->get_available_sample_bytes() - address) {
+        return EI_FRAMED_INVALID_PARAMETER;
+    }
+
+    if(memory->read_sample_data(data, address, length) != length) {
+        return EI_FRAMED_FAILED;
+    }
+    *data_len = length;
+
+    return EI_FRAMED_SUCCESS;
+}
+
+static void run_frame(const uint8_t *frame, uint16_t len)
+{
+    uint8_t *data = &tx_frame[FRAME_HEADER_LEN];
+    uint16_t data_len = 0;
+    ei_framed_status_t status;
+
+    if(len < 2 + FRAME_CRC_LEN ||
+       get_u32(&frame[len - FRAME_CRC_LEN]) != ei_crc32_update(0, frame, len - FRAME_CRC_LEN)) {
+        tx_frame[0] = (len > 0) ? frame[0] : 0;
+        tx_frame[1] = EI_FRAMED_BAD_FRAME;
+        tx_frame[2] = EI_FRAMED_BAD_CRC;
+        tx_lock();
+        send_frame(tx_frame, FRAME_HEADER_LEN);
+        tx_unlock();
+        return;
+    }
+
+    uint8_t seq = frame[0];
+    uint8_t opcode = frame[1];
+    const uint8_t *param = &frame[2];
+    uint16_t param_len = len - 2 - FRAME_CRC_LEN;
+
+    switch(opcode) {
+        case EI_FRAMED_OP_INFO:
+            status = get_info(data, &data_len);
+            break;
+        case EI_FRAMED_OP_GET_CONFIG:
+            status = get_config(data, &data_len);
+            break;
+        case EI_FRAMED_OP_SET_SAMPLE:
+            status = set_sample(param, param_len);
+            break;
+        case EI_FRAMED_OP_SET_DEVICEID:
+            status = set_device_id(param, param_len);
+            break;
+        case EI_FRAMED_OP_CONTROL:
+            status = control(param, param_len, data, &data_len);
+            break;
+        case EI_FRAMED_OP_READ_BUFFER:
+            status = read_buffer(param, param_len, data, &data_len);
+            break;
+        case EI_FRAMED_OP_EXIT:
+            status = EI_FRAMED_SUCCESS;
+            break;
+        default:
+            status = EI_FRAMED_UNKNOWN_OPCODE;
+            break;
+    }
+
+    tx_lock();
+
+    // whatever the command printed comes first
+    log_flush();
+
+    tx_frame[0] = seq;
+    tx_frame[1] = opcode | EI_FRAMED_RESPONSE;
+    tx_frame[2] = status;
+    send_frame(tx_frame, FRAME_HEADER_LEN + data_len);
+
+    if(opcode == EI_FRAMED_OP_EXIT) {
+        ei_serial_flush();
+        active = false;
+    }
+
+    tx_unlock();
+}
+
+void ei_framed_start(void)
+{
+#ifdef FREERTOS_ENABLED
+    if(tx_mutex == NULL) {
+        tx_mutex = xSemaphoreCreateRecursiveMutex();
+    }
+#endif
+    rx_len = 0;
+    rx_overflow = false;
+    log_len = 0;
+    active = true;
+}
+
+bool ei_framed_is_active(void)
+{
+    return active;
+}
+
+void ei_framed_handle(uint8_t c)
+{
+    if(c != 0) {
+        if(rx_len < sizeof(rx_encoded)) {
+            rx_encoded[rx_len++] = c;
+        }
+        else {
+            rx_overflow = true;
+        }
+        return;
+    }
+
+    // 0x00 ends a frame, an empty one is just a delimiter
+    if(rx_len > 0 && rx_overflow == false) {
+        int len = cobs_decode(rx_encoded, rx_len, rx_frame, sizeof(rx_frame));
+        run_frame(rx_frame, (len < 0) ? 0 : (uint16_t)len);
+    }
+    rx_len = 0;
+    rx_overflow = false;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_FRAMED_PROTOCOL_H
+#define EI_FRAMED_PROTOCOL_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+
+/**
+ * Framed serial protocol for automated testing, entered with AT+FRAMED.
+ * Every frame is COBS encoded and ends with a 0x00 byte. Decoded:
+ *
+ *   request    [seq u8] [opcode u8] [parameters] [CRC-32 u32]
+ *   response   [seq u8] [opcode | EI_FRAMED_RESPONSE] [status u8] [data] [CRC-32 u32]
+ *   log        [0] [EI_FRAMED_LOG] [0] [text] [CRC-32 u32]
+ *
+ * The CRC-32 (as zlib.crc32) covers everything before it, all fields are
+ * little endian, a string is [length u8] [bytes] (no NUL). A response
+ * whose strings do not fit in EI_FRAMED_MAX_DATA has status
+ * EI_FRAMED_FAILED and no data. There is no echo; text
+ * the firmware prints (inference results, errors) comes as log frames,
+ * one per line. A frame with a bad CRC is answered with opcode
+ * EI_FRAMED_BAD_FRAME and the seq byte as received.
+ *
+ * INFO         data: [version u8] [max data u16] [device id str] [device type str]
+ * GET_CONFIG   data: [interval ms f32] [length ms u32] [label str] [upload host str]
+ *              [upload path str]
+ * SET_SAMPLE   [interval ms f32] [length ms u32] [label str], as AT+SAMPLESETTINGS,
+ *              the label is at most EI_FRAMED_MAX_LABEL bytes (the config field)
+ * SET_DEVICEID [device id str]
+ * CONTROL      a Control Point command (see ei_ble_control.h), status and
+ *              data are those of its response
+ * READ_BUFFER  [address u32] [length u16], data: the sample bytes (raw, not base64)
+ * EXIT         back to the AT shell after the response
+ */
+
+#define EI_FRAMED_VERSION           1
+
+#define EI_FRAMED_OP_INFO           0x01
+#define EI_FRAMED_OP_GET_CONFIG     0x02
+#define EI_FRAMED_OP_SET_SAMPLE     0x03
+#define EI_FRAMED_OP_SET_DEVICEID   0x04
+#define EI_FRAMED_OP_CONTROL        0x05
+#define EI_FRAMED_OP_READ_BUFFER    0x06
+#define EI_FRAMED_OP_EXIT           0x07
+
+#define EI_FRAMED_RESPONSE          0x80
+#define EI_FRAMED_LOG               0xC0
+#define EI_FRAMED_BAD_FRAME         0xFF
+
+typedef enum {
+    EI_FRAMED_SUCCESS = 0,
+    EI_FRAMED_UNKNOWN_OPCODE,
+    EI_FRAMED_INVALID_PARAMETER,
+    EI_FRAMED_BUSY,
+    EI_FRAMED_FAILED,
+    EI_FRAMED_BAD_CRC,
+} ei_framed_status_t;
+
+/* largest data field of a frame, READ_BUFFER length */
+#define EI_FRAMED_MAX_DATA          512
+/* longest SET_SAMPLE label, as EiConfig stores it with its NUL */
+#define EI_FRAMED_MAX_LABEL         127
+
+void ei_framed_start(void);
+bool ei_framed_is_active(void);
+
+/**
+ * @brief Feed a byte received on the UART, a complete frame is run and
+ *        answered right away
+ */
+void ei_framed_handle(uint8_t c);
+
+/**
+ * @brief Text printed while framed mode is active (ei_printf), sent as log
+ *        frames line by line. Safe to call from any task.
+ * @return false when framed mode is not active, the text was not taken
+ */
+bool ei_framed_log(const char *text);
+
+#endif /* EI_FRAMED_PROTOCOL_H */
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "ei_hmac_sha256.h"
+
+/******
+ *
+ * @brief HMAC-SHA256 (RFC 2104) over a SHA-256 engine:
+ *        H((K ^ opad) || H((K ^ ipad) || message))
+ *
+ ******/
+
+#define HMAC_IPAD   0x36
+#define HMAC_OPAD   0x5C
+
+static int sw_start(void *state)
+{
+    ei_sha256_start((ei_sha256_ctx_t *)state);
+
+    return 0;
+}
+
+static int sw_update(void *state, const uint8_t *data, size_t len)
+{
+    ei_sha256_update((ei_sha256_ctx_t *)state, data, len);
+
+    return 0;
+}
+
+static int sw_finish(void *state, uint8_t *digest)
+{
+    ei_sha256_finish((ei_sha256_ctx_t *)state, digest);
+
+    return 0;
+}
+
+static void sw_release(void *state)
+{
+    (void)state;
+}
+
+static const ei_sha256_backend_t sw_backend = {
+    "software",
+    &sw_start,
+    &sw_update,
+    &sw_finish,
+    &sw_release,
+};
+
+const ei_sha256_backend_t *ei_sha256_sw_backend(void)
+{
+    return &sw_backend;
+}
+
+__attribute__((weak)) const ei_sha256_backend_t *ei_sha256_hw_backend(void)
+{
+    return NULL;
+}
+
+/* key block XOR pad, the key is never longer than a block here */
+static void key_block(const ei_hs256_ctx_t *hs_ctx, uint8_t pad, uint8_t *block)
+{
+    size_t key_len = strlen(hs_ctx->hmac_key);
+
+    memset(block, pad, EI_SHA256_BLOCK_SIZE);
+    for(size_t ix = 0; ix < key_len; ix++) {
+        block[ix] ^= (uint8_t)hs_ctx->hmac_key[ix];
+    }
+}
+
+static int batch_flush(ei_hs256_ctx_t *hs_ctx)
+{
+    int ret = 0;
+
+    if(hs_ctx->batch_len > 0) {
+        ret = hs_ctx->backend->update(&hs_ctx->state, hs_ctx->batch, hs_ctx->batch_len);
+        hs_ctx->batch_len = 0;
+    }
+
+    return ret;
+}
+
+static int ei_hs256_init(sensor_aq_signing_ctx_t *aq_ctx)
+{
+    ei_hs256_ctx_t *hs_ctx = (ei_hs256_ctx_t *)aq_ctx->ctx;
+    uint8_t block[EI_SHA256_BLOCK_SIZE];
+
+    // the crypto block signs one thing at a time, others use software
+    ei_hs256_release(hs_ctx);
+    hs_ctx->backend = ei_sha256_hw_backend();
+    if(hs_ctx->backend == NULL || hs_ctx->backend->start(&hs_ctx->state) != 0) {
+        hs_ctx->backend = &sw_backend;
+        if(hs_ctx->backend->start(&hs_ctx->state) != 0) {
+            return -1;
+        }
+    }
+    hs_ctx->batch_len = 0;
+
+    key_block(hs_ctx, HMAC_IPAD, block);
+
+    return hs_ctx->backend->update(&hs_ctx->state, block, sizeof(block));
+}
+
+static int ei_hs256_update(sensor_aq_signing_ctx_t *aq_ctx, const uint8_t *buffer, size_t buffer_size)
+{
+    ei_hs256_ctx_t *hs_ctx = (ei_hs256_ctx_t *)aq_ctx->ctx;
+    int ret = 0;
+
+    if(hs_ctx->batch_len + buffer_size > EI_HS256_BATCH_SIZE) {
+        ret = batch_flush(hs_ctx);
+    }
+
+    if(buffer_size >= EI_HS256_BATCH_SIZE) {
+        return (ret != 0) ? ret : hs_ctx->backend->update(&hs_ctx->state, buffer, buffer_size);
+    }
+
+    memcpy(&hs_ctx->batch[hs_ctx->batch_len], buffer, buffer_size);
+    hs_ctx->batch_len += buffer_size;
+
+    return ret;
+}
+
+static int ei_hs256_finish(sensor_aq_signing_ctx_t *aq_ctx, uint8_t *buffer)
+{
+    ei_hs256_ctx_t *hs_ctx = (ei_hs256_ctx_t *)aq_ctx->ctx;
+    uint8_t block[EI_SHA256_BLOCK_SIZE];
+    uint8_t inner[EI_SHA256_DIGEST_SIZE];
+    int ret;
+
+    ret = batch_flush(hs_ctx);
+    // finish releases the engine, even after an error
+    if(hs_ctx->backend->finish(&hs_ctx->state, inner) != 0 || ret != 0) {
+        return -1;
+    }
+
+    // the outer hash is two blocks, done in software so it can't fail on
+    // an engine another context took after the inner hash released it
+    key_block(hs_ctx, HMAC_OPAD, block);
+
+    ei_sha256_start(&hs_ctx->state);
+    ei_sha256_update(&hs_ctx->state, block, sizeof(block));
+    ei_sha256_update(&hs_ctx->state, inner, sizeof(inner));
+    ei_sha256_finish(&hs_ctx->state, buffer);
+
+    return 0;
+}
+
+void ei_hs256_release(ei_hs256_ctx_t *hs_ctx)
+{
+    const ei_sha256_backend_t *hw = ei_sha256_hw_backend();
+
+    // only compares the state address, hs_ctx may not be initialized yet
+    if(hw != NULL) {
+        hw->release(&hs_ctx->state);
+    }
+    hs_ctx->backend = &sw_backend;
+    hs_ctx->batch_len = 0;
+}
+
+void ei_hs256_init_context(sensor_aq_signing_ctx_t *aq_ctx, ei_hs256_ctx_t *hs_ctx, const char *hmac_key)
+{
+    ei_hs256_release(hs_ctx);
+
+    strncpy(hs_ctx->hmac_key, hmac_key, EI_HS256_KEY_MAX);
+    hs_ctx->hmac_key[EI_HS256_KEY_MAX] = 0;
+
+    if(strlen(hmac_key) > EI_HS256_KEY_MAX) {
+        ei_printf("ERR: HMAC key is longer than %d characters, truncated\n", EI_HS256_KEY_MAX);
+    }
+
+    aq_ctx->alg = "HS256"; // JWS algorithm
+    aq_ctx->signature_length = EI_SHA256_DIGEST_SIZE;
+    aq_ctx->ctx = (void *)hs_ctx;
+    aq_ctx->init = &ei_hs256_init;
+    aq_ctx->set_protected = NULL;
+    aq_ctx->update = &ei_hs256_update;
+    aq_ctx->finish = &ei_hs256_finish;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_HMAC_SHA256_H
+#define EI_HMAC_SHA256_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include <cstddef>
+#include "firmware-sdk/sensor_aq.h"
+#include "ei_sha256.h"
+
+/**
+ * HS256 signing context for sensor_aq (and the model store) with a
+ * pluggable SHA-256 engine: the PSoC 6 crypto block when it is free,
+ * the software SHA-256 (ei_sha256.h) otherwise (and on the host).
+ * sensor_aq signs every sample value on its own, a few bytes at a time;
+ * updates are collected in a batch buffer so the engine sees blocks of
+ * EI_HS256_BATCH_SIZE instead. Larger updates go to the engine directly.
+ * The engine only hashes the message, the two block outer hash is always
+ * done in software.
+ */
+#define EI_HS256_BATCH_SIZE         256
+#define EI_HS256_KEY_MAX            32      // as sensor_aq_mbedtls_hs256
+
+typedef struct {
+    const char *name;
+    /* return 0 if OK, start fails if the engine is in use */
+    int (*start)(void *state);
+    int (*update)(void *state, const uint8_t *data, size_t len);
+    int (*finish)(void *state, uint8_t *digest);
+    /* drop a hash that is not finished, frees the engine if state holds it */
+    void (*release)(void *state);
+} ei_sha256_backend_t;
+
+typedef struct {
+    const ei_sha256_backend_t *backend;
+    ei_sha256_ctx_t state;                  // software engine state
+    char hmac_key[EI_HS256_KEY_MAX + 1];
+    uint8_t batch[EI_HS256_BATCH_SIZE];
+    size_t batch_len;
+} ei_hs256_ctx_t;
+
+/**
+ * @brief Construct an HS256 signing context, same use as
+ *        sensor_aq_init_mbedtls_hs256_context (the key is limited to 32
+ *        characters)
+ */
+void ei_hs256_init_context(sensor_aq_signing_ctx_t *aq_ctx, ei_hs256_ctx_t *hs_ctx, const char *hmac_key);
+
+/**
+ * @brief Give up a signature that will not be finished (capture aborted),
+ *        so the crypto block is free for the next one. Also done by
+ *        ei_hs256_init_context() and init on the same context.
+ */
+void ei_hs256_release(ei_hs256_ctx_t *hs_ctx);
+
+const ei_sha256_backend_t *ei_sha256_sw_backend(void);
+
+/**
+ * @brief The hardware engine, the weak version returns NULL (no crypto
+ *        block, the host build)
+ */
+const ei_sha256_backend_t *ei_sha256_hw_backend(void);
+
+#endif /* EI_HMAC_SHA256_H */
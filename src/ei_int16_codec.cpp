@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "ei_int16_codec.h"
+
+/******
+ *
+ * @brief Saturating int16 quantization and zigzag varints
+ *
+ ******/
+
+int16_t ei_quantize_int16(float value, float scale, uint32_t *saturated)
+{
+    float scaled = value * scale;
+
+    if(scaled >= (float)INT16_MAX) {
+        if(saturated != NULL) {
+            (*saturated)++;
+        }
+        return INT16_MAX;
+    }
+    if(scaled <= (float)INT16_MIN) {
+        if(saturated != NULL) {
+            (*saturated)++;
+        }
+        return INT16_MIN;
+    }
+    return (int16_t)(scaled + ((scaled < 0.0f) ? -0.5f : 0.5f));
+}
+
+size_t ei_varint_put(uint8_t *out, int32_t value)
+{
+    uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    size_t len = 0;
+
+    while(zigzag >= 0x80) {
+        out[len++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    out[len++] = (uint8_t)zigzag;
+
+    return len;
+}
+
+size_t ei_varint_get(const uint8_t *in, size_t len, int32_t *value)
+{
+    uint32_t zigzag = 0;
+
+    for(size_t ix = 0; ix < len && ix < EI_VARINT_MAX_LEN; ix++) {
+        zigzag |= (uint32_t)(in[ix] & 0x7f) << (7 * ix);
+        if((in[ix] & 0x80) == 0) {
+            *value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+            return ix + 1;
+        }
+    }
+
+    return 0;
+}
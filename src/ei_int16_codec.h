@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_INT16_CODEC_H
+#define EI_INT16_CODEC_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Value coding shared by the compact sample files (ei_sample_format.h) and
+ * the BLE raw stream (ei_ble_stream.h): readings scaled and rounded to a
+ * saturated int16, differences of those as zigzag varints (7 bits per
+ * byte, least significant group first, high bit set on all but the last).
+ */
+/* zigzag varint of a 17 bit difference */
+#define EI_VARINT_MAX_LEN           3
+
+/**
+ * @brief value * scale rounded to the nearest int16
+ * @param saturated incremented when the value is clipped, may be NULL
+ */
+int16_t ei_quantize_int16(float value, float scale, uint32_t *saturated);
+
+/**
+ * @return bytes written to out (at most 5, EI_VARINT_MAX_LEN for the
+ *         difference of two int16)
+ */
+size_t ei_varint_put(uint8_t *out, int32_t value);
+
+/**
+ * @return bytes used, 0 if in holds no complete varint of at most
+ *         EI_VARINT_MAX_LEN bytes
+ */
+size_t ei_varint_get(const uint8_t *in, size_t len, int32_t *value);
+
+#endif /* EI_INT16_CODEC_H */
@@ -23,31 +23,14 @@
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
 #include "edge-impulse-sdk/dsp/numpy.hpp"
 #include "firmware-sdk/sensor_aq.h"
-#include "ei_device_psoc62.h"
+#include "firmware-sdk/ei_device_info_lib.h"
 #include "ei_microphone.h"
+#include "ei_microphone_pdm.h"
 #include "sensor_aq_none.h"
-#include "sensor_aq_mbedtls_hs256.h"
-#include "cy_pdl.h"
-#include "cyhal.h"
-#include "cybsp.h"
-#include "cyhal_clock.h"
-#include "cyhal_pdmpcm.h"
+#include "ei_sample_signing.h"
 #include <stdint.h>
 #include <stdlib.h>
 
-/* AUDIO SYSTEM CONSTANTS */
-/* Audio Subsystem Clock. Typical values depends on the desire sample rate:
-- 8/16/48kHz    : 24.576 MHz
-- 22.05/44.1kHz : 22.579 MHz */
-#define AUDIO_SYS_CLOCK_HZ          24576000u
-/* Decimation Rate of the PDM/PCM block. Typical value is 64 */
-#define DECIMATION_RATE             64u
-/* PDM/PCM Pins */
-#define PDM_CLK     P10_4
-#define PDM_DATA    P10_5
-/* this is variable, received from studio */
-#define PDM_DEFAULT_FREQ_HZ (16000UL)
-
 /* Microphone takes about 100ms settling time */
 #define MICROPHONE_SETTLE_TIME 300 /* triple this to be safe */
 
@@ -62,19 +45,6 @@
 #define SINGLE_BUFFER_SAMPLES   (SINGLE_BUFFER_SIZE / sizeof(microphone_sample_t))
 
 /* LOCAL VARIABLES */
-static cyhal_clock_t audio_clock;
-/* PDM interface object */
-static cyhal_pdm_pcm_t pdm_pcm;
-/* Basic configuration */
-static cyhal_pdm_pcm_cfg_t pdm_pcm_cfg = {
-            .sample_rate     = PDM_DEFAULT_FREQ_HZ,
-            .decimation_rate = DECIMATION_RATE,
-            .mode            = CYHAL_PDM_PCM_MODE_LEFT,
-            .word_length     = sizeof(microphone_sample_t) * 8,  /* bits */
-            .left_gain       = 20,   /* dB */
-            .right_gain      = 0,   /* dB */
-};
-
 /* Sampling related variables */
 static volatile bool pdm_pcm_flag = false;
 static int16_t *readyBuffer;
@@ -101,7 +71,7 @@ static int ei_seek(EI_SENSOR_AQ_STREAM*, long int offset, int origin);
 
 static unsigned char ei_mic_ctx_buffer[1024];
 static sensor_aq_signing_ctx_t ei_mic_signing_ctx;
-static sensor_aq_mbedtls_hs256_ctx_t ei_mic_hs_ctx;
+static ei_hs256_ctx_t ei_mic_hs_ctx;
 static sensor_aq_ctx ei_mic_ctx = {
     { ei_mic_ctx_buffer, 1024 },
     &ei_mic_signing_ctx,
@@ -124,55 +94,7 @@ static int ei_seek(EI_SENSOR_AQ_STREAM*, long int offset, int origin)
 
 /****************************** PDM RELATED FUNCTIONS *******************************************************/
 
-bool ei_microphone_pdm_init(void)
-{
-    cyhal_clock_t pll_clock;
-
-    /* Initialize the PLL */
-    cyhal_clock_reserve(&pll_clock, &CYHAL_CLOCK_PLL[0]);
-    cyhal_clock_set_frequency(&pll_clock, AUDIO_SYS_CLOCK_HZ, NULL);
-    cyhal_clock_set_enabled(&pll_clock, true, true);
-    cyhal_clock_free(&pll_clock);
-
-    /* Initialize the audio subsystem clock HF[1] */
-    cyhal_clock_reserve(&audio_clock, &CYHAL_CLOCK_HF[1]);
-
-    /* Source the audio subsystem clock from PLL */
-    cyhal_clock_set_source(&audio_clock, &pll_clock);
-    cyhal_clock_set_enabled(&audio_clock, true, true);
-
-    return true;
-}
-
-static bool pdm_configure(uint32_t sample_rate, cyhal_pdm_pcm_event_callback_t pdm_callback)
-{
-    cy_rslt_t result = CY_RSLT_SUCCESS;
-    // set sample rate
-    pdm_pcm_cfg.sample_rate = sample_rate;
-
-    // set PDM configuration
-    result = cyhal_pdm_pcm_init(&pdm_pcm, PDM_DATA, PDM_CLK, &audio_clock, &pdm_pcm_cfg);
-    if(result != CY_RSLT_SUCCESS) {
-        ei_printf("ERR: failed to configure PDM (0x%04lx)\n", result);
-        return false;
-    }
-
-    // register callback
-    cyhal_pdm_pcm_register_callback(&pdm_pcm, pdm_callback, NULL);
-    // callback called when async operation is complete (all data received)
-    cyhal_pdm_pcm_enable_event(&pdm_pcm, CYHAL_PDM_PCM_ASYNC_COMPLETE, CYHAL_ISR_PRIORITY_DEFAULT, false);
-
-    // start PDM
-    result = cyhal_pdm_pcm_start(&pdm_pcm);
-    if(result != CY_RSLT_SUCCESS)
-    {
-        ei_printf("ERR: PDM interface init failed (0x%04lx)!\n", result);
-        return false;
-    }
-    return true;
-}
-
-void ingestion_isr_handler(void *arg, cyhal_pdm_pcm_event_t event)
+static void ingestion_isr_handler(void)
 {
     static bool ping_pong = false;
 
@@ -184,14 +106,14 @@ void ingestion_isr_handler(void *arg, cyhal_pdm_pcm_event_t event)
     if(ping_pong)
     {
         /* Write next frame to ping buffer */
-        cyhal_pdm_pcm_read_async(&pdm_pcm, bufOne, SINGLE_BUFFER_SAMPLES);
+        ei_pdm_read_async(bufOne, SINGLE_BUFFER_SAMPLES);
         /* Setup the pong buffer to be read */
         readyBuffer = bufTwo;
     }
     else
     {
         /* Write next frame to pong buffer */
-        cyhal_pdm_pcm_read_async(&pdm_pcm, bufTwo, SINGLE_BUFFER_SAMPLES);
+        ei_pdm_read_async(bufTwo, SINGLE_BUFFER_SAMPLES);
         /* Setup the ping buffer to be read */
         readyBuffer = bufOne;
     }
@@ -202,13 +124,17 @@ void ingestion_isr_handler(void *arg, cyhal_pdm_pcm_event_t event)
 
 /****************************** INGESTION RELATED FUNCTIONS *************************************************/
 
-static void ingestion_process(uint32_t n_bytes)
+static void ingestion_process(uint32_t n_bytes, uint32_t required_bytes)
 {
-    EiDevicePSoC62* dev = static_cast<EiDevicePSoC62*>(EiDevicePSoC62::get_device());
+    EiDeviceInfo* dev = EiDeviceInfo::get_device();
     EiDeviceMemory* mem = dev->get_memory();
 
     if(readyBuffer != NULL) {
         mem->write_sample_data((const uint8_t *)readyBuffer, headerOffset + collected_bytes, n_bytes);
+
+        // sign what is uploaded, the last buffer can run past the sample length
+        uint32_t signed_bytes = (collected_bytes + n_bytes > required_bytes) ? required_bytes - collected_bytes : n_bytes;
+        ei_mic_ctx.signature_ctx->update(ei_mic_ctx.signature_ctx, (const uint8_t *)readyBuffer, signed_bytes);
     }
 
     collected_bytes += n_bytes;
@@ -237,13 +163,12 @@ static int insert_ref(char *buffer, int hdrLength)
 static bool create_header(void)
 {
     int ret;
-    EiDevicePSoC62* dev = static_cast<EiDevicePSoC62*>(EiDevicePSoC62::get_device());
-    EiDeviceMemory* mem = dev->get_memory();
+    EiDeviceInfo* dev = EiDeviceInfo::get_device();
     const char *device_name = dev->get_device_id().c_str();
     const char *device_type = dev->get_device_type().c_str();
     float interval_ms = dev->get_sample_interval_ms();
 
-    sensor_aq_init_mbedtls_hs256_context(&ei_mic_signing_ctx, &ei_mic_hs_ctx, dev->get_sample_hmac_key().c_str());
+    ei_signing_init_context(&ei_mic_signing_ctx, &ei_mic_hs_ctx, dev->get_sample_hmac_key().c_str());
 
     sensor_aq_payload_info payload = {
         device_name,
@@ -275,13 +200,13 @@ static bool create_header(void)
 
     int ref_size = insert_ref(((char*)ei_mic_ctx.cbor_buffer.ptr + end_of_header_ix), end_of_header_ix);
 
-    end_of_header_ix += ref_size;
+    ei_mic_ctx.signature_ctx->update(ei_mic_ctx.signature_ctx,
+        (uint8_t*)ei_mic_ctx.cbor_buffer.ptr + end_of_header_ix, ref_size);
 
-    // Write to blockdevice
-    ret = mem->write_sample_data((uint8_t*)ei_mic_ctx.cbor_buffer.ptr, 0, end_of_header_ix);
+    end_of_header_ix += ref_size;
 
-    if (ret != (int)end_of_header_ix) {
-        ei_printf("Failed to write to header blockdevice (%d)\n", ret);
+    // Write to blockdevice, the signature is written when sampling is done
+    if (ei_signing_write_header(&ei_mic_ctx, end_of_header_ix) == false) {
         return false;
     }
 
@@ -292,9 +217,8 @@ static bool create_header(void)
 
 bool ei_microphone_sample_start(void)
 {
-    EiDevicePSoC62* dev = static_cast<EiDevicePSoC62*>(EiDevicePSoC62::get_device());
+    EiDeviceInfo* dev = EiDeviceInfo::get_device();
     EiDeviceMemory* mem = dev->get_memory();
-    cy_rslt_t result;
     uint32_t required_samples, required_bytes;
 
     ei_printf("Sampling settings:\n");
@@ -335,19 +259,23 @@ bool ei_microphone_sample_start(void)
         ei_sleep(2000 - delay_time_ms);
     }
 
-    pdm_configure((uint32_t)(1000.f / dev->get_sample_interval_ms()), ingestion_isr_handler);
+    ei_pdm_start((uint32_t)(1000.f / dev->get_sample_interval_ms()), ingestion_isr_handler);
 
-    create_header();
+    if(create_header() == false) {
+        ei_pdm_stop();
+        // the signature was started, free the crypto block for the next one
+        ei_hs256_release(&ei_mic_hs_ctx);
+        return false;
+    }
 
     // discard first mic data, because it takes about 100ms for the mic to settle
-    cyhal_pdm_pcm_read_async(&pdm_pcm, bufOne, SINGLE_BUFFER_SAMPLES);
+    ei_pdm_read_async(bufOne, SINGLE_BUFFER_SAMPLES);
     ei_sleep(MICROPHONE_SETTLE_TIME);
-    cyhal_pdm_pcm_abort_async(&pdm_pcm);
+    ei_pdm_abort_async();
     // enable PDM async sampling
-    cyhal_pdm_pcm_enable_event(&pdm_pcm, CYHAL_PDM_PCM_ASYNC_COMPLETE, CYHAL_ISR_PRIORITY_DEFAULT, true);
+    ei_pdm_enable_event(true);
     // now start normal data collection
-    result = cyhal_pdm_pcm_read_async(&pdm_pcm, bufOne, SINGLE_BUFFER_SAMPLES);
-    if(result != CY_RSLT_SUCCESS) {
+    if(ei_pdm_read_async(bufOne, SINGLE_BUFFER_SAMPLES) == false) {
         ei_printf("ERR: no audio data!\n");
     }
 
@@ -358,19 +286,25 @@ bool ei_microphone_sample_start(void)
     while (collected_bytes < required_bytes) {
         if(pdm_pcm_flag) {
             pdm_pcm_flag = false;
-            ingestion_process(SINGLE_BUFFER_SIZE);
+            ingestion_process(SINGLE_BUFFER_SIZE, required_bytes);
+        }
+        else {
+            ei_sleep(1);
         }
     }
 
-    cyhal_pdm_pcm_abort_async(&pdm_pcm);
-    cyhal_pdm_pcm_stop(&pdm_pcm);
-    cyhal_pdm_pcm_free(&pdm_pcm);
+    ei_pdm_abort_async();
+    ei_pdm_stop();
 
     // we collect multiply of SINGLE_BUFFER_SAMPLES, if user requested less we have to adjust collected_bytes
     if(collected_bytes > required_bytes) {
         collected_bytes = required_bytes;
     }
 
+    if(ei_signing_finish(&ei_mic_ctx, collected_bytes + headerOffset) == false) {
+        return false;
+    }
+
     ei_printf("Done sampling, total bytes collected: %lu\n", collected_bytes);
     ei_printf("[1/1] Uploading file to Edge Impulse...\n");
     ei_printf("Not uploading file, not connected to WiFi. Used buffer, from=0, to=%lu.\n", collected_bytes + headerOffset);
@@ -382,13 +316,13 @@ bool ei_microphone_sample_start(void)
 
 /****************************** INFERENCE RELATED FUNCTIONS *************************************************/
 
-void inference_isr_handler(void *arg, cyhal_pdm_pcm_event_t event)
+static void inference_isr_handler(void)
 {
     /* swap inference buffers */
     inference.buf_select ^= 1;
 
     /* Write next frame to ping buffer */
-    cyhal_pdm_pcm_read_async(&pdm_pcm, inference.buffers[inference.buf_select], inference.n_samples);
+    ei_pdm_read_async(inference.buffers[inference.buf_select], inference.n_samples);
 
     /* mark buffer ready */
     inference.buf_ready = 1;
@@ -404,8 +338,7 @@ int ei_microphone_inference_get_data(size_t offset, size_t length, float *out_pt
 
 bool ei_microphone_inference_start(uint32_t n_samples, float interval_ms)
 {
-    EiDevicePSoC62* dev = static_cast<EiDevicePSoC62*>(EiDevicePSoC62::get_device());
-    cy_rslt_t result;
+    EiDeviceInfo* dev = EiDeviceInfo::get_device();
 
     inference.buffers[0] = (microphone_sample_t*)ei_malloc(n_samples * sizeof(microphone_sample_t));
     if(inference.buffers[0] == NULL) {
@@ -426,11 +359,10 @@ bool ei_microphone_inference_start(uint32_t n_samples, float interval_ms)
     inference.n_samples  = n_samples;
     inference.buf_ready  = 0;
 
-    pdm_configure((uint32_t)(1000.0f / dev->get_sample_interval_ms()), inference_isr_handler);
-    cyhal_pdm_pcm_enable_event(&pdm_pcm, CYHAL_PDM_PCM_ASYNC_COMPLETE, CYHAL_ISR_PRIORITY_DEFAULT, true);
+    ei_pdm_start((uint32_t)(1000.0f / dev->get_sample_interval_ms()), inference_isr_handler);
+    ei_pdm_enable_event(true);
 
-    result = cyhal_pdm_pcm_read_async(&pdm_pcm, inference.buffers[0], n_samples);
-    if(result != CY_RSLT_SUCCESS) {
+    if(ei_pdm_read_async(inference.buffers[0], n_samples) == false) {
         ei_printf("ERR: no audio data!\n");
         return false;
     }
@@ -451,9 +383,8 @@ void ei_microphone_inference_reset_buffers(void)
 
 bool ei_microphone_inference_end(void)
 {
-    cyhal_pdm_pcm_abort_async(&pdm_pcm);
-    cyhal_pdm_pcm_stop(&pdm_pcm);
-    cyhal_pdm_pcm_free(&pdm_pcm);
+    ei_pdm_abort_async();
+    ei_pdm_stop();
 
     ei_free(inference.buffers[0]);
     ei_free(inference.buffers[1]);
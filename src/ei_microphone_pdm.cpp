@@ -0,0 +1,138 @@
+/* Edge Impulse ingestion SDK
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "ei_microphone.h"
+#include "ei_microphone_pdm.h"
+#include "cy_pdl.h"
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cyhal_clock.h"
+#include "cyhal_pdmpcm.h"
+
+/* AUDIO SYSTEM CONSTANTS */
+/* Audio Subsystem Clock. Typical values depends on the desire sample rate:
+- 8/16/48kHz    : 24.576 MHz
+- 22.05/44.1kHz : 22.579 MHz */
+#define AUDIO_SYS_CLOCK_HZ          24576000u
+/* Decimation Rate of the PDM/PCM block. Typical value is 64 */
+#define DECIMATION_RATE             64u
+/* PDM/PCM Pins */
+#define PDM_CLK     P10_4
+#define PDM_DATA    P10_5
+/* this is variable, received from studio */
+#define PDM_DEFAULT_FREQ_HZ (16000UL)
+
+/* LOCAL VARIABLES */
+static cyhal_clock_t audio_clock;
+/* PDM interface object */
+static cyhal_pdm_pcm_t pdm_pcm;
+/* Basic configuration */
+static cyhal_pdm_pcm_cfg_t pdm_pcm_cfg = {
+            .sample_rate     = PDM_DEFAULT_FREQ_HZ,
+            .decimation_rate = DECIMATION_RATE,
+            .mode            = CYHAL_PDM_PCM_MODE_LEFT,
+            .word_length     = sizeof(microphone_sample_t) * 8,  /* bits */
+            .left_gain       = 20,   /* dB */
+            .right_gain      = 0,   /* dB */
+};
+/* Read complete callback of the current user (ingestion or inference) */
+static pdm_read_complete_cb_t read_complete_cb;
+
+static void pdm_isr_handler(void *arg, cyhal_pdm_pcm_event_t event)
+{
+    if(read_complete_cb != NULL) {
+        read_complete_cb();
+    }
+}
+
+bool ei_microphone_pdm_init(void)
+{
+    cyhal_clock_t pll_clock;
+
+    /* Initialize the PLL */
+    cyhal_clock_reserve(&pll_clock, &CYHAL_CLOCK_PLL[0]);
+    cyhal_clock_set_frequency(&pll_clock, AUDIO_SYS_CLOCK_HZ, NULL);
+    cyhal_clock_set_enabled(&pll_clock, true, true);
+    cyhal_clock_free(&pll_clock);
+
+    /* Initialize the audio subsystem clock HF[1] */
+    cyhal_clock_reserve(&audio_clock, &CYHAL_CLOCK_HF[1]);
+
+    /* Source the audio subsystem clock from PLL */
+    cyhal_clock_set_source(&audio_clock, &pll_clock);
+    cyhal_clock_set_enabled(&audio_clock, true, true);
+
+    return true;
+}
+
+bool ei_pdm_start(uint32_t sample_rate, pdm_read_complete_cb_t callback)
+{
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+    // set sample rate
+    pdm_pcm_cfg.sample_rate = sample_rate;
+
+    // set PDM configuration
+    result = cyhal_pdm_pcm_init(&pdm_pcm, PDM_DATA, PDM_CLK, &audio_clock, &pdm_pcm_cfg);
+    if(result != CY_RSLT_SUCCESS) {
+        ei_printf("ERR: failed to configure PDM (0x%04lx)\n", result);
+        return false;
+    }
+
+    // register callback
+    read_complete_cb = callback;
+    cyhal_pdm_pcm_register_callback(&pdm_pcm, pdm_isr_handler, NULL);
+    // callback called when async operation is complete (all data received)
+    cyhal_pdm_pcm_enable_event(&pdm_pcm, CYHAL_PDM_PCM_ASYNC_COMPLETE, CYHAL_ISR_PRIORITY_DEFAULT, false);
+
+    // start PDM
+    result = cyhal_pdm_pcm_start(&pdm_pcm);
+    if(result != CY_RSLT_SUCCESS)
+    {
+        ei_printf("ERR: PDM interface init failed (0x%04lx)!\n", result);
+        return false;
+    }
+    return true;
+}
+
+bool ei_pdm_read_async(microphone_sample_t *buffer, size_t n_samples)
+{
+    return (cyhal_pdm_pcm_read_async(&pdm_pcm, buffer, n_samples) == CY_RSLT_SUCCESS);
+}
+
+void ei_pdm_abort_async(void)
+{
+    cyhal_pdm_pcm_abort_async(&pdm_pcm);
+}
+
+void ei_pdm_enable_event(bool enable)
+{
+    cyhal_pdm_pcm_enable_event(&pdm_pcm, CYHAL_PDM_PCM_ASYNC_COMPLETE, CYHAL_ISR_PRIORITY_DEFAULT, enable);
+}
+
+void ei_pdm_stop(void)
+{
+    cyhal_pdm_pcm_stop(&pdm_pcm);
+    cyhal_pdm_pcm_free(&pdm_pcm);
+    read_complete_cb = NULL;
+}
@@ -0,0 +1,45 @@
+/* Edge Impulse ingestion SDK
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef EI_MICROPHONE_PDM_H
+#define EI_MICROPHONE_PDM_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include <cstdlib>
+#include "ei_microphone.h"
+
+/**
+ * Called (from interrupt context) when an asynchronous read
+ * started with ei_pdm_read_async() has filled the whole buffer.
+ */
+typedef void (*pdm_read_complete_cb_t)(void);
+
+/* Function prototypes ----------------------------------------------------- */
+bool ei_pdm_start(uint32_t sample_rate, pdm_read_complete_cb_t callback);
+bool ei_pdm_read_async(microphone_sample_t *buffer, size_t n_samples);
+void ei_pdm_abort_async(void);
+void ei_pdm_enable_event(bool enable);
+void ei_pdm_stop(void);
+
+#endif
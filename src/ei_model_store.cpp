@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "firmware-sdk/ei_device_info_lib.h"
+#include "firmware-sdk/ei_device_lib.h"
+#include "ei_hmac_sha256.h"
+#include "ei_model_store.h"
+
+/******
+ *
+ * @brief Model slots in the external flash, see ei_model_store.h for the
+ *        layout. Addresses are relative to the sample area, the store
+ *        starts where get_available_sample_bytes() ends.
+ *
+ ******/
+
+#define SLOT_MAGIC          0x444D4945  // "EIMD"
+#define SELECTOR_MAGIC      0x4C534945  // "EISL"
+#define ERASED_WORD         0xFFFFFFFF
+#define IO_CHUNK            512
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;
+    uint8_t slot;
+    uint8_t reserved[3];
+    uint32_t crc;           // CRC-32 of the fields above
+} selector_record_t;
+
+typedef struct {
+    bool active;
+    uint8_t slot;
+    uint32_t length;
+    uint32_t crc32;
+    uint32_t version;
+    uint32_t received;
+} update_state_t;
+
+static ei_model_info_t active = { EI_MODEL_NO_SLOT, 0, 0, 0 };
+static uint8_t selector_block = 0;      // block the records are appended to
+static uint32_t selector_next = 0;      // offset of the first free selector record
+static update_state_t update;
+static uint8_t io_buffer[IO_CHUNK];
+#ifdef EI_MODEL_SIGNING_KEY
+static const char model_key[] = EI_MODEL_SIGNING_KEY;
+#else
+static const char model_key[] = "";
+#endif
+
+static EiDeviceMemory *get_memory(void)
+{
+    return EiDeviceInfo::get_device()->get_memory();
+}
+
+static uint32_t selector_address(EiDeviceMemory *mem, uint8_t block)
+{
+    return mem->get_available_sample_bytes() + block * mem->block_size;
+}
+
+static uint32_t slot_address(EiDeviceMemory *mem, uint8_t slot)
+{
+    return selector_address(mem, 0) + (EI_MODEL_SELECTOR_BLOCKS + slot * EI_MODEL_SLOT_BLOCKS) * mem->block_size;
+}
+
+static uint32_t slot_capacity(EiDeviceMemory *mem)
+{
+    return EI_MODEL_SLOT_BLOCKS * mem->block_size - EI_MODEL_SLOT_DATA_OFFSET;
+}
+
+static bool read_header(EiDeviceMemory *mem, uint8_t slot, ei_model_slot_header_t *header)
+{
+    if(mem->read_sample_data((uint8_t *)header, slot_address(mem, slot), sizeof(*header)) != sizeof(*header)) {
+        return false;
+    }
+
+    return header->magic == SLOT_MAGIC &&
+           header->header_crc == ei_crc32_update(0, (const uint8_t *)header, offsetof(ei_model_slot_header_t, header_crc)) &&
+           header->length <= slot_capacity(mem);
+}
+
+static bool append_selector(EiDeviceMemory *mem, uint8_t slot, uint32_t seq)
+{
+    selector_record_t record;
+
+    if(selector_next + sizeof(record) > mem->block_size) {
+        // full, continue in the other block, the current record stays valid
+        uint8_t next_block = (selector_block + 1) % EI_MODEL_SELECTOR_BLOCKS;
+        if(mem->erase_sample_data(selector_address(mem, next_block), mem->block_size) != mem->block_size) {
+            return false;
+        }
+        selector_block = next_block;
+        selector_next = 0;
+    }
+
+    record.magic = SELECTOR_MAGIC;
+    record.seq = seq;
+    record.slot = slot;
+    memset(record.reserved, 0xFF, sizeof(record.reserved));
+    record.crc = ei_crc32_update(0, (const uint8_t *)&record, offsetof(selector_record_t, crc));
+
+    if(mem->write_sample_data((const uint8_t *)&record, selector_address(mem, selector_block) + selector_next, sizeof(record)) != sizeof(record)) {
+        return false;
+    }
+    selector_next += sizeof(record);
+
+    return true;
+}
+
+/* newest valid record of one block, next is set to the first free offset
+ * (block_size when full)
+ */
+static bool scan_selector(EiDeviceMemory *mem, uint8_t block, selector_record_t *best, bool *found, uint32_t *next)
+{
+    *next = mem->block_size;
+
+    // records are appended, the first erased one ends the list
+    for(uint32_t offset = 0; offset < mem->block_size; offset += IO_CHUNK) {
+        if(mem->read_sample_data(io_buffer, selector_address(mem, block) + offset, IO_CHUNK) != IO_CHUNK) {
+            ei_printf("ERR: Failed to read the model selector\n");
+            return false;
+        }
+
+        for(uint32_t ix = 0; ix < IO_CHUNK; ix += sizeof(selector_record_t)) {
+            selector_record_t record;
+            memcpy(&record, &io_buffer[ix], sizeof(record));
+
+            if(record.magic == ERASED_WORD) {
+                *next = offset + ix;
+                return true;
+            }
+            if(record.magic == SELECTOR_MAGIC && record.slot < EI_MODEL_STORE_SLOTS &&
+               record.crc == ei_crc32_update(0, (const uint8_t *)&record, offsetof(selector_record_t, crc)) &&
+               (*found == false || record.seq > best->seq)) {
+                *best = record;
+                *found = true;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ei_model_store_init(void)
+{
+    EiDeviceMemory *mem = get_memory();
+    selector_record_t best = { 0, 0, EI_MODEL_NO_SLOT, { 0 }, 0 };
+    bool found = false;
+    ei_model_slot_header_t header;
+
+    active.slot = EI_MODEL_NO_SLOT;
+    selector_block = 0;
+
+    uint32_t next[EI_MODEL_SELECTOR_BLOCKS];
+
+    // records are appended to the block that holds the newest one
+    for(uint8_t block = 0; block < EI_MODEL_SELECTOR_BLOCKS; block++) {
+        selector_record_t record;
+        bool block_found = false;
+
+        if(scan_selector(mem, block, &record, &block_found, &next[block]) == false) {
+            return false;
+        }
+        if(block_found && (found == false || record.seq > best.seq)) {
+            best = record;
+            found = true;
+            selector_block = block;
+        }
+    }
+    selector_next = next[selector_block];
+
+    if(found == false) {
+        return true;
+    }
+
+    if(read_header(mem, best.slot, &header) == false) {
+        ei_printf("ERR: Model slot %u is not valid, using the built-in model\n", best.slot);
+        return false;
+    }
+
+    active.slot = best.slot;
+    active.version = header.version;
+    active.length = header.length;
+    active.seq = best.seq;
+
+    return true;
+}
+
+void ei_model_store_get_active(ei_model_info_t *info)
+{
+    *info = active;
+}
+
+ei_model_status_t ei_model_store_begin(uint32_t length, uint32_t crc32, uint32_t version)
+{
+    EiDeviceMemory *mem = get_memory();
+
+    update.active = false;
+
+    // anyone could sign a blob for a key that is public or empty
+    if(ei_model_store_has_key() == false) {
+        ei_printf("ERR: EI_MODEL_SIGNING_KEY is not set, model updates are disabled\n");
+        return EI_MODEL_ERR_NO_KEY;
+    }
+    if(length == 0 || length > slot_capacity(mem)) {
+        ei_printf("ERR: Model must be 1..%lu bytes\n", (unsigned long)slot_capacity(mem));
+        return EI_MODEL_ERR_SIZE;
+    }
+
+    // never touch the slot in use
+    update.slot = (active.slot == 0) ? 1 : 0;
+
+    uint32_t blocks = (EI_MODEL_SLOT_DATA_OFFSET + length + mem->block_size - 1) / mem->block_size;
+    if(mem->erase_sample_data(slot_address(mem, update.slot), blocks * mem->block_size) != blocks * mem->block_size) {
+        ei_printf("ERR: Failed to erase model slot %u\n", update.slot);
+        return EI_MODEL_ERR_FLASH;
+    }
+
+    update.length = length;
+    update.crc32 = crc32;
+    update.version = version;
+    update.received = 0;
+    update.active = true;
+
+    return EI_MODEL_OK;
+}
+
+ei_model_status_t ei_model_store_write(uint32_t offset, const uint8_t *data, uint32_t len)
+{
+    EiDeviceMemory *mem = get_memory();
+
+    if(update.active == false) {
+        return EI_MODEL_ERR_STATE;
+    }
+    if(offset != update.received) {
+        return EI_MODEL_ERR_OFFSET;
+    }
+    if(len > update.length - update.received) {
+        return EI_MODEL_ERR_SIZE;
+    }
+
+    uint32_t address = slot_address(mem, update.slot) + EI_MODEL_SLOT_DATA_OFFSET + offset;
+    if(mem->write_sample_data(data, address, len) != len) {
+        ei_printf("ERR: Failed to write model slot %u\n", update.slot);
+        update.active = false;
+        return EI_MODEL_ERR_FLASH;
+    }
+    update.received += len;
+
+    return EI_MODEL_OK;
+}
+
+ei_model_status_t ei_model_store_commit(const uint8_t *signature)
+{
+    EiDeviceMemory *mem = get_memory();
+    sensor_aq_signing_ctx_t signing_ctx;
+    ei_hs256_ctx_t hs_ctx;
+    uint8_t hmac[EI_MODEL_SIGNATURE_LEN];
+    ei_model_slot_header_t header;
+    uint32_t crc = 0;
+
+    if(update.active == false) {
+        return EI_MODEL_ERR_STATE;
+    }
+    if(update.received != update.length) {
+        return EI_MODEL_ERR_OFFSET;
+    }
+    update.active = false;
+
+    // check what is in the flash, not what was received
+    ei_hs256_init_context(&signing_ctx, &hs_ctx, model_key);
+    if(signing_ctx.init(&signing_ctx) != 0) {
+        return EI_MODEL_ERR_SIGNATURE;
+    }
+
+    uint32_t address = slot_address(mem, update.slot) + EI_MODEL_SLOT_DATA_OFFSET;
+    for(uint32_t offset = 0; offset < update.length; offset += IO_CHUNK) {
+        uint32_t len = (update.length - offset < IO_CHUNK) ? update.length - offset : IO_CHUNK;
+
+        if(mem->read_sample_data(io_buffer, address + offset, len) != len) {
+            signing_ctx.finish(&signing_ctx, hmac);
+            return EI_MODEL_ERR_FLASH;
+        }
+        crc = ei_crc32_update(crc, io_buffer, len);
+        signing_ctx.update(&signing_ctx, io_buffer, len);
+    }
+    signing_ctx.finish(&signing_ctx, hmac);
+
+    if(crc != update.crc32) {
+        ei_printf("ERR: Model CRC mismatch (%08lx, expected %08lx)\n", (unsigned long)crc, (unsigned long)update.crc32);
+        return EI_MODEL_ERR_CRC;
+    }
+    if(memcmp(hmac, signature, sizeof(hmac)) != 0) {
+        ei_printf("ERR: Model signature mismatch\n");
+        return EI_MODEL_ERR_SIGNATURE;
+    }
+
+    header.magic = SLOT_MAGIC;
+    header.version = update.version;
+    header.length = update.length;
+    header.crc32 = update.crc32;
+    memcpy(header.signature, hmac, sizeof(header.signature));
+    header.header_crc = ei_crc32_update(0, (const uint8_t *)&header, offsetof(ei_model_slot_header_t, header_crc));
+
+    if(mem->write_sample_data((const uint8_t *)&header, slot_address(mem, update.slot), sizeof(header)) != sizeof(header)) {
+        return EI_MODEL_ERR_FLASH;
+    }
+
+    // the switch: one record, the old slot stays active until it is written
+    if(append_selector(mem, update.slot, active.seq + 1) == false) {
+        ei_printf("ERR: Failed to switch to model slot %u\n", update.slot);
+        return EI_MODEL_ERR_FLASH;
+    }
+
+    active.slot = update.slot;
+    active.version = update.version;
+    active.length = update.length;
+    active.seq++;
+
+    return EI_MODEL_OK;
+}
+
+void ei_model_store_abort(void)
+{
+    update.active = false;
+}
+
+uint32_t ei_model_store_get_received(void)
+{
+    return update.active ? update.received : 0;
+}
+
+bool ei_model_store_has_key(void)
+{
+    return (model_key[0] != '\0');
+}
+
+const char *ei_model_store_status_name(ei_model_status_t status)
+{
+    switch(status) {
+        case EI_MODEL_OK:
+            return "ok";
+        case EI_MODEL_ERR_STATE:
+            return "no update in progress";
+        case EI_MODEL_ERR_OFFSET:
+            return "data missing";
+        case EI_MODEL_ERR_SIZE:
+            return "too large";
+        case EI_MODEL_ERR_FLASH:
+            return "flash error";
+        case EI_MODEL_ERR_CRC:
+            return "CRC mismatch";
+        case EI_MODEL_ERR_SIGNATURE:
+            return "signature mismatch";
+        case EI_MODEL_ERR_NO_KEY:
+            return "no signing key";
+        default:
+            return "unknown";
+    }
+}
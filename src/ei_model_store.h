@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_MODEL_STORE_H
+#define EI_MODEL_STORE_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+
+/**
+ * Dual slot model storage at the top of the external flash, above the
+ * sample area (the flash memory classes leave EI_MODEL_STORE_BLOCKS out of
+ * get_available_sample_bytes()):
+ *
+ *   blocks 0..1    selector, append-only records naming the active slot,
+ *                  the highest seq in either block wins
+ *   blocks 2..5    slot 0: ei_model_slot_header_t, model blob at
+ *                  EI_MODEL_SLOT_DATA_OFFSET
+ *   blocks 6..9    slot 1
+ *
+ * An update always goes to the inactive slot. The blob is checked against
+ * the CRC-32 given at the start and the HMAC-SHA256 (EI_MODEL_SIGNING_KEY)
+ * given at the end, then one selector record switches the active slot.
+ * When a selector block is full the record goes to the start of the other
+ * one, which is erased first, so the current record is never erased before
+ * the next one is written. Power loss before that record is complete leaves
+ * the previous slot active.
+ *
+ * The blob is only stored and selected: inference keeps running the model
+ * compiled into the image. On the device the QSPI flash driver
+ * (src/ei_flash_memory.cpp) is still stubbed, its reads return without
+ * data, so the read-back check in ei_model_store_commit() fails there until
+ * the driver is enabled; the host build runs the whole update.
+ */
+#define EI_MODEL_STORE_SLOTS        2
+#define EI_MODEL_SLOT_BLOCKS        4
+#define EI_MODEL_SELECTOR_BLOCKS    2
+#define EI_MODEL_STORE_BLOCKS       (EI_MODEL_SELECTOR_BLOCKS + EI_MODEL_STORE_SLOTS * EI_MODEL_SLOT_BLOCKS)
+/* one flash page for the header */
+#define EI_MODEL_SLOT_DATA_OFFSET   512
+#define EI_MODEL_SIGNATURE_LEN      32
+#define EI_MODEL_NO_SLOT            0xFF
+
+/* Model blobs are signed with their own key, not the sample HMAC key, set
+ * it per fleet in the Makefile DEFINES. There is no default: without it
+ * every update is refused with EI_MODEL_ERR_NO_KEY.
+ */
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t version;       // set by the sender, reported back
+    uint32_t length;        // blob bytes
+    uint32_t crc32;         // blob CRC-32 (as zlib.crc32)
+    uint8_t signature[EI_MODEL_SIGNATURE_LEN];  // blob HMAC-SHA256
+    uint32_t header_crc;    // CRC-32 of the fields above
+} ei_model_slot_header_t;
+
+typedef enum {
+    EI_MODEL_OK = 0,
+    EI_MODEL_ERR_STATE,         // no update in progress
+    EI_MODEL_ERR_OFFSET,        // data not contiguous
+    EI_MODEL_ERR_SIZE,          // larger than a slot
+    EI_MODEL_ERR_FLASH,
+    EI_MODEL_ERR_CRC,
+    EI_MODEL_ERR_SIGNATURE,
+    EI_MODEL_ERR_NO_KEY,        // EI_MODEL_SIGNING_KEY not set
+} ei_model_status_t;
+
+typedef struct {
+    uint8_t slot;           // EI_MODEL_NO_SLOT: compiled-in model only
+    uint32_t version;
+    uint32_t length;
+    uint32_t seq;           // selector record sequence
+} ei_model_info_t;
+
+/**
+ * @brief Find the active slot (call once the flash memory is set up)
+ */
+bool ei_model_store_init(void);
+void ei_model_store_get_active(ei_model_info_t *info);
+
+/* Update of the inactive slot, data in order from offset 0 */
+ei_model_status_t ei_model_store_begin(uint32_t length, uint32_t crc32, uint32_t version);
+ei_model_status_t ei_model_store_write(uint32_t offset, const uint8_t *data, uint32_t len);
+ei_model_status_t ei_model_store_commit(const uint8_t *signature);
+void ei_model_store_abort(void);
+/* bytes received by the update in progress */
+uint32_t ei_model_store_get_received(void);
+/* false when EI_MODEL_SIGNING_KEY is not set and updates are refused */
+bool ei_model_store_has_key(void);
+
+const char *ei_model_store_status_name(ei_model_status_t status);
+
+#endif /* EI_MODEL_STORE_H */
@@ -22,13 +22,19 @@
 
 #include "model-parameters/model_metadata.h"
 #if defined(EI_CLASSIFIER_SENSOR) && EI_CLASSIFIER_SENSOR == EI_CLASSIFIER_SENSOR_MICROPHONE
-#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
 #include "edge-impulse-sdk/dsp/numpy.hpp"
-#include "ei_device_psoc62.h"
+#include "firmware-sdk/ei_device_info_lib.h"
 #include "ei_microphone.h"
 #include "ei_run_impulse.h"
+#include "ei_classifier.h"
 #include "cycfg_gatt_db.h"
 #include "ei_bluetooth_psoc63.h"
+#include "ei_ble_results.h"
+
+#ifdef FREERTOS_ENABLED
+#include <FreeRTOS.h>
+#include <task.h>
+#endif
 
 typedef enum {
     INFERENCE_STOPPED = 0,
@@ -37,19 +43,29 @@ typedef enum {
     INFERENCE_DATA_READY
 } inference_state_t;
 
+typedef enum {
+    IMPULSE_REQUEST_NONE = 0,
+    IMPULSE_REQUEST_SINGLE,
+    IMPULSE_REQUEST_CONTINUOUS,
+    IMPULSE_REQUEST_STOP
+} impulse_request_t;
+
 static int print_results;
+/* slices between continuous results */
+static uint32_t result_stride = (EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW >> 1);
 static uint16_t samples_per_inference;
 static volatile inference_state_t inference_state = INFERENCE_STOPPED;
 static uint64_t last_inference_ts = 0;
 static bool continuous_mode = false;
 static bool debug_mode = false;
+/* set by ei_stop_impulse(), the NN is released by ei_run_impulse() */
+static volatile bool nn_release_pending = false;
+/* start or stop asked for by another task, applied by ei_run_impulse() */
+static volatile impulse_request_t request = IMPULSE_REQUEST_NONE;
 
 static void display_results(ei_impulse_result_t* result)
 {
     static int ble_inference_settings_ready = 0;
-    float max = 0.0f;
-    size_t max_ix = 0;
-    size_t volatile label_len = 0;
 
     /* Update BLE settings payload once */
     if(!ble_inference_settings_ready) {
@@ -85,28 +101,48 @@ static void display_results(ei_impulse_result_t* result)
         ei_printf("\r\n");
 #endif
 
-    /* Find the label with maximum confidence */
-    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
-        if (result->classification[ix].value > max) {
-            max = result->classification[ix].value;
-            max_ix = ix;
-        }
-    }
-    /* Update BLE payload */
-    label_len = strlen(result->classification[max_ix].label);
-    //printf("strlen = %u, app_edge_impulse_class_result_len = %d\n", label_len, app_edge_impulse_class_result_len);
-    if (label_len > app_edge_impulse_class_result_len) {
-        label_len = app_edge_impulse_class_result_len;
-    }
-    //printf("label_len = %u\n", label_len);
-    memset(app_edge_impulse_class_result, 0x00, app_edge_impulse_class_result_len);
-    memcpy(app_edge_impulse_class_result, result->classification[max_ix].label, label_len);
-    bt_app_send_notification(CLASS_RESULT);
+    /* Class Result and Result Record notifications, sent as the link allows */
+    ei_ble_results_push(result, continuous_mode);
+}
+
+static impulse_request_t request_take(void)
+{
+#ifdef FREERTOS_ENABLED
+    taskENTER_CRITICAL();
+#endif
+    impulse_request_t req = request;
+    request = IMPULSE_REQUEST_NONE;
+#ifdef FREERTOS_ENABLED
+    taskEXIT_CRITICAL();
+#endif
+
+    return req;
 }
 
+static void start_impulse(bool continuous, bool debug, bool use_max_uart_speed);
+static void stop_impulse(void);
+
 void ei_run_impulse(void)
 {
     EiDeviceInfo *dev = EiDeviceInfo::get_device();
+
+    /* a request from the BT task is applied here, so a window classified
+     * meanwhile cannot overwrite the state it set */
+    impulse_request_t req = request_take();
+    if(req == IMPULSE_REQUEST_STOP) {
+        stop_impulse();
+    }
+    else if(req != IMPULSE_REQUEST_NONE) {
+        stop_impulse();
+        start_impulse(req == IMPULSE_REQUEST_CONTINUOUS, false, false);
+    }
+
+    /* after a stop the resident NN is released here, outside the classifier */
+    if(nn_release_pending) {
+        nn_release_pending = false;
+        ei_classifier_release();
+    }
+
     switch(inference_state) {
         case INFERENCE_STOPPED:
             // nothing to do
@@ -142,10 +178,10 @@ void ei_run_impulse(void)
     ei_impulse_result_t result = { 0 };
     EI_IMPULSE_ERROR ei_error;
     if(continuous_mode == true) {
-        ei_error = run_classifier_continuous(&signal, &result, debug_mode);
+        ei_error = ei_classifier_run_continuous(&signal, &result, debug_mode);
     }
     else {
-        ei_error = run_classifier(&signal, &result, debug_mode);
+        ei_error = ei_classifier_run(&signal, &result, debug_mode);
     }
     if (ei_error != EI_IMPULSE_OK) {
         ei_printf("Failed to run impulse (%d)", ei_error);
@@ -153,7 +189,7 @@ void ei_run_impulse(void)
     }
 
     if(continuous_mode == true) {
-        if(++print_results >= (EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW >> 1)) {
+        if(++print_results >= (int)result_stride) {
             display_results(&result);
             print_results = 0;
         }
@@ -172,20 +208,21 @@ void ei_run_impulse(void)
     }
 }
 
-void ei_start_impulse(bool continuous, bool debug, bool use_max_uart_speed)
+static void start_impulse(bool continuous, bool debug, bool use_max_uart_speed)
 {
     EiDeviceInfo *dev = EiDeviceInfo::get_device();
 
     continuous_mode = continuous;
     debug_mode = debug;
+    /* results every few hundred ms, ask for a shorter connection interval */
+    bt_app_set_link_mode(BT_LINK_RESULTS);
 
     // summary of inferencing settings (from model_metadata.h)
     ei_printf("Inferencing settings:\n");
     ei_printf("\tInterval: %.04fms.\n", (float)EI_CLASSIFIER_INTERVAL_MS);
     ei_printf("\tFrame size: %d\n", EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE);
     ei_printf("\tSample length: %.02f ms.", (float)(EI_CLASSIFIER_RAW_SAMPLE_COUNT * EI_CLASSIFIER_INTERVAL_MS));
-    ei_printf("\tNo. of classes: %d\n", sizeof(ei_classifier_inferencing_categories) /
-                                            sizeof(ei_classifier_inferencing_categories[0]));
+    ei_printf("\tNo. of classes: %d\n", EI_CLASSIFIER_LABEL_COUNT);
     ei_printf("Starting inferencing, press 'b' to break\n");
 
     dev->set_sample_length_ms(EI_CLASSIFIER_RAW_SAMPLE_COUNT * EI_CLASSIFIER_INTERVAL_MS, false);
@@ -215,7 +252,24 @@ void ei_start_impulse(bool continuous, bool debug, bool use_max_uart_speed)
     }
 }
 
-void ei_stop_impulse(void) 
+bool ei_set_result_stride(uint32_t slices)
+{
+    if(slices == 0 || slices > EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW) {
+        ei_printf("ERR: Stride must be 1..%d slices\n", EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW);
+        return false;
+    }
+
+    result_stride = slices;
+
+    return true;
+}
+
+uint32_t ei_get_result_stride(void)
+{
+    return result_stride;
+}
+
+static void stop_impulse(void)
 {
     EiDeviceInfo *dev = EiDeviceInfo::get_device();
 
@@ -223,14 +277,57 @@ void ei_stop_impulse(void)
         ei_microphone_inference_end();
         inference_state = INFERENCE_STOPPED;
         ei_printf("Inferencing stopped by user\r\n");
+        ei_ble_results_flush();
+        bt_app_set_link_mode(BT_LINK_IDLE);
         dev->set_state(eiStateFinished);
         run_classifier_deinit();
+        nn_release_pending = true;
     }
 }
 
+void ei_start_impulse(bool continuous, bool debug, bool use_max_uart_speed)
+{
+    // drops an older request from the BT task
+    request_take();
+    start_impulse(continuous, debug, use_max_uart_speed);
+}
+
+void ei_stop_impulse(void)
+{
+    request_take();
+    stop_impulse();
+}
+
+void ei_request_start_impulse(bool continuous)
+{
+    request = continuous ? IMPULSE_REQUEST_CONTINUOUS : IMPULSE_REQUEST_SINGLE;
+}
+
+void ei_request_stop_impulse(void)
+{
+    request = IMPULSE_REQUEST_STOP;
+}
+
 bool is_inference_running(void)
 {
+    impulse_request_t req = request;
+
+    if(req != IMPULSE_REQUEST_NONE) {
+        return (req != IMPULSE_REQUEST_STOP);
+    }
+
     return (inference_state != INFERENCE_STOPPED);
 }
 
+bool is_inference_continuous(void)
+{
+    impulse_request_t req = request;
+
+    if(req != IMPULSE_REQUEST_NONE) {
+        return (req == IMPULSE_REQUEST_CONTINUOUS);
+    }
+
+    return (inference_state != INFERENCE_STOPPED) && continuous_mode;
+}
+
 #endif /* defined(EI_CLASSIFIER_SENSOR) && EI_CLASSIFIER_SENSOR == EI_CLASSIFIER_SENSOR_MICROPHONE */
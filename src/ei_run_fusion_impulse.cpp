@@ -18,13 +18,19 @@
 #if defined(EI_CLASSIFIER_SENSOR) && \
            ((EI_CLASSIFIER_SENSOR == EI_CLASSIFIER_SENSOR_FUSION) || \
             (EI_CLASSIFIER_SENSOR == EI_CLASSIFIER_SENSOR_ACCELEROMETER))
-#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
 #include "edge-impulse-sdk/dsp/numpy.hpp"
 #include "firmware-sdk/ei_fusion.h"
-#include "ei_device_psoc62.h"
+#include "firmware-sdk/ei_device_info_lib.h"
 #include "ei_run_impulse.h"
+#include "ei_classifier.h"
 #include "cycfg_gatt_db.h"
 #include "ei_bluetooth_psoc63.h"
+#include "ei_ble_results.h"
+
+#ifdef FREERTOS_ENABLED
+#include <FreeRTOS.h>
+#include <task.h>
+#endif
 
 
 typedef enum {
@@ -34,14 +40,32 @@ typedef enum {
     INFERENCE_DATA_READY
 } inference_state_t;
 
+typedef enum {
+    IMPULSE_REQUEST_NONE = 0,
+    IMPULSE_REQUEST_SINGLE,
+    IMPULSE_REQUEST_CONTINUOUS,
+    IMPULSE_REQUEST_STOP
+} impulse_request_t;
+
 static int print_results;
+/* slices between continuous results */
+static uint32_t result_stride = (EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW >> 1);
 static uint16_t samples_per_inference;
 static inference_state_t state = INFERENCE_STOPPED;
 static uint64_t last_inference_ts = 0;
 static bool continuous_mode = false;
 static bool debug_mode = false;
-static float samples_circ_buff[EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE];
-static int samples_wr_index = 0;
+/* set by ei_stop_impulse(), the NN is released by ei_run_impulse() */
+static volatile bool nn_release_pending = false;
+/* start or stop asked for by another task, applied by ei_run_impulse() */
+static volatile impulse_request_t request = IMPULSE_REQUEST_NONE;
+/* written by the sampler, also while a window is classified */
+static float samples_ring[EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE];
+/* the window being classified, oldest value first */
+static float samples_window[EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE];
+/* values written to the ring (sampler only) and taken by ei_run_impulse */
+static volatile uint32_t samples_written = 0;
+static uint32_t samples_read = 0;
 
 /**
  * @brief Called for each single sample
@@ -49,34 +73,43 @@ static int samples_wr_index = 0;
  */
 bool samples_callback(const void *raw_sample, uint32_t raw_sample_size)
 {
-    if(state != INFERENCE_SAMPLING) {
-        // stop collecting samples if we are not in SAMPLING state
+    if(state == INFERENCE_STOPPED) {
+        // stop collecting samples, inference was stopped
+        return true;
+    }
+
+    if(continuous_mode == false && state != INFERENCE_SAMPLING) {
+        // single window is complete
         return true;
     }
 
     float *sample = (float *)raw_sample;
+    uint32_t written = samples_written;
 
     for(int i = 0; i < (int)(raw_sample_size / sizeof(float)); i++) {
-        samples_circ_buff[samples_wr_index++] = sample[i];
-        if(samples_wr_index > EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
-            /* start from beginning of the circular buffer */
-            samples_wr_index = 0;
-        }
-        if(samples_wr_index >= samples_per_inference) {
-            state = INFERENCE_DATA_READY;
-            return true;
-        }
+        samples_ring[written % EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE] = sample[i];
+        written++;
+    }
+    samples_written = written;
+
+    if(state == INFERENCE_SAMPLING && written - samples_read >= samples_per_inference) {
+        state = INFERENCE_DATA_READY;
+        return (continuous_mode == false);
     }
 
     return false;
 }
 
+static void samples_reset(void)
+{
+    memset(samples_ring, 0, sizeof(samples_ring));
+    samples_written = 0;
+    samples_read = 0;
+}
+
 static void display_results(ei_impulse_result_t* result)
 {
     static int ble_inference_settings_ready = 0;
-    float max = 0.0f;
-    size_t max_ix = 0;
-    size_t volatile label_len = 0;
 
     /* Update BLE settings payload once */
     if(!ble_inference_settings_ready) {
@@ -108,28 +141,48 @@ static void display_results(ei_impulse_result_t* result)
     ei_printf("    anomaly score: %f\r\n", result->anomaly);
 #endif
 
-    /* Find the label with maximum confidence */
-    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
-        if (result->classification[ix].value > max) {
-            max = result->classification[ix].value;
-            max_ix = ix;
-        }
-    }
-    /* Update BLE payload */
-    label_len = strlen(result->classification[max_ix].label);
-    //printf("strlen = %u, app_edge_impulse_class_result_len = %d\n", label_len, app_edge_impulse_class_result_len);
-    if (label_len > app_edge_impulse_class_result_len) {
-        label_len = app_edge_impulse_class_result_len;
-    }
-    //printf("label_len = %u\n", label_len);
-    memset(app_edge_impulse_class_result, 0x00, app_edge_impulse_class_result_len);
-    memcpy(app_edge_impulse_class_result, result->classification[max_ix].label, label_len);
-    bt_app_send_notification(CLASS_RESULT);
+    /* Class Result and Result Record notifications, sent as the link allows */
+    ei_ble_results_push(result, continuous_mode);
+}
+
+static impulse_request_t request_take(void)
+{
+#ifdef FREERTOS_ENABLED
+    taskENTER_CRITICAL();
+#endif
+    impulse_request_t req = request;
+    request = IMPULSE_REQUEST_NONE;
+#ifdef FREERTOS_ENABLED
+    taskEXIT_CRITICAL();
+#endif
+
+    return req;
 }
 
+static void start_impulse(bool continuous, bool debug, bool use_max_uart_speed);
+static void stop_impulse(void);
+
 void ei_run_impulse(void)
 {
     EiDeviceInfo *dev = EiDeviceInfo::get_device();
+
+    /* a request from the BT task is applied here, so a window classified
+     * meanwhile cannot overwrite the state it set */
+    impulse_request_t req = request_take();
+    if(req == IMPULSE_REQUEST_STOP) {
+        stop_impulse();
+    }
+    else if(req != IMPULSE_REQUEST_NONE) {
+        stop_impulse();
+        start_impulse(req == IMPULSE_REQUEST_CONTINUOUS, false, false);
+    }
+
+    /* after a stop the resident NN is released here, outside the classifier */
+    if(nn_release_pending) {
+        nn_release_pending = false;
+        ei_classifier_release();
+    }
+
     switch(state) {
         case INFERENCE_STOPPED:
             // nothing to do
@@ -138,6 +191,7 @@ void ei_run_impulse(void)
             if(ei_read_timer_ms() < (last_inference_ts + 2000)) {
                 return;
             }
+            samples_reset();
             state = INFERENCE_SAMPLING;
             ei_fusion_sample_start(&samples_callback, EI_CLASSIFIER_INTERVAL_MS);
             dev->set_state(eiStateSampling);
@@ -153,44 +207,43 @@ void ei_run_impulse(void)
             break;
     }
 
+    if(continuous_mode == true) {
+        // one slice more, the window is classified every result_stride slices
+        samples_read += samples_per_inference;
+        if(++print_results < (int)result_stride) {
+            state = INFERENCE_SAMPLING;
+            return;
+        }
+        print_results = 0;
+    }
+
     signal_t signal;
+    uint32_t written = samples_written;
 
-    // shift circular buffer, so the newest data will be the first
-    // if samples_wr_index is 0, then roll is immediately returning
-    numpy::roll(samples_circ_buff, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, (-samples_wr_index));
-    /* reset wr index, the oldest data will be overwritten */
-    samples_wr_index = 0;
+    // latest window out of the ring, oldest first, so a sample arriving
+    // during the copy only overwrites a value that was copied already
+    for(uint32_t ix = 0; ix < EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE; ix++) {
+        samples_window[ix] = samples_ring[(written + ix) % EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE];
+    }
 
     // Create a data structure to represent this window of data
-    int err = numpy::signal_from_buffer(samples_circ_buff, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+    int err = numpy::signal_from_buffer(samples_window, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
     if (err != 0) {
         ei_printf("ERR: signal_from_buffer failed (%d)\n", err);
     }
 
     // run the impulse: DSP, neural network and the Anomaly algorithm
+    // run_classifier_continuous only supports the audio DSP blocks, so in continuous
+    // mode the whole (sliding) window is classified every result_stride slices
     ei_impulse_result_t result = { 0 };
-    EI_IMPULSE_ERROR ei_error;
-    if(continuous_mode == true) {
-        ei_error = run_classifier_continuous(&signal, &result, debug_mode);
-    }
-    else {
-        ei_error = run_classifier(&signal, &result, debug_mode);
-    }
+    EI_IMPULSE_ERROR ei_error = ei_classifier_run(&signal, &result, debug_mode);
 
     if (ei_error != EI_IMPULSE_OK) {
         ei_printf("Failed to run impulse (%d)", ei_error);
         return;
     }
 
-    if(continuous_mode == true) {
-        if(++print_results >= (EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW >> 1)) {
-            display_results(&result);
-            print_results = 0;
-        }
-    }
-    else {
-        display_results(&result);
-    }
+    display_results(&result);
 
     if(continuous_mode == true) {
         state = INFERENCE_SAMPLING;
@@ -202,7 +255,7 @@ void ei_run_impulse(void)
     }
 }
 
-void ei_start_impulse(bool continuous, bool debug, bool use_max_uart_speed)
+static void start_impulse(bool continuous, bool debug, bool use_max_uart_speed)
 {
     EiDeviceInfo *dev = EiDeviceInfo::get_device();
 
@@ -213,6 +266,8 @@ void ei_start_impulse(bool continuous, bool debug, bool use_max_uart_speed)
     }
 
     continuous_mode = continuous;
+    /* results every few hundred ms, ask for a shorter connection interval */
+    bt_app_set_link_mode(BT_LINK_RESULTS);
     debug_mode = debug;
 
     // summary of inferencing settings (from model_metadata.h)
@@ -220,22 +275,25 @@ void ei_start_impulse(bool continuous, bool debug, bool use_max_uart_speed)
     ei_printf("\tInterval: %.04fms.\n", (float)EI_CLASSIFIER_INTERVAL_MS);
     ei_printf("\tFrame size: %d\n", EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE);
     ei_printf("\tSample length: %.02f ms.\n", (float)(EI_CLASSIFIER_RAW_SAMPLE_COUNT * EI_CLASSIFIER_INTERVAL_MS));
-    ei_printf("\tNo. of classes: %d\n", sizeof(ei_classifier_inferencing_categories) /
-                                            sizeof(ei_classifier_inferencing_categories[0]));
+    ei_printf("\tNo. of classes: %d\n", EI_CLASSIFIER_LABEL_COUNT);
     ei_printf("Starting inferencing, press 'b' to break\n");
 
     dev->set_sample_length_ms(EI_CLASSIFIER_RAW_SAMPLE_COUNT * EI_CLASSIFIER_INTERVAL_MS, false);
     dev->set_sample_interval_ms(EI_CLASSIFIER_INTERVAL_MS, true);
 
     if (continuous == true) {
+        // the sampler fills the ring continuously, only the last window of a
+        // stride is displayed, so only that one is classified
         samples_per_inference = EI_CLASSIFIER_SLICE_SIZE * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
         // In order to have meaningful classification results, continuous inference has to run over
         // the complete model window. So the first iterations will print out garbage.
         // We now use a fixed length moving average filter of half the slices per model window and
         // only print when we run the complete maf buffer to prevent printing the same classification multiple times.
         print_results = -(EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW);
-        run_classifier_init();
+        samples_reset();
         state = INFERENCE_SAMPLING;
+        ei_fusion_sample_start(&samples_callback, EI_CLASSIFIER_INTERVAL_MS);
+        dev->set_state(eiStateSampling);
     }
     else {
         samples_per_inference = EI_CLASSIFIER_RAW_SAMPLE_COUNT * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
@@ -246,22 +304,80 @@ void ei_start_impulse(bool continuous, bool debug, bool use_max_uart_speed)
     }
 }
 
-void ei_stop_impulse(void) 
+bool ei_set_result_stride(uint32_t slices)
+{
+    if(slices == 0 || slices > EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW) {
+        ei_printf("ERR: Stride must be 1..%d slices\n", EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW);
+        return false;
+    }
+
+    result_stride = slices;
+
+    return true;
+}
+
+uint32_t ei_get_result_stride(void)
+{
+    return result_stride;
+}
+
+static void stop_impulse(void)
 {
     EiDeviceInfo *dev = EiDeviceInfo::get_device();
 
     if(state != INFERENCE_STOPPED) {
         state = INFERENCE_STOPPED;
         ei_printf("Inferencing stopped by user\r\n");
+        ei_ble_results_flush();
+        bt_app_set_link_mode(BT_LINK_IDLE);
         dev->set_state(eiStateFinished);
-        /* reset samples buffer */
-        samples_wr_index = 0;
+        nn_release_pending = true;
     }
 }
 
+void ei_start_impulse(bool continuous, bool debug, bool use_max_uart_speed)
+{
+    // drops an older request from the BT task
+    request_take();
+    start_impulse(continuous, debug, use_max_uart_speed);
+}
+
+void ei_stop_impulse(void)
+{
+    request_take();
+    stop_impulse();
+}
+
+void ei_request_start_impulse(bool continuous)
+{
+    request = continuous ? IMPULSE_REQUEST_CONTINUOUS : IMPULSE_REQUEST_SINGLE;
+}
+
+void ei_request_stop_impulse(void)
+{
+    request = IMPULSE_REQUEST_STOP;
+}
+
 bool is_inference_running(void)
 {
+    impulse_request_t req = request;
+
+    if(req != IMPULSE_REQUEST_NONE) {
+        return (req != IMPULSE_REQUEST_STOP);
+    }
+
     return (state != INFERENCE_STOPPED);
 }
 
+bool is_inference_continuous(void)
+{
+    impulse_request_t req = request;
+
+    if(req != IMPULSE_REQUEST_NONE) {
+        return (req == IMPULSE_REQUEST_CONTINUOUS);
+    }
+
+    return (state != INFERENCE_STOPPED) && continuous_mode;
+}
+
 #endif /* defined(EI_CLASSIFIER_SENSOR) && ((EI_CLASSIFIER_SENSOR == EI_CLASSIFIER_SENSOR_FUSION) || (EI_CLASSIFIER_SENSOR == EI_CLASSIFIER_SENSOR_ACCELEROMETER)) */
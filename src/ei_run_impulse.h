@@ -20,8 +20,29 @@
 #include <cstdint>
 
 void ei_start_impulse(bool continuous, bool debug, bool use_max_uart_speed = false);
+/**
+ * ei_run_impulse() is called from the inference task loop, also when
+ * stopped. ei_start_impulse() and ei_stop_impulse() run on that task too,
+ * the NN a stop leaves set up is released on the next ei_run_impulse().
+ */
 void ei_run_impulse(void);
 void ei_stop_impulse(void);
+/**
+ * Start (restarting a running inference) or stop from another task, the
+ * BT stack task. Only the latest request is kept, the next ei_run_impulse()
+ * applies it; until then is_inference_running() and
+ * is_inference_continuous() report the requested state.
+ */
+void ei_request_start_impulse(bool continuous);
+void ei_request_stop_impulse(void);
 bool is_inference_running(void);
+bool is_inference_continuous(void);
+/**
+ * Continuous mode displays (and sends) a result every stride slices of
+ * EI_CLASSIFIER_SLICE_SIZE, 1..EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW.
+ * Applies from the next ei_start_impulse().
+ */
+bool ei_set_result_stride(uint32_t slices);
+uint32_t ei_get_result_stride(void);
 
 #endif /* EI_RUN_IMPULSE_H */
@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "firmware-sdk/ei_device_lib.h"
+#include "ei_sample_format.h"
+
+/******
+ *
+ * @brief Compact int16 sample files (plain or delta coded columns) in
+ *        CRC checked blocks, about a quarter of the CBOR size
+ *
+ ******/
+
+#define PAD4(len)   (((len) + 3) & ~3)
+
+static ei_sample_format_t sample_format = EI_SAMPLE_FORMAT_CBOR;
+static ei_sample_format_stats_t stats = { 0, 0, 0 };
+
+/***************************************
+ *        Encoding
+ **************************************/
+
+static size_t string_length(const char *str)
+{
+    size_t len = (str != NULL) ? strlen(str) : 0;
+
+    return (len > EI_SAMPLE_MAX_STRING) ? EI_SAMPLE_MAX_STRING : len;
+}
+
+static size_t put_string(uint8_t *out, const char *str)
+{
+    size_t len = string_length(str);
+
+    out[0] = (uint8_t)len;
+    memcpy(&out[1], str, len);
+
+    return len + 1;
+}
+
+static uint32_t block_crc(const ei_sample_block_header_t *header, const uint8_t *payload)
+{
+    uint32_t crc = ei_crc32_update(0, (const uint8_t *)&header->seq, 3 * sizeof(uint16_t));
+
+    return ei_crc32_update(crc, payload, header->len);
+}
+
+size_t ei_sample_encoder_begin(ei_sample_encoder_t *enc, ei_sample_format_t format,
+                               const sensor_aq_payload_info *payload, uint8_t *header, size_t max_len)
+{
+    ei_sample_file_header_t file_header;
+    uint8_t n_axes = 0;
+    size_t len = sizeof(file_header);
+    size_t needed = len + string_length(payload->device_name) + string_length(payload->device_type) + 2;
+
+    while(n_axes < EI_MAX_SENSOR_AXES && string_length(payload->sensors[n_axes].name) > 0) {
+        needed += string_length(payload->sensors[n_axes].name) + string_length(payload->sensors[n_axes].units) + 2;
+        n_axes++;
+    }
+
+    if(n_axes == 0 || PAD4(needed) > max_len) {
+        ei_printf("ERR: Sample header does not fit\n");
+        return 0;
+    }
+
+    len += put_string(&header[len], payload->device_name);
+    len += put_string(&header[len], payload->device_type);
+    for(uint8_t ix = 0; ix < n_axes; ix++) {
+        len += put_string(&header[len], payload->sensors[ix].name);
+        len += put_string(&header[len], payload->sensors[ix].units);
+    }
+    memset(&header[len], 0xFF, PAD4(len) - len);
+    len = PAD4(len);
+
+    file_header.magic = EI_SAMPLE_FILE_MAGIC;
+    file_header.format = (uint8_t)format;
+    file_header.n_axes = n_axes;
+    file_header.scale = EI_SAMPLE_SCALE;
+    file_header.interval_ms = payload->interval_ms;
+    file_header.header_len = (uint16_t)len;
+    file_header.block_samples = EI_SAMPLE_BLOCK_VALUES / n_axes;
+    memcpy(header, &file_header, sizeof(file_header));
+
+    enc->format = format;
+    enc->n_axes = n_axes;
+    enc->block_samples = file_header.block_samples;
+    enc->n_samples = 0;
+    enc->seq = 0;
+    enc->samples = 0;
+    enc->saturated = 0;
+
+    return len;
+}
+
+bool ei_sample_encoder_add(ei_sample_encoder_t *enc, const float *values)
+{
+    int16_t *sample = &enc->values[enc->n_samples * enc->n_axes];
+
+    for(uint8_t ix = 0; ix < enc->n_axes; ix++) {
+        sample[ix] = ei_quantize_int16(values[ix], EI_SAMPLE_SCALE, &enc->saturated);
+    }
+    enc->n_samples++;
+    enc->samples++;
+
+    return enc->n_samples >= enc->block_samples;
+}
+
+size_t ei_sample_encoder_flush(ei_sample_encoder_t *enc, uint8_t *block)
+{
+    ei_sample_block_header_t header;
+    uint8_t *payload = &block[sizeof(header)];
+    size_t len = 0;
+
+    if(enc->n_samples == 0) {
+        return 0;
+    }
+
+    // columns, samples are stored interleaved
+    for(uint8_t axis = 0; axis < enc->n_axes; axis++) {
+        int16_t previous = 0;
+
+        for(uint16_t ix = 0; ix < enc->n_samples; ix++) {
+            int16_t value = enc->values[ix * enc->n_axes + axis];
+
+            if(enc->format == EI_SAMPLE_FORMAT_DELTA) {
+                len += ei_varint_put(&payload[len], (ix == 0) ? value : (int32_t)value - previous);
+                previous = value;
+            }
+            else {
+                payload[len++] = (uint8_t)value;
+                payload[len++] = (uint8_t)((uint16_t)value >> 8);
+            }
+        }
+    }
+
+    header.magic = EI_SAMPLE_BLOCK_MAGIC;
+    header.seq = enc->seq++;
+    header.n_samples = enc->n_samples;
+    header.len = (uint16_t)len;
+    header.crc32 = block_crc(&header, payload);
+    memcpy(block, &header, sizeof(header));
+
+    len += sizeof(header);
+    memset(&block[len], 0xFF, PAD4(len) - len);
+
+    enc->n_samples = 0;
+
+    return PAD4(len);
+}
+
+/***************************************
+ *        Decoding
+ **************************************/
+
+static size_t get_string(const uint8_t *in, size_t len, char *out)
+{
+    if(len == 0 || in[0] > EI_SAMPLE_MAX_STRING || (size_t)in[0] + 1 > len) {
+        return 0;
+    }
+
+    memcpy(out, &in[1], in[0]);
+    out[in[0]] = 0;
+
+    return in[0] + 1;
+}
+
+size_t ei_sample_file_parse_header(const uint8_t *file, size_t len, ei_sample_file_info_t *info)
+{
+    ei_sample_file_header_t header;
+
+    if(len < sizeof(header)) {
+        return 0;
+    }
+    memcpy(&header, file, sizeof(header));
+
+    if(header.magic != EI_SAMPLE_FILE_MAGIC || header.n_axes == 0 || header.n_axes > EI_MAX_SENSOR_AXES ||
+       (header.format != EI_SAMPLE_FORMAT_INT16 && header.format != EI_SAMPLE_FORMAT_DELTA) ||
+       header.scale == 0 || header.header_len < sizeof(header) || header.header_len > len ||
+       header.block_samples == 0 || header.block_samples * header.n_axes > EI_SAMPLE_BLOCK_VALUES) {
+        return 0;
+    }
+
+    memset(info, 0, sizeof(*info));
+    info->format = (ei_sample_format_t)header.format;
+    info->n_axes = header.n_axes;
+    info->scale = header.scale;
+    info->block_samples = header.block_samples;
+    info->interval_ms = header.interval_ms;
+
+    size_t pos = sizeof(header);
+    size_t used;
+    char *strings[2 + 2 * EI_MAX_SENSOR_AXES] = { info->device_name, info->device_type };
+
+    for(uint8_t ix = 0; ix < header.n_axes; ix++) {
+        strings[2 + 2 * ix] = info->axes[ix].name;
+        strings[3 + 2 * ix] = info->axes[ix].units;
+    }
+
+    for(size_t ix = 0; ix < 2 + 2 * (size_t)header.n_axes; ix++) {
+        used = get_string(&file[pos], header.header_len - pos, strings[ix]);
+        if(used == 0) {
+            return 0;
+        }
+        pos += used;
+    }
+
+    return header.header_len;
+}
+
+int ei_sample_file_decode_block(const uint8_t *block, size_t len, const ei_sample_file_info_t *info,
+                                int16_t *values, size_t max_values, size_t *block_len)
+{
+    ei_sample_block_header_t header;
+
+    // an erased block header (or the end of the dump) ends the data
+    if(len < sizeof(header) || (block[0] == 0xFF && block[1] == 0xFF)) {
+        return 0;
+    }
+    memcpy(&header, block, sizeof(header));
+
+    const uint8_t *payload = &block[sizeof(header)];
+    size_t n_values = (size_t)header.n_samples * info->n_axes;
+
+    if(header.magic != EI_SAMPLE_BLOCK_MAGIC || header.n_samples == 0 || header.n_samples > info->block_samples ||
+       n_values > max_values || sizeof(header) + header.len > len || block_crc(&header, payload) != header.crc32) {
+        return -1;
+    }
+
+    size_t pos = 0;
+
+    for(uint8_t axis = 0; axis < info->n_axes; axis++) {
+        int32_t value = 0;
+
+        for(uint16_t ix = 0; ix < header.n_samples; ix++) {
+            if(info->format == EI_SAMPLE_FORMAT_DELTA) {
+                int32_t delta;
+                size_t used = ei_varint_get(&payload[pos], header.len - pos, &delta);
+                if(used == 0) {
+                    return -1;
+                }
+                pos += used;
+                value = (ix == 0) ? delta : value + delta;
+            }
+            else {
+                if(pos + 2 > header.len) {
+                    return -1;
+                }
+                value = (int16_t)(payload[pos] | (payload[pos + 1] << 8));
+                pos += 2;
+            }
+            values[ix * info->n_axes + axis] = (int16_t)value;
+        }
+    }
+
+    if(pos != header.len) {
+        return -1;
+    }
+
+    *block_len = PAD4(sizeof(header) + header.len);
+
+    return header.n_samples;
+}
+
+/***************************************
+ *        Settings
+ **************************************/
+
+void ei_sample_set_format(ei_sample_format_t format)
+{
+    sample_format = format;
+}
+
+ei_sample_format_t ei_sample_get_format(void)
+{
+    return sample_format;
+}
+
+const char *ei_sample_format_name(ei_sample_format_t format)
+{
+    switch(format) {
+        case EI_SAMPLE_FORMAT_CBOR:
+            return "cbor";
+        case EI_SAMPLE_FORMAT_INT16:
+            return "int16";
+        case EI_SAMPLE_FORMAT_DELTA:
+            return "delta";
+        default:
+            return "unknown";
+    }
+}
+
+bool ei_sample_format_from_name(const char *name, ei_sample_format_t *out)
+{
+    for(int ix = EI_SAMPLE_FORMAT_CBOR; ix <= EI_SAMPLE_FORMAT_DELTA; ix++) {
+        if(strcmp(name, ei_sample_format_name((ei_sample_format_t)ix)) == 0) {
+            *out = (ei_sample_format_t)ix;
+            return true;
+        }
+    }
+
+    ei_printf("ERR: Unknown sample format %s (cbor, int16, delta)\n", name);
+    return false;
+}
+
+void ei_sample_format_get_stats(ei_sample_format_stats_t *out)
+{
+    *out = stats;
+}
+
+void ei_sample_format_set_stats(const ei_sample_format_stats_t *in)
+{
+    stats = *in;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_SAMPLE_FORMAT_H
+#define EI_SAMPLE_FORMAT_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include <cstddef>
+#include "firmware-sdk/sensor_aq.h"
+#include "ei_int16_codec.h"
+
+/**
+ * Compact sample file, stored instead of the data acquisition CBOR when
+ * AT+SAMPLEFORMAT is int16 or delta (the host converts it to CBOR).
+ * Values are the sensor reading * scale as int16 (saturated). All fields
+ * are little endian, the header and every block are padded to 4 bytes
+ * with 0xFF (left erased).
+ *
+ * File header: ei_sample_file_header_t, then device_name, device_type and
+ * name, units of every axis, each as [length u8] [characters].
+ *
+ * Blocks: ei_sample_block_header_t, then up to block_samples samples in
+ * columns (all values of the first axis, then the next axis...):
+ * EI_SAMPLE_FORMAT_INT16: values as int16.
+ * EI_SAMPLE_FORMAT_DELTA: per column the first value as zigzag varint,
+ *   every next value as the zigzag varint of its difference to the one
+ *   before (as the BLE raw stream).
+ * The CRC-32 (as zlib.crc32) covers seq, n_samples, len and the payload,
+ * every block decodes on its own. The data ends at an erased block magic.
+ */
+#define EI_SAMPLE_FILE_MAGIC        0x31534945      // "EIS1"
+#define EI_SAMPLE_BLOCK_MAGIC       0xB10C
+#define EI_SAMPLE_SCALE             1000            // m/s2 -> mm/s2
+#define EI_SAMPLE_BLOCK_VALUES      192             // 64 samples of 3 axes
+#define EI_SAMPLE_MAX_STRING        31
+#define EI_SAMPLE_BLOCK_MAX_LEN     (sizeof(ei_sample_block_header_t) + EI_SAMPLE_BLOCK_VALUES * EI_VARINT_MAX_LEN + 3)
+
+typedef enum {
+    EI_SAMPLE_FORMAT_CBOR = 0,
+    EI_SAMPLE_FORMAT_INT16 = 1,
+    EI_SAMPLE_FORMAT_DELTA = 2,
+} ei_sample_format_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             // EI_SAMPLE_FILE_MAGIC
+    uint8_t format;             // ei_sample_format_t
+    uint8_t n_axes;
+    uint16_t scale;             // value = int16 / scale
+    float interval_ms;
+    uint16_t header_len;        // with the strings and padding
+    uint16_t block_samples;     // samples in a full block
+} ei_sample_file_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;             // EI_SAMPLE_BLOCK_MAGIC
+    uint16_t seq;
+    uint16_t n_samples;
+    uint16_t len;               // payload bytes, without padding
+    uint32_t crc32;
+} ei_sample_block_header_t;
+
+typedef struct {
+    uint32_t bytes;             // file length of the last recording
+    uint32_t samples;
+    uint32_t saturated;         // values clipped to int16
+} ei_sample_format_stats_t;
+
+typedef struct {
+    ei_sample_format_t format;
+    uint8_t n_axes;
+    uint16_t block_samples;
+    uint16_t n_samples;         // in the current block
+    uint16_t seq;
+    uint32_t samples;
+    uint32_t saturated;
+    int16_t values[EI_SAMPLE_BLOCK_VALUES];
+} ei_sample_encoder_t;
+
+typedef struct {
+    char name[EI_SAMPLE_MAX_STRING + 1];
+    char units[EI_SAMPLE_MAX_STRING + 1];
+} ei_sample_file_axis_t;
+
+typedef struct {
+    ei_sample_format_t format;
+    uint8_t n_axes;
+    uint16_t scale;
+    uint16_t block_samples;
+    float interval_ms;
+    char device_name[EI_SAMPLE_MAX_STRING + 1];
+    char device_type[EI_SAMPLE_MAX_STRING + 1];
+    ei_sample_file_axis_t axes[EI_MAX_SENSOR_AXES];
+} ei_sample_file_info_t;
+
+void ei_sample_set_format(ei_sample_format_t format);
+ei_sample_format_t ei_sample_get_format(void);
+const char *ei_sample_format_name(ei_sample_format_t format);
+bool ei_sample_format_from_name(const char *name, ei_sample_format_t *format);
+void ei_sample_format_get_stats(ei_sample_format_stats_t *stats);
+void ei_sample_format_set_stats(const ei_sample_format_stats_t *stats);
+
+/**
+ * @brief Start a compact file, the header is written to header
+ * @return header length, 0 if it does not fit in max_len
+ */
+size_t ei_sample_encoder_begin(ei_sample_encoder_t *enc, ei_sample_format_t format,
+                               const sensor_aq_payload_info *payload, uint8_t *header, size_t max_len);
+
+/**
+ * @brief Add one sample of n_axes values
+ * @return true when the block is full (call ei_sample_encoder_flush())
+ */
+bool ei_sample_encoder_add(ei_sample_encoder_t *enc, const float *values);
+
+/**
+ * @brief Encode the samples added since the last flush into block
+ *        (EI_SAMPLE_BLOCK_MAX_LEN bytes)
+ * @return block length with padding, 0 if there were no samples
+ */
+size_t ei_sample_encoder_flush(ei_sample_encoder_t *enc, uint8_t *block);
+
+/**
+ * @brief Read the header of a compact file (host tools)
+ * @return header length, 0 if it is not a compact file
+ */
+size_t ei_sample_file_parse_header(const uint8_t *file, size_t len, ei_sample_file_info_t *info);
+
+/**
+ * @brief Decode one block into interleaved samples (host tools)
+ * @return number of samples decoded, 0 at the end of the data, -1 on a
+ *         damaged block. block_len is set to its length with padding.
+ */
+int ei_sample_file_decode_block(const uint8_t *block, size_t len, const ei_sample_file_info_t *info,
+                                int16_t *values, size_t max_values, size_t *block_len);
+
+#endif /* EI_SAMPLE_FORMAT_H */
@@ -0,0 +1,566 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+#include <cmath>
+
+#include "model-parameters/model_metadata.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "firmware-sdk/ei_device_info_lib.h"
+#include "firmware-sdk/ei_device_memory.h"
+#include "QCBOR/inc/qcbor.h"
+#include "ei_sample_format.h"
+#include "ei_sample_reader.h"
+#include "ei_classifier.h"
+
+/******
+ *
+ * @brief Indexed, chunked reads of the sample file in flash as a signal_t
+ *
+ ******/
+
+#define AUDIO_REF               "Ref-BINARY-i16"
+/* a frame of doubles: array head and 9 bytes per value */
+#define CBOR_MAX_FRAME_LEN      (1 + EI_MAX_SENSOR_AXES * 9)
+#define NO_UNIT                 0xFFFFFFFF
+
+static bool file_open = false;
+static ei_sample_reader_info_t file;
+static ei_sample_file_info_t compact_info;
+
+static uint8_t window[EI_SAMPLE_READER_CHUNK];
+static uint32_t window_addr = 0;
+static uint32_t window_len = 0;
+
+static uint32_t index_addr[EI_SAMPLE_READER_INDEX_SIZE];
+/* samples in a unit, all but the last unit are full */
+static uint32_t unit_samples;
+
+/* next unit to read, the unit in unit_values */
+static uint32_t cursor_unit;
+static uint32_t cursor_addr;
+static uint32_t cached_unit = NO_UNIT;
+static float unit_values[EI_SAMPLE_BLOCK_VALUES];
+static int16_t block_values[EI_SAMPLE_BLOCK_VALUES];
+
+/* window of the recording for run_classifier_batch_strided() */
+static size_t batch_base = 0;
+
+/***************************************
+ *        Flash window
+ **************************************/
+
+/* need bytes from addr in the window (less at the end of the data) */
+static bool window_get(uint32_t addr, size_t need, const uint8_t **data, size_t *available)
+{
+    EiDeviceMemory *mem = EiDeviceInfo::get_device()->get_memory();
+
+    if(addr >= file.data_end) {
+        return false;
+    }
+    if(need > file.data_end - addr) {
+        need = file.data_end - addr;
+    }
+
+    if(addr < window_addr || addr + need > window_addr + window_len) {
+        uint32_t len = file.data_end - addr;
+        if(len > EI_SAMPLE_READER_CHUNK) {
+            len = EI_SAMPLE_READER_CHUNK;
+        }
+
+        window_len = 0;
+        if(mem->read_sample_data(window, addr, len) != len) {
+            ei_printf("ERR: Failed to read the sample at %lu\n", (unsigned long)addr);
+            return false;
+        }
+        window_addr = addr;
+        window_len = len;
+        file.reads++;
+        file.read_bytes += len;
+    }
+
+    *data = &window[addr - window_addr];
+    *available = window_addr + window_len - addr;
+
+    return true;
+}
+
+/***************************************
+ *        Units
+ **************************************/
+
+static bool item_value(const QCBORItem *item, float *value)
+{
+    // half and single precision values are also returned as double
+    if(item->uDataType == QCBOR_TYPE_DOUBLE || item->uDataType == QCBOR_TYPE_FLOAT) {
+        *value = (float)item->val.dfnum;
+    }
+    else if(item->uDataType == QCBOR_TYPE_INT64) {
+        *value = (float)item->val.int64;
+    }
+    else {
+        return false;
+    }
+
+    return true;
+}
+
+/* one sensor_aq frame: an array of n_axes values, or the value if n_axes is 1 */
+static int read_frame(uint32_t addr, size_t *len)
+{
+    QCBORDecodeContext ctx;
+    QCBORItem item;
+    const uint8_t *data;
+    size_t available;
+
+    if(window_get(addr, CBOR_MAX_FRAME_LEN, &data, &available) == false) {
+        return -1;
+    }
+    // 0xFF: break of the values array (or erased flash)
+    if(data[0] == 0xFF) {
+        return 0;
+    }
+
+    UsefulBufC encoded = { data, available };
+    QCBORDecode_Init(&ctx, encoded, QCBOR_DECODE_MODE_NORMAL);
+
+    if(QCBORDecode_GetNext(&ctx, &item) != QCBOR_SUCCESS) {
+        return -1;
+    }
+
+    if(item.uDataType == QCBOR_TYPE_ARRAY) {
+        if(item.val.uCount != file.n_axes) {
+            return -1;
+        }
+        for(uint8_t ix = 0; ix < file.n_axes; ix++) {
+            if(QCBORDecode_GetNext(&ctx, &item) != QCBOR_SUCCESS || item_value(&item, &unit_values[ix]) == false) {
+                return -1;
+            }
+        }
+    }
+    else if(file.n_axes != 1 || item_value(&item, &unit_values[0]) == false) {
+        return -1;
+    }
+
+    *len = UsefulInputBuf_Tell(&ctx.InBuf);
+
+    return 1;
+}
+
+static int read_block(uint32_t addr, size_t *len)
+{
+    const uint8_t *data;
+    size_t available;
+
+    if(window_get(addr, EI_SAMPLE_BLOCK_MAX_LEN, &data, &available) == false) {
+        return -1;
+    }
+
+    int n = ei_sample_file_decode_block(data, available, &compact_info, block_values, EI_SAMPLE_BLOCK_VALUES, len);
+
+    for(int ix = 0; ix < n * compact_info.n_axes; ix++) {
+        unit_values[ix] = (float)block_values[ix] / compact_info.scale;
+    }
+
+    return n;
+}
+
+/* decode the unit at addr into unit_values, 0 at the end of the data */
+static int read_unit(uint32_t addr, size_t *len)
+{
+    if(addr >= file.data_end) {
+        return 0;
+    }
+
+    return (file.type == EI_SAMPLE_FILE_COMPACT) ? read_block(addr, len) : read_frame(addr, len);
+}
+
+static bool load_unit(uint32_t unit)
+{
+    if(unit == cached_unit) {
+        return true;
+    }
+
+    // go on from the last read when it is closer than the index entry
+    if(unit < cursor_unit || unit - cursor_unit >= file.index_stride) {
+        cursor_unit = unit - (unit % file.index_stride);
+        cursor_addr = index_addr[unit / file.index_stride];
+    }
+
+    cached_unit = NO_UNIT;
+
+    while(true) {
+        size_t len;
+
+        if(read_unit(cursor_addr, &len) <= 0) {
+            ei_printf("ERR: Failed to read sample unit %lu at %lu\n", (unsigned long)cursor_unit,
+                (unsigned long)cursor_addr);
+            return false;
+        }
+        cursor_addr += len;
+        cursor_unit++;
+
+        if(cursor_unit - 1 == unit) {
+            cached_unit = unit;
+            return true;
+        }
+    }
+}
+
+static void index_add(uint32_t unit, uint32_t addr)
+{
+    if(unit % file.index_stride != 0) {
+        return;
+    }
+
+    // full: keep every other entry
+    if(file.index_entries == EI_SAMPLE_READER_INDEX_SIZE) {
+        for(uint32_t ix = 0; ix < EI_SAMPLE_READER_INDEX_SIZE / 2; ix++) {
+            index_addr[ix] = index_addr[ix * 2];
+        }
+        file.index_entries = EI_SAMPLE_READER_INDEX_SIZE / 2;
+        file.index_stride *= 2;
+    }
+
+    index_addr[file.index_entries++] = addr;
+}
+
+/***************************************
+ *        Header
+ **************************************/
+
+static bool parse_cbor_header(void)
+{
+    QCBORDecodeContext ctx;
+    QCBORItem item;
+    const uint8_t *data;
+    size_t available;
+    bool found = false;
+
+    if(window_get(0, EI_SAMPLE_READER_CHUNK, &data, &available) == false) {
+        return false;
+    }
+
+    UsefulBufC encoded = { data, available };
+    QCBORDecode_Init(&ctx, encoded, QCBOR_DECODE_MODE_NORMAL);
+
+    while(found == false && QCBORDecode_GetNext(&ctx, &item) == QCBOR_SUCCESS) {
+        if(item.uLabelType != QCBOR_TYPE_TEXT_STRING) {
+            continue;
+        }
+
+        UsefulBufC label = item.label.string;
+
+        if(label.len == 11 && memcmp(label.ptr, "interval_ms", 11) == 0) {
+            item_value(&item, &file.interval_ms);
+        }
+        else if(label.len == 7 && memcmp(label.ptr, "sensors", 7) == 0 && item.uDataType == QCBOR_TYPE_ARRAY) {
+            file.n_axes = (uint8_t)item.val.uCount;
+        }
+        else if(label.len == 6 && memcmp(label.ptr, "values", 6) == 0 && item.uDataType == QCBOR_TYPE_ARRAY) {
+            file.data_start = UsefulInputBuf_Tell(&ctx.InBuf);
+            found = true;
+        }
+    }
+
+    if(found == false || file.n_axes == 0 || file.n_axes > EI_MAX_SENSOR_AXES || file.data_start >= available) {
+        ei_printf("ERR: No sample file (CBOR values array not found)\n");
+        return false;
+    }
+
+    // the microphone writes the reference string and a break, then raw int16
+    if((data[file.data_start] & 0xE0) != 0x60) {
+        return true;
+    }
+
+    UsefulBufC ref = { &data[file.data_start], available - file.data_start };
+    QCBORDecode_Init(&ctx, ref, QCBOR_DECODE_MODE_NORMAL);
+
+    if(QCBORDecode_GetNext(&ctx, &item) != QCBOR_SUCCESS || item.uDataType != QCBOR_TYPE_TEXT_STRING ||
+       item.val.string.len < strlen(AUDIO_REF) || memcmp(item.val.string.ptr, AUDIO_REF, strlen(AUDIO_REF)) != 0) {
+        ei_printf("ERR: Unknown sample data reference\n");
+        return false;
+    }
+
+    file.type = EI_SAMPLE_FILE_AUDIO;
+    file.data_start += UsefulInputBuf_Tell(&ctx.InBuf) + 1;
+
+    return true;
+}
+
+static bool parse_compact_header(void)
+{
+    const uint8_t *data;
+    size_t available;
+
+    if(window_get(0, EI_SAMPLE_READER_CHUNK, &data, &available) == false) {
+        return false;
+    }
+
+    file.data_start = ei_sample_file_parse_header(data, available, &compact_info);
+    if(file.data_start == 0) {
+        ei_printf("ERR: Damaged compact sample header\n");
+        return false;
+    }
+
+    file.type = EI_SAMPLE_FILE_COMPACT;
+    file.n_axes = compact_info.n_axes;
+    file.interval_ms = compact_info.interval_ms;
+
+    return true;
+}
+
+/***************************************
+ *        Public functions
+ **************************************/
+
+bool ei_sample_reader_open(uint32_t length)
+{
+    EiDeviceMemory *mem = EiDeviceInfo::get_device()->get_memory();
+    const uint8_t *data;
+    size_t available;
+
+    file_open = false;
+    memset(&file, 0, sizeof(file));
+    file.type = EI_SAMPLE_FILE_CBOR;
+    file.data_end = (length > 0) ? length : mem->get_available_sample_bytes();
+    file.index_stride = 1;
+    window_len = 0;
+    cached_unit = NO_UNIT;
+
+    if(window_get(0, sizeof(uint32_t), &data, &available) == false || available < sizeof(uint32_t)) {
+        ei_printf("ERR: No sample file\n");
+        return false;
+    }
+
+    uint32_t magic = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+    if((magic == EI_SAMPLE_FILE_MAGIC) ? (parse_compact_header() == false) : (parse_cbor_header() == false)) {
+        return false;
+    }
+
+    if(file.type == EI_SAMPLE_FILE_AUDIO) {
+        if(length == 0) {
+            ei_printf("ERR: LENGTH is required for audio samples\n");
+            return false;
+        }
+        if(file.data_start > file.data_end) {
+            ei_printf("ERR: Sample length is too short\n");
+            return false;
+        }
+        file.samples = (file.data_end - file.data_start) / sizeof(int16_t);
+        file_open = true;
+        return true;
+    }
+
+    unit_samples = (file.type == EI_SAMPLE_FILE_COMPACT) ? compact_info.block_samples : 1;
+
+    // walk the file once, every unit is checked
+    uint32_t addr = file.data_start;
+    uint32_t unit = 0;
+    int n = 0;
+
+    while(true) {
+        size_t len;
+        int last_n = n;
+
+        n = read_unit(addr, &len);
+        if(n == 0) {
+            break;
+        }
+        if(n < 0 || (unit > 0 && (uint32_t)last_n != unit_samples)) {
+            ei_printf("ERR: Damaged sample at %lu\n", (unsigned long)addr);
+            return false;
+        }
+
+        index_add(unit, addr);
+        file.samples += n;
+        addr += len;
+        unit++;
+    }
+
+    if(length == 0) {
+        file.data_end = addr;
+    }
+
+    cursor_unit = 0;
+    cursor_addr = file.data_start;
+    file_open = true;
+
+    return true;
+}
+
+void ei_sample_reader_get_info(ei_sample_reader_info_t *info)
+{
+    *info = file;
+}
+
+const char *ei_sample_reader_type_name(ei_sample_file_type_t type)
+{
+    switch(type) {
+        case EI_SAMPLE_FILE_CBOR:
+            return "cbor";
+        case EI_SAMPLE_FILE_AUDIO:
+            return "audio";
+        case EI_SAMPLE_FILE_COMPACT:
+            return ei_sample_format_name(compact_info.format);
+        default:
+            return "unknown";
+    }
+}
+
+int ei_sample_reader_get_data(size_t offset, size_t length, float *out_ptr)
+{
+    if(file_open == false || offset + length > (size_t)file.samples * file.n_axes) {
+        return -1;
+    }
+
+    while(length > 0) {
+        size_t n;
+
+        if(file.type == EI_SAMPLE_FILE_AUDIO) {
+            const uint8_t *data;
+            size_t available;
+
+            if(window_get(file.data_start + offset * sizeof(int16_t), length * sizeof(int16_t), &data, &available) == false) {
+                return -1;
+            }
+            n = available / sizeof(int16_t);
+            if(n > length) {
+                n = length;
+            }
+            for(size_t ix = 0; ix < n; ix++) {
+                out_ptr[ix] = (float)(int16_t)(data[ix * 2] | (data[ix * 2 + 1] << 8));
+            }
+        }
+        else {
+            uint32_t sample = offset / file.n_axes;
+            uint32_t unit = sample / unit_samples;
+
+            if(load_unit(unit) == false) {
+                return -1;
+            }
+
+            size_t first = offset - (size_t)unit * unit_samples * file.n_axes;
+            size_t in_unit = (size_t)unit_samples * file.n_axes;
+            if((size_t)(unit + 1) * unit_samples > file.samples) {
+                in_unit = (size_t)(file.samples - unit * unit_samples) * file.n_axes;
+            }
+
+            n = in_unit - first;
+            if(n > length) {
+                n = length;
+            }
+            memcpy(out_ptr, &unit_values[first], n * sizeof(float));
+        }
+
+        out_ptr += n;
+        offset += n;
+        length -= n;
+    }
+
+    return 0;
+}
+
+void ei_sample_reader_get_signal(signal_t *signal)
+{
+    signal->total_length = file_open ? (size_t)file.samples * file.n_axes : 0;
+    signal->get_data = &ei_sample_reader_get_data;
+}
+
+static int batch_get_data(size_t offset, size_t length, float *out_ptr)
+{
+    return ei_sample_reader_get_data(batch_base + offset, length, out_ptr);
+}
+
+bool ei_sample_reader_run_impulse(uint32_t length, uint32_t stride, bool debug)
+{
+    static ei_impulse_result_t results[EI_SAMPLE_READER_BATCH];
+    EI_IMPULSE_ERROR res = EI_IMPULSE_OK;
+    size_t n_windows = 0;
+
+    if(ei_sample_reader_open(length) == false) {
+        return false;
+    }
+
+    if(file.n_axes != EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME) {
+        ei_printf("ERR: The sample has %u axes, the impulse expects %u\n", file.n_axes,
+            EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME);
+        return false;
+    }
+    if(fabsf(file.interval_ms - EI_CLASSIFIER_INTERVAL_MS) > EI_CLASSIFIER_INTERVAL_MS * 0.01f) {
+        ei_printf("WARN: Sample interval %.5f ms, the impulse expects %.5f ms\n", file.interval_ms,
+            (float)EI_CLASSIFIER_INTERVAL_MS);
+    }
+
+    if(stride == 0) {
+        stride = EI_CLASSIFIER_SLICE_SIZE;
+    }
+
+    size_t total = (size_t)file.samples * file.n_axes;
+    size_t step = (size_t)stride * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+
+    if(total < EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
+        ei_printf("ERR: The sample is shorter than one window (%lu of %u values)\n", (unsigned long)total,
+            EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE);
+        return false;
+    }
+
+    size_t max_windows = 1 + (total - EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) / step;
+    uint64_t start_ms = ei_read_timer_ms();
+
+    ei_printf("Classifying %lu samples (%s, %u axes), %lu windows\n", (unsigned long)file.samples,
+        ei_sample_reader_type_name(file.type), file.n_axes, (unsigned long)max_windows);
+
+    // a few windows per batch, the results are printed as they come
+    while(n_windows < max_windows && res == EI_IMPULSE_OK) {
+        size_t batch = max_windows - n_windows;
+        size_t n_results = 0;
+
+        if(batch > EI_SAMPLE_READER_BATCH) {
+            batch = EI_SAMPLE_READER_BATCH;
+        }
+
+        signal_t part;
+        batch_base = n_windows * step;
+        part.total_length = EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE + (batch - 1) * step;
+        part.get_data = &batch_get_data;
+
+        res = run_classifier_batch_strided(&part, stride, results, batch, &n_results, debug);
+
+        // one line per window: start time, best label and its score
+        for(size_t ix = 0; ix < n_results; ix++) {
+            size_t best = 0;
+            for(size_t jx = 1; jx < EI_CLASSIFIER_LABEL_COUNT; jx++) {
+                if(results[ix].classification[jx].value > results[ix].classification[best].value) {
+                    best = jx;
+                }
+            }
+            ei_printf("%u,%s,%.5f\n", (unsigned int)((n_windows + ix) * stride * EI_CLASSIFIER_INTERVAL_MS),
+                results[ix].classification[best].label, results[ix].classification[best].value);
+        }
+
+        n_windows += n_results;
+        if(n_results < batch && res == EI_IMPULSE_OK) {
+            break;
+        }
+    }
+
+    ei_printf("Classified %lu windows in %lu ms, %lu flash reads (%lu bytes)\n", (unsigned long)n_windows,
+        (unsigned long)(ei_read_timer_ms() - start_ms), (unsigned long)file.reads,
+        (unsigned long)file.read_bytes);
+
+    return (res == EI_IMPULSE_OK);
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_SAMPLE_READER_H
+#define EI_SAMPLE_READER_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include <cstddef>
+#include "edge-impulse-sdk/classifier/ei_classifier_types.h"
+#include "edge-impulse-sdk/classifier/ei_signal_with_axes.h"
+
+/**
+ * Streaming reader for the sample file in flash (data acquisition CBOR,
+ * audio Ref-BINARY-i16 or a compact int16/delta file), so a stored
+ * recording can be classified again on the device.
+ * Opening the file walks it once, the CBOR frames are decoded with QCBOR.
+ * Every index_stride-th unit (CBOR frame or compact block) is kept in an
+ * index of EI_SAMPLE_READER_INDEX_SIZE addresses, the stride doubles when
+ * it fills up. get_data() seeks from the nearest index entry (or goes on
+ * from the last read) and reads the flash EI_SAMPLE_READER_CHUNK bytes at
+ * a time.
+ * It needs a flash that reads back: with the QSPI driver stubbed
+ * (EI_FLASH_QSPI_DRIVER 0 in ei_flash_memory.h, the default) the device
+ * answers AT+RUNIMPULSESTORED with ERR, the host build reads its
+ * simulated flash.
+ */
+#define EI_SAMPLE_READER_CHUNK          2048
+#define EI_SAMPLE_READER_INDEX_SIZE     512
+/* windows classified per run_classifier_batch_strided() call */
+#define EI_SAMPLE_READER_BATCH          8
+
+typedef enum {
+    EI_SAMPLE_FILE_CBOR = 0,
+    EI_SAMPLE_FILE_AUDIO,
+    EI_SAMPLE_FILE_COMPACT,
+} ei_sample_file_type_t;
+
+typedef struct {
+    ei_sample_file_type_t type;
+    uint8_t n_axes;
+    float interval_ms;
+    uint32_t samples;
+    uint32_t data_start;        // first frame, audio sample or block
+    uint32_t data_end;          // end marker or the given length
+    uint32_t index_entries;
+    uint32_t index_stride;      // units between index entries
+    uint32_t reads;             // flash reads since the file was opened
+    uint32_t read_bytes;
+} ei_sample_reader_info_t;
+
+/**
+ * @brief Open the sample file at the start of the sample area and build
+ *        its index
+ * @param length file length (the upload "to=" offset), 0 to read up to
+ *        the end of the data (not for audio, it has no end marker)
+ */
+bool ei_sample_reader_open(uint32_t length);
+void ei_sample_reader_get_info(ei_sample_reader_info_t *info);
+const char *ei_sample_reader_type_name(ei_sample_file_type_t type);
+
+/**
+ * @brief signal_t get_data of the open file, offset and length count
+ *        values (samples * n_axes)
+ */
+int ei_sample_reader_get_data(size_t offset, size_t length, float *out_ptr);
+
+/**
+ * @brief Signal over the whole open file
+ */
+void ei_sample_reader_get_signal(signal_t *signal);
+
+/**
+ * @brief Classify the stored sample window by window, one result line
+ *        (start time, best label and its score) per window
+ * @param stride window step in samples, 0 for one slice
+ */
+bool ei_sample_reader_run_impulse(uint32_t length, uint32_t stride, bool debug);
+
+#endif /* EI_SAMPLE_READER_H */
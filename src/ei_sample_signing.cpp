@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "firmware-sdk/ei_device_info_lib.h"
+#include "firmware-sdk/ei_device_memory.h"
+#include "ei_sample_signing.h"
+
+/******
+ *
+ * @brief Inline or deferred HS256 signing of the sample file in flash
+ *
+ ******/
+
+static ei_signing_mode_t signing_mode = EI_SIGNING_INLINE;
+static ei_signing_stats_t stats = { 0, 0 };
+static uint8_t read_buffer[EI_SIGNING_READ_SIZE];
+
+/* deferred mode: sensor_aq hashes nothing while recording */
+static int deferred_init(sensor_aq_signing_ctx_t *aq_ctx)
+{
+    (void)aq_ctx;
+    return 0;
+}
+
+static int deferred_update(sensor_aq_signing_ctx_t *aq_ctx, const uint8_t *buffer, size_t buffer_size)
+{
+    (void)aq_ctx;
+    (void)buffer;
+    (void)buffer_size;
+    return 0;
+}
+
+static int deferred_finish(sensor_aq_signing_ctx_t *aq_ctx, uint8_t *buffer)
+{
+    (void)aq_ctx;
+    (void)buffer;
+    return 0;
+}
+
+/* one pass over the stored file, the signature field reads as '0's */
+static bool sign_stored(sensor_aq_ctx *ctx, uint32_t length)
+{
+    EiDeviceMemory *mem = EiDeviceInfo::get_device()->get_memory();
+    ei_hs256_ctx_t *hs_ctx = (ei_hs256_ctx_t *)ctx->signature_ctx->ctx;
+    sensor_aq_signing_ctx_t sign_ctx;
+    char hmac_key[EI_HS256_KEY_MAX + 1];
+    uint32_t sig_start = ctx->signature_index;
+    uint32_t sig_end = sig_start + ctx->hash_buffer.size;
+
+    memcpy(hmac_key, hs_ctx->hmac_key, sizeof(hmac_key));
+    ei_hs256_init_context(&sign_ctx, hs_ctx, hmac_key);
+
+    if(sign_ctx.init(&sign_ctx) != 0) {
+        return false;
+    }
+
+    for(uint32_t offset = 0; offset < length; offset += EI_SIGNING_READ_SIZE) {
+        uint32_t len = length - offset;
+        if(len > EI_SIGNING_READ_SIZE) {
+            len = EI_SIGNING_READ_SIZE;
+        }
+
+        if(mem->read_sample_data(read_buffer, offset, len) != len) {
+            ei_printf("ERR: Failed to read the sample at %lu\n", (unsigned long)offset);
+            sign_ctx.finish(&sign_ctx, ctx->hash_buffer.buffer);
+            return false;
+        }
+
+        if(sig_start < offset + len && sig_end > offset) {
+            uint32_t from = (sig_start > offset) ? sig_start - offset : 0;
+            uint32_t to = (sig_end < offset + len) ? sig_end - offset : len;
+            memset(&read_buffer[from], '0', to - from);
+        }
+
+        if(sign_ctx.update(&sign_ctx, read_buffer, len) != 0) {
+            sign_ctx.finish(&sign_ctx, ctx->hash_buffer.buffer);
+            return false;
+        }
+    }
+
+    return sign_ctx.finish(&sign_ctx, ctx->hash_buffer.buffer) == 0;
+}
+
+void ei_signing_set_mode(ei_signing_mode_t mode)
+{
+    signing_mode = mode;
+}
+
+ei_signing_mode_t ei_signing_get_mode(void)
+{
+    return signing_mode;
+}
+
+const char *ei_signing_mode_name(ei_signing_mode_t mode)
+{
+    switch(mode) {
+        case EI_SIGNING_INLINE:
+            return "inline";
+        case EI_SIGNING_DEFERRED:
+            return "deferred";
+        default:
+            return "unknown";
+    }
+}
+
+bool ei_signing_mode_from_name(const char *name, ei_signing_mode_t *out)
+{
+    for(int ix = EI_SIGNING_INLINE; ix <= EI_SIGNING_DEFERRED; ix++) {
+        if(strcmp(name, ei_signing_mode_name((ei_signing_mode_t)ix)) == 0) {
+            *out = (ei_signing_mode_t)ix;
+            return true;
+        }
+    }
+
+    ei_printf("ERR: Unknown signing mode %s (inline, deferred)\n", name);
+    return false;
+}
+
+void ei_signing_get_stats(ei_signing_stats_t *out)
+{
+    *out = stats;
+}
+
+void ei_signing_init_context(sensor_aq_signing_ctx_t *aq_ctx, ei_hs256_ctx_t *hs_ctx, const char *hmac_key)
+{
+    ei_hs256_init_context(aq_ctx, hs_ctx, hmac_key);
+
+    if(signing_mode == EI_SIGNING_DEFERRED) {
+        aq_ctx->init = &deferred_init;
+        aq_ctx->update = &deferred_update;
+        aq_ctx->finish = &deferred_finish;
+    }
+}
+
+bool ei_signing_write_header(sensor_aq_ctx *ctx, size_t len)
+{
+    EiDeviceMemory *mem = EiDeviceInfo::get_device()->get_memory();
+    const uint8_t *header = (const uint8_t *)ctx->cbor_buffer.ptr;
+    size_t sig_end = ctx->signature_index + ctx->hash_buffer.size;
+
+    if(mem->write_sample_data(header, 0, ctx->signature_index) != ctx->signature_index ||
+       mem->write_sample_data(&header[sig_end], sig_end, len - sig_end) != len - sig_end) {
+        ei_printf("ERR: Failed to write the sample header\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool ei_signing_finish(sensor_aq_ctx *ctx, uint32_t length)
+{
+    EiDeviceMemory *mem = EiDeviceInfo::get_device()->get_memory();
+    uint64_t start = ei_read_timer_ms();
+    uint8_t *hash = ctx->hash_buffer.buffer;
+    char hex[64];
+    bool ret;
+
+    if(signing_mode == EI_SIGNING_DEFERRED) {
+        ret = sign_stored(ctx, length);
+    }
+    else {
+        ret = ctx->signature_ctx->finish(ctx->signature_ctx, hash) == 0;
+    }
+
+    if(ret == false) {
+        ei_printf("ERR: Failed to sign the sample\n");
+        return false;
+    }
+
+    // as sensor_aq_finish, lower case hex of the first half of hash_buffer
+    for(size_t ix = 0; ix < ctx->hash_buffer.size / 2; ix++) {
+        uint8_t first = (hash[ix] >> 4) & 0xf;
+        uint8_t second = hash[ix] & 0xf;
+
+        hex[ix * 2] = first >= 10 ? 'a' - 10 + first : '0' + first;
+        hex[ix * 2 + 1] = second >= 10 ? 'a' - 10 + second : '0' + second;
+    }
+
+    if(mem->write_sample_data((uint8_t *)hex, ctx->signature_index, ctx->hash_buffer.size) != ctx->hash_buffer.size) {
+        ei_printf("ERR: Failed to write the signature\n");
+        return false;
+    }
+
+    stats.bytes = length;
+    stats.sign_ms = (uint32_t)(ei_read_timer_ms() - start);
+
+    return true;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_SAMPLE_SIGNING_H
+#define EI_SAMPLE_SIGNING_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include <cstddef>
+#include "firmware-sdk/sensor_aq.h"
+#include "ei_hmac_sha256.h"
+
+/**
+ * Signing of the sample file in flash (IMU and microphone). The HMAC
+ * covers every byte of the stored file with the signature field as '0'
+ * characters. The field is left erased when the header is written and
+ * the hex signature is programmed into it at the end (NOR flash can only
+ * clear bits, the '0' placeholder could not be overwritten).
+ * EI_SIGNING_INLINE hashes while recording (the default),
+ * EI_SIGNING_DEFERRED records without hashing and signs the stored file
+ * in one pass of EI_SIGNING_READ_SIZE reads after the capture.
+ * Deferred signing depends on reading the file back: the QSPI flash
+ * driver (ei_flash_memory.cpp) is still stubbed on the device, so there
+ * the pass hashes whatever is left in the read buffer instead of the
+ * captured data. Only the host build signs correctly in deferred mode.
+ */
+#define EI_SIGNING_READ_SIZE        4096
+
+typedef enum {
+    EI_SIGNING_INLINE = 0,
+    EI_SIGNING_DEFERRED,
+} ei_signing_mode_t;
+
+typedef struct {
+    uint32_t bytes;         // length of the last signed file
+    uint32_t sign_ms;       // time spent signing after the capture
+} ei_signing_stats_t;
+
+void ei_signing_set_mode(ei_signing_mode_t mode);
+ei_signing_mode_t ei_signing_get_mode(void);
+const char *ei_signing_mode_name(ei_signing_mode_t mode);
+bool ei_signing_mode_from_name(const char *name, ei_signing_mode_t *mode);
+void ei_signing_get_stats(ei_signing_stats_t *stats);
+
+/**
+ * @brief Signing context for sensor_aq_init, in deferred mode its
+ *        updates are no-ops (same HS256 header either way)
+ */
+void ei_signing_init_context(sensor_aq_signing_ctx_t *aq_ctx, ei_hs256_ctx_t *hs_ctx, const char *hmac_key);
+
+/**
+ * @brief Write the CBOR header at the start of the sample area, all but
+ *        the signature field
+ */
+bool ei_signing_write_header(sensor_aq_ctx *ctx, size_t len);
+
+/**
+ * @brief Finish the signature over the first length bytes of the sample
+ *        area and program it into the header
+ */
+bool ei_signing_finish(sensor_aq_ctx *ctx, uint32_t length);
+
+#endif /* EI_SAMPLE_SIGNING_H */
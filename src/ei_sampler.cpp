@@ -22,7 +22,8 @@
 #include "firmware-sdk/ei_device_memory.h"
 #include "firmware-sdk/ei_config_types.h"
 #include "firmware-sdk/sensor_aq.h"
-#include "sensor_aq_mbedtls/sensor_aq_mbedtls_hs256.h"
+#include "ei_sample_signing.h"
+#include "ei_sample_format.h"
 #include "ei_sampler.h"
 
 static size_t ei_write(const void *buffer, size_t size, size_t count, EI_SENSOR_AQ_STREAM *);
@@ -38,7 +39,7 @@ static int write_addr = 0;
 EI_SENSOR_AQ_STREAM stream;
 
 static unsigned char ei_sensor_ctx_buffer[1024];
-static sensor_aq_mbedtls_hs256_ctx_t ei_sensor_hs_ctx;
+static ei_hs256_ctx_t ei_sensor_hs_ctx;
 static sensor_aq_signing_ctx_t ei_sensor_signing_ctx;
 static sensor_aq_ctx ei_sensor_ctx = {
     { ei_sensor_ctx_buffer, 1024 },
@@ -48,6 +49,11 @@ static sensor_aq_ctx ei_sensor_ctx = {
     &ei_time,
 };
 
+/* compact sample file (AT+SAMPLEFORMAT), the header uses ei_sensor_ctx_buffer */
+static ei_sample_encoder_t encoder;
+static uint8_t block_buffer[EI_SAMPLE_BLOCK_MAX_LEN];
+static uint32_t compact_addr;
+
 
 
 /**
@@ -131,8 +137,7 @@ static void ei_write_last_data(void)
 static bool create_header(sensor_aq_payload_info *payload)
 {
     EiDeviceInfo *dev = EiDeviceInfo::get_device();
-    EiDeviceMemory *mem = dev->get_memory();
-    sensor_aq_init_mbedtls_hs256_context(&ei_sensor_signing_ctx, &ei_sensor_hs_ctx, dev->get_sample_hmac_key().c_str());
+    ei_signing_init_context(&ei_sensor_signing_ctx, &ei_sensor_hs_ctx, dev->get_sample_hmac_key().c_str());
 
     size_t tr = sensor_aq_init(&ei_sensor_ctx, payload, NULL, true);
 
@@ -156,11 +161,8 @@ static bool create_header(sensor_aq_payload_info *payload)
         return false;
     }
 
-    // Write to blockdevice
-    tr = mem->write_sample_data((uint8_t*)ei_sensor_ctx.cbor_buffer.ptr, 0, end_of_header_ix);
-
-    if (tr != end_of_header_ix) {
-        ei_printf("Failed to write to header blockdevice (%d)\n", tr);
+    // Write to blockdevice, the signature is written when sampling is done
+    if (ei_signing_write_header(&ei_sensor_ctx, end_of_header_ix) == false) {
         return false;
     }
 
@@ -172,6 +174,47 @@ static bool create_header(sensor_aq_payload_info *payload)
     return true;
 }
 
+/**
+ * @brief      Write the compact file header to FLASH
+ *
+ * @param      payload  The payload
+ *
+ * @return     True on success
+ */
+static bool create_compact_header(sensor_aq_payload_info *payload)
+{
+    EiDeviceMemory *mem = EiDeviceInfo::get_device()->get_memory();
+    size_t len = ei_sample_encoder_begin(&encoder, ei_sample_get_format(), payload,
+        ei_sensor_ctx_buffer, sizeof(ei_sensor_ctx_buffer));
+
+    if (len == 0) {
+        return false;
+    }
+
+    if (mem->write_sample_data(ei_sensor_ctx_buffer, 0, len) != len) {
+        ei_printf("Failed to write to header blockdevice\n");
+        return false;
+    }
+
+    compact_addr = len;
+
+    return true;
+}
+
+/**
+ * @brief      Encode the buffered samples and write them to FLASH as one block
+ */
+static void write_compact_block(void)
+{
+    EiDeviceMemory *mem = EiDeviceInfo::get_device()->get_memory();
+    size_t len = ei_sample_encoder_flush(&encoder, block_buffer);
+
+    if (len > 0) {
+        mem->write_sample_data(block_buffer, compact_addr, len);
+        compact_addr += len;
+    }
+}
+
 /**
  * @brief      Write samples to FLASH in CBOR format
  *
@@ -192,17 +235,40 @@ static bool sample_data_callback(const void *sample_buf, uint32_t byteLenght)
     }
 }
 
+/**
+ * @brief      Collect samples in the compact format, a full block is
+ *             written to FLASH
+ *
+ * @param[in]  sample_buf  The sample buffer
+ * @param[in]  byteLenght  The byte lenght
+ *
+ * @return     true if all required samples are received. Caller should stop sampling,
+ */
+static bool compact_data_callback(const void *sample_buf, uint32_t byteLenght)
+{
+    if(current_sample >= samples_required) {
+        return true;
+    }
+
+    if(ei_sample_encoder_add(&encoder, (const float *)sample_buf)) {
+        write_compact_block();
+    }
+
+    return ++current_sample >= samples_required;
+}
+
 /**
  * @brief      Sampling is finished, signal no uploading file
  *
  * @param      filename          The filename
  * @param[in]  sample_length_ms  The sample length milliseconds
+ * @param[in]  used_bytes        The file length in FLASH
  */
-static void finish_and_upload(char *filename, uint32_t sample_length_ms)
+static void finish_and_upload(char *filename, uint32_t sample_length_ms, uint32_t used_bytes)
 {
     ei_printf("Done sampling, total bytes collected: %u\n", samples_required);
     ei_printf("[1/1] Uploading file to Edge Impulse...\n");
-    ei_printf("Not uploading file, not connected to WiFi. Used buffer, from=%lu, to=%lu.\n", 0, write_addr + headerOffset);
+    ei_printf("Not uploading file, not connected to WiFi. Used buffer, from=%lu, to=%lu.\n", 0, used_bytes);
     ei_printf("OK\n");
 }
 
@@ -220,8 +286,13 @@ bool ei_sampler_start_sampling(void *v_ptr_payload, starter_callback ei_sample_s
     ei_printf("\tHMAC Key: %s\n", dev->get_sample_hmac_key().c_str());
     ei_printf("\tFile name: %s\n", dev->get_sample_label().c_str());
 
+    ei_sample_format_t format = ei_sample_get_format();
+
     samples_required = (uint32_t)((dev->get_sample_length_ms()) / dev->get_sample_interval_ms());
-    sample_buffer_size = (samples_required * sample_size) * 2;
+    sample_buffer_size = samples_required * ei_sampler_sample_bytes(sample_size / sizeof(float));
+    if (format != EI_SAMPLE_FORMAT_CBOR) {
+        sample_buffer_size += sizeof(ei_sensor_ctx_buffer);
+    }
     current_sample = 0;
 
     ei_printf("Samples req: %d\n", samples_required);
@@ -241,11 +312,20 @@ bool ei_sampler_start_sampling(void *v_ptr_payload, starter_callback ei_sample_s
         ei_sleep(2000 - delay_time_ms);
     }
 
-    if (create_header(payload) == false) {
+    if (format != EI_SAMPLE_FORMAT_CBOR) {
+        if (create_compact_header(payload) == false) {
+            return false;
+        }
+    }
+    else if (create_header(payload) == false) {
+        // the signature was started, free the crypto block for the next one
+        ei_hs256_release(&ei_sensor_hs_ctx);
         return false;
     }
 
-    if (ei_sample_start(&sample_data_callback, dev->get_sample_interval_ms()) == false) {
+    if (ei_sample_start((format != EI_SAMPLE_FORMAT_CBOR) ? &compact_data_callback : &sample_data_callback,
+                        dev->get_sample_interval_ms()) == false) {
+        ei_hs256_release(&ei_sensor_hs_ctx);
         return false;
     }
 
@@ -256,20 +336,48 @@ bool ei_sampler_start_sampling(void *v_ptr_payload, starter_callback ei_sample_s
         ei_sleep(10);
     }
 
+    if (format != EI_SAMPLE_FORMAT_CBOR) {
+        write_compact_block();
+
+        ei_sample_format_stats_t stats = { compact_addr, encoder.samples, encoder.saturated };
+        ei_sample_format_set_stats(&stats);
+        if (encoder.saturated > 0) {
+            ei_printf("WARN: %lu values out of the int16 range\n", (unsigned long)encoder.saturated);
+        }
+
+        finish_and_upload((char *)"fd/imu", dev->get_sample_length_ms(), compact_addr);
+
+        return true;
+    }
+
     ei_write_last_data();
     write_addr++;
 
     uint8_t final_byte[] = {0xff};
     int ctx_err = ei_sensor_ctx.signature_ctx->update(ei_sensor_ctx.signature_ctx, final_byte, 1);
     if (ctx_err != 0) {
-        return ctx_err;
+        ei_hs256_release(&ei_sensor_hs_ctx);
+        return false;
     }
 
-    // finish the signing
-    ctx_err =
-        ei_sensor_ctx.signature_ctx->finish(ei_sensor_ctx.signature_ctx, ei_sensor_ctx.hash_buffer.buffer);
+    // finish the signing and write it into the header
+    if (ei_signing_finish(&ei_sensor_ctx, write_addr + headerOffset) == false) {
+        return false;
+    }
 
-    finish_and_upload((char *)"fd/imu", dev->get_sample_length_ms());
+    finish_and_upload((char *)"fd/imu", dev->get_sample_length_ms(), write_addr + headerOffset);
 
     return true;
 }
+
+uint32_t ei_sampler_sample_bytes(uint32_t n_axes)
+{
+    switch (ei_sample_get_format()) {
+        case EI_SAMPLE_FORMAT_INT16:
+            return n_axes * sizeof(int16_t) + 2;
+        case EI_SAMPLE_FORMAT_DELTA:
+            return n_axes * EI_VARINT_MAX_LEN + 2;
+        default:
+            return n_axes * sizeof(float) * 2;
+    }
+}
@@ -21,4 +21,10 @@
 
 bool ei_sampler_start_sampling(void *v_ptr_payload, starter_callback ei_sample_start, uint32_t sample_size);
 
+/**
+ * @brief FLASH bytes to reserve per sample in the current sample format
+ *        (AT+SAMPLEFORMAT), the worst case with the block overhead
+ */
+uint32_t ei_sampler_sample_bytes(uint32_t n_axes);
+
 #endif /* EI_SAMPLER_H_ */
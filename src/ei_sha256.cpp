@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+
+#include "ei_sha256.h"
+#include "mbedtls/sha256.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define EI_SHA256_SHANI     1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+/******
+ *
+ * @brief SHA-256 (FIPS 180-4)
+ *
+ ******/
+
+static const uint32_t H0[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+/* the Mbed TLS block function, on a context that only carries the state */
+static void process_mbedtls(uint32_t *state, const uint8_t *data, size_t blocks)
+{
+    mbedtls_sha256_context ctx;
+
+    memcpy(ctx.state, state, sizeof(ctx.state));
+    for(; blocks > 0; blocks--, data += EI_SHA256_BLOCK_SIZE) {
+        mbedtls_internal_sha256_process(&ctx, data);
+    }
+    memcpy(state, ctx.state, sizeof(ctx.state));
+}
+
+#ifdef EI_SHA256_SHANI
+
+/* round constants, only the SHA-NI rounds need them */
+static const uint32_t K[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+/* state is kept as ABEF and CDGH for sha256rnds2 */
+__attribute__((target("sha,sse4.1")))
+static void process_shani(uint32_t *state, const uint8_t *data, size_t blocks)
+{
+    const __m128i byte_swap = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for(; blocks > 0; blocks--, data += EI_SHA256_BLOCK_SIZE) {
+        __m128i abef = state0;
+        __m128i cdgh = state1;
+        __m128i m[4];
+
+        // four rounds per group, m[g & 3] holds message words 4g..4g+3
+        for(int g = 0; g < 16; g++) {
+            if(g < 4) {
+                m[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&data[g * 16]), byte_swap);
+            }
+            else {
+                __m128i sum = _mm_add_epi32(_mm_sha256msg1_epu32(m[(g - 4) & 3], m[(g - 3) & 3]),
+                    _mm_alignr_epi8(m[(g - 1) & 3], m[(g - 2) & 3], 4));
+                m[g & 3] = _mm_sha256msg2_epu32(sum, m[(g - 1) & 3]);
+            }
+
+            __m128i msg = _mm_add_epi32(m[g & 3], _mm_loadu_si128((const __m128i *)&K[g * 4]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+        }
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+
+static bool cpu_has_shani(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if(__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0 || (ecx & bit_SSE4_1) == 0) {
+        return false;
+    }
+    if(__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) == 0) {
+        return false;
+    }
+
+    return (ebx & (1u << 29)) != 0;
+}
+#endif /* EI_SHA256_SHANI */
+
+typedef void (*process_fn_t)(uint32_t *state, const uint8_t *data, size_t blocks);
+
+static process_fn_t process = NULL;
+
+static process_fn_t select_process(void)
+{
+    if(process == NULL) {
+#ifdef EI_SHA256_SHANI
+        process = cpu_has_shani() ? &process_shani : &process_mbedtls;
+#else
+        process = &process_mbedtls;
+#endif
+    }
+
+    return process;
+}
+
+const char *ei_sha256_implementation(void)
+{
+    return (select_process() == &process_mbedtls) ? "mbedtls" : "sha-ni";
+}
+
+bool ei_sha256_select(const char *name)
+{
+    if(strcmp(name, "mbedtls") == 0) {
+        process = &process_mbedtls;
+        return true;
+    }
+#ifdef EI_SHA256_SHANI
+    if(strcmp(name, "sha-ni") == 0 && cpu_has_shani()) {
+        process = &process_shani;
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+void ei_sha256_start(ei_sha256_ctx_t *ctx)
+{
+    memcpy(ctx->state, H0, sizeof(ctx->state));
+    ctx->length = 0;
+    ctx->buffer_len = 0;
+    select_process();
+}
+
+void ei_sha256_update(ei_sha256_ctx_t *ctx, const uint8_t *data, size_t len)
+{
+    ctx->length += len;
+
+    if(ctx->buffer_len > 0) {
+        size_t n = EI_SHA256_BLOCK_SIZE - ctx->buffer_len;
+        if(n > len) {
+            n = len;
+        }
+        memcpy(&ctx->buffer[ctx->buffer_len], data, n);
+        ctx->buffer_len += n;
+        data += n;
+        len -= n;
+
+        if(ctx->buffer_len < EI_SHA256_BLOCK_SIZE) {
+            return;
+        }
+        process(ctx->state, ctx->buffer, 1);
+        ctx->buffer_len = 0;
+    }
+
+    // whole blocks straight from the input
+    size_t blocks = len / EI_SHA256_BLOCK_SIZE;
+    if(blocks > 0) {
+        process(ctx->state, data, blocks);
+        data += blocks * EI_SHA256_BLOCK_SIZE;
+        len -= blocks * EI_SHA256_BLOCK_SIZE;
+    }
+
+    memcpy(ctx->buffer, data, len);
+    ctx->buffer_len = len;
+}
+
+void ei_sha256_finish(ei_sha256_ctx_t *ctx, uint8_t *digest)
+{
+    uint64_t bits = ctx->length * 8;
+    size_t len = ctx->buffer_len;
+
+    ctx->buffer[len++] = 0x80;
+    if(len > EI_SHA256_BLOCK_SIZE - 8) {
+        memset(&ctx->buffer[len], 0, EI_SHA256_BLOCK_SIZE - len);
+        process(ctx->state, ctx->buffer, 1);
+        len = 0;
+    }
+    memset(&ctx->buffer[len], 0, EI_SHA256_BLOCK_SIZE - 8 - len);
+    for(int ix = 0; ix < 8; ix++) {
+        ctx->buffer[EI_SHA256_BLOCK_SIZE - 1 - ix] = (uint8_t)(bits >> (ix * 8));
+    }
+    process(ctx->state, ctx->buffer, 1);
+
+    for(int ix = 0; ix < 8; ix++) {
+        digest[ix * 4 + 0] = (uint8_t)(ctx->state[ix] >> 24);
+        digest[ix * 4 + 1] = (uint8_t)(ctx->state[ix] >> 16);
+        digest[ix * 4 + 2] = (uint8_t)(ctx->state[ix] >> 8);
+        digest[ix * 4 + 3] = (uint8_t)(ctx->state[ix]);
+    }
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_SHA256_H
+#define EI_SHA256_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Software SHA-256 for the signing path (see ei_hmac_sha256.h). Blocks are
+ * hashed with the Mbed TLS block function, or on x86 hosts with the SHA
+ * extensions with those (checked at run time). On the Cortex-M4 this is the
+ * Mbed TLS compression function, so it is no faster than mbedtls_sha256
+ * there; it only saves the copy of whole blocks, which are hashed straight
+ * from the caller's buffer (a partial block is copied).
+ */
+#define EI_SHA256_BLOCK_SIZE        64
+#define EI_SHA256_DIGEST_SIZE       32
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;                    // bytes hashed
+    uint8_t buffer[EI_SHA256_BLOCK_SIZE];
+    uint8_t buffer_len;
+} ei_sha256_ctx_t;
+
+void ei_sha256_start(ei_sha256_ctx_t *ctx);
+void ei_sha256_update(ei_sha256_ctx_t *ctx, const uint8_t *data, size_t len);
+void ei_sha256_finish(ei_sha256_ctx_t *ctx, uint8_t *digest);
+
+/**
+ * @brief Name of the block function in use ("mbedtls" or "sha-ni")
+ */
+const char *ei_sha256_implementation(void);
+
+/**
+ * @brief Use the named block function (the host benchmark compares them)
+ * @return false if it is not available on this CPU
+ */
+bool ei_sha256_select(const char *name);
+
+#endif /* EI_SHA256_H */
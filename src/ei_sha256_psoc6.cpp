@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "ei_hmac_sha256.h"
+#include "cy_pdl.h"
+
+#if defined(CY_IP_MXCRYPTO)
+
+/******
+ *
+ * @brief SHA-256 on the PSoC 6 crypto block (direct core API). There is
+ *        one engine, a second context started while it is in use gets
+ *        -1 and runs in software. The engine is held from sensor_aq init
+ *        to finish; a capture that ends early releases it, and so does a
+ *        new start of the same context. Nothing else in this firmware
+ *        uses the block: Mbed TLS is built without the _ALT hooks and the
+ *        BT host stack talks HCI to the CYW43012, which does its own
+ *        link encryption.
+ *
+ ******/
+
+#define SHA256_ROUND_MEM_SIZE   256     // crypto v1 round buffer, 64 words
+
+static cy_stc_crypto_sha_state_t hw_state;
+/* block, hash and round memory, crypto v1 is the largest layout */
+static uint32_t hw_buffers[(EI_SHA256_BLOCK_SIZE + EI_SHA256_DIGEST_SIZE + SHA256_ROUND_MEM_SIZE) / 4];
+static volatile bool hw_in_use = false;
+static void *hw_owner = NULL;       // state of the context holding the engine
+
+/* nothing to do unless state holds the engine */
+static void hw_release(void *state)
+{
+    uint32_t interrupts = Cy_SysLib_EnterCriticalSection();
+    bool owned = hw_in_use && (hw_owner == state);
+    Cy_SysLib_ExitCriticalSection(interrupts);
+
+    if(owned) {
+        Cy_Crypto_Core_Sha_Free(CRYPTO, &hw_state);
+        hw_owner = NULL;
+        hw_in_use = false;
+    }
+}
+
+static int hw_start(void *state)
+{
+    uint32_t interrupts = Cy_SysLib_EnterCriticalSection();
+    bool busy = hw_in_use;
+    hw_in_use = true;
+    Cy_SysLib_ExitCriticalSection(interrupts);
+
+    if(busy) {
+        return -1;
+    }
+    hw_owner = state;
+
+    if(Cy_Crypto_Core_IsEnabled(CRYPTO) == false) {
+        Cy_Crypto_Core_Enable(CRYPTO);
+    }
+
+    if(Cy_Crypto_Core_Sha_Init(CRYPTO, &hw_state, CY_CRYPTO_MODE_SHA256, hw_buffers) != CY_CRYPTO_SUCCESS ||
+       Cy_Crypto_Core_Sha_Start(CRYPTO, &hw_state) != CY_CRYPTO_SUCCESS) {
+        hw_owner = NULL;
+        hw_in_use = false;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int hw_update(void *state, const uint8_t *data, size_t len)
+{
+    (void)state;
+
+    return (Cy_Crypto_Core_Sha_Update(CRYPTO, &hw_state, data, len) == CY_CRYPTO_SUCCESS) ? 0 : -1;
+}
+
+static int hw_finish(void *state, uint8_t *digest)
+{
+    (void)state;
+    cy_en_crypto_status_t status = Cy_Crypto_Core_Sha_Finish(CRYPTO, &hw_state, digest);
+
+    Cy_Crypto_Core_Sha_Free(CRYPTO, &hw_state);
+    hw_owner = NULL;
+    hw_in_use = false;
+
+    return (status == CY_CRYPTO_SUCCESS) ? 0 : -1;
+}
+
+static const ei_sha256_backend_t hw_backend = {
+    "crypto",
+    &hw_start,
+    &hw_update,
+    &hw_finish,
+    &hw_release,
+};
+
+const ei_sha256_backend_t *ei_sha256_hw_backend(void)
+{
+    return &hw_backend;
+}
+
+#endif /* CY_IP_MXCRYPTO */
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "ei_framed_protocol.h"
+#include "ei_uart_tx.h"
+
+#ifdef FREERTOS_ENABLED
+#include <FreeRTOS.h>
+#include <task.h>
+#endif
+
+/******
+ *
+ * @brief Console transmit ring. Writers (tasks) append at head, the port
+ *        consumes from tail, from its transfer complete interrupt on the
+ *        device. head and tail run freely and wrap with the mask.
+ *
+ ******/
+
+#define RING_MASK       (EI_UART_TX_RING_SIZE - 1)
+
+static_assert((EI_UART_TX_RING_SIZE & RING_MASK) == 0 && EI_UART_TX_RING_SIZE <= UINT16_MAX + 1,
+    "EI_UART_TX_RING_SIZE must be a power of 2, at most 64 kB");
+
+static uint8_t ring[EI_UART_TX_RING_SIZE];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+static ei_uart_tx_policy_t tx_policy = EI_UART_TX_BLOCK;
+static ei_uart_tx_stats_t stats = { 0, 0, 0, 0, EI_UART_TX_RING_SIZE };
+
+static inline void ring_lock(void)
+{
+#ifdef FREERTOS_ENABLED
+    taskENTER_CRITICAL();
+#endif
+}
+
+static inline void ring_unlock(void)
+{
+#ifdef FREERTOS_ENABLED
+    taskEXIT_CRITICAL();
+#endif
+}
+
+/* copy what fits, @return bytes copied */
+static size_t ring_put(const uint8_t *data, size_t len)
+{
+    ring_lock();
+
+    uint32_t used = head - tail;
+    size_t n = EI_UART_TX_RING_SIZE - used;
+    if(n > len) {
+        n = len;
+    }
+
+    uint32_t start = head & RING_MASK;
+    size_t first = EI_UART_TX_RING_SIZE - start;
+    if(first > n) {
+        first = n;
+    }
+    memcpy(&ring[start], data, first);
+    memcpy(&ring[0], &data[first], n - first);
+    head += n;
+
+    stats.bytes += n;
+    if(used + n > stats.peak) {
+        stats.peak = (uint16_t)((used + n > UINT16_MAX) ? UINT16_MAX : used + n);
+    }
+
+    ring_unlock();
+
+    return n;
+}
+
+size_t ei_uart_tx_write(const uint8_t *data, size_t len)
+{
+    size_t queued = 0;
+    bool waited = false;
+
+    while(true) {
+        queued += ring_put(&data[queued], len - queued);
+        ei_uart_tx_kick();
+
+        if(queued == len) {
+            break;
+        }
+        if(tx_policy == EI_UART_TX_DROP) {
+            ring_lock();
+            stats.dropped += len - queued;
+            ring_unlock();
+            break;
+        }
+        if(waited == false) {
+            ring_lock();
+            stats.waits++;
+            ring_unlock();
+            waited = true;
+        }
+        ei_sleep(1);
+    }
+
+    return queued;
+}
+
+void ei_uart_tx_flush(void)
+{
+    while(head != tail) {
+        ei_uart_tx_kick();
+        ei_sleep(1);
+    }
+}
+
+size_t ei_uart_tx_pending(const uint8_t **data)
+{
+    uint32_t used = head - tail;
+    uint32_t start = tail & RING_MASK;
+    size_t len = EI_UART_TX_RING_SIZE - start;
+
+    *data = &ring[start];
+
+    return (used < len) ? used : len;
+}
+
+void ei_uart_tx_done(size_t len)
+{
+    tail += len;
+}
+
+/**
+ * @brief Without a DMA port the ring goes out through stdio right away
+ */
+__attribute__((weak)) void ei_uart_tx_kick(void)
+{
+    const uint8_t *data;
+    size_t len;
+
+    while((len = ei_uart_tx_pending(&data)) > 0) {
+        fwrite(data, 1, len, stdout);
+        ei_uart_tx_done(len);
+    }
+}
+
+void ei_uart_tx_set_policy(ei_uart_tx_policy_t policy)
+{
+    tx_policy = policy;
+}
+
+ei_uart_tx_policy_t ei_uart_tx_get_policy(void)
+{
+    return tx_policy;
+}
+
+const char *ei_uart_tx_policy_name(ei_uart_tx_policy_t policy)
+{
+    switch(policy) {
+        case EI_UART_TX_BLOCK:
+            return "block";
+        case EI_UART_TX_DROP:
+            return "drop";
+        default:
+            return "unknown";
+    }
+}
+
+bool ei_uart_tx_policy_from_name(const char *name, ei_uart_tx_policy_t *out)
+{
+    for(int ix = EI_UART_TX_BLOCK; ix <= EI_UART_TX_DROP; ix++) {
+        if(strcmp(name, ei_uart_tx_policy_name((ei_uart_tx_policy_t)ix)) == 0) {
+            *out = (ei_uart_tx_policy_t)ix;
+            return true;
+        }
+    }
+
+    ei_printf("ERR: Unknown UART TX policy %s (block, drop)\n", name);
+    return false;
+}
+
+void ei_uart_tx_get_stats(ei_uart_tx_stats_t *out)
+{
+    ring_lock();
+    *out = stats;
+    ring_unlock();
+}
+
+/**
+ * @brief Replaces the weak porting version (a blocking printf), the text
+ *        goes to the ring, or into log frames in framed mode
+ */
+void ei_printf(const char *format, ...)
+{
+    char buffer[256];
+    va_list args;
+
+    va_start(args, format);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if(len <= 0) {
+        return;
+    }
+    if(len >= (int)sizeof(buffer)) {
+        len = sizeof(buffer) - 1;
+    }
+
+    if(ei_framed_log(buffer) == false) {
+        ei_uart_tx_write((const uint8_t *)buffer, len);
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef EI_UART_TX_H
+#define EI_UART_TX_H
+
+/* Include ----------------------------------------------------------------- */
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Transmit ring for the console. ei_printf() copies its text into the ring
+ * and returns, the port sends the ring out in the background (DMA on the
+ * device, see ei_uart_tx_kick()), so printing no longer stalls the caller
+ * for the time the UART needs to shift the text out.
+ * When the ring is full the policy decides: EI_UART_TX_BLOCK waits for
+ * room (no output is lost, the default), EI_UART_TX_DROP drops what does
+ * not fit and counts it.
+ */
+#ifndef EI_UART_TX_RING_SIZE
+#define EI_UART_TX_RING_SIZE        4096    // power of 2
+#endif
+
+typedef enum {
+    EI_UART_TX_BLOCK = 0,
+    EI_UART_TX_DROP,
+} ei_uart_tx_policy_t;
+
+typedef struct {
+    uint32_t bytes;         // bytes queued
+    uint32_t dropped;       // bytes dropped, EI_UART_TX_DROP
+    uint32_t waits;         // writes that waited for room, EI_UART_TX_BLOCK
+    uint16_t peak;          // highest ring usage
+    uint16_t size;
+} ei_uart_tx_stats_t;
+
+/**
+ * @brief Queue bytes for the console, see the policy
+ * @return bytes queued
+ */
+size_t ei_uart_tx_write(const uint8_t *data, size_t len);
+
+/**
+ * @brief Wait until the ring is empty (before writing around it)
+ */
+void ei_uart_tx_flush(void);
+
+void ei_uart_tx_set_policy(ei_uart_tx_policy_t policy);
+ei_uart_tx_policy_t ei_uart_tx_get_policy(void);
+const char *ei_uart_tx_policy_name(ei_uart_tx_policy_t policy);
+bool ei_uart_tx_policy_from_name(const char *name, ei_uart_tx_policy_t *policy);
+void ei_uart_tx_get_stats(ei_uart_tx_stats_t *stats);
+
+/* Port side */
+
+/**
+ * @brief Start sending the ring if the port is idle. Called after every
+ *        write; the weak version sends through stdio right away.
+ */
+void ei_uart_tx_kick(void);
+
+/**
+ * @brief The oldest contiguous run of queued bytes, for one transfer
+ * @return its length, 0 if the ring is empty
+ */
+size_t ei_uart_tx_pending(const uint8_t **data);
+
+/**
+ * @brief len bytes of ei_uart_tx_pending() are sent, may be called from
+ *        the transfer complete interrupt
+ */
+void ei_uart_tx_done(size_t len);
+
+#endif /* EI_UART_TX_H */
@@ -24,9 +24,11 @@
 #include "ei_device_psoc62.h"
 #include "ei_at_handlers.h"
 #include "ei_flash_memory.h"
+#include "ei_model_store.h"
 #include "ei_inertial_sensor.h"
 #include "ei_microphone.h"
 #include "ei_run_impulse.h"
+#include "ei_framed_protocol.h"
 #include "ei_bluetooth_psoc63.h"
 
 #include "cyhal_clock.h"
@@ -118,6 +120,7 @@ int main(void)
     ei_printf(UART_CLEAR_SCREEN);
 
     eidev =  static_cast<EiDevicePSoC62*>(EiDeviceInfo::get_device());
+    ei_model_store_init();
     at = ei_at_init(eidev);
     ei_printf("Type AT+HELP to see a list of commands.\r\n");
     at->print_prompt();
@@ -154,6 +157,14 @@ void ei_task(void* param)
     while(1)
     {
         if(cyhal_uart_getc(&cy_retarget_io_uart_obj, (uint8_t*)&uart_data, 5) == CY_RSLT_SUCCESS) {
+            /* Framed mode, inference is controlled with CONTROL frames */
+            if(ei_framed_is_active()) {
+                ei_framed_handle(uart_data);
+                if(ei_framed_is_active() == false) {
+                    at->print_prompt();
+                }
+                continue;
+            }
             /* Controlling inference */
             if(is_inference_running() && uart_data == 'b') {
                 ei_stop_impulse();
@@ -163,8 +174,9 @@ void ei_task(void* param)
             at->handle(uart_data);
         }
 
-        if(is_inference_running()) {
-            ei_run_impulse();
-        }
+        /* returns at once when stopped, after a stop it frees the resident NN */
+        ei_run_impulse();
+
+        eidev->check_data_output_baudrate();
     }
 }